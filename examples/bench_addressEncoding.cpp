@@ -0,0 +1,212 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+
+#include "benchmark.hpp"
+
+#include <tribe/protocol/messageWriter.hpp>
+#include <tribe/networkAddress.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+
+using namespace Solace;
+using namespace tribe;
+using namespace tribe::bench;
+
+
+namespace {
+
+/// Typical MTU sized datagram
+constexpr std::size_t kDatagramSize = 1400;
+
+/// Number of members of the cluster
+constexpr uint32 kMembers = 10000;
+
+NodeInfo const kSelf{{321}, 19};
+NodeID const kTarget{7177};
+
+
+Address parseAddress(char const* value) {
+	auto maybeAddress = tryParseAddress(StringView{value});
+	if (!maybeAddress) {
+		std::cerr << "Failed to parse address: " << value << '\n';
+		std::exit(EXIT_FAILURE);
+	}
+
+	return *maybeAddress;
+}
+
+
+/// Addresses of members of a cluster, as they are distributed over a network
+struct Distribution {
+	char const*		name;
+	Address			(*address)(uint32 member, std::mt19937& rng);
+};
+
+
+/// Members on one IPv4 /24 subnet, a few members to a host, each member listening on a port of its own
+Address subnet24(uint32 member, std::mt19937&) {
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "10.1.7.%u:%u", member % 254 + 1, 7000 + member / 254);
+	return parseAddress(buffer);
+}
+
+/// Members spread over an IPv4 /16, listening on the same port
+Address subnet16(uint32, std::mt19937& rng) {
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "10.1.%u.%u:7000",
+				  static_cast<unsigned>(rng() % 256), static_cast<unsigned>(rng() % 254 + 1));
+	return parseAddress(buffer);
+}
+
+/// Members on one IPv6 /64 with random interface identifiers, listening on the same port
+Address subnet64(uint32, std::mt19937& rng) {
+	char buffer[96];
+	std::snprintf(buffer, sizeof(buffer), "[fd00:1:2:3:%x:%x:%x:%x]:7000",
+				  static_cast<unsigned>(rng() % 0x10000), static_cast<unsigned>(rng() % 0x10000),
+				  static_cast<unsigned>(rng() % 0x10000), static_cast<unsigned>(rng() % 0x10000));
+	return parseAddress(buffer);
+}
+
+/// Members on two sites: half on an IPv4 /24, half on an IPv6 /64
+Address mixed(uint32 member, std::mt19937& rng) {
+	return (member % 2) ? subnet24(member / 2, rng) : subnet64(member / 2, rng);
+}
+
+/// Members with unrelated public IPv4 addresses and random ports
+Address scattered(uint32, std::mt19937& rng) {
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u:%u",
+				  static_cast<unsigned>(rng() % 223 + 1), static_cast<unsigned>(rng() % 256),
+				  static_cast<unsigned>(rng() % 256), static_cast<unsigned>(rng() % 254 + 1),
+				  static_cast<unsigned>(rng() % 50000 + 1024));
+	return parseAddress(buffer);
+}
+
+
+/// Updates of all of the members of a cluster, ordered by node ID as the snapshot and gossip queue order them
+std::vector<MembershipUpdate> makeUpdates(Distribution const& distribution) {
+	std::mt19937 rng{kMembers};
+	std::unordered_set<Address> addresses;
+	std::vector<MembershipUpdate> updates;
+	updates.reserve(kMembers);
+	for (uint32 i = 0; i < kMembers; ++i) {
+		// Members can not share an address: draw another one if it is taken
+		auto address = distribution.address(i, rng);
+		while (!addresses.insert(address).second) {
+			address = distribution.address(i, rng);
+		}
+
+		updates.push_back(MembershipUpdate{MembershipUpdate::Kind::Alive, {{static_cast<uint32>(rng())}, 1 + i % 4},
+										   address});
+	}
+
+	std::sort(updates.begin(), updates.end(), [](MembershipUpdate const& lhs, MembershipUpdate const& rhs) {
+		return lhs.node.id.value < rhs.node.id.value;
+	});
+
+	return updates;
+}
+
+
+/// Updates of all of the members sent in pongs
+struct Sent {
+	std::size_t		bytes;		//!< Bytes of updates, not counting pong headers
+	uint32			datagrams;	//!< Number of pongs it takes
+};
+
+
+/// Send all of the updates in pongs, each carrying as many of the updates still to send as fit
+Sent sendAll(std::vector<MembershipUpdate> const& updates, std::vector<byte>& buffer, UpdateEncoding encoding) {
+	auto const headerSize = MessageWriter::sizeOf(PongMessage{});
+	auto const total = static_cast<uint32>(updates.size());
+
+	Sent sent{0, 0};
+	for (uint32 offset = 0; offset < total; sent.datagrams += 1) {
+		auto const rest = arrayView(updates.data() + offset, total - offset);
+		ByteWriter writer{wrapMemory(buffer.data(), static_cast<MemoryView::size_type>(buffer.size()))};
+		MessageWriter{writer}.pong(kTarget, kSelf, rest, encoding);
+
+		// Pong ends with the number of the updates it carries
+		offset += buffer[headerSize - 1];
+		sent.bytes += writer.position() - headerSize;
+	}
+
+	return sent;
+}
+
+
+/// Size of gossip with addresses encoded fixed or compactly, and cost of writing it
+void benchAddressEncoding() {
+	Distribution const distributions[] = {
+		{"v4 /24", subnet24},
+		{"v4 /16", subnet16},
+		{"v6 /64", subnet64},
+		{"v4 /24+v6 /64", mixed},
+		{"v4 scattered", scattered},
+	};
+
+	std::cout << "Updates of all of " << kMembers << " members sent in " << kDatagramSize << " byte pongs\n";
+	printLabel("addresses");
+	for (auto const& distribution : distributions) {
+		std::cout << std::setw(14) << distribution.name;
+	}
+	std::cout << '\n';
+
+	std::vector<byte> buffer(kDatagramSize);
+	std::vector<double> fixedSize, compactSize, fixedPongs, compactPongs, fixedWrite, compactWrite;
+	for (auto const& distribution : distributions) {
+		auto const updates = makeUpdates(distribution);
+
+		auto const fixed = sendAll(updates, buffer, UpdateEncoding::Fixed);
+		auto const compact = sendAll(updates, buffer, UpdateEncoding::Compact);
+		fixedSize.push_back(static_cast<double>(fixed.bytes) / kMembers);
+		compactSize.push_back(static_cast<double>(compact.bytes) / kMembers);
+		fixedPongs.push_back(fixed.datagrams);
+		compactPongs.push_back(compact.datagrams);
+
+		fixedWrite.push_back(nsPerOp(1, [&](std::size_t) {
+			doNotOptimize(sendAll(updates, buffer, UpdateEncoding::Fixed).bytes);
+		}, 20) / kMembers);
+		compactWrite.push_back(nsPerOp(1, [&](std::size_t) {
+			doNotOptimize(sendAll(updates, buffer, UpdateEncoding::Compact).bytes);
+		}, 20) / kMembers);
+	}
+
+	printRow("bytes per update, fixed", fixedSize);
+	printRow("bytes per update, compact", compactSize);
+	printRow("pongs, fixed", fixedPongs, 0);
+	printRow("pongs, compact", compactPongs, 0);
+	printRow("write, ns per update, fixed", fixedWrite);
+	printRow("write, ns per update, compact", compactWrite);
+}
+
+}  // namespace
+
+
+/**
+ * Benchmark of encoded size of membership updates, with addresses encoded fixed or compactly.
+ */
+int main() {
+	benchAddressEncoding();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+
+#include "benchmark.hpp"
+
+#include <tribe/flatMap.hpp>
+#include <tribe/persistentMap.hpp>
+#include <tribe/peer.hpp>
+#include <tribe/networkAddress.hpp>
+
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+
+using namespace Solace;
+using namespace tribe;
+using namespace tribe::bench;
+
+
+namespace {
+
+/// Iterate over all of the peers and look up random ones by id, in a map of a given type
+template<typename Map>
+void benchMap(char const* name, std::vector<uint32> const& sizes) {
+	std::vector<double> iteration, lookup, miss;
+	for (auto n : sizes) {
+		Map map;
+		std::vector<NodeID> ids;
+		std::mt19937 rng{n};
+		for (uint32 i = 0; i < n; ++i) {
+			auto const id = NodeID{static_cast<uint32>(rng())};
+			ids.push_back(id);
+			map.try_emplace(id, Peer{i, anyAddress(static_cast<uint16>(i)), i});
+		}
+
+		iteration.push_back(nsPerOp(std::max<std::size_t>(1, 1000000 / n), [&](std::size_t) {
+			uint64 sum = 0;
+			for (auto const& entry : map) {
+				sum += entry.second.generation;
+			}
+			doNotOptimize(sum);
+		}) / n);
+
+		std::uniform_int_distribution<std::size_t> pick{0, ids.size() - 1};
+		lookup.push_back(nsPerOp(1000000, [&](std::size_t) {
+			auto it = map.find(ids[pick(rng)]);
+			doNotOptimize(it->second.generation);
+		}));
+
+		miss.push_back(nsPerOp(1000000, [&](std::size_t i) {
+			auto it = map.find(NodeID{static_cast<uint32>(i * 2654435761u)});
+			doNotOptimize(it == map.end());
+		}));
+	}
+
+	std::cout << name << '\n';
+	printRow("  iteration, ns per peer", iteration, 2);
+	printRow("  lookup of a member, ns", lookup);
+	printRow("  lookup of a non-member, ns", miss);
+}
+
+
+/// Insert keys that only differ in some of their bits, as ids or addresses of a subnet do
+template<typename Map>
+double insertKeys(uint32 count, uint32 shift) {
+	return nsPerOp(1, [&](std::size_t) {
+		Map map;
+		for (uint32 i = 0; i < count; ++i) {
+			map.try_emplace(NodeID{i << shift}, i);
+		}
+		doNotOptimize(map.size());
+	}, 3) / count;
+}
+
+}  // namespace
+
+
+/**
+ * Benchmark of the flat hash map against node based and persistent maps, keyed by NodeID.
+ */
+int main() {
+	std::vector<uint32> const sizes{128, 4096, 65536};
+	std::cout << "Maps of NodeID to Peer\n";
+	printRow("peers", sizes, 0);
+
+	benchMap<FlatMap<NodeID, Peer>>("FlatMap", sizes);
+	benchMap<std::unordered_map<NodeID, Peer>>("std::unordered_map", sizes);
+	benchMap<PersistentMap<NodeID, Peer>>("PersistentMap", sizes);
+
+	constexpr uint32 kKeys = 20000;
+	std::cout << "\nInsertion of " << kKeys << " keys, ns per key\n";
+	printRow("shift", std::vector<uint32>{0, 8, 16}, 0);
+	printRow("FlatMap, key = i << shift", std::vector<double>{
+				insertKeys<FlatMap<NodeID, uint32>>(kKeys, 0),
+				insertKeys<FlatMap<NodeID, uint32>>(kKeys, 8),
+				insertKeys<FlatMap<NodeID, uint32>>(kKeys, 16)});
+	printRow("unordered_map, key = i << shift", std::vector<double>{
+				insertKeys<std::unordered_map<NodeID, uint32>>(kKeys, 0),
+				insertKeys<std::unordered_map<NodeID, uint32>>(kKeys, 8),
+				insertKeys<std::unordered_map<NodeID, uint32>>(kKeys, 16)});
+
+	return EXIT_SUCCESS;
+}
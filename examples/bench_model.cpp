@@ -0,0 +1,203 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+
+#include "benchmark.hpp"
+
+#include <tribe/model.hpp>
+#include <tribe/networkAddress.hpp>
+
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+
+using namespace Solace;
+using namespace tribe;
+using namespace tribe::bench;
+
+
+namespace {
+
+constexpr uint16 kTtl = 8;
+
+
+PeersModel makeModel(uint32 nPeers, bool lazyDecay = false, uint16 ttl = kTtl) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{0}, 1};
+	model.params.lazyDecay = lazyDecay;
+	for (uint32 i = 1; i <= nPeers; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(i)), {{i}, 1}, ttl});
+	}
+
+	return model;
+}
+
+
+/// Cost of a single action applied to a model shared with the caller, against the number of members
+void benchActionCost() {
+	std::vector<uint32> const sizes{128, 1024, 4096, 16384, 65536};
+	std::cout << "Per-action cost, ns: update(PeersModel const&, Action&&)\n";
+	printRow("members", sizes, 0);
+
+	std::vector<double> generation, add, copy;
+	for (auto n : sizes) {
+		auto const model = makeModel(n);
+		std::mt19937 rng{n};
+		std::uniform_int_distribution<uint32> pick{1, n};
+
+		generation.push_back(nsPerOp(20000, [&](std::size_t i) {
+			auto next = update(model, UpdatePeerGeneration{{pick(rng)}, static_cast<uint32>(i + 2), kTtl});
+			doNotOptimize(next.members.size());
+		}));
+
+		add.push_back(nsPerOp(20000, [&](std::size_t i) {
+			auto const id = n + 1 + static_cast<uint32>(i);
+			auto next = update(model, AddPeer{anyAddress(static_cast<uint16>(id)), {{id}, 1}, kTtl});
+			doNotOptimize(next.members.size());
+		}));
+
+		// What each action used to cost: a deep copy of the member table
+		std::unordered_map<NodeID, Peer> members;
+		for (auto const& entry : model.members) {
+			members.emplace(entry.first, entry.second);
+		}
+		copy.push_back(nsPerOp((n > 4096) ? 20 : 200, [&](std::size_t) {
+			auto next = members;
+			doNotOptimize(next.size());
+		}));
+	}
+
+	printRow("UpdatePeerGeneration", generation);
+	printRow("AddPeer", add);
+	printRow("copy of unordered_map<NodeID, Peer>", copy);
+	std::cout << '\n';
+}
+
+
+/// Mixed burst of actions, as a batch of datagrams would produce
+std::vector<Action> makeActions(uint32 count, uint32 nPeers, uint32 seed) {
+	std::mt19937 rng{seed};
+	std::uniform_int_distribution<uint32> pick{1, nPeers};
+
+	std::vector<Action> actions;
+	actions.reserve(count);
+	for (uint32 i = 0; i < count; ++i) {
+		auto const id = pick(rng);
+		switch (i % 3) {
+		case 0: {
+			auto const newId = nPeers + 1 + i;
+			actions.emplace_back(AddPeer{anyAddress(static_cast<uint16>(newId)), {{newId}, 1}, kTtl});
+		} break;
+		case 1:
+			actions.emplace_back(UpdatePeerGeneration{{id}, 2 + i, kTtl});
+			break;
+		default:
+			actions.emplace_back(PronouncePeerDead{{{id}, 1}});
+			break;
+		}
+	}
+
+	return actions;
+}
+
+
+/// Throughput of batches of actions against applying the same actions one by one
+void benchBatches() {
+	constexpr uint32 kMembers = 4096;
+	std::vector<uint32> const batchSizes{1, 16, 256, 4096};
+	std::cout << "Batch throughput, ns per action, " << kMembers << " members\n";
+	printRow("batch size", batchSizes, 0);
+
+	auto const model = makeModel(kMembers);
+	std::vector<double> batched, oneByOne;
+	for (auto batchSize : batchSizes) {
+		auto const actions = makeActions(batchSize, kMembers, batchSize);
+		auto const iterations = std::max<std::size_t>(1, 20000 / batchSize);
+
+		// Note: actions are consumed, so both variants pay for a copy of the batch
+		batched.push_back(nsPerOp(iterations, [&](std::size_t) {
+			auto batch = actions;
+			auto next = update(model, arrayView(batch.data(), static_cast<uint32>(batch.size())));
+			doNotOptimize(next.members.size());
+		}) / batchSize);
+
+		oneByOne.push_back(nsPerOp(iterations, [&](std::size_t) {
+			auto batch = actions;
+			auto next = model;
+			for (auto& action : batch) {
+				next = update(static_cast<PeersModel const&>(next), std::move(action));
+			}
+			doNotOptimize(next.members.size());
+		}) / batchSize);
+	}
+
+	printRow("update(model, ArrayView<Action>)", batched);
+	printRow("update(model, Action) one by one", oneByOne);
+	std::cout << '\n';
+}
+
+
+/// Cost of a decay tick of a model owned by the caller, with liveness of peers decayed eagerly or estimated on read
+void benchDecay() {
+	// Peers live long enough to stay tracked over all of the ticks, decaying slowly as if heard from now and then
+	constexpr uint16 kLongTtl = 60000;
+	auto const decay = DecayPeerInfo{1, 1000, 0.001f};
+
+	std::vector<uint32> const sizes{1024, 4096, 16384, 65536};
+	std::cout << "Decay tick, ns: update(PeersModel&&, DecayPeerInfo)\n";
+	printRow("members", sizes, 0);
+
+	std::vector<double> eager, lazy, read;
+	for (auto n : sizes) {
+		auto eagerModel = makeModel(n, false, kLongTtl);
+		eager.push_back(nsPerOp(200, [&](std::size_t) {
+			eagerModel = update(std::move(eagerModel), DecayPeerInfo{decay});
+		}, 3));
+
+		auto lazyModel = makeModel(n, true, kLongTtl);
+		lazy.push_back(nsPerOp(200, [&](std::size_t) {
+			lazyModel = update(std::move(lazyModel), DecayPeerInfo{decay});
+		}, 3));
+
+		// Lazy estimates are paid for on read instead
+		std::mt19937 rng{n};
+		std::uniform_int_distribution<uint32> pick{1, n};
+		read.push_back(nsPerOp(100000, [&](std::size_t) {
+			auto const& peer = lazyModel.members.find(NodeID{pick(rng)})->second;
+			doNotOptimize(lazyModel.isHealthy(peer));
+		}));
+	}
+
+	printRow("eager sweep", eager);
+	printRow("lazy", lazy);
+	printRow("lazy: isHealthy of a peer", read);
+	std::cout << '\n';
+}
+
+}  // namespace
+
+
+/**
+ * Benchmark of updates of the membership model.
+ */
+int main() {
+	benchActionCost();
+	benchBatches();
+	benchDecay();
+
+	return EXIT_SUCCESS;
+}
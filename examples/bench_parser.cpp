@@ -0,0 +1,308 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+
+#include "benchmark.hpp"
+
+#include <tribe/protocol/messageParser.hpp>
+#include <tribe/protocol/messageWriter.hpp>
+#include <tribe/networkAddress.hpp>
+
+#include <solace/posixErrorDomain.hpp>
+
+#include <cstdlib>
+#include <new>
+#include <variant>
+#include <vector>
+
+
+using namespace Solace;
+using namespace tribe;
+using namespace tribe::bench;
+
+
+namespace {
+
+std::size_t allocationsCount{0};
+
+}  // namespace
+
+// Count heap allocations made by the benchmark
+void* operator new(std::size_t size) {
+	allocationsCount += 1;
+	if (auto memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+
+	throw std::bad_alloc{};
+}
+
+// Note: GCC can not tell that the replacement operator new above allocates with malloc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#pragma GCC diagnostic pop
+
+
+namespace {
+
+/// Typical MTU sized datagram
+constexpr std::size_t kDatagramSize = 1400;
+
+/// Number of membership updates piggybacked on pings, pongs and snapshot chunks
+constexpr uint32 kUpdates = 16;
+
+
+/// Encoded message of a given type
+struct Datagram {
+	char const*			name;
+	std::vector<byte>	data;
+
+	MemoryView view() const { return wrapMemory(data.data(), static_cast<MemoryView::size_type>(data.size())); }
+};
+
+
+template<typename Write>
+Datagram makeDatagram(char const* name, Write&& write) {
+	std::vector<byte> buffer(kDatagramSize);
+	ByteWriter writer{wrapMemory(buffer.data(), static_cast<MemoryView::size_type>(buffer.size()))};
+	MessageWriter messageWriter{writer};
+	write(messageWriter);
+	buffer.resize(writer.position());
+
+	return {name, std::move(buffer)};
+}
+
+
+/// A datagram of each message type
+std::vector<Datagram> makeDatagrams() {
+	std::vector<MembershipUpdate> updates;
+	for (uint32 i = 0; i < kUpdates; ++i) {
+		updates.push_back(MembershipUpdate{MembershipUpdate::Kind::Alive, {{1000 + i}, 1},
+										   anyAddress(static_cast<uint16>(7000 + i))});
+	}
+	auto const view = arrayView(static_cast<MembershipUpdate const*>(updates.data()), kUpdates);
+
+	NodeInfo const self{{321}, 19};
+	NodeID const target{7177};
+	byte const token[32] = {0};
+	auto const redirect = anyAddress(7001);
+
+	return {
+		makeDatagram("JoinReq", [&](MessageWriter& w) { w.join(self, wrapMemory(token), MemoryView{}); }),
+		makeDatagram("JoinAck", [&](MessageWriter& w) { w.joinAck(self, view); }),
+		makeDatagram("JoinRedirect", [&](MessageWriter& w) {
+			w.joinRedirect(makeError(BasicError::Overflow, "full"), redirect);
+		}),
+		makeDatagram("JoinNak", [&](MessageWriter& w) { w.joinNack(makeError(BasicError::Overflow, "full")); }),
+		makeDatagram("PingDirect", [&](MessageWriter& w) { w.ping(self.id, target, view); }),
+		makeDatagram("PongDirect", [&](MessageWriter& w) { w.pong(target, self, view); }),
+		makeDatagram("PingCompact", [&](MessageWriter& w) { w.ping(self.id, target, view, UpdateEncoding::Compact); }),
+		makeDatagram("PongCompact", [&](MessageWriter& w) { w.pong(target, self, view, UpdateEncoding::Compact); }),
+		makeDatagram("SyncPush", [&](MessageWriter& w) { w.syncPush(self, {1, 0, 1}, view); }),
+		makeDatagram("SyncReply", [&](MessageWriter& w) { w.syncReply(self, {1, 0, 1}, view); }),
+		makeDatagram("Broadcast", [&](MessageWriter& w) { w.advertise(self); }),
+	};
+}
+
+
+/// Parse throughput and allocations of each message type, parsed into a message or a view of the datagram
+void benchParse(std::vector<Datagram> const& datagrams) {
+	auto const parser = MessageParser{};
+	constexpr std::size_t kIterations = 200000;
+
+	std::cout << "Parse of a datagram, " << kUpdates << " updates per ping, pong or snapshot chunk\n";
+	printLabel("message type");
+	std::cout << std::setw(14) << "parse, ns" << std::setw(14) << "parseView, ns"
+			  << std::setw(14) << "allocs" << std::setw(14) << "allocs view" << '\n';
+
+	for (auto const& datagram : datagrams) {
+		auto const data = datagram.view();
+
+		auto const allocationsBefore = allocationsCount;
+		auto const parseNs = nsPerOp(kIterations, [&](std::size_t) {
+			ByteReader reader{data};
+			auto message = parser.parse(reader);
+			doNotOptimize(message.isOk());
+		});
+		auto const allocations = allocationsCount - allocationsBefore;
+
+		auto const viewAllocationsBefore = allocationsCount;
+		auto const viewNs = nsPerOp(kIterations, [&](std::size_t) {
+			ByteReader reader{data};
+			auto message = parser.parseView(reader);
+			doNotOptimize(message.isOk());
+		});
+		auto const viewAllocations = allocationsCount - viewAllocationsBefore;
+
+		// Note: nsPerOp runs the function 5 times as many times as it is asked to
+		printLabel(datagram.name);
+		printColumn(parseNs);
+		printColumn(viewNs);
+		printColumn(static_cast<double>(allocations) / (5 * kIterations), 2);
+		printColumn(static_cast<double>(viewAllocations) / (5 * kIterations), 2);
+		std::cout << '\n';
+	}
+	std::cout << '\n';
+}
+
+
+/// Decode a million mixed datagrams in batches, as received by recvmmsg, against one datagram at a time
+void benchBatch(std::vector<Datagram> const& datagrams) {
+	constexpr uint32 kTotal = 1000000;
+	auto const parser = MessageParser{};
+
+	// Mostly pings and pongs, with the odd membership and sync message: indexes into datagrams
+	uint32 const mix[] = {4, 5, 6, 7, 4, 5, 6, 7, 4, 5, 6, 7, 0, 1, 2, 3, 8, 9, 10, 4};
+
+	std::cout << "Decode of " << kTotal << " mixed datagrams, ms\n";
+	printRow("batch size", std::vector<uint32>{64, 1024}, 0);
+
+	std::vector<double> batched, single;
+	for (uint32 batchSize : {64u, 1024u}) {
+		std::vector<MemoryView> batch;
+		std::vector<Address> sources;
+		for (uint32 i = 0; i < batchSize; ++i) {
+			batch.push_back(datagrams[mix[i % (sizeof(mix) / sizeof(mix[0]))]].view());
+			sources.push_back(anyAddress(static_cast<uint16>(i)));
+		}
+		std::vector<MessageParser::ParsedDatagram> messages(batchSize);
+		std::vector<uint32> failed(batchSize);
+
+		auto const batches = kTotal / batchSize;
+		batched.push_back(nsPerOp(1, [&](std::size_t) {
+			for (uint32 i = 0; i < batches; ++i) {
+				auto result = parser.parseBatch(arrayView(static_cast<MemoryView const*>(batch.data()), batchSize),
+												arrayView(static_cast<Address const*>(sources.data()), batchSize),
+												arrayView(messages.data(), batchSize),
+												arrayView(failed.data(), batchSize));
+				doNotOptimize(result.isOk());
+			}
+		}, 3) / 1e6);
+
+		single.push_back(nsPerOp(1, [&](std::size_t) {
+			for (uint32 i = 0; i < batches; ++i) {
+				for (auto const& data : batch) {
+					ByteReader reader{data};
+					auto message = parser.parseView(reader);
+					doNotOptimize(message.isOk());
+				}
+			}
+		}, 3) / 1e6);
+	}
+
+	printRow("parseBatch", batched);
+	printRow("parseView of each datagram", single);
+	std::cout << '\n';
+}
+
+
+/// Handler of parsed messages, that only counts them by type
+struct CountingHandler {
+	uint64 counts[8]{};
+
+	void onJoinRequest(ConnectRequest const&) { counts[0] += 1; }
+	void onJoinAck(ConnectResponseAck const&) { counts[1] += 1; }
+	void onJoinRedirect(ConnectResponseRedirectView const&) { counts[2] += 1; }
+	void onJoinRejected(ConnectResponseRejectedView const&) { counts[3] += 1; }
+	void onPing(PingMessage const&) { counts[4] += 1; }
+	void onPong(PongMessage const&) { counts[5] += 1; }
+	void onSync(SyncMessage const&) { counts[6] += 1; }
+	void onBroadcast(BroadcastMessage const&) { counts[7] += 1; }
+
+	// Messages parsed into a variant, that own their data
+	void onJoinRedirect(ConnectResponseRedirect const&) { counts[2] += 1; }
+	void onJoinRejected(ConnectResponseRejected const&) { counts[3] += 1; }
+};
+
+
+/// Visitor of message variants, that calls the handler callback for the type of message
+struct Visitor {
+	CountingHandler& handler;
+
+	void operator() (ConnectRequest const& msg) { handler.onJoinRequest(msg); }
+	void operator() (ConnectResponseAck const& msg) { handler.onJoinAck(msg); }
+	void operator() (ConnectResponseRedirect const& msg) { handler.onJoinRedirect(msg); }
+	void operator() (ConnectResponseRedirectView const& msg) { handler.onJoinRedirect(msg); }
+	void operator() (ConnectResponseRejected const& msg) { handler.onJoinRejected(msg); }
+	void operator() (ConnectResponseRejectedView const& msg) { handler.onJoinRejected(msg); }
+	void operator() (PingMessage const& msg) { handler.onPing(msg); }
+	void operator() (PongMessage const& msg) { handler.onPong(msg); }
+	void operator() (SyncMessage const& msg) { handler.onSync(msg); }
+	void operator() (BroadcastMessage const& msg) { handler.onBroadcast(msg); }
+};
+
+
+/// Dispatch of parsed messages to typed callbacks against parsing a message variant and visiting it
+void benchDispatch(std::vector<Datagram> const& datagrams) {
+	auto const parser = MessageParser{};
+	constexpr std::size_t kIterations = 200000;
+	CountingHandler handler;
+
+	std::cout << "Parse and handle a datagram, ns\n";
+	printLabel("message type");
+	std::cout << std::setw(14) << "parse+visit" << std::setw(14) << "view+visit" << std::setw(14) << "dispatch" << '\n';
+
+	for (auto const& datagram : datagrams) {
+		auto const data = datagram.view();
+
+		auto const parseNs = nsPerOp(kIterations, [&](std::size_t) {
+			ByteReader reader{data};
+			auto message = parser.parse(reader);
+			if (message) {
+				std::visit(Visitor{handler}, *message);
+			}
+		});
+
+		auto const viewNs = nsPerOp(kIterations, [&](std::size_t) {
+			ByteReader reader{data};
+			auto message = parser.parseView(reader);
+			if (message) {
+				std::visit(Visitor{handler}, *message);
+			}
+		});
+
+		auto const dispatchNs = nsPerOp(kIterations, [&](std::size_t) {
+			ByteReader reader{data};
+			auto result = parser.dispatch(reader, handler);
+			doNotOptimize(result.isOk());
+		});
+
+		printLabel(datagram.name);
+		printColumn(parseNs);
+		printColumn(viewNs);
+		printColumn(dispatchNs);
+		std::cout << '\n';
+	}
+	doNotOptimize(handler.counts);
+	std::cout << '\n';
+}
+
+}  // namespace
+
+
+/**
+ * Benchmark of parsing of gossip messages.
+ */
+int main() {
+	auto const datagrams = makeDatagrams();
+	benchParse(datagrams);
+	benchBatch(datagrams);
+	benchDispatch(datagrams);
+
+	return EXIT_SUCCESS;
+}
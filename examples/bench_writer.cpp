@@ -0,0 +1,243 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+
+#include "benchmark.hpp"
+
+#include <tribe/protocol/messageWriter.hpp>
+#include <tribe/networkAddress.hpp>
+
+#include <netinet/in.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+using namespace Solace;
+using namespace tribe;
+using namespace tribe::bench;
+
+
+namespace {
+
+/// Typical MTU sized datagram
+constexpr std::size_t kDatagramSize = 1400;
+
+NodeInfo const kSelf{{321}, 19};
+NodeID const kTarget{7177};
+
+/// Size of a pong without updates: type, requestor, node info, ttl and updates count
+constexpr std::size_t kPongSize = 1 + 4 + 8 + 1 + 1;
+
+
+/**
+ * Messages written field by field with bounds checked writes, as they were written before message schemas.
+ * Layout is the same as that of the messages written by MessageWriter.
+ * Note: writers of whole messages are not inlined, as MessageWriter calls into the library are not either.
+ */
+void writeType(ByteWriter& writer, Gossip::MessageType type) {
+	writer.writeLE(static_cast<byte>(type));
+}
+
+void writeNode(ByteWriter& writer, NodeInfo const& node) {
+	writer.writeLE(node.id.value);
+	writer.writeLE(node.gen);
+}
+
+void writeData(ByteWriter& writer, MemoryView data) {
+	writer.writeLE(static_cast<Gossip::size_type>(data.size()));
+	writer.write(data);
+}
+
+[[gnu::noinline]] void handWrittenPing(ByteWriter& writer) {
+	writeType(writer, Gossip::MessageType::PingDirect);
+	writer.writeLE(kSelf.id.value);
+	writer.writeLE(kTarget.value);
+	writer.writeLE(uint8{0});	// ttl
+	writer.writeLE(uint8{0});	// updates count
+}
+
+[[gnu::noinline]] void handWrittenPong(ByteWriter& writer) {
+	writeType(writer, Gossip::MessageType::PongDirect);
+	writer.writeLE(kTarget.value);
+	writeNode(writer, kSelf);
+	writer.writeLE(uint8{0});	// ttl
+	writer.writeLE(uint8{0});	// updates count
+}
+
+[[gnu::noinline]] void handWrittenPong(ByteWriter& writer, NodeID requestor, ArrayView<MembershipUpdate const> updates) {
+	auto const count = MessageWriter::piggybackCapacity(updates, writer.remaining() - kPongSize);
+
+	writeType(writer, Gossip::MessageType::PongDirect);
+	writer.writeLE(requestor.value);
+	writeNode(writer, kSelf);
+	writer.writeLE(uint8{0});	// ttl
+	writer.writeLE(static_cast<uint8>(count));
+	for (uint32 i = 0; i < count; ++i) {
+		auto const& update = updates[i];
+		auto const& addr = *reinterpret_cast<sockaddr_in const*>(&update.address.addr);
+
+		writer.writeLE(static_cast<uint8>(update.kind));
+		writeNode(writer, update.node);
+		writer.writeLE(update.address.addr.ss_family);
+		writer.write(addr.sin_port);
+		writer.write(addr.sin_addr.s_addr);
+	}
+}
+
+[[gnu::noinline]] void handWrittenJoin(ByteWriter& writer, MemoryView token) {
+	writeType(writer, Gossip::MessageType::JoinReq);
+	writeNode(writer, kSelf);
+	writeData(writer, token);
+	writeData(writer, MemoryView{});
+}
+
+[[gnu::noinline]] void handWrittenAdvertise(ByteWriter& writer) {
+	writeType(writer, Gossip::MessageType::Broadcast);
+	writeNode(writer, kSelf);
+}
+
+
+/// Time writing a message both ways, checking that both write the same bytes
+template<typename Generated, typename HandWritten>
+void benchMessage(char const* name, Generated&& generated, HandWritten&& handWritten) {
+	std::vector<byte> buffer(kDatagramSize);
+	std::vector<byte> expected(kDatagramSize);
+	auto const bufferView = wrapMemory(buffer.data(), static_cast<MemoryView::size_type>(buffer.size()));
+
+	ByteWriter expectedWriter{wrapMemory(expected.data(), static_cast<MemoryView::size_type>(expected.size()))};
+	handWritten(expectedWriter);
+	ByteWriter writer{bufferView};
+	MessageWriter messageWriter{writer};
+	generated(messageWriter);
+	if (writer.position() != expectedWriter.position() ||
+		std::memcmp(buffer.data(), expected.data(), writer.position()) != 0) {
+		std::cerr << name << ": messages written differ\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	constexpr std::size_t kIterations = 1000000;
+	auto const generatedNs = nsPerOp(kIterations, [&](std::size_t) {
+		ByteWriter dest{bufferView};
+		MessageWriter w{dest};
+		generated(w);
+		doNotOptimize(dest.position());
+	});
+
+	auto const handWrittenNs = nsPerOp(kIterations, [&](std::size_t) {
+		ByteWriter dest{bufferView};
+		handWritten(dest);
+		doNotOptimize(dest.position());
+	});
+
+	printLabel(name);
+	printColumn(static_cast<double>(writer.position()), 0);
+	printColumn(generatedNs);
+	printColumn(handWrittenNs);
+	std::cout << '\n';
+}
+
+
+/// Messages of a fixed layout, written by MessageWriter from their schema against written by hand
+void benchSchemaWriter() {
+	byte const token[32] = {0};
+
+	std::cout << "Write of a message, ns\n";
+	printLabel("message");
+	std::cout << std::setw(14) << "bytes" << std::setw(14) << "schema" << std::setw(14) << "hand-written" << '\n';
+
+	benchMessage("ping",
+				 [](MessageWriter& w) { w.ping(kSelf.id, kTarget); },
+				 [](ByteWriter& w) { handWrittenPing(w); });
+	benchMessage("pong",
+				 [](MessageWriter& w) { w.pong(kTarget, kSelf); },
+				 [](ByteWriter& w) { handWrittenPong(w); });
+	benchMessage("join, 32 byte token",
+				 [&](MessageWriter& w) { w.join(kSelf, wrapMemory(token), MemoryView{}); },
+				 [&](ByteWriter& w) { handWrittenJoin(w, wrapMemory(token)); });
+	benchMessage("advertise",
+				 [](MessageWriter& w) { w.advertise(kSelf); },
+				 [](ByteWriter& w) { handWrittenAdvertise(w); });
+	std::cout << '\n';
+}
+
+
+/// Pongs to each of the peers probed, as a node of a large cluster sends them, with and without updates piggybacked
+void benchPongLoad() {
+	constexpr uint32 kPeers = 10000;
+	std::vector<double> const updateCounts{0, 8, 32};
+
+	std::cout << "Write of " << kPeers << " pongs, one to each peer probed, us\n";
+	printRow("updates piggybacked", updateCounts, 0);
+
+	std::vector<byte> buffer(kDatagramSize);
+	std::vector<byte> expected(kDatagramSize);
+	auto const bufferView = wrapMemory(buffer.data(), static_cast<MemoryView::size_type>(buffer.size()));
+
+	std::vector<double> generated, handWritten;
+	for (auto updatesCount : updateCounts) {
+		std::vector<MembershipUpdate> updates;
+		for (uint32 i = 0; i < updatesCount; ++i) {
+			updates.push_back(MembershipUpdate{MembershipUpdate::Kind::Alive, {{1000 + i}, 1},
+											   anyAddress(static_cast<uint16>(7000 + i))});
+		}
+		auto const view = arrayView(static_cast<MembershipUpdate const*>(updates.data()),
+									static_cast<uint32>(updates.size()));
+
+		ByteWriter expectedWriter{wrapMemory(expected.data(), static_cast<MemoryView::size_type>(expected.size()))};
+		handWrittenPong(expectedWriter, kTarget, view);
+		ByteWriter writer{bufferView};
+		MessageWriter{writer}.pong(kTarget, kSelf, view);
+		if (writer.position() != expectedWriter.position() ||
+			std::memcmp(buffer.data(), expected.data(), writer.position()) != 0) {
+			std::cerr << "pong: messages written differ\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		generated.push_back(nsPerOp(100, [&](std::size_t) {
+			for (uint32 peer = 0; peer < kPeers; ++peer) {
+				ByteWriter dest{bufferView};
+				MessageWriter{dest}.pong(NodeID{peer}, kSelf, view);
+				doNotOptimize(dest.position());
+			}
+		}) / 1000);
+
+		handWritten.push_back(nsPerOp(100, [&](std::size_t) {
+			for (uint32 peer = 0; peer < kPeers; ++peer) {
+				ByteWriter dest{bufferView};
+				handWrittenPong(dest, NodeID{peer}, view);
+				doNotOptimize(dest.position());
+			}
+		}) / 1000);
+	}
+
+	printRow("MessageWriter::pong", generated);
+	printRow("hand-written, checked", handWritten);
+	std::cout << '\n';
+}
+
+}  // namespace
+
+
+/**
+ * Benchmark of writing of gossip messages.
+ */
+int main() {
+	benchSchemaWriter();
+	benchPongLoad();
+
+	return EXIT_SUCCESS;
+}
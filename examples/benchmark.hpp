@@ -0,0 +1,86 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe benchmarks
+ *	@file examples/benchmark.hpp
+ *	@brief		Minimal timing helpers shared by bench_* examples
+ ******************************************************************************/
+#pragma once
+#ifndef TRIBE_EXAMPLES_BENCHMARK_HPP
+#define TRIBE_EXAMPLES_BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+
+namespace tribe {
+namespace bench {
+
+/// Keep the compiler from optimising away computation of a value that is otherwise unused
+template<typename T>
+inline void doNotOptimize(T const& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+/**
+ * Time a function called `iterations` times.
+ * The measurement is repeated a number of times and the fastest run is kept, as the least disturbed by the system.
+ * @return Nanoseconds per call.
+ */
+template<typename F>
+double nsPerOp(std::size_t iterations, F&& f, int repeats = 5) {
+	using Clock = std::chrono::steady_clock;
+
+	auto best = std::numeric_limits<double>::max();
+	for (int r = 0; r < repeats; ++r) {
+		auto const start = Clock::now();
+		for (std::size_t i = 0; i < iterations; ++i) {
+			f(i);
+		}
+		auto const elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		best = std::min(best, elapsed / static_cast<double>(iterations));
+	}
+
+	return best;
+}
+
+
+/// Print a row of a results table: a label followed by columns of numbers
+inline void printLabel(char const* label) {
+	std::cout << std::left << std::setw(36) << label << std::right;
+}
+
+inline void printColumn(double value, int precision = 1) {
+	std::cout << std::setw(14) << std::fixed << std::setprecision(precision) << value;
+}
+
+template<typename Values>
+void printRow(char const* label, Values const& values, int precision = 1) {
+	printLabel(label);
+	for (auto value : values) {
+		printColumn(static_cast<double>(value), precision);
+	}
+	std::cout << '\n';
+}
+
+}  // namespace bench
+}  // namespace tribe
+#endif  // TRIBE_EXAMPLES_BENCHMARK_HPP
@@ -0,0 +1,103 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_DECAYSCHEDULER_HPP
+#define TRIBE_DECAYSCHEDULER_HPP
+
+#include "model.hpp"
+#include "localHealth.hpp"
+#include "flatMap.hpp"
+#include "timerWheel.hpp"
+
+
+namespace tribe {
+
+/**
+ * Timer driven alternative to periodic DecayPeerInfo sweeps.
+ *
+ * Instead of decaying every peer on every tick, the scheduler computes when the next observable change
+ * of each peer happens - transition to Suspected or Dead, TTL running out or expiry - and sets a timer for it.
+ * A tick only updates the peers whose timers expire, so its cost is O(changing peers) rather than O(all peers).
+ *
+ * Each tick is equivalent to `update(model, DecayPeerInfo{1, decayTimeMs, decayRate, mode})` as far as peers states,
+ * health and membership are concerned. Probability and TTL of a peer are only brought up to date
+ * when its timer expires, or for all of the peers by `sync`.
+ *
+ * Note: a peer is only decayed once it is tracked. Call `track` for every peer added or refreshed in the model.
+ */
+struct DecayScheduler {
+	using Tick = TimerWheel<NodeID>::Tick;
+
+	/// Ticks to look ahead for the next change of a peer before re-evaluating.
+	static constexpr Tick kMaxLookahead = 1 << 12;
+
+	/// Create a scheduler using decay parameters of the membership settings
+	explicit DecayScheduler(MembershipSettings const& settings) noexcept;
+
+	DecayScheduler(Solace::uint32 decayTimeMs, Solace::float32 decayRate,
+				   DecayMode mode = DecayMode::Linear) noexcept;
+
+	/// Number of ticks processed
+	Tick now() const noexcept { return _wheel.now(); }
+
+	/// Number of peers tracked
+	Solace::uint64 size() const noexcept { return _entries.size(); }
+
+	/// (Re)start tracking a peer, given its liveness as of now.
+	void track(NodeID id, Peer::Liveness const& liveness);
+
+	/// Start tracking all the members of the model.
+	void track(PeersModel const& model);
+
+	/// Stop tracking the peer.
+	void forget(NodeID id);
+
+	/// Move forward by one tick: update peers that change state and remove expired ones and decay seeds.
+	PeersModel tick(PeersModel&& model);
+
+	/**
+	 * Move forward by the number of ticks elapsed, stretched by local health: ticks as many times
+	 * as the decay clock of local health advances. @see LocalHealth::advance
+	 * This is equivalent to applying `health.decay(settings, elapsed)` to the model.
+	 */
+	PeersModel advance(PeersModel&& model, LocalHealth& health, LocalHealth::Tick elapsed);
+
+	/**
+	 * Bring probability and TTL of all the tracked peers up to date.
+	 * Note: the model must be the one the scheduler ticks, as peers are only decayed from the last sync on.
+	 */
+	PeersModel sync(PeersModel&& model);
+
+private:
+
+	struct Entry {
+		Tick			synced;		//!< Tick at which liveness of the peer in the model was accurate
+		Tick			deadline;	//!< Tick of the next change
+		Peer::Liveness	next;		//!< Liveness of the peer at the deadline
+	};
+
+	void schedule(NodeID id, Peer::Liveness const& liveness);
+
+	Peer::Liveness replay(Peer::Liveness value, Tick ticks) const noexcept;
+
+private:
+	Solace::float32				_decayFactor;
+	FlatMap<NodeID, Entry>		_entries;
+	TimerWheel<NodeID>			_wheel;
+};
+
+}  // namespace tribe
+#endif  // TRIBE_DECAYSCHEDULER_HPP
@@ -0,0 +1,128 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_DISSEMINATIONQUEUE_HPP
+#define TRIBE_DISSEMINATIONQUEUE_HPP
+
+#include "flatMap.hpp"
+#include "protocol/gossip.hpp"
+
+#include <solace/arrayView.hpp>
+
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * Queue of membership updates waiting to be piggybacked on pings and pongs.
+ *
+ * Each update is retransmitted `ceil(lambda * log10(N + 1))` times, N being the size of the cluster,
+ * after which it is considered to have been disseminated and is dropped.
+ * Updates that have been sent the fewest times go first, newer updates first among equals.
+ * A queue holds at most one update per node: only a newer update about a node replaces the pending one.
+ * An update is newer if it is about a later generation of the node, or is about the same generation
+ * and takes precedence: Dead over Suspect over Alive. Suspicion of the same generation by another member
+ * is newer too. Copies of the pending update, as re-gossiped by peers, are rejected.
+ *
+ * Pending updates are kept in a binary heap, so picking k updates out of n costs O(k log n).
+ */
+struct DisseminationQueue {
+	using size_type = Solace::uint32;
+
+	/// Default retransmit multiplier, lambda.
+	static constexpr Solace::float32 kDefaultRetransmitMultiplier = 4;
+
+	/// Max number of updates that do not fit into the budget a fill looks past, in search of smaller updates
+	static constexpr size_type kMaxSkips = 8;
+
+	explicit DisseminationQueue(Solace::float32 retransmitMultiplier = kDefaultRetransmitMultiplier) noexcept
+		: _retransmitMultiplier{retransmitMultiplier}
+	{}
+
+	/// Number of updates pending
+	size_type size() const noexcept { return static_cast<size_type>(_heap.size()); }
+	bool empty() const noexcept { return _heap.empty(); }
+
+	/// Check if there is an update pending for a node
+	bool contains(NodeID id) const { return (_pending.find(id) != _pending.end()); }
+
+	/// Number of times an update is to be transmitted in a cluster of a given size
+	size_type retransmitLimit(size_type clusterSize) const noexcept;
+
+	/**
+	 * Queue an update to be disseminated.
+	 * @return True if the update has been queued, false if it is no newer than the one pending for the node.
+	 */
+	bool enqueue(MembershipUpdate const& update);
+
+	/// Drop update pending for a node, if any.
+	bool erase(NodeID id);
+
+	/**
+	 * Pick updates to piggyback on a message, least transmitted first.
+	 * Picked updates are counted as transmitted once and dropped once sent retransmitLimit times.
+	 * Updates that do not fit into the budget left are skipped, up to kMaxSkips of them, and stay as they are:
+	 * a large update does not hold smaller ones back. Picking stops once the budget is used up
+	 * or there is no room left in dest, and at most as many updates as a message can carry are picked.
+	 * Updates picked for compact encoding are ordered by node ID, so that all of them fit once delta-encoded.
+	 *
+	 * @param budget Number of bytes available for encoded updates.
+	 * @param clusterSize Number of nodes in the cluster, to derive the retransmit limit.
+	 * @param dest Output for picked updates.
+	 * @param encoding Encoding the updates are to be written with.
+	 * @return Number of updates picked.
+	 */
+	size_type fill(std::size_t budget, size_type clusterSize, Solace::ArrayView<MembershipUpdate> dest,
+				   UpdateEncoding encoding = UpdateEncoding::Fixed);
+
+private:
+
+	struct HeapEntry {
+		size_type		transmits;	//!< Number of times the update has been transmitted
+		Solace::uint64	sequence;	//!< Order in which updates have been queued
+		NodeID			id;
+	};
+
+	struct Pending {
+		MembershipUpdate	update;
+		size_type			position;	//!< Position of the entry in the heap
+	};
+
+	static bool isBefore(HeapEntry const& lhs, HeapEntry const& rhs) noexcept {
+		return (lhs.transmits < rhs.transmits) ||
+				(lhs.transmits == rhs.transmits && lhs.sequence > rhs.sequence);
+	}
+
+	void place(size_type position, HeapEntry const& entry);
+	void siftUp(size_type position);
+	void siftDown(size_type position);
+	void removeAt(size_type position);
+
+	/// Take an entry out of the heap, keeping the update pending
+	void detach(size_type position);
+
+private:
+	Solace::float32					_retransmitMultiplier;
+	Solace::uint64					_sequence{0};
+	std::vector<HeapEntry>			_heap;
+	std::vector<HeapEntry>			_picked;	//!< Scratch space for updates picked by fill
+	std::vector<HeapEntry>			_skipped;	//!< Scratch space for updates skipped by fill
+	FlatMap<NodeID, Pending>		_pending;
+};
+
+}  // namespace tribe
+#endif  // TRIBE_DISSEMINATIONQUEUE_HPP
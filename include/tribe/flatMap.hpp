@@ -0,0 +1,483 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_FLATMAP_HPP
+#define TRIBE_FLATMAP_HPP
+
+#include <solace/types.hpp>
+
+#include <functional>  // std::hash, std::equal_to
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace tribe {
+
+/**
+ * Open-addressing hash map with entries stored in a single flat array.
+ *
+ * The table is split into groups of 16 slots. Each slot has a control byte: either a marker of an empty/deleted slot
+ * or 7 bits of the key hash. Lookup probes a group at a time, comparing all control bytes of the group at once
+ * (with SSE2 where available), and only compares keys of the slots with matching hash bits.
+ * Iteration is a linear scan of the slot array.
+ *
+ * The interface mimics a subset of std::unordered_map. Note: any insertion may invalidate iterators.
+ */
+template<typename K,
+		 typename V,
+		 typename Hash = std::hash<K>,
+		 typename KeyEqual = std::equal_to<K>>
+struct FlatMap {
+	using key_type = K;
+	using mapped_type = V;
+	using value_type = std::pair<K const, V>;
+	using size_type = std::size_t;
+	using hasher = Hash;
+	using key_equal = KeyEqual;
+
+private:
+	using ctrl_t = Solace::int8;
+
+	static constexpr ctrl_t kEmpty = -128;		// 0b10000000
+	static constexpr ctrl_t kDeleted = -2;		// 0b11111110
+	static constexpr size_type kGroupWidth = 16;
+
+	union Slot {
+		Slot() noexcept {}
+		~Slot() noexcept {}
+
+		value_type	value;
+	};
+
+	static constexpr bool isFull(ctrl_t c) noexcept { return c >= 0; }
+
+	/// Bitmask of slots in a group matching a given predicate
+	struct Group {
+		explicit Group(ctrl_t const* ctrl) noexcept
+			: _ctrl{ctrl}
+		{}
+
+		Solace::uint32 match(ctrl_t h2) const noexcept {
+#if defined(__SSE2__)
+			auto const ctrl = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_ctrl));
+			return static_cast<Solace::uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+#else
+			Solace::uint32 mask = 0;
+			for (size_type i = 0; i < kGroupWidth; ++i) {
+				mask |= static_cast<Solace::uint32>(_ctrl[i] == h2) << i;
+			}
+			return mask;
+#endif
+		}
+
+		Solace::uint32 matchEmpty() const noexcept { return match(kEmpty); }
+
+		Solace::uint32 matchEmptyOrDeleted() const noexcept {
+#if defined(__SSE2__)
+			// Both markers have the high bit set, while full slots hold a 7 bit hash
+			auto const ctrl = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_ctrl));
+			return static_cast<Solace::uint32>(_mm_movemask_epi8(ctrl));
+#else
+			Solace::uint32 mask = 0;
+			for (size_type i = 0; i < kGroupWidth; ++i) {
+				mask |= static_cast<Solace::uint32>(!isFull(_ctrl[i])) << i;
+			}
+			return mask;
+#endif
+		}
+
+	private:
+		ctrl_t const* _ctrl;
+	};
+
+	static Solace::uint32 lowestBit(Solace::uint32 mask) noexcept {
+		return static_cast<Solace::uint32>(__builtin_ctz(mask));
+	}
+
+public:
+
+	template<typename MapType, typename ValueType>
+	struct Iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = FlatMap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = ValueType*;
+		using reference = ValueType&;
+
+		constexpr Iterator() noexcept = default;
+
+		constexpr Iterator(MapType* map, size_type index) noexcept
+			: _map{map}
+			, _index{index}
+		{}
+
+		/// Mutable iterator is convertible to a const one
+		template<typename M, typename VT,
+				 typename = std::enable_if_t<std::is_const<MapType>::value && !std::is_const<M>::value>>
+		constexpr Iterator(Iterator<M, VT> const& other) noexcept
+			: _map{other._map}
+			, _index{other._index}
+		{}
+
+		reference operator* () const { return _map->_slots[_index].value; }
+		pointer operator-> () const { return &(_map->_slots[_index].value); }
+
+		Iterator& operator++ () {
+			_index = _map->nextFull(_index + 1);
+			return *this;
+		}
+
+		Iterator operator++ (int) {
+			auto result = *this;
+			++(*this);
+			return result;
+		}
+
+		friend bool operator== (Iterator const& lhs, Iterator const& rhs) noexcept {
+			return (lhs._index == rhs._index);
+		}
+
+		friend bool operator!= (Iterator const& lhs, Iterator const& rhs) noexcept {
+			return (lhs._index != rhs._index);
+		}
+
+	private:
+		friend struct FlatMap;
+		template<typename M, typename VT> friend struct Iterator;
+
+		MapType*	_map{nullptr};
+		size_type	_index{0};
+	};
+
+	using iterator = Iterator<FlatMap, value_type>;
+	using const_iterator = Iterator<FlatMap const, value_type const>;
+
+public:
+
+	~FlatMap() {
+		destroy();
+	}
+
+	FlatMap() noexcept = default;
+
+	FlatMap(FlatMap const& other)
+		: _capacity{other._capacity}
+		, _size{other._size}
+		, _deleted{other._deleted}
+	{
+		if (_capacity == 0) {
+			return;
+		}
+
+		_ctrl = std::make_unique<ctrl_t[]>(_capacity);
+		_slots = std::make_unique<Slot[]>(_capacity);
+		for (size_type i = 0; i < _capacity; ++i) {
+			_ctrl[i] = other._ctrl[i];
+		}
+
+		size_type constructed = 0;
+		try {
+			for (; constructed < _capacity; ++constructed) {
+				if (isFull(_ctrl[constructed])) {
+					new (&_slots[constructed].value) value_type(other._slots[constructed].value);
+				}
+			}
+		} catch (...) {
+			for (size_type i = 0; i < constructed; ++i) {
+				if (isFull(_ctrl[i])) {
+					_slots[i].value.~value_type();
+				}
+			}
+			throw;
+		}
+	}
+
+	FlatMap(FlatMap&& other) noexcept
+		: _ctrl{std::move(other._ctrl)}
+		, _slots{std::move(other._slots)}
+		, _capacity{std::exchange(other._capacity, 0)}
+		, _size{std::exchange(other._size, 0)}
+		, _deleted{std::exchange(other._deleted, 0)}
+	{}
+
+	FlatMap& operator= (FlatMap const& rhs) {
+		if (this != &rhs) {
+			FlatMap copy{rhs};
+			swap(copy);
+		}
+
+		return *this;
+	}
+
+	FlatMap& operator= (FlatMap&& rhs) noexcept {
+		FlatMap moved{std::move(rhs)};
+		swap(moved);
+
+		return *this;
+	}
+
+	void swap(FlatMap& rhs) noexcept {
+		using std::swap;
+		swap(_ctrl, rhs._ctrl);
+		swap(_slots, rhs._slots);
+		swap(_capacity, rhs._capacity);
+		swap(_size, rhs._size);
+		swap(_deleted, rhs._deleted);
+	}
+
+	size_type size() const noexcept { return _size; }
+	bool empty() const noexcept { return (_size == 0); }
+	size_type capacity() const noexcept { return _capacity; }
+
+	iterator begin() noexcept { return {this, nextFull(0)}; }
+	iterator end() noexcept { return {this, _capacity}; }
+	const_iterator begin() const noexcept { return {this, nextFull(0)}; }
+	const_iterator end() const noexcept { return {this, _capacity}; }
+
+	iterator find(K const& key) { return {this, findIndex(key)}; }
+	const_iterator find(K const& key) const { return {this, findIndex(key)}; }
+
+	size_type count(K const& key) const { return (findIndex(key) != _capacity) ? 1 : 0; }
+
+	/// Insert a new entry with a value constructed in-place if the key is not in the map.
+	template<typename... Args>
+	std::pair<iterator, bool> try_emplace(K const& key, Args&&... args) {
+		auto const hash = hashOf(key);
+		auto const existing = findIndex(key, hash);
+		if (existing != _capacity) {
+			return {iterator{this, existing}, false};
+		}
+
+		auto const i = prepareInsert(hash);
+		new (&_slots[i].value) value_type(std::piecewise_construct,
+										  std::forward_as_tuple(key),
+										  std::forward_as_tuple(std::forward<Args>(args)...));
+
+		return {iterator{this, i}, true};
+	}
+
+	/// Insert a new entry or replace a value of existing entry.
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(K const& key, M&& value) {
+		auto result = try_emplace(key, std::forward<M>(value));
+		if (!result.second) {
+			result.first->second = std::forward<M>(value);
+		}
+
+		return result;
+	}
+
+	V& operator[] (K const& key) {
+		return try_emplace(key).first->second;
+	}
+
+	size_type erase(K const& key) {
+		auto const i = findIndex(key);
+		if (i == _capacity) {
+			return 0;
+		}
+
+		eraseAt(i);
+		return 1;
+	}
+
+	/// Remove an entry pointed to by the iterator. @return Iterator to the next entry.
+	iterator erase(const_iterator pos) {
+		eraseAt(pos._index);
+		return {this, nextFull(pos._index + 1)};
+	}
+
+	void clear() noexcept {
+		for (size_type i = 0; i < _capacity; ++i) {
+			if (isFull(_ctrl[i])) {
+				_slots[i].value.~value_type();
+			}
+			_ctrl[i] = kEmpty;
+		}
+
+		_size = 0;
+		_deleted = 0;
+	}
+
+	/// Make sure the table can hold at least `count` entries without rehashing.
+	void reserve(size_type count) {
+		if (count > growthLimit(_capacity)) {
+			rehash(capacityFor(count));
+		}
+	}
+
+private:
+
+	static size_type hashOf(K const& key) noexcept {
+		// Hash of integral keys, e.g. NodeID or an IPv4 address, is often an identity function.
+		// Keys that only differ in high bits must still differ in the low bits used for h1 and h2:
+		// murmur3 finalizer lets every bit of the key affect every bit of the hash.
+		auto hash = static_cast<Solace::uint64>(hasher{}(key));
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+
+		return static_cast<size_type>(hash);
+	}
+
+	static size_type h1(size_type hash) noexcept { return hash >> 7; }
+	static ctrl_t h2(size_type hash) noexcept { return static_cast<ctrl_t>(hash & 0x7F); }
+
+	/// Max number of entries (full and deleted) for the table to maintain 7/8 load factor.
+	static constexpr size_type growthLimit(size_type capacity) noexcept { return capacity - capacity / 8; }
+
+	static size_type capacityFor(size_type count) noexcept {
+		size_type capacity = kGroupWidth;
+		while (growthLimit(capacity) < count) {
+			capacity *= 2;
+		}
+
+		return capacity;
+	}
+
+	size_type nextFull(size_type index) const noexcept {
+		while (index < _capacity && !isFull(_ctrl[index])) {
+			++index;
+		}
+
+		return index;
+	}
+
+	size_type findIndex(K const& key) const {
+		return findIndex(key, hashOf(key));
+	}
+
+	/// Find a slot index of the key. @return capacity if the key is not in the map.
+	size_type findIndex(K const& key, size_type hash) const {
+		if (_size == 0) {
+			return _capacity;
+		}
+
+		auto const groupMask = _capacity / kGroupWidth - 1;
+		auto const tag = h2(hash);
+		auto group = h1(hash) & groupMask;
+		for (size_type probe = 1; probe <= groupMask + 1; ++probe) {
+			auto const offset = group * kGroupWidth;
+			Group g{_ctrl.get() + offset};
+
+			for (auto match = g.match(tag); match != 0; match &= match - 1) {
+				auto const i = offset + lowestBit(match);
+				if (key_equal{}(_slots[i].value.first, key)) {
+					return i;
+				}
+			}
+
+			if (g.matchEmpty()) {
+				return _capacity;
+			}
+
+			group = (group + probe) & groupMask;  // Triangular probing visits every group
+		}
+
+		return _capacity;
+	}
+
+	/// Find a free slot for a new entry with the given hash, growing the table if required.
+	size_type prepareInsert(size_type hash) {
+		if (_size + _deleted + 1 > growthLimit(_capacity)) {
+			rehash((_size + 1 > growthLimit(_capacity) / 2)
+				   ? capacityFor(2 * (_size + 1))
+				   : _capacity);  // Mostly tombstones: rehash in place to reclaim them
+		}
+
+		auto const groupMask = _capacity / kGroupWidth - 1;
+		auto group = h1(hash) & groupMask;
+		for (size_type probe = 1; ; ++probe) {
+			auto const offset = group * kGroupWidth;
+			auto const free = Group{_ctrl.get() + offset}.matchEmptyOrDeleted();
+			if (free) {
+				auto const i = offset + lowestBit(free);
+				if (_ctrl[i] == kDeleted) {
+					_deleted -= 1;
+				}
+
+				_ctrl[i] = h2(hash);
+				_size += 1;
+
+				return i;
+			}
+
+			group = (group + probe) & groupMask;
+		}
+	}
+
+	void eraseAt(size_type i) {
+		_slots[i].value.~value_type();
+		_size -= 1;
+
+		// Slot can be marked empty if the group never overflowed: probing stops at groups with empty slots anyway
+		auto const offset = i - i % kGroupWidth;
+		if (Group{_ctrl.get() + offset}.matchEmpty()) {
+			_ctrl[i] = kEmpty;
+		} else {
+			_ctrl[i] = kDeleted;
+			_deleted += 1;
+		}
+	}
+
+	void rehash(size_type newCapacity) {
+		FlatMap rehashed;
+		rehashed._capacity = newCapacity;
+		rehashed._ctrl = std::make_unique<ctrl_t[]>(newCapacity);
+		rehashed._slots = std::make_unique<Slot[]>(newCapacity);
+		for (size_type i = 0; i < newCapacity; ++i) {
+			rehashed._ctrl[i] = kEmpty;
+		}
+
+		for (size_type i = 0; i < _capacity; ++i) {
+			if (isFull(_ctrl[i])) {
+				auto& value = _slots[i].value;
+				auto const j = rehashed.prepareInsert(hashOf(value.first));
+				new (&rehashed._slots[j].value) value_type(std::move(value));
+			}
+		}
+
+		swap(rehashed);
+	}
+
+	void destroy() noexcept {
+		for (size_type i = 0; i < _capacity; ++i) {
+			if (isFull(_ctrl[i])) {
+				_slots[i].value.~value_type();
+			}
+		}
+	}
+
+private:
+	std::unique_ptr<ctrl_t[]>	_ctrl;
+	std::unique_ptr<Slot[]>		_slots;
+	size_type					_capacity{0};
+	size_type					_size{0};		//!< Number of full slots
+	size_type					_deleted{0};	//!< Number of slots marked as deleted
+};
+
+}  // namespace tribe
+#endif  // TRIBE_FLATMAP_HPP
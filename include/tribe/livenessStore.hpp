@@ -0,0 +1,173 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_LIVENESSSTORE_HPP
+#define TRIBE_LIVENESSSTORE_HPP
+
+#include "peer.hpp"
+#include "persistentVector.hpp"
+
+#include <solace/optional.hpp>
+
+#include <vector>
+
+
+namespace tribe {
+
+/// Model of peers liveness decay over time
+enum class DecayMode : Solace::uint8 {
+	Linear,			//!< Linear approximation p*(1 - k*dt). Decay by any ttlDelta is a single step.
+	Exponential		//!< Exact p*exp(-k*dt). Decay by ttlDelta is the same as ttlDelta single tick decays.
+};
+
+
+/**
+ * Liveness estimates of a number of peers stored as a structure of arrays.
+ * Probabilities, TTLs and states are kept in separate contiguous arrays, so that decaying all of the estimates
+ * touches only the data it needs and can be vectorized.
+ *
+ * Arrays are split into blocks of kBlockSize estimates, kept in a persistent vector: copies of a store share blocks,
+ * and decaying a store modifies blocks it owns in-place. Each estimate is tagged with the id of its peer.
+ */
+struct LivenessStore {
+	using size_type = Solace::uint32;
+
+	static constexpr size_type kBlockSize = 64;
+
+	/// Observable change of an estimate by decay: a change of state, health or expiry
+	struct Change {
+		NodeID			id;			//!< Id of the peer the estimate is of
+		Peer::State		previous;	//!< State of the peer before the decay
+	};
+
+	size_type size() const noexcept { return _size; }
+	bool empty() const noexcept { return (_size == 0); }
+
+	void clear() noexcept;
+
+	/// Add an estimate of the given peer at the index `size()`
+	void push_back(Peer::Liveness const& value, NodeID id = {});
+
+	/**
+	 * Remove the estimate at the given index by moving the last estimate into its place.
+	 * @return Id of the peer which estimate has been moved into the index, if any.
+	 */
+	Solace::Optional<NodeID> erase(size_type index);
+
+	Peer::Liveness operator[] (size_type index) const noexcept {
+		auto const& block = _blocks[index / kBlockSize];
+		auto const i = index % kBlockSize;
+		return {block.ttls[i], block.probabilities[i], static_cast<Peer::State>(block.states[i])};
+	}
+
+	/// Id of the peer the estimate at the given index is of
+	NodeID id(size_type index) const noexcept { return _blocks[index / kBlockSize].ids[index % kBlockSize]; }
+
+	void set(size_type index, Peer::Liveness const& value);
+
+	/**
+	 * Decay all of the estimates in the store by the given delta: TTL by `ttlDelta` and probability by `decayFactor`.
+	 * @param ttlDelta Number of ttl ticks passed.
+	 * @param decayFactor Multiplier of the probability estimates for the passed time.
+	 */
+	void decay(Solace::uint16 ttlDelta, Solace::float32 decayFactor);
+
+	/// Decay all of the estimates in the store by the given delta, collecting observable changes of the estimates.
+	void decay(Solace::uint16 ttlDelta, Solace::float32 decayFactor, std::vector<Change>& changes);
+
+	/**
+	 * Decay all of the estimates in the store by a number of ticks at once.
+	 * The result is the same as decaying the store by one tick `ticks` times, including peers
+	 * that become suspected and then dead in between.
+	 * @param ticks Number of ticks passed.
+	 * @param tickFactor Multiplier of the probability estimates for a single tick.
+	 */
+	void catchUp(Solace::uint16 ticks, Solace::float32 tickFactor);
+
+	/// Decay all of the estimates in the store by a number of ticks at once, collecting observable changes.
+	void catchUp(Solace::uint16 ticks, Solace::float32 tickFactor, std::vector<Change>& changes);
+
+private:
+
+	struct Block {
+		Solace::float32		probabilities[kBlockSize];
+		Solace::uint16		ttls[kBlockSize];
+		Solace::uint8		states[kBlockSize];
+		NodeID				ids[kBlockSize];
+	};
+
+	void assign(size_type index, Peer::Liveness const& value, NodeID id);
+
+	void decay(Solace::uint16 ttlDelta, Solace::float32 decayFactor, Solace::float32 deadThreshold,
+			   std::vector<Change>* changes);
+
+private:
+	PersistentVector<Block, 0>		_blocks;
+	size_type						_size{0};
+};
+
+
+/**
+ * Compute a multiplier of the probability estimates for the given time passed.
+ * @param decayRate Rate of decay per second.
+ * @param ttlDelta Number of ttl ticks passed.
+ * @param decayTimeMs Duration of a single tick in milliseconds.
+ * @param mode Linear approximation is only accurate for small k*dt and is clamped at zero,
+ * exponential decay is exact for any time passed.
+ */
+Solace::float32
+decayFactor(Solace::float32 decayRate, Solace::uint16 ttlDelta, Solace::uint32 decayTimeMs,
+			DecayMode mode = DecayMode::Linear) noexcept;
+
+/**
+ * Compute suspicion timeout given the number of independent confirmations of the suspicion, as in Lifeguard.
+ * The timeout shrinks from max to min logarithmically as confirmations arrive:
+ * max - (max - min) * log(C + 1) / log(K + 1), rounded up, C being confirmations and K - confirmations expected.
+ * @return Timeout in ticks. Max timeout if it is below min or no confirmations are expected.
+ */
+Solace::uint16
+suspicionTimeout(Solace::uint16 minTimeout, Solace::uint16 maxTimeout, Solace::uint32 confirmations,
+				 Solace::uint32 expectedConfirmations) noexcept;
+
+/**
+ * Decay liveness estimate of a single peer: scale the probability, decrement TTL and update the state.
+ * Alive peers become suspected once probability drops below the threshold,
+ * and suspected peers are considered dead when their TTL expires.
+ */
+Peer::Liveness
+decayLiveness(Peer::Liveness value, Solace::uint16 ttlDelta, Solace::float32 decayFactor) noexcept;
+
+/**
+ * Decay liveness estimate of a single peer by a number of ticks in O(1).
+ * The result is the same as calling decayLiveness(value, 1, tickFactor) `ticks` times.
+ */
+Peer::Liveness
+catchUpLiveness(Peer::Liveness value, Solace::uint16 ticks, Solace::float32 tickFactor) noexcept;
+
+/**
+ * Number of ticks a peer, alive before a decay by a number of ticks at once, has been suspected for by the end of it.
+ * Decay by a number of ticks at once does not stop at the tick the peer becomes suspected at,
+ * so suspicion of the peer is to be started as of that tick, `ticksSuspected` ticks back.
+ * @param value Liveness estimate of the peer after the decay.
+ * @param ticks Number of ticks decayed by.
+ * @param tickFactor Multiplier of the probability estimate for a single tick.
+ * @return Number of ticks since the tick the peer has become suspected at, less than `ticks`.
+ */
+Solace::uint16
+ticksSuspected(Peer::Liveness const& value, Solace::uint16 ticks, Solace::float32 tickFactor) noexcept;
+
+}  // namespace tribe
+#endif  // TRIBE_LIVENESSSTORE_HPP
@@ -0,0 +1,101 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_LOCALHEALTH_HPP
+#define TRIBE_LOCALHEALTH_HPP
+
+#include "model.hpp"
+
+#include <solace/optional.hpp>
+
+
+namespace tribe {
+
+/**
+ * Local health awareness, as in Lifeguard: estimate of how well this node itself keeps up with the protocol.
+ *
+ * A node that is slow to process messages - starved of CPU, paused or overloaded - misses acks of healthy peers
+ * and would suspect them. Evidence of such a slowdown raises the health score, evidence of timely processing
+ * lowers it. Timeouts are then stretched by the health multiplier `score + 1`:
+ *  - probe period and probe timeout of the ProbeScheduler;
+ *  - decay of peers liveness: the decay clock runs `multiplier` times slower, so that it takes a peer that long
+ *    to become Suspected, and a suspected peer that long to be considered Dead.
+ *    Decay is stretched when driven by `decay`, eagerly or lazily, or by DecayScheduler::advance.
+ *    PhiAccrualDetector adapts to latencies observed instead, and is not stretched.
+ * Failed probes and missed nacks are fed by the ProbeScheduler, refuted suspicions by `mergeGossip`.
+ *
+ * Score of 0 is a healthy node, with timeouts as configured.
+ */
+struct LocalHealth {
+	using Score = Solace::uint32;
+	using Tick = PeersModel::Tick;
+
+	/// Create a health estimate with max score of the membership settings
+	explicit LocalHealth(MembershipSettings const& settings) noexcept;
+
+	/// Create a health estimate with a given max score. Score of 0 disables local health awareness.
+	explicit LocalHealth(Score maxScore = 0) noexcept;
+
+	/// Current health score: 0 for a healthy node
+	Score score() const noexcept { return _score; }
+
+	/// Max health score
+	Score maxScore() const noexcept { return _maxScore; }
+
+	/// Multiplier of timeouts
+	Score multiplier() const noexcept { return _score + 1; }
+
+	/// Stretch a timeout by the health multiplier
+	Tick scale(Tick ticks) const noexcept { return ticks * multiplier(); }
+
+	/// Probe has been acked in time, directly or through a helper
+	void onProbeSuccess() noexcept;
+
+	/// Probe has not been acked in time
+	void onProbeFailure() noexcept;
+
+	/// Helper has not reported on an indirect probe: likely because this node is slow to process its messages
+	void onMissedNack() noexcept;
+
+	/// Another node suspects this node to have failed, and this node had to refute the suspicion
+	void onRefutedSuspicion() noexcept;
+
+	/**
+	 * Advance the decay clock by the number of ticks elapsed.
+	 * The decay clock runs `multiplier` times slower than the ticks elapsed, ticks left over carry on to the next call.
+	 * @return Number of decay ticks due.
+	 */
+	Tick advance(Tick elapsed) noexcept;
+
+	/**
+	 * Get action to decay peers info as the time passes, using decay parameters of the membership settings.
+	 * @see advance
+	 * @return Action to apply to the model, or none if no decay tick is due yet.
+	 */
+	Solace::Optional<DecayPeerInfo>
+	decay(MembershipSettings const& settings, Solace::uint16 elapsed) noexcept;
+
+private:
+	void raise() noexcept;
+
+private:
+	Score		_maxScore;
+	Score		_score{0};
+	Tick		_lag{0};	//!< Ticks elapsed that the decay clock is yet to catch up with
+};
+
+}  // namespace tribe
+#endif  // TRIBE_LOCALHEALTH_HPP
@@ -0,0 +1,147 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_MEMBERSHIPSNAPSHOT_HPP
+#define TRIBE_MEMBERSHIPSNAPSHOT_HPP
+
+#include "model.hpp"
+#include "localHealth.hpp"
+#include "protocol/gossip.hpp"
+
+#include <solace/arrayView.hpp>
+#include <solace/optional.hpp>
+
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * Snapshot of the members of a group as seen by a node, to share with a joining node or a peer in anti-entropy sync.
+ *
+ * Members are ordered by node ID, so that they take the least space once compactly encoded:
+ * node IDs are delta-encoded and addresses of nodes of the same subnet refer to each other.
+ * A snapshot too large for a single datagram is split into chunks, each encoded independently of others.
+ */
+struct MembershipSnapshot {
+	using size_type = Solace::uint32;
+
+	/// Take a snapshot of the members of the model. Self is not included.
+	explicit MembershipSnapshot(PeersModel const& model);
+
+	/// Number of members in the snapshot
+	size_type size() const noexcept { return static_cast<size_type>(_members.size()); }
+	bool empty() const noexcept { return _members.empty(); }
+
+	/// Members of the snapshot, as updates ordered by node ID
+	Solace::ArrayView<MembershipUpdate const> members() const noexcept {
+		return {_members.data(), size()};
+	}
+
+	/**
+	 * Split the snapshot into chunks, each of which fits into a sync message of a given size.
+	 * A chunk that fits into a sync message fits into a join acknowledgement too.
+	 * @param datagramSize Max size in bytes of a datagram to carry a chunk.
+	 * @return Number of chunks.
+	 */
+	size_type split(Gossip::size_type datagramSize);
+
+	/// Number of chunks the snapshot has been split into. @see split
+	size_type chunkCount() const noexcept { return static_cast<size_type>(_chunkEnds.size()); }
+
+	/// Members of a chunk of the snapshot
+	Solace::ArrayView<MembershipUpdate const> chunk(size_type index) const noexcept;
+
+private:
+	std::vector<MembershipUpdate>	_members;
+	std::vector<size_type>			_chunkEnds;		//!< Index of the member past the end of each chunk
+};
+
+
+/**
+ * Get actions that bring the model up to date with members of a snapshot received from a peer.
+ *
+ * Nodes the model does not know of are added, unless they are dead.
+ * Known peers are updated when the snapshot has a newer generation of a node, and pronounced dead
+ * when the snapshot has them dead as of their current generation or later.
+ * Liveness of known peers is not refreshed otherwise: only the node itself can vouch that it is alive.
+ *
+ * @param model Model to merge the snapshot into.
+ * @param members Members of a snapshot chunk, as decoded by MessageParser::parseUpdates.
+ * @param actions Output for the actions to apply to the model.
+ * @return Number of actions added.
+ */
+Solace::uint32
+mergeSnapshot(PeersModel const& model, Solace::ArrayView<MembershipUpdate const> members,
+			  std::vector<Action>& actions);
+
+
+/**
+ * Get actions that apply membership updates piggybacked on gossip to the model.
+ *
+ * Updates are merged as members of a snapshot are, and Suspect updates suspect the node on behalf of the member
+ * that has raised the suspicion, as carried by the update, rather than the member that has relayed it.
+ * Suspicion of this node itself, as of its current generation or later, is refuted: the model moves the node
+ * to a newer generation, that the caller is to disseminate, and local health is notified.
+ *
+ * @param model Model to apply the updates to.
+ * @param updates Updates, as decoded by MessageParser::parseUpdates.
+ * @param actions Output for the actions to apply to the model.
+ * @param health Local health estimate of this node.
+ * @return Number of actions added.
+ */
+Solace::uint32
+mergeGossip(PeersModel const& model, Solace::ArrayView<MembershipUpdate const> updates,
+			std::vector<Action>& actions, LocalHealth& health);
+
+
+/**
+ * Schedule of the periodic anti-entropy push/pull.
+ * Every `syncInterval` ticks of the model the node pushes a snapshot of its membership to a random healthy peer,
+ * which merges it and replies with a snapshot of its own.
+ * This repairs membership changes that gossip has failed to disseminate, such as updates dropped
+ * by a full dissemination queue or lost by a partition.
+ */
+struct AntiEntropy {
+
+	/// Create a schedule with the sync interval of the membership settings
+	explicit AntiEntropy(MembershipSettings const& settings) noexcept
+		: AntiEntropy{settings.syncInterval}
+	{}
+
+	explicit AntiEntropy(PeersModel::Tick interval) noexcept
+		: _interval{interval}
+	{}
+
+	/**
+	 * Pick a peer to sync with if a sync is due.
+	 * @param model Model of the group, that gives the current tick and the peers to pick from.
+	 * @param random Uniformly distributed random value used to pick a peer.
+	 * @return Id of a healthy peer to push a snapshot to, or none if no sync is due or there is no one to sync with.
+	 */
+	Solace::Optional<NodeID> poll(PeersModel const& model, Solace::uint64 random);
+
+	/// Get an id for the next snapshot to push
+	Solace::uint32 nextSnapshot() noexcept { return ++_snapshot; }
+
+private:
+	PeersModel::Tick	_interval;
+	PeersModel::Tick	_nextSync{0};
+	Solace::uint32		_snapshot{0};
+};
+
+}  // namespace tribe
+#endif  // TRIBE_MEMBERSHIPSNAPSHOT_HPP
@@ -18,11 +18,17 @@
 #define TRIBE_MODEL_HPP
 
 #include "nodeInfo.hpp"
+#include "livenessStore.hpp"
+#include "flatMap.hpp"
+#include "persistentMap.hpp"
+#include "persistentVector.hpp"
 
-#include <solace/range_view.hpp>
+#include <solace/arrayView.hpp>
+#include <solace/optional.hpp>
 
-#include <unordered_map>
+#include <iterator>
 #include <variant>
+#include <vector>
 #include <functional>  // std::function - to handle side-effects
 
 
@@ -38,88 +44,294 @@ struct SeedPeer {
 
 
 
-/**
- * Value representing local view of another group member/cluseter participants.
- * Each group member keeps track of a limited number of other nodes - its peers.
- * For each peer the node estimates the probability that that peer is still 'alive'
- */
-struct Peer {
-	static const Solace::float32 kCertainlyAlive;
-	static const Solace::float32 kMaybeNotAlive;
-	static const Solace::float32 kCertainlyNotAlive;
-
-	enum class State {
-		Alive,
-		Suspected,
-		Dead
-	};
-
-	struct Liveness {
-		Solace::uint16      ttl;			//!< Number of ticks before we should start to worry if node is alive
-		Solace::float32		probabitily;  	//!< The probability that the node is alive
-		State				state;
-	};
-
-	Solace::uint32		generation;			//!< Generation of the node / individual node 'token'
-	Address				address;			//!< Network address to reach this peer
-	Liveness			liveness;			//!< Estimated state of the peer
-	Solace::uint64		comSequance{0};     //!< Communication sequance number
-	Solace::uint32		capacity{0};		//!< Estimated capacity of the peer
-	Solace::uint32		peerCount{0};		//!< Estimated number of peers
-
-	constexpr Peer(Solace::uint32 gen, Address rsvpAddress, Solace::uint16 baseTtl, Solace::float32 aliveness) noexcept
-		: generation{gen}
-		, address{std::move(rsvpAddress)}
-		, liveness{baseTtl, aliveness, State::Alive}
-		, comSequance{0}
-		, capacity{0}
-		, peerCount{0}
-	{}
-};
-
-
 /// Group membership parameters
 struct MembershipSettings {
 	Solace::uint32		peerInfoDecayTimeMs{1300};
 	Solace::float32		peerInfoDecayRate{0.3f};
+	DecayMode			peerInfoDecayMode{DecayMode::Linear};
+	bool				lazyDecay{false};	//!< Estimate liveness of peers on read rather than on every decay.
 	Solace::uint16		ttl{8};
 
 	bool				allowedToJoin;  	//!< Does this node accept new connections?
 	bool				allowedRedirect;  	//!< Can this node redirect connection requests to peer when at capacity?
 	Solace::uint32		maxPeers{128};		//!< Max number of peer this node tracks
 	Solace::uint32		samplingRate{3};  	//!< Max sample size if state info does not fit into a datagram buffer
+	Solace::uint32		syncInterval{32};	//!< Ticks between anti-entropy syncs with a random peer. 0 to disable.
+
+	Solace::uint16		suspicionMinTimeout{2};		//!< Suspicion timeout once expected confirmations are in
+	Solace::uint16		suspicionMaxTimeout{0};		//!< Min TTL of a peer as it becomes suspected. 0 to keep TTL left.
+	Solace::uint32		suspicionConfirmations{3};	//!< Number of confirmations expected of a suspicion
+
+	Solace::uint32		probePeriod{5};		//!< Ticks between probes of peers: duration of SWIM protocol period
+	Solace::uint32		probeTimeout{2};	//!< Ticks to wait for an ack to a direct probe before probing indirectly
+	Solace::uint32		indirectProbes{3};	//!< Number of peers asked to probe a peer that has not acked
+	Solace::uint32		maxLocalHealth{8};	//!< Max local health score: timeouts stretch up to `1 + max` times. 0 to disable.
+
+	Solace::float32		phiSuspectThreshold{8.0f};	//!< Phi at which phi-accrual detector suspects a peer
+	Solace::float32		phiDeadThreshold{16.0f};	//!< Phi at which phi-accrual detector considers a peer dead
+	Solace::float32		phiMinStdDev{1.0f};			//!< Lower bound of std deviation of heartbeat intervals, in ticks
+};
+
+
+/**
+ * Set of peer ids that supports insertion, removal and selection of a member by index in O(log32 N).
+ * Ids are kept in a dense persistent array, with positions of ids in the array kept in a persistent map,
+ * so that copies of the set share their data.
+ */
+struct PeerIdSet {
+	using size_type = Solace::uint32;
+	using const_iterator = PersistentVector<NodeID>::const_iterator;
+
+	size_type size() const noexcept { return static_cast<size_type>(_ids.size()); }
+	bool empty() const noexcept { return _ids.empty(); }
+
+	const_iterator begin() const noexcept { return _ids.begin(); }
+	const_iterator end() const noexcept { return _ids.end(); }
+
+	NodeID operator[] (size_type index) const noexcept { return _ids[index]; }
+
+	bool contains(NodeID id) const { return (_positions.find(id) != _positions.end()); }
+
+	bool insert(NodeID id) {
+		if (!_positions.try_emplace(id, size())) {
+			return false;
+		}
+
+		_ids.push_back(id);
+		return true;
+	}
+
+	bool erase(NodeID id) {
+		auto it = _positions.find(id);
+		if (it == _positions.end()) {
+			return false;
+		}
+
+		// Move the last id into the place of the removed one
+		auto const position = it->second;
+		_positions.erase(id);
+		if (position + 1 != size()) {
+			auto const last = _ids.back();
+			_ids.set(position, last);
+			_positions.insert_or_assign(last, position);
+		}
+
+		_ids.pop_back();
+		return true;
+	}
+
+private:
+	PersistentVector<NodeID>			_ids;
+	PersistentMap<NodeID, size_type>	_positions;
 };
 
 
 /**
  * Model of cluster membership
+ * Note: members and indexes of members are stored in persistent structures, thus copying a model is cheap
+ * and shares peers data: an update of a copy only copies the paths to the data it modifies.
+ * Seeds are few and are swept on every decay tick so they are kept in a flat hash table.
+ * Suspected, dead and healthy members are indexed, so that enumerating or picking them does not require
+ * a scan of all members.
+ * Liveness estimates of members are kept aside of members, in a persistent LivenessStore indexed by Peer::slot,
+ * so that DecayPeerInfo decays them in-place and only updates members and indexes of peers it changes.
+ *
+ * With `params.lazyDecay` set, DecayPeerInfo only advances the model clock: liveness of a peer is estimated
+ * on read from the last estimate and the number of ticks passed since, using exponential decay
+ * at the rate given by `params` rather than by the action.
+ * State transitions and expiry of peers are still applied as the clock advances,
+ * using a queue of lazily decayed peers ordered by the tick of their next transition.
+ *
+ * Peers becoming suspected, be it by decay or by SuspectPeer, start a suspicion: TTL of a suspected peer is its
+ * suspicion timeout, which independent confirmations of the suspicion shrink. @see suspicionTimeout
+ * Suspicion is recorded in `suspicions` until the peer is alive again, dead or removed.
  */
 struct PeersModel {
-	using PeerRangeView = Solace::RangeView<Peer, std::unordered_map<NodeID, Peer>::const_iterator>;
+	using Seeds = FlatMap<Address, SeedPeer>;
+	using Members = PersistentMap<NodeID, Peer>;
+	using Tick = Solace::uint32;
+
+	/// Index of members in a given state: maps peer id to the tick it entered the state
+	using StateIndex = PersistentMap<NodeID, Tick>;
+
+	/**
+	 * Suspicion of a suspected peer, as confirmed by other members.
+	 * Each member, other than the first, known to suspect the peer independently is a confirmation,
+	 * that shrinks the suspicion timeout, as TTL of the suspected peer.
+	 */
+	struct Suspicion {
+		static constexpr Solace::uint32 kMaxSuspecters = 8;
+
+		Solace::uint32		since{0};					//!< Model tick the suspicion has started at
+		Solace::uint16		timeout{0};					//!< Suspicion timeout with no confirmations
+		Solace::uint8		count{0};					//!< Number of members known to suspect the peer
+		NodeID				suspecters[kMaxSuspecters]{};	//!< Members known to suspect the peer
+
+		/// Number of independent confirmations of the suspicion
+		Solace::uint32 confirmations() const noexcept { return (count > 0) ? count - 1u : 0u; }
+	};
+
+	/// Suspicions of suspected members, kept aside of members as only a few peers are suspected at a time
+	using Suspicions = PersistentMap<NodeID, Suspicion>;
 
-	static bool isAlive(Peer const& p) noexcept { return (p.liveness.state == Peer::State::Alive); }
-	static bool isSuspected(Peer const& p) noexcept { return (p.liveness.state == Peer::State::Suspected); }
-	static bool isDead(Peer const& p) noexcept { return (p.liveness.state == Peer::State::Dead); }
-	static bool isExpired(Peer const& p) noexcept { return isDead(p) && (p.liveness.ttl == 0); }
+	/// Entry of the transitions queue of lazily decayed peers
+	struct LivenessEvent {
+		Tick	deadline;	//!< Tick at or before which the peer changes state
+		Tick	heardAt;	//!< Peer::heardAt at the time of scheduling. The entry is stale if the peer was heard since.
+		NodeID	id;
+	};
 
-	static bool isHealthy(Peer const& p) noexcept {
-		return (isAlive(p) && p.liveness.ttl > 0 && p.liveness.probabitily > Peer::kMaybeNotAlive);
+	/// Min-heap of lazily decayed peers ordered by deadline
+	using LivenessEvents = PersistentVector<LivenessEvent>;
+
+	/**
+	 * View of members in a given state.
+	 * Iterates over the index of the state, so visiting K peers costs O(K) regardless of the number of members.
+	 */
+	struct StateView {
+		using Filter = bool (PeersModel::*)(Peer const&) const;
+
+		struct const_iterator {
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Members::value_type;
+			using difference_type = std::ptrdiff_t;
+			using pointer = value_type const*;
+			using reference = value_type const&;
+
+			const_iterator(PeersModel const* model, StateIndex::const_iterator it, StateIndex::const_iterator end,
+						   Filter filter) noexcept
+				: _model{model}
+				, _it{it}
+				, _end{end}
+				, _filter{filter}
+			{
+				skip();
+			}
+
+			reference operator* () const { return *_model->members.find(_it->first); }
+			pointer operator-> () const { return &(**this); }
+
+			const_iterator& operator++ () {
+				++_it;
+				skip();
+				return *this;
+			}
+
+			const_iterator operator++ (int) {
+				auto result = *this;
+				++(*this);
+				return result;
+			}
+
+			friend bool operator== (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+				return (lhs._it == rhs._it);
+			}
+
+			friend bool operator!= (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+				return !(lhs == rhs);
+			}
+
+		private:
+			void skip() {
+				while (_filter && _it != _end && !(_model->*_filter)(_model->members.find(_it->first)->second)) {
+					++_it;
+				}
+			}
+
+			PeersModel const*				_model;
+			StateIndex::const_iterator		_it;
+			StateIndex::const_iterator		_end;
+			Filter							_filter;
+		};
+
+		const_iterator begin() const { return {model, index->begin(), index->end(), filter}; }
+		const_iterator end() const { return {model, index->end(), index->end(), filter}; }
+
+		/// Number of peers in the index. Note: this is an upper bound for filtered views.
+		StateIndex::size_type size() const noexcept { return index->size(); }
+		bool empty() const { return begin() == end(); }
+
+		PeersModel const*	model;
+		StateIndex const*	index;
+		Filter				filter;
+	};
+
+	static bool isAlive(Peer::Liveness const& l) noexcept { return (l.state == Peer::State::Alive); }
+	static bool isSuspected(Peer::Liveness const& l) noexcept { return (l.state == Peer::State::Suspected); }
+	static bool isDead(Peer::Liveness const& l) noexcept { return (l.state == Peer::State::Dead); }
+	static bool isExpired(Peer::Liveness const& l) noexcept { return isDead(l) && (l.ttl == 0); }
+
+	static bool isHealthy(Peer::Liveness const& l) noexcept {
+		return (isAlive(l) && l.ttl > 0 && l.probabitily > Peer::kMaybeNotAlive);
 	}
 
+	/// Liveness of a peer as of the current tick of the model.
+	Peer::Liveness liveness(Peer const& p) const noexcept;
+
+	/// Liveness of a member as of the current tick of the model, if it is a member.
+	Solace::Optional<Peer::Liveness> liveness(NodeID id) const;
+
+	/// Replace liveness estimate of a peer. Note: indexes are not updated. @see reindex
+	void setLiveness(Peer const& p, Peer::Liveness const& value) { estimates.set(p.slot, value); }
+
+	bool isAlive(Peer const& p) const noexcept { return isAlive(liveness(p)); }
+	bool isSuspected(Peer const& p) const noexcept { return isSuspected(liveness(p)); }
+	bool isDead(Peer const& p) const noexcept { return isDead(liveness(p)); }
+	bool isExpired(Peer const& p) const noexcept { return isExpired(liveness(p)); }
+	bool isHealthy(Peer const& p) const noexcept { return isHealthy(liveness(p)); }
+
 
 	// return a list of peers that should be checked for liveness
-	PeerRangeView suspectedPeers() const noexcept	{ return {members.begin(), members.end(), isSuspected}; }
-	PeerRangeView deadPeers() const noexcept		{ return {members.begin(), members.end(), isDead}; }
-	PeerRangeView expiredPeers() const noexcept		{ return {members.begin(), members.end(), isExpired}; }
+	StateView suspectedPeers() const noexcept	{ return {this, &suspected, nullptr}; }
+	StateView deadPeers() const noexcept		{ return {this, &dead, nullptr}; }
+	StateView expiredPeers() const noexcept		{ return {this, &dead, &PeersModel::isExpired}; }
 
+	/// Find a healthy peer to redirect connection requests to.
 	Solace::Optional<Address>
 	findRedirectAddress() const;
 
+	/**
+	 * Pick a random healthy peer to redirect connection requests to in O(log32 N).
+	 * @param random Uniformly distributed random value used to pick a peer.
+	 * @param preferSpareCapacity If true, pick one of two random healthy peers with more spare capacity,
+	 * as estimated by `capacity - peerCount`.
+	 */
+	Solace::Optional<Address>
+	findRedirectAddress(Solace::uint64 random, bool preferSpareCapacity = false) const;
+
+	/**
+	 * Update indexes with the current liveness estimate of a member.
+	 * Suspicion of a member that is no longer suspected is dropped.
+	 */
+	void reindex(NodeID id, Peer::Liveness const& value);
+
+	/// Remove a member along with its liveness estimate and its entries in the state indexes
+	void erasePeer(NodeID id);
+
+	/**
+	 * Start suspicion of a peer that has just become suspected: the peer is given at least
+	 * `params.suspicionMaxTimeout` ticks before it is considered dead, unless the suspicion is confirmed.
+	 * @param id Id of the suspected peer.
+	 * @param liveness Liveness estimate of the suspected peer, which TTL is set to the suspicion timeout.
+	 * @param suspecter Member that suspects the peer.
+	 * @param since Tick the peer has become suspected at.
+	 */
+	void startSuspicion(NodeID id, Peer::Liveness& liveness, NodeID suspecter, Tick since);
+
 	NodeInfo				node;
 	MembershipSettings		params;
 
-	std::unordered_map<Address, SeedPeer>	seeds;
-	std::unordered_map<NodeID, Peer>		members;
+	Seeds					seeds;
+	Members					members;
+	LivenessStore			estimates;		//!< Liveness estimates of members, indexed by Peer::slot
+
+	StateIndex				suspected;		//!< Members in Suspected state
+	StateIndex				dead;			//!< Members in Dead state
+	PeerIdSet				healthy;		//!< Members that are healthy
+	Suspicions				suspicions;		//!< Suspicions of suspected members
+
+	Tick					now{0};				//!< Number of ticks passed
+	LivenessEvents			livenessEvents;		//!< Transitions queue of lazily decayed peers
 };
 
 
@@ -143,8 +355,18 @@ struct UpdatePeerAddress	{ NodeInfo	nodeInfo; Address newAddress; };
 struct UpdatePeerGeneration { NodeID	peerId; Solace::uint32  gen; Solace::uint16 ttl; };
 /// Change the state of a peer to 'dead'.
 struct PronouncePeerDead	{ NodeInfo	nodeInfo; };
+/**
+ * Suspicion of a peer, piggybacked on gossip by another member: suspects the peer or confirms the suspicion.
+ * Suspicion of this node itself is refuted by moving the node on to a newer generation.
+ */
+struct SuspectPeer			{ NodeInfo	nodeInfo; NodeID from; };
 /// Decay infor about peer state as time passes
-struct DecayPeerInfo		{ Solace::uint16 ttlDelta; 	Solace::uint32 decayTimeMs; Solace::float32	decayRate; };
+struct DecayPeerInfo {
+	Solace::uint16		ttlDelta;
+	Solace::uint32		decayTimeMs;
+	Solace::float32		decayRate;
+	DecayMode			mode{DecayMode::Linear};
+};
 
 
 /// Action to update peers model
@@ -153,6 +375,7 @@ using Action = std::variant<AddSeed, ForgetSeed,
 							UpdatePeerAddress,
 							UpdatePeerGeneration,
 							PronouncePeerDead,
+							SuspectPeer,
 							DecayPeerInfo
 							>;
 
@@ -164,5 +387,24 @@ update(PeersModel const& state, Action&& action);
 PeersModel
 update(PeersModel const& state, Action&& action, std::function<void()>);
 
+/**
+ * Update Peer model by applying a batch of actions in order.
+ * The result is the same as applying each action one by one, but the model is only copied once per batch.
+ * Note: pure function with respect to the model, actions are consumed.
+ */
+PeersModel
+update(PeersModel const& state, Solace::ArrayView<Action> actions);
+
+/**
+ * Update Peer model by applying an action to the model owned by the caller.
+ * No copy of the model is made: data not shared with other copies of the model is modified in-place.
+ */
+PeersModel
+update(PeersModel&& state, Action&& action);
+
+/// Update Peer model owned by the caller by applying a batch of actions in order.
+PeersModel
+update(PeersModel&& state, Solace::ArrayView<Action> actions);
+
 }  // namespace tribe
 #endif  // TRIBE_MODEL_HPP
@@ -28,6 +28,7 @@ std::ostream& operator<< (std::ostream& ostr, Address const& address);
 std::ostream& operator<< (std::ostream& ostr, NodeID const& nodeId);
 std::ostream& operator<< (std::ostream& ostr, NodeInfo const& node);
 std::ostream& operator<< (std::ostream& ostr, Peer const& peer);
+std::ostream& operator<< (std::ostream& ostr, Peer::Liveness const& liveness);
 
 }  // namespace tribe
 #endif  // TRIBE_OSTREAM_HPP
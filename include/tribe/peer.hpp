@@ -0,0 +1,69 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PEER_HPP
+#define TRIBE_PEER_HPP
+
+#include "nodeInfo.hpp"
+
+#include <solace/types.hpp>
+
+
+namespace tribe {
+
+/**
+ * Value representing local view of another group member/cluseter participants.
+ * Each group member keeps track of a limited number of other nodes - its peers.
+ * For each peer the node estimates the probability that that peer is still 'alive'.
+ * Note: the estimate is kept by the model in a LivenessStore, at the slot of the peer. @see PeersModel::liveness
+ */
+struct Peer {
+	static const Solace::float32 kCertainlyAlive;
+	static const Solace::float32 kMaybeNotAlive;
+	static const Solace::float32 kCertainlyNotAlive;
+
+	enum class State {
+		Alive,
+		Suspected,
+		Dead
+	};
+
+	struct Liveness {
+		Solace::uint16      ttl;			//!< Number of ticks before we should start to worry if node is alive
+		Solace::float32		probabitily;  	//!< The probability that the node is alive
+		State				state;
+	};
+
+	Solace::uint32		generation;			//!< Generation of the node / individual node 'token'
+	Address				address;			//!< Network address to reach this peer
+	Solace::uint32		slot;				//!< Index of the liveness estimate of the peer in the model
+	Solace::uint64		comSequance{0};     //!< Communication sequance number
+	Solace::uint32		capacity{0};		//!< Estimated capacity of the peer
+	Solace::uint32		peerCount{0};		//!< Estimated number of peers
+	Solace::uint32		heardAt{0};			//!< Model tick the liveness estimate is as of. Used by lazy decay.
+
+	constexpr Peer(Solace::uint32 gen, Address rsvpAddress, Solace::uint32 livenessSlot) noexcept
+		: generation{gen}
+		, address{std::move(rsvpAddress)}
+		, slot{livenessSlot}
+		, comSequance{0}
+		, capacity{0}
+		, peerCount{0}
+	{}
+};
+
+}  // namespace tribe
+#endif  // TRIBE_PEER_HPP
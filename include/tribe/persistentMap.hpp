@@ -0,0 +1,504 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PERSISTENTMAP_HPP
+#define TRIBE_PERSISTENTMAP_HPP
+
+#include <solace/types.hpp>
+
+#include <array>
+#include <functional>  // std::hash, std::equal_to
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * Persistent (immutable) hash map with structural sharing.
+ *
+ * This is a compressed hash-array mapped prefix trie (CHAMP): each node indexes 5 bits of a key hash and keeps
+ * entries and sub-nodes in two compact arrays addressed by bitmaps.
+ * Copying a map is O(1) - copies share all of the nodes. Any modification copies only the path from the root to
+ * the modified entry, that is O(log32 N) nodes, leaving other copies unchanged.
+ * Nodes that are not shared with any other copy are modified in-place, so a map that is owned uniquely
+ * (e.g. moved-from model) is edited without any allocations, just like a mutable container.
+ *
+ * The interface mimics a subset of std::unordered_map. Note that there are no mutable iterators:
+ * use `insert_or_assign` or `update` to change a value.
+ */
+template<typename K,
+		 typename V,
+		 typename Hash = std::hash<K>,
+		 typename KeyEqual = std::equal_to<K>>
+struct PersistentMap {
+	using key_type = K;
+	using mapped_type = V;
+	using value_type = std::pair<K, V>;
+	using size_type = std::size_t;
+	using hasher = Hash;
+	using key_equal = KeyEqual;
+
+private:
+	static constexpr Solace::uint32 kBitsPerLevel = 5;
+	static constexpr Solace::uint32 kLevelMask = (1 << kBitsPerLevel) - 1;
+	static constexpr Solace::uint32 kHashBits = sizeof(size_t) * 8;
+	static constexpr Solace::uint32 kMaxDepth = (kHashBits + kBitsPerLevel - 1) / kBitsPerLevel + 1;
+
+	struct Node;
+	using NodePtr = std::shared_ptr<Node>;
+
+	struct Node {
+		Solace::uint32				dataMap{0};		//!< Bitmap of hash fragments stored as inline entries
+		Solace::uint32				nodeMap{0};		//!< Bitmap of hash fragments stored in sub-nodes
+		std::vector<value_type>		entries;		//!< Inline entries, ordered by hash fragment
+		std::vector<NodePtr>		children;		//!< Sub-nodes, ordered by hash fragment
+
+		/// Node that holds a single entry can be inlined into its parent.
+		bool isSingleton() const noexcept { return children.empty() && entries.size() == 1; }
+	};
+
+public:
+
+	/// Forward iterator over all entries of the map. Note: order of iteration is unspecified.
+	struct const_iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = PersistentMap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = value_type const*;
+		using reference = value_type const&;
+
+		const_iterator() noexcept = default;
+
+		reference operator* () const { return top().node->entries[top().entry]; }
+		pointer operator-> () const { return &(operator* ()); }
+
+		const_iterator& operator++ () {
+			top().entry += 1;
+			settle();
+			return *this;
+		}
+
+		const_iterator operator++ (int) {
+			auto result = *this;
+			++(*this);
+			return result;
+		}
+
+		friend bool operator== (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+			if (lhs._depth == 0 || rhs._depth == 0) {
+				return (lhs._depth == rhs._depth);
+			}
+
+			return (lhs.top().node == rhs.top().node) && (lhs.top().entry == rhs.top().entry);
+		}
+
+		friend bool operator!= (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+			return !(lhs == rhs);
+		}
+
+	private:
+		friend struct PersistentMap;
+
+		struct Frame {
+			Node const*		node;
+			Solace::uint32	entry;		//!< Index of the current entry in the node
+			Solace::uint32	child;		//!< Index of the next child node to visit
+		};
+
+		Frame& top() noexcept { return _stack[_depth - 1]; }
+		Frame const& top() const noexcept { return _stack[_depth - 1]; }
+
+		void push(Node const* node, Solace::uint32 entry) noexcept {
+			_stack[_depth++] = Frame{node, entry, 0};
+		}
+
+		/// Move to the next entry in depth-first order, starting from the current position
+		void settle() noexcept {
+			while (_depth > 0) {
+				auto& frame = top();
+				if (frame.entry < frame.node->entries.size()) {
+					return;
+				}
+
+				if (frame.child < frame.node->children.size()) {
+					push(frame.node->children[frame.child++].get(), 0);
+				} else {
+					_depth -= 1;
+				}
+			}
+		}
+
+		std::array<Frame, kMaxDepth>	_stack{};
+		Solace::uint32					_depth{0};  //!< Zero depth indicates the end of the map
+	};
+
+	using iterator = const_iterator;
+
+public:
+
+	PersistentMap() noexcept = default;
+
+	size_type size() const noexcept { return _size; }
+	bool empty() const noexcept { return (_size == 0); }
+
+	const_iterator begin() const noexcept {
+		const_iterator it;
+		if (_root) {
+			it.push(_root.get(), 0);
+			it.settle();
+		}
+
+		return it;
+	}
+
+	const_iterator end() const noexcept { return {}; }
+
+	const_iterator find(K const& key) const {
+		const_iterator it;
+		auto const hash = hasher{}(key);
+		Solace::uint32 shift = 0;
+
+		for (Node const* node = _root.get(); node != nullptr; shift += kBitsPerLevel) {
+			if (shift >= kHashBits) {  // Collision node: linear search
+				for (Solace::uint32 i = 0; i < node->entries.size(); ++i) {
+					if (key_equal{}(node->entries[i].first, key)) {
+						it.push(node, i);
+						return it;
+					}
+				}
+
+				return end();
+			}
+
+			auto const bit = bitpos(hash, shift);
+			if (node->dataMap & bit) {
+				auto const i = index(node->dataMap, bit);
+				if (!key_equal{}(node->entries[i].first, key)) {
+					return end();
+				}
+
+				it.push(node, i);
+				return it;
+			}
+
+			if (!(node->nodeMap & bit)) {
+				return end();
+			}
+
+			// Ancestors are resumed after the subtree the key is in: entries are visited before the children.
+			auto const childIndex = index(node->nodeMap, bit);
+			it.push(node, static_cast<Solace::uint32>(node->entries.size()));
+			it.top().child = childIndex + 1;
+
+			node = node->children[childIndex].get();
+		}
+
+		return end();
+	}
+
+	size_type count(K const& key) const { return (find(key) != end()) ? 1 : 0; }
+
+
+	/**
+	 * Insert a new entry with a value constructed in-place if the key is not in the map.
+	 * @return True if a new entry has been inserted.
+	 */
+	template<typename... Args>
+	bool try_emplace(K const& key, Args&&... args) {
+		if (find(key) != end()) {
+			return false;
+		}
+
+		return insert_or_assign(key, V{std::forward<Args>(args)...});
+	}
+
+	/**
+	 * Insert a new entry or replace a value of existing entry.
+	 * @return True if a new entry has been inserted, false if the value has been replaced.
+	 */
+	bool insert_or_assign(K const& key, V value) {
+		bool inserted = false;
+		_root = insert(_root, isOwned(_root), 0, hasher{}(key), value_type{key, std::move(value)}, inserted);
+		if (inserted) {
+			_size += 1;
+		}
+
+		return inserted;
+	}
+
+	/**
+	 * Modify a value associated with the given key, if present.
+	 * @param fn Callable that is given a mutable reference to a copy of the value.
+	 * @return True if the key was found and the value updated.
+	 */
+	template<typename F>
+	bool update(K const& key, F&& fn) {
+		auto it = find(key);
+		if (it == end()) {
+			return false;
+		}
+
+		auto value = it->second;
+		fn(value);
+		insert_or_assign(key, std::move(value));
+
+		return true;
+	}
+
+	/**
+	 * Remove an entry with the given key.
+	 * @return Number of entries removed.
+	 */
+	size_type erase(K const& key) {
+		bool erased = false;
+		_root = remove(_root, isOwned(_root), 0, hasher{}(key), key, erased);
+		if (!erased) {
+			return 0;
+		}
+
+		_size -= 1;
+		return 1;
+	}
+
+	void clear() noexcept {
+		_root.reset();
+		_size = 0;
+	}
+
+private:
+
+	static constexpr Solace::uint32 fragment(size_t hash, Solace::uint32 shift) noexcept {
+		return static_cast<Solace::uint32>(hash >> shift) & kLevelMask;
+	}
+
+	static constexpr Solace::uint32 bitpos(size_t hash, Solace::uint32 shift) noexcept {
+		return Solace::uint32{1} << fragment(hash, shift);
+	}
+
+	static Solace::uint32 index(Solace::uint32 bitmap, Solace::uint32 bit) noexcept {
+		return static_cast<Solace::uint32>(__builtin_popcount(bitmap & (bit - 1)));
+	}
+
+	/**
+	 * Check if a node is exclusively owned by this version of the map.
+	 * A node is only owned if it is not shared and all of its ancestors are owned too.
+	 */
+	static bool isOwned(NodePtr const& node, bool parentOwned = true) noexcept {
+		return parentOwned && node && (node.use_count() == 1);
+	}
+
+	/**
+	 * Get a node that can be modified without affecting other versions of the map.
+	 * Nodes exclusively owned by this version are modified in-place, shared nodes are copied.
+	 */
+	static NodePtr edit(NodePtr const& node, bool owned) {
+		return owned
+				? node
+				: std::make_shared<Node>(*node);
+	}
+
+	/// Create a sub-trie holding two entries with different keys.
+	static NodePtr merge(value_type&& a, size_t hashA, value_type&& b, size_t hashB, Solace::uint32 shift) {
+		auto node = std::make_shared<Node>();
+		if (shift >= kHashBits) {  // Full hash collision
+			node->entries.reserve(2);
+			node->entries.emplace_back(std::move(a));
+			node->entries.emplace_back(std::move(b));
+
+			return node;
+		}
+
+		auto const fragA = fragment(hashA, shift);
+		auto const fragB = fragment(hashB, shift);
+		if (fragA == fragB) {
+			node->nodeMap = bitpos(hashA, shift);
+			node->children.emplace_back(merge(std::move(a), hashA, std::move(b), hashB, shift + kBitsPerLevel));
+		} else {
+			node->dataMap = bitpos(hashA, shift) | bitpos(hashB, shift);
+			node->entries.reserve(2);
+			if (fragA < fragB) {
+				node->entries.emplace_back(std::move(a));
+				node->entries.emplace_back(std::move(b));
+			} else {
+				node->entries.emplace_back(std::move(b));
+				node->entries.emplace_back(std::move(a));
+			}
+		}
+
+		return node;
+	}
+
+	static NodePtr
+	insert(NodePtr const& node, bool owned, Solace::uint32 shift, size_t hash, value_type&& entry, bool& inserted) {
+		if (!node) {
+			auto newNode = std::make_shared<Node>();
+			newNode->dataMap = bitpos(hash, shift);
+			newNode->entries.emplace_back(std::move(entry));
+			inserted = true;
+
+			return newNode;
+		}
+
+		if (shift >= kHashBits) {  // Collision node
+			auto newNode = edit(node, owned);
+			for (auto& e : newNode->entries) {
+				if (key_equal{}(e.first, entry.first)) {
+					e.second = std::move(entry.second);
+					return newNode;
+				}
+			}
+
+			newNode->entries.emplace_back(std::move(entry));
+			inserted = true;
+			return newNode;
+		}
+
+		auto const bit = bitpos(hash, shift);
+		if (node->dataMap & bit) {
+			auto const i = index(node->dataMap, bit);
+			auto newNode = edit(node, owned);
+			auto& existing = newNode->entries[i];
+			if (key_equal{}(existing.first, entry.first)) {
+				existing.second = std::move(entry.second);
+				return newNode;
+			}
+
+			// Two different keys share the hash fragment: push both of them one level down
+			auto const existingHash = hasher{}(existing.first);
+			auto subNode = merge(std::move(existing), existingHash, std::move(entry), hash, shift + kBitsPerLevel);
+			newNode->entries.erase(newNode->entries.begin() + i);
+			newNode->dataMap ^= bit;
+			newNode->nodeMap |= bit;
+			newNode->children.insert(newNode->children.begin() + index(newNode->nodeMap, bit), std::move(subNode));
+			inserted = true;
+
+			return newNode;
+		}
+
+		if (node->nodeMap & bit) {
+			auto const i = index(node->nodeMap, bit);
+			auto const& child = node->children[i];
+			auto newChild = insert(child, isOwned(child, owned),
+								   shift + kBitsPerLevel, hash, std::move(entry), inserted);
+			if (newChild == child) {  // Child has been modified in-place
+				return node;
+			}
+
+			auto newNode = edit(node, owned);
+			newNode->children[i] = std::move(newChild);
+
+			return newNode;
+		}
+
+		auto newNode = edit(node, owned);
+		newNode->dataMap |= bit;
+		newNode->entries.insert(newNode->entries.begin() + index(newNode->dataMap, bit), std::move(entry));
+		inserted = true;
+
+		return newNode;
+	}
+
+
+	static NodePtr
+	remove(NodePtr const& node, bool owned, Solace::uint32 shift, size_t hash, K const& key, bool& erased) {
+		if (!node) {
+			return node;
+		}
+
+		if (shift >= kHashBits) {  // Collision node
+			for (Solace::uint32 i = 0; i < node->entries.size(); ++i) {
+				if (key_equal{}(node->entries[i].first, key)) {
+					erased = true;
+					if (node->entries.size() == 1) {
+						return {};
+					}
+
+					auto newNode = edit(node, owned);
+					newNode->entries.erase(newNode->entries.begin() + i);
+					return newNode;
+				}
+			}
+
+			return node;
+		}
+
+		auto const bit = bitpos(hash, shift);
+		if (node->dataMap & bit) {
+			auto const i = index(node->dataMap, bit);
+			if (!key_equal{}(node->entries[i].first, key)) {
+				return node;
+			}
+
+			erased = true;
+			if (node->isSingleton()) {
+				return {};
+			}
+
+			auto newNode = edit(node, owned);
+			newNode->entries.erase(newNode->entries.begin() + i);
+			newNode->dataMap ^= bit;
+
+			return newNode;
+		}
+
+		if (node->nodeMap & bit) {
+			auto const i = index(node->nodeMap, bit);
+			auto const& child = node->children[i];
+			auto newChild = remove(child, isOwned(child, owned), shift + kBitsPerLevel, hash, key, erased);
+			if (!erased) {
+				return node;
+			}
+
+			if (newChild && !newChild->isSingleton()) {
+				if (newChild == child) {  // Child has been modified in-place
+					return node;
+				}
+
+				auto newNode = edit(node, owned);
+				newNode->children[i] = std::move(newChild);
+				return newNode;
+			}
+
+			// Keep the trie canonical: drop empty sub-nodes and inline sub-nodes with a single entry
+			auto newNode = edit(node, owned);
+			newNode->children.erase(newNode->children.begin() + i);
+			newNode->nodeMap ^= bit;
+			if (newChild) {
+				newNode->dataMap |= bit;
+				newNode->entries.insert(newNode->entries.begin() + index(newNode->dataMap, bit),
+										newChild->entries.front());
+			}
+
+			if (newNode->entries.empty() && newNode->children.empty()) {
+				return {};
+			}
+
+			return newNode;
+		}
+
+		return node;
+	}
+
+private:
+	NodePtr		_root;
+	size_type	_size{0};
+};
+
+}  // namespace tribe
+#endif  // TRIBE_PERSISTENTMAP_HPP
@@ -0,0 +1,286 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PERSISTENTVECTOR_HPP
+#define TRIBE_PERSISTENTVECTOR_HPP
+
+#include <solace/types.hpp>
+
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * Persistent (immutable) vector with structural sharing.
+ *
+ * This is a radix balanced trie: leaves hold up to `2^LeafBits` consecutive values, branches hold up to 32 sub-nodes,
+ * each indexing the next 5 bits of the index of a leaf.
+ * As with PersistentMap, copying a vector is O(1) and any modification copies only the path from the root to
+ * the modified value, that is O(log32 N) nodes. Nodes that are not shared with any other copy are modified in-place.
+ *
+ * Leaves of large values, such as blocks of values stored as a structure of arrays, are best kept to a single value
+ * with LeafBits of 0, so that a modification copies no more than the block modified.
+ */
+template<typename T, Solace::uint32 LeafBits = 5>
+struct PersistentVector {
+	using value_type = T;
+	using size_type = std::size_t;
+
+private:
+	static constexpr Solace::uint32 kBitsPerLevel = 5;
+	static constexpr size_type kBranching = size_type{1} << kBitsPerLevel;
+	static constexpr size_type kLevelMask = kBranching - 1;
+	static constexpr size_type kLeafSize = size_type{1} << LeafBits;
+	static constexpr size_type kLeafMask = kLeafSize - 1;
+
+	struct Node;
+	using NodePtr = std::shared_ptr<Node>;
+
+	struct Node {
+		std::vector<NodePtr>	children;	//!< Sub-nodes of a branch
+		std::vector<T>			values;		//!< Values of a leaf
+	};
+
+public:
+
+	/// Forward iterator over values of the vector in order
+	struct const_iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = T const*;
+		using reference = T const&;
+
+		const_iterator() noexcept = default;
+
+		const_iterator(PersistentVector const* vector, size_type index) noexcept
+			: _vector{vector}
+			, _index{index}
+		{}
+
+		reference operator* () const { return (*_vector)[_index]; }
+		pointer operator-> () const { return &(operator* ()); }
+
+		const_iterator& operator++ () {
+			_index += 1;
+			return *this;
+		}
+
+		const_iterator operator++ (int) {
+			auto result = *this;
+			++(*this);
+			return result;
+		}
+
+		friend bool operator== (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+			return (lhs._index == rhs._index);
+		}
+
+		friend bool operator!= (const_iterator const& lhs, const_iterator const& rhs) noexcept {
+			return (lhs._index != rhs._index);
+		}
+
+	private:
+		PersistentVector const*		_vector{nullptr};
+		size_type					_index{0};
+	};
+
+	using iterator = const_iterator;
+
+public:
+
+	PersistentVector() noexcept = default;
+
+	size_type size() const noexcept { return _size; }
+	bool empty() const noexcept { return (_size == 0); }
+
+	const_iterator begin() const noexcept { return {this, 0}; }
+	const_iterator end() const noexcept { return {this, _size}; }
+
+	T const& operator[] (size_type index) const noexcept {
+		auto const leafIndex = index >> LeafBits;
+		Node const* node = _root.get();
+		for (auto level = _height; level > 0; --level) {
+			node = node->children[(leafIndex >> (kBitsPerLevel * (level - 1))) & kLevelMask].get();
+		}
+
+		return node->values[index & kLeafMask];
+	}
+
+	T const& back() const noexcept { return (*this)[_size - 1]; }
+
+	/// Replace a value at the given index
+	void set(size_type index, T value) {
+		update(index, [&value](T& item) { item = std::move(value); });
+	}
+
+	/**
+	 * Modify a value at the given index in-place.
+	 * @param fn Callable that is given a mutable reference to the value, that is not shared with any other copy.
+	 */
+	template<typename F>
+	void update(size_type index, F&& fn) {
+		_root = modify(_root, isOwned(_root), _height, index, fn);
+	}
+
+	/**
+	 * Modify all of the values in order.
+	 * Leaves shared with other copies are copied once, others are modified in-place.
+	 * @param fn Callable that is given the index of a value and a mutable reference to it.
+	 */
+	template<typename F>
+	void updateEach(F&& fn) {
+		if (_root) {
+			_root = modifyEach(_root, isOwned(_root), _height, 0, fn);
+		}
+	}
+
+	void push_back(T value) {
+		auto const leafIndex = _size >> LeafBits;
+		if (_root && leafIndex == (size_type{1} << (kBitsPerLevel * _height))) {
+			// Trie is full: grow a level
+			auto root = std::make_shared<Node>();
+			root->children.emplace_back(std::move(_root));
+			_root = std::move(root);
+			_height += 1;
+		}
+
+		_root = append(_root, isOwned(_root), _height, leafIndex, std::move(value));
+		_size += 1;
+	}
+
+	void pop_back() {
+		_size -= 1;
+		_root = removeLast(_root, isOwned(_root), _height, _size >> LeafBits);
+
+		// Drop levels that are left with a single branch
+		while (_height > 0 && _root->children.size() == 1) {
+			auto child = _root->children.front();
+			_root = std::move(child);
+			_height -= 1;
+		}
+
+		if (_size == 0) {
+			clear();
+		}
+	}
+
+	void clear() noexcept {
+		_root.reset();
+		_size = 0;
+		_height = 0;
+	}
+
+private:
+
+	/// @see PersistentMap::isOwned
+	static bool isOwned(NodePtr const& node, bool parentOwned = true) noexcept {
+		return parentOwned && node && (node.use_count() == 1);
+	}
+
+	static NodePtr edit(NodePtr const& node, bool owned) {
+		return owned
+				? node
+				: std::make_shared<Node>(*node);
+	}
+
+	static size_type childIndex(size_type leafIndex, Solace::uint32 level) noexcept {
+		return (leafIndex >> (kBitsPerLevel * (level - 1))) & kLevelMask;
+	}
+
+	template<typename F>
+	static NodePtr modify(NodePtr const& node, bool owned, Solace::uint32 level, size_type index, F& fn) {
+		auto newNode = edit(node, owned);
+		if (level == 0) {
+			fn(newNode->values[index & kLeafMask]);
+			return newNode;
+		}
+
+		auto& child = newNode->children[childIndex(index >> LeafBits, level)];
+		child = modify(child, isOwned(child, owned), level - 1, index, fn);
+
+		return newNode;
+	}
+
+	template<typename F>
+	static NodePtr modifyEach(NodePtr const& node, bool owned, Solace::uint32 level, size_type first, F& fn) {
+		auto newNode = edit(node, owned);
+		if (level == 0) {
+			for (size_type i = 0; i < newNode->values.size(); ++i) {
+				fn(first + i, newNode->values[i]);
+			}
+
+			return newNode;
+		}
+
+		auto const span = kLeafSize << (kBitsPerLevel * (level - 1));
+		for (size_type i = 0; i < newNode->children.size(); ++i) {
+			auto& child = newNode->children[i];
+			child = modifyEach(child, isOwned(child, owned), level - 1, first + i * span, fn);
+		}
+
+		return newNode;
+	}
+
+	static NodePtr append(NodePtr const& node, bool owned, Solace::uint32 level, size_type leafIndex, T&& value) {
+		auto newNode = node
+				? edit(node, owned)
+				: std::make_shared<Node>();
+		if (level == 0) {
+			newNode->values.emplace_back(std::move(value));
+			return newNode;
+		}
+
+		auto const i = childIndex(leafIndex, level);
+		if (i == newNode->children.size()) {
+			newNode->children.emplace_back(append(NodePtr{}, true, level - 1, leafIndex, std::move(value)));
+		} else {
+			auto& child = newNode->children[i];
+			child = append(child, isOwned(child, owned), level - 1, leafIndex, std::move(value));
+		}
+
+		return newNode;
+	}
+
+	static NodePtr removeLast(NodePtr const& node, bool owned, Solace::uint32 level, size_type leafIndex) {
+		auto newNode = edit(node, owned);
+		if (level == 0) {
+			newNode->values.pop_back();
+		} else {
+			auto& child = newNode->children.back();
+			child = removeLast(child, isOwned(child, owned), level - 1, leafIndex);
+			if (!child) {
+				newNode->children.pop_back();
+			}
+		}
+
+		return (newNode->values.empty() && newNode->children.empty())
+				? NodePtr{}
+				: newNode;
+	}
+
+private:
+	NodePtr				_root;
+	size_type			_size{0};
+	Solace::uint32		_height{0};		//!< Number of branch levels above the leaves
+};
+
+}  // namespace tribe
+#endif  // TRIBE_PERSISTENTVECTOR_HPP
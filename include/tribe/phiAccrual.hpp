@@ -0,0 +1,154 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PHIACCRUAL_HPP
+#define TRIBE_PHIACCRUAL_HPP
+
+#include "model.hpp"
+#include "flatMap.hpp"
+
+#include <solace/optional.hpp>
+
+
+namespace tribe {
+
+/**
+ * Phi-accrual estimate of liveness of a single peer.
+ *
+ * Keeps a window of the last intervals between heartbeats of the peer, with a running sum and sum of squares,
+ * so that the mean and variance of intervals are O(1) to get.
+ * Phi is the suspicion level of the peer: -log10 of the probability that a heartbeat yet to come takes longer
+ * than the time since the last heartbeat, under the normal distribution of intervals observed.
+ * So the time it takes for phi to reach a given threshold adapts to the latency profile of the link to each peer.
+ *
+ * Note: intervals are kept in ticks, clamped to 16 bits, so the estimator fits into a single cache line.
+ */
+struct PhiAccrualEstimator {
+	using Tick = PeersModel::Tick;
+	using size_type = Solace::uint32;
+
+	/// Number of the last intervals between heartbeats kept
+	static constexpr size_type kWindowSize = 16;
+
+	/// Start estimating assuming a single interval of the given duration, as no heartbeat has been seen yet.
+	PhiAccrualEstimator(Tick now, Tick firstInterval) noexcept;
+
+	/// Record a heartbeat of the peer
+	void heartbeat(Tick now) noexcept;
+
+	/// Tick of the last heartbeat
+	Tick lastHeartbeat() const noexcept { return _last; }
+
+	/// Number of intervals in the window
+	size_type size() const noexcept { return _count; }
+
+	/// Mean of intervals in the window
+	Solace::float32 mean() const noexcept;
+
+	/// Variance of intervals in the window
+	Solace::float32 variance() const noexcept;
+
+	/**
+	 * Suspicion level of the peer as of the given tick.
+	 * @param now Current tick.
+	 * @param minStdDev Lower bound of the standard deviation of intervals, so that a link that has been very regular
+	 * so far is not suspected as soon as a heartbeat is late by a fraction of a tick.
+	 * @return Phi: 0 if the peer is certainly alive, growing as the time since the last heartbeat grows.
+	 */
+	Solace::float32 phi(Tick now, Solace::float32 minStdDev) const noexcept;
+
+private:
+	void push(Solace::uint16 interval) noexcept;
+
+private:
+	Solace::uint16	_intervals[kWindowSize];	//!< Ring buffer of intervals
+	Solace::uint32	_sum{0};					//!< Sum of intervals in the window
+	Solace::uint64	_sumSquares{0};				//!< Sum of squares of intervals in the window
+	Tick			_last;						//!< Tick of the last heartbeat
+	Solace::uint8	_head{0};					//!< Position of the next interval in the ring buffer
+	Solace::uint8	_count{0};					//!< Number of intervals in the window
+};
+
+static_assert(sizeof(PhiAccrualEstimator) <= 64, "Estimator is expected to fit into a cache line");
+
+
+/**
+ * Phi-accrual failure detector: alternative to decay of peers liveness at a fixed rate.
+ *
+ * Each tick, peers tracked have their state set by their phi:
+ *  - Alive while phi is below the suspicion threshold;
+ *  - Suspected once it is at or above the suspicion threshold. Suspected peers that are heard from are Alive again;
+ *  - Dead once it is at or above the dead threshold, or once the suspicion of the peer times out.
+ *    Dead peers stay dead.
+ * Probability of a peer being alive is interpolated from the phi between the probability thresholds of the states:
+ * from `Peer::kCertainlyAlive` at phi 0, through `Peer::kMaybeNotAlive` at the suspicion threshold,
+ * to `Peer::kCertainlyNotAlive` at the dead threshold. So health of a peer agrees with its state.
+ *
+ * Peers that become suspected have their suspicion started by the model on behalf of this node,
+ * and suspicions of peers that are alive again are dropped.
+ * Suspicions, be they started by this node or gossiped by other members, are timed as with decay:
+ * a suspected peer is dead once `suspicionTimeout` ticks, shrunk by confirmations, have passed since the suspicion
+ * has started. A suspected peer is only alive again once it is heard from since then, however low its phi is.
+ *
+ * The detector is to be used instead of DecayPeerInfo or DecayScheduler, with the model in eager mode.
+ * TTL of peers is not counted down: dead peers are to be forgotten by the caller.
+ *
+ * Note: a peer is only estimated once it is tracked. Call `heartbeat` for every peer added or heard from.
+ */
+struct PhiAccrualDetector {
+	using Tick = PeersModel::Tick;
+
+	/// Create a detector using phi thresholds of the membership settings
+	explicit PhiAccrualDetector(MembershipSettings const& settings) noexcept;
+
+	/**
+	 * Create a detector with given thresholds.
+	 * @param suspectThreshold Phi at which a peer is suspected. Clamped to be positive.
+	 * @param deadThreshold Phi at which a peer is considered dead. Clamped to be no less than suspectThreshold.
+	 * @param firstInterval Interval between heartbeats assumed for a peer that has only been heard from once.
+	 * @param minStdDev Lower bound of the standard deviation of intervals, in ticks.
+	 */
+	PhiAccrualDetector(Solace::float32 suspectThreshold, Solace::float32 deadThreshold, Tick firstInterval,
+					   Solace::float32 minStdDev) noexcept;
+
+	/// Number of peers tracked
+	Solace::uint64 size() const noexcept { return _estimators.size(); }
+
+	/// Record a heartbeat of a peer, starting to track the peer if it is not tracked yet.
+	void heartbeat(NodeID id, Tick now);
+
+	/// Stop tracking the peer.
+	void forget(NodeID id);
+
+	/// Suspicion level of a peer as of the given tick, if the peer is tracked.
+	Solace::Optional<Solace::float32> phi(NodeID id, Tick now) const;
+
+	/// Estimate liveness of a peer given its current liveness and phi.
+	Peer::Liveness liveness(Peer::Liveness value, Solace::float32 phi) const noexcept;
+
+	/// Move forward by one tick: update states and probabilities of the peers tracked.
+	PeersModel tick(PeersModel&& model);
+
+private:
+	Solace::float32								_suspectThreshold;
+	Solace::float32								_deadThreshold;
+	Tick										_firstInterval;
+	Solace::float32								_minStdDev;
+	FlatMap<NodeID, PhiAccrualEstimator>		_estimators;
+};
+
+}  // namespace tribe
+#endif  // TRIBE_PHIACCRUAL_HPP
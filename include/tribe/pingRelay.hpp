@@ -0,0 +1,80 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PINGRELAY_HPP
+#define TRIBE_PINGRELAY_HPP
+
+#include "model.hpp"
+#include "protocol/gossip.hpp"
+#include "protocol/messageParser.hpp"
+
+#include <solace/mutableMemoryView.hpp>
+#include <solace/result.hpp>
+
+
+namespace tribe {
+
+/**
+ * Where a received ping or pong is to go.
+ *
+ * Indirect probes are relayed: a node asked to probe a peer receives a ping addressed to the peer and forwards it,
+ * and forwards the pong addressed to the requester back.
+ * A message is only ever forwarded straight to the node it is addressed to, so it can not loop.
+ */
+struct Route {
+	enum class Kind : Solace::uint8 {
+		Deliver,	//!< Message is addressed to this node
+		Forward,	//!< Message is to be forwarded to the node it is addressed to
+		Drop		//!< Message is addressed to a node that is not to be reached through this node
+	};
+
+	Kind		kind;
+	Address		nextHop;	//!< Address to forward the message to
+};
+
+
+/// Id of the node a ping is addressed to: the target of the ping
+inline NodeID addressee(PingMessage const& msg) noexcept { return msg.target; }
+
+/// Id of the node a pong is addressed to: the node that has requested the ping
+inline NodeID addressee(PongMessage const& msg) noexcept { return msg.origin; }
+
+
+/**
+ * Decide where a ping received goes.
+ * A ping addressed to another node is forwarded if its ttl has not run out and the node is a known member,
+ * that is not dead. Otherwise it is dropped.
+ */
+Route route(PeersModel const& model, PingMessage const& msg);
+
+/// Decide where a pong received goes. @see route(PeersModel const&, PingMessage const&)
+Route route(PeersModel const& model, PongMessage const& msg);
+
+
+/**
+ * Route a received datagram with a ping or pong, patching the datagram in place if it is to be forwarded:
+ * ttl of the message is decremented, while the rest of it, piggybacked updates included, is sent on as is.
+ * Only the fixed size prefix of the message is read: updates are decoded by the node the message is addressed to.
+ *
+ * @param model Model of the group to look up the node the message is addressed to.
+ * @param datagram Datagram received.
+ * @return Route of the message, or an error if the datagram is not a ping or pong, or is too short for one.
+ */
+Solace::Result<Route, MessageParser::Error>
+relay(PeersModel const& model, Solace::MutableMemoryView datagram);
+
+}  // namespace tribe
+#endif  // TRIBE_PINGRELAY_HPP
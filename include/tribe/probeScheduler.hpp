@@ -0,0 +1,156 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PROBESCHEDULER_HPP
+#define TRIBE_PROBESCHEDULER_HPP
+
+#include "model.hpp"
+#include "localHealth.hpp"
+#include "flatMap.hpp"
+
+#include <solace/arrayView.hpp>
+#include <solace/optional.hpp>
+
+#include <random>
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * SWIM failure detector: decides whom to probe every protocol period.
+ *
+ * At the start of each period the next target is picked and pinged directly.
+ * If the target has not acked by the probe timeout, a number of random healthy peers are asked to ping it
+ * on our behalf. If there is still no ack by the end of the period, the target is reported as failed.
+ * Should no tick land between the probe timeout and the end of the period, helpers are asked all the same,
+ * and the period is extended to give them as long as they would have had.
+ * Thus each node sends at most `1 + indirectProbes` probes per period, regardless of the size of the cluster.
+ *
+ * Targets are picked in round-robin order over the members, shuffled anew every round.
+ * Peers joining during a round are inserted at a random position among the peers yet to be probed.
+ * So every member is probed within `2N - 1` periods, N being the number of members, rather than eventually.
+ *
+ * Period and timeout are stretched by the local health multiplier, as of the start of a period.
+ * Failed probes worsen local health, and probes acked within the probe timeout as configured improve it:
+ * an ack that has only made it thanks to the stretched timeouts is no evidence that this node has recovered.
+ * Helpers report on the target by relaying its ack, in place of the nack of Lifeguard: once the target is known
+ * to be alive, each helper that has not relayed an ack by the end of the period is a missed nack,
+ * which worsens local health too. Probes nobody acks are only counted as failed, as the target may well be down.
+ *
+ * Note: new peers are only probed once tracked. Call `track` for every peer added to the model.
+ */
+struct ProbeScheduler {
+	using Tick = PeersModel::Tick;
+	using size_type = Solace::uint32;
+
+	/// TTL of a ping sent to a helper to relay to the target of an indirect probe
+	static constexpr Solace::uint8 kIndirectProbeTtl = 1;
+
+	/// Probe the scheduler has decided to make
+	struct Probe {
+		enum class Kind : Solace::uint8 {
+			Direct,		//!< Ping the target
+			Indirect,	//!< Send a ping for the target to the helper, with TTL of kIndirectProbeTtl
+			Failed		//!< Target has not acked within the protocol period and is to be suspected
+		};
+
+		Kind		kind;
+		NodeID		target;		//!< Peer being probed
+		NodeID		via;		//!< Helper to relay an indirect probe
+	};
+
+	/// Create a scheduler using probe parameters of the membership settings
+	ProbeScheduler(MembershipSettings const& settings, Solace::uint64 seed) noexcept;
+
+	ProbeScheduler(Tick period, Tick timeout, size_type indirectProbes, Solace::uint64 seed,
+				   LocalHealth::Score maxLocalHealth = 0) noexcept;
+
+	/// Max number of probes a single tick can produce
+	size_type maxProbesPerTick() const noexcept { return _indirectProbes + 2; }
+
+	/// Local health estimate of this node
+	LocalHealth& health() noexcept { return _health; }
+	LocalHealth const& health() const noexcept { return _health; }
+
+	/// Duration of the current protocol period, stretched by the local health multiplier
+	Tick period() const noexcept { return _periodLength; }
+
+	/// Target of the current protocol period, if any
+	Solace::Optional<NodeID> target() const;
+
+	/// Check if the target of the current protocol period is yet to ack
+	bool awaitingAck() const noexcept { return _probing && !_acked; }
+
+	/// Add a peer, that has joined the group, to the current round
+	void track(NodeID id);
+
+	/**
+	 * Process an ack from a peer, received directly or relayed by a helper.
+	 * @return True if the ack is from the target of the current protocol period.
+	 */
+	bool onAck(NodeID from) noexcept;
+
+	/**
+	 * Process an ack from a peer, relayed by a helper asked to probe the peer.
+	 * @return True if the ack is from the target of the current protocol period.
+	 */
+	bool onAck(NodeID from, NodeID via) noexcept;
+
+	/**
+	 * Advance to a given tick and get the probes due.
+	 * @param model Model of the group: members to probe and healthy peers to help probing.
+	 * @param now Current tick. Ticks are not required to be consecutive.
+	 * @param dest Output for the probes due. Must have room for `maxProbesPerTick()` probes.
+	 * @return Number of probes due.
+	 */
+	size_type tick(PeersModel const& model, Tick now, Solace::ArrayView<Probe> dest);
+
+private:
+
+	/// Pick the next target, skipping peers that have left or are dead
+	Solace::Optional<NodeID> nextTarget(PeersModel const& model);
+
+	/// Shuffle members of the model into the order of a new round
+	void startRound(PeersModel const& model);
+
+	/// Pick distinct random healthy peers, other than the target, to probe the target indirectly
+	size_type pickHelpers(PeersModel const& model, Solace::ArrayView<Probe> dest);
+
+private:
+	Tick					_period;
+	Tick					_timeout;
+	size_type				_indirectProbes;
+	std::mt19937_64			_random;
+	LocalHealth				_health;
+
+	std::vector<NodeID>		_order;				//!< Order of the members to probe in the current round
+	FlatMap<NodeID, size_type>	_pending;		//!< Position in the order of each peer yet to be probed this round
+	size_type				_next{0};			//!< Position in the order of the next target
+	std::vector<NodeID>		_helpers;			//!< Helpers of the current period yet to relay an ack
+
+	NodeID					_target{0};			//!< Target of the current period
+	Tick					_periodStart{0};	//!< Tick the current period has started at
+	Tick					_lastTick{0};		//!< Tick of the last call to `tick`
+	Tick					_periodLength;		//!< Duration of the current period
+	Tick					_periodTimeout;		//!< Probe timeout of the current period
+	bool					_probing{false};	//!< Is the target of the current period being probed
+	bool					_acked{false};		//!< Has the target acked
+	bool					_indirect{false};	//!< Have the helpers been asked to probe the target
+};
+
+}  // namespace tribe
+#endif  // TRIBE_PROBESCHEDULER_HPP
@@ -39,11 +39,6 @@ struct ConnectRequest {
 	Solace::MemoryView	auth;
 };
 
-/// Response acknowleding a node joining the group of the sender
-struct ConnectResponseAck {
-	NodeInfo		self;  	// The peer you have joined
-	// TODO(abbyssoul): Encoded base state a view of the group this peer is sharing with requestor
-};
 
 /// Response when peer cannot accept requestor into a group but someone else in the group may
 struct ConnectResponseRedirect {
@@ -56,11 +51,68 @@ struct ConnectResponseRejected {
 	Solace::Error		reason;
 };
 
+/// Change of membership of a node, gossiped along with pings and pongs
+struct MembershipUpdate {
+	enum class Kind : Solace::uint8 {
+		Alive,
+		Suspect,
+		Dead,
+		Joined
+	};
+
+	Kind			kind;
+	NodeInfo		node;
+	Address			address;
+	NodeID			suspecter{};	//!< Member that suspects the node. Only encoded for Suspect updates.
+};
+
+/// Encoding of piggybacked membership updates
+enum class UpdateEncoding : Solace::uint8 {
+	Fixed,		//!< Fixed width little-endian integers
+	Compact		//!< LEB128 varints, with node IDs delta-encoded against the previous update
+};
+
+/**
+ * Gossip piggybacked on a ping or a pong: a packed list of encoded membership updates.
+ * Use MessageParser::parseUpdates to decode updates.
+ */
+struct PiggybackView {
+	Solace::uint8		count;		//!< Number of updates
+	Solace::MemoryView	data;		//!< Updates as encoded
+	UpdateEncoding		encoding;	//!< How updates are encoded. Given by message type.
+};
+
+/// Response acknowleding a node joining the group of the sender
+struct ConnectResponseAck {
+	NodeInfo		self;  	// The peer you have joined
+	PiggybackView	members{0, {}, UpdateEncoding::Compact};	//!< First chunk of the snapshot of the group
+};
+
+/// Position of a chunk in a membership snapshot split over a number of datagrams
+struct SnapshotChunk {
+	Solace::uint32		snapshot;	//!< Identifies the snapshot the chunk is a part of
+	Solace::uint16		index;		//!< Index of the chunk
+	Solace::uint16		count;		//!< Total number of chunks in the snapshot
+};
+
+/**
+ * Anti-entropy sync: a chunk of a snapshot of the group membership as seen by the sender.
+ * A node pushes its snapshot to a peer, that replies with its own snapshot.
+ * Chunks are self-contained, so each one can be merged as it arrives.
+ */
+struct SyncMessage {
+	NodeInfo		origin;
+	SnapshotChunk	chunk;
+	PiggybackView	members{0, {}, UpdateEncoding::Compact};	//!< Members of the group, as updates
+	bool			isReply{false};		//!< Is this a reply to a push. Given by message type.
+};
+
 /// "Are you there?"
 struct PingMessage {
 	NodeID			origin;
 	NodeID			target;
 	Solace::uint8		ttl;
+	PiggybackView	updates;
 };
 
 /// "Hey! I am alive" Message
@@ -68,6 +120,7 @@ struct PongMessage {
 	NodeID			origin;
 	NodeInfo		nodeDetails;
 	Solace::uint8		ttl;
+	PiggybackView	updates;
 };
 
 /// Broadcast message to elicit peer intoduction
@@ -81,9 +134,42 @@ using Message = std::variant<ConnectRequest,
 							ConnectResponseRejected,
 
 							PingMessage, PongMessage,
+							SyncMessage,
 							BroadcastMessage>;
 
 
+/// Error as it is transmitted in a message
+struct ErrorView {
+	Solace::uint64		domain;
+	Solace::uint64		code;
+	Solace::StringView	tag;
+};
+
+/// View of ConnectResponseRedirect message
+struct ConnectResponseRedirectView {
+	Solace::MemoryView	otherNode;		//!< Encoded address of the node to try instead
+	ErrorView			reason;
+};
+
+/// View of ConnectResponseRejected message
+struct ConnectResponseRejectedView {
+	ErrorView			reason;
+};
+
+/**
+ * Lightweight view of a message.
+ * Messages that own no data are parsed as is, others refer to the buffer they have been parsed from
+ * and are only valid while the buffer is.
+ */
+using MessageView = std::variant<ConnectRequest,
+								ConnectResponseAck,
+								ConnectResponseRedirectView,
+								ConnectResponseRejectedView,
+								PingMessage, PongMessage,
+								SyncMessage,
+								BroadcastMessage>;
+
+
 /**
  * Netowork Protocol utils
  */
@@ -101,6 +187,11 @@ struct Gossip {
 
 		PingDirect,
 		PongDirect,
+		PingCompact,	//!< Ping with compactly encoded updates
+		PongCompact,	//!< Pong with compactly encoded updates
+
+		SyncPush,		//!< Chunk of a snapshot pushed to a peer
+		SyncReply,		//!< Chunk of a snapshot sent in reply to a push
 
 		Broadcast = 250
 	};
@@ -115,6 +206,17 @@ struct Gossip {
 		return sizeof(MessageHeader::type);
 	}
 
+	/// Number of preceding updates which addresses a compactly encoded address can refer to
+	static constexpr Solace::uint32 kAddressWindow = 64;
+
+	/// Tags of compactly encoded addresses
+	static constexpr Solace::uint8 kCompactIPv4 = 0x00;			//!< IPv4 address and port follow
+	static constexpr Solace::uint8 kCompactIPv6 = 0x01;			//!< IPv6 address and port follow
+	static constexpr Solace::uint8 kCompactUnknown = 0x3F;		//!< Address of unsupported family
+	static constexpr Solace::uint8 kCompactRef = 0x40;			//!< Reference, suffix of IP address and port follow
+	static constexpr Solace::uint8 kCompactRefSamePort = 0x80;	//!< Reference and suffix of IP address follow
+	static constexpr Solace::uint8 kCompactFormMask = 0xC0;
+
 
 	Gossip() = delete;
 	Gossip(Gossip const& ) = delete;
@@ -19,6 +19,8 @@
 
 #include "gossip.hpp"
 
+#include <solace/arrayView.hpp>
+
 namespace tribe {
 
 /**
@@ -27,6 +29,19 @@ namespace tribe {
 struct MessageParser {
 	struct Error {};
 
+	/// Message parsed from a datagram of a batch
+	struct ParsedDatagram {
+		MessageView			message;
+		Solace::uint32		index;		//!< Index of the datagram in the batch
+		Address const*		source;		//!< Address the datagram has been received from, if known
+	};
+
+	/// Outcome of parsing a batch of datagrams
+	struct BatchResult {
+		Solace::uint32		parsed;		//!< Number of messages parsed
+		Solace::uint32		failed;		//!< Number of datagrams that could not be parsed
+	};
+
 	[[nodiscard]]
 	Solace::Result<Gossip::MessageHeader, Error>
 	parseMessageHeader(Solace::ByteReader& src) const;
@@ -34,6 +49,139 @@ struct MessageParser {
 	[[nodiscard]]
 	Solace::Result<Message, Error>
 	parse(Solace::ByteReader& src) const;
+
+	/**
+	 * Parse a message without copying its data or allocating memory.
+	 * The result refers to the buffer being read and must not outlive it.
+	 */
+	[[nodiscard]]
+	Solace::Result<MessageView, Error>
+	parseView(Solace::ByteReader& src) const;
+
+	/**
+	 * Parse a batch of received datagrams, as returned by recvmmsg, in one pass without allocating memory.
+	 * Messages come out in the order the datagrams have been received.
+	 *
+	 * @param datagrams Payloads of the datagrams received. One message per datagram.
+	 * @param sources Addresses the datagrams have been received from. Either empty or one per datagram.
+	 * @param messages Output for parsed messages. Must have room for a message per datagram.
+	 * @param failed Output for indexes of datagrams that could not be parsed. Must have room for all the datagrams.
+	 */
+	[[nodiscard]]
+	Solace::Result<BatchResult, Error>
+	parseBatch(Solace::ArrayView<Solace::MemoryView const> datagrams,
+			   Solace::ArrayView<Address const> sources,
+			   Solace::ArrayView<ParsedDatagram> messages,
+			   Solace::ArrayView<Solace::uint32> failed) const;
+
+	/**
+	 * Parse a message and pass it straight to a matching callback of the handler.
+	 * No message variant is constructed: the type of the message is switched on once and the payload
+	 * is decoded into a message of that type on the stack.
+	 * The handler must provide callbacks for all of the message types:
+	 * onJoinRequest, onJoinAck, onJoinRedirect, onJoinRejected, onPing, onPong, onSync and onBroadcast.
+	 * Messages passed to the handler refer to the buffer being read and must not outlive it.
+	 */
+	template<typename Handler>
+	[[nodiscard]]
+	Solace::Result<void, Error>
+	dispatch(Solace::ByteReader& src, Handler&& handler) const {
+		auto maybeHeader = parseMessageHeader(src);
+		if (!maybeHeader) {
+			return Solace::Err(maybeHeader.moveError());
+		}
+
+		switch (maybeHeader.unwrap().type) {
+		case Gossip::MessageType::JoinReq:
+			return dispatchPayload<ConnectRequest>(src, [&](auto const& msg) { handler.onJoinRequest(msg); });
+		case Gossip::MessageType::JoinAck:
+			return dispatchPayload<ConnectResponseAck>(src, [&](auto const& msg) { handler.onJoinAck(msg); });
+		case Gossip::MessageType::JoinRedirect:
+			return dispatchPayload<ConnectResponseRedirectView>(src, [&](auto const& msg) {
+				handler.onJoinRedirect(msg);
+			});
+		case Gossip::MessageType::JoinNak:
+			return dispatchPayload<ConnectResponseRejectedView>(src, [&](auto const& msg) {
+				handler.onJoinRejected(msg);
+			});
+
+		case Gossip::MessageType::PingDirect:
+			return dispatchPayload<PingMessage>(src, [&](auto const& msg) { handler.onPing(msg); });
+		case Gossip::MessageType::PongDirect:
+			return dispatchPayload<PongMessage>(src, [&](auto const& msg) { handler.onPong(msg); });
+		case Gossip::MessageType::PingCompact:
+			return dispatchPayload<PingMessage>(src, [&](auto const& msg) { handler.onPing(msg); },
+												UpdateEncoding::Compact);
+		case Gossip::MessageType::PongCompact:
+			return dispatchPayload<PongMessage>(src, [&](auto const& msg) { handler.onPong(msg); },
+												UpdateEncoding::Compact);
+
+		case Gossip::MessageType::SyncPush:
+			return dispatchPayload<SyncMessage>(src, [&](auto const& msg) { handler.onSync(msg); });
+		case Gossip::MessageType::SyncReply:
+			return dispatchPayload<SyncMessage>(src, [&](auto& msg) {
+				msg.isReply = true;
+				handler.onSync(msg);
+			});
+
+		case Gossip::MessageType::Broadcast:
+			return dispatchPayload<BroadcastMessage>(src, [&](auto const& msg) { handler.onBroadcast(msg); });
+		}
+
+		return Solace::Err(Error{});
+	}
+
+	/// Decode payload of a message, that follows message header
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, ConnectRequest* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, ConnectResponseAck* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, ConnectResponseRedirectView* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, ConnectResponseRejectedView* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, PingMessage* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, PongMessage* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, SyncMessage* msg);
+	static Solace::Result<void, Error> parsePayload(Solace::ByteReader& src, BroadcastMessage* msg);
+
+	/**
+	 * Decode membership updates piggybacked on a ping or pong, or members of a snapshot chunk, with no allocations.
+	 * @param updates Piggybacked updates or snapshot members of a parsed message.
+	 * @param dest Output for decoded updates. Must have room for all of the updates.
+	 * @return Number of updates decoded.
+	 */
+	[[nodiscard]]
+	Solace::Result<Solace::uint32, Error>
+	parseUpdates(PiggybackView updates, Solace::ArrayView<MembershipUpdate> dest) const;
+
+	/// Decode network address referred to by a message view
+	[[nodiscard]]
+	Solace::Result<Address, Error>
+	parseAddress(Solace::MemoryView encoded) const;
+
+private:
+
+	template<typename MessageType, typename Callback>
+	static Solace::Result<void, Error> dispatchPayload(Solace::ByteReader& src, Callback&& callback) {
+		MessageType msg{};
+		auto result = parsePayload(src, &msg);
+		if (result) {
+			callback(msg);
+		}
+
+		return result;
+	}
+
+	/// Dispatch a ping or pong, which updates are encoded as given
+	template<typename MessageType, typename Callback>
+	static Solace::Result<void, Error>
+	dispatchPayload(Solace::ByteReader& src, Callback&& callback, UpdateEncoding encoding) {
+		MessageType msg{};
+		msg.updates.encoding = encoding;
+		auto result = parsePayload(src, &msg);
+		if (result) {
+			callback(msg);
+		}
+
+		return result;
+	}
 };
 
 }  // namespace tribe
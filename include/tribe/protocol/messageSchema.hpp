@@ -0,0 +1,228 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_PROTOCOL_MESSAGESCHEMA_HPP
+#define TRIBE_PROTOCOL_MESSAGESCHEMA_HPP
+
+#include "gossip.hpp"
+
+#include <cstddef>  // std::size_t
+#include <tuple>
+#include <type_traits>
+
+
+namespace tribe {
+
+/**
+ * Wire layout of a gossip message.
+ * A schema lists message type code and members of the message in the order they are encoded.
+ * Encoder, decoder and size of encoded message are all derived from this single definition.
+ */
+template<typename MessageType>
+struct MessageSchema;
+
+
+template<>
+struct MessageSchema<ConnectRequest> {
+	static constexpr auto type = Gossip::MessageType::JoinReq;
+	static constexpr auto fields = std::make_tuple(&ConnectRequest::nodeInfo,
+												   &ConnectRequest::token,
+												   &ConnectRequest::auth);
+};
+
+template<>
+struct MessageSchema<ConnectResponseAck> {
+	static constexpr auto type = Gossip::MessageType::JoinAck;
+	static constexpr auto fields = std::make_tuple(&ConnectResponseAck::self,
+												   &ConnectResponseAck::members);
+};
+
+template<>
+struct MessageSchema<ConnectResponseRejectedView> {
+	static constexpr auto type = Gossip::MessageType::JoinNak;
+	static constexpr auto fields = std::make_tuple(&ConnectResponseRejectedView::reason);
+};
+
+template<>
+struct MessageSchema<PingMessage> {
+	static constexpr auto type = Gossip::MessageType::PingDirect;
+	static constexpr auto fields = std::make_tuple(&PingMessage::origin,
+												   &PingMessage::target,
+												   &PingMessage::ttl,
+												   &PingMessage::updates);
+};
+
+template<>
+struct MessageSchema<PongMessage> {
+	static constexpr auto type = Gossip::MessageType::PongDirect;
+	static constexpr auto fields = std::make_tuple(&PongMessage::origin,
+												   &PongMessage::nodeDetails,
+												   &PongMessage::ttl,
+												   &PongMessage::updates);
+};
+
+template<>
+struct MessageSchema<SyncMessage> {
+	static constexpr auto type = Gossip::MessageType::SyncPush;
+	static constexpr auto fields = std::make_tuple(&SyncMessage::origin,
+												   &SyncMessage::chunk,
+												   &SyncMessage::members);
+};
+
+template<>
+struct MessageSchema<BroadcastMessage> {
+	static constexpr auto type = Gossip::MessageType::Broadcast;
+	static constexpr auto fields = std::make_tuple(&BroadcastMessage::node);
+};
+
+
+/// Size in bytes of encoded fields of fixed size
+constexpr std::size_t encodedSize(Solace::uint8) noexcept { return sizeof(Solace::uint8); }
+constexpr std::size_t encodedSize(Solace::uint16) noexcept { return sizeof(Solace::uint16); }
+constexpr std::size_t encodedSize(Solace::uint32) noexcept { return sizeof(Solace::uint32); }
+constexpr std::size_t encodedSize(Solace::uint64) noexcept { return sizeof(Solace::uint64); }
+constexpr std::size_t encodedSize(NodeID id) noexcept { return encodedSize(id.value); }
+constexpr std::size_t encodedSize(NodeInfo const& node) noexcept {
+	return encodedSize(node.id) + encodedSize(node.gen);
+}
+constexpr std::size_t encodedSize(SnapshotChunk const& chunk) noexcept {
+	return encodedSize(chunk.snapshot) + encodedSize(chunk.index) + encodedSize(chunk.count);
+}
+
+/**
+ * Size in bytes of encoded fields of variable size. Data is prefixed by its size.
+ * Note: sizes are not truncated to the width of the size prefix, so that a field too large to be encoded
+ * is never mistaken for a small one.
+ */
+constexpr std::size_t encodedSize(Solace::MemoryView data) noexcept {
+	return sizeof(Gossip::size_type) + data.size();
+}
+
+constexpr std::size_t encodedSize(Solace::StringView data) noexcept {
+	return sizeof(Gossip::size_type) + data.size();
+}
+
+constexpr std::size_t encodedSize(ErrorView const& error) noexcept {
+	return encodedSize(error.domain) + encodedSize(error.code) + encodedSize(error.tag);
+}
+
+/// Size in bytes of encoded network address. Depends on the address family.
+std::size_t encodedSize(Address const& address) noexcept;
+
+/// Size in bytes of piggybacked updates: number of updates followed by the updates
+constexpr std::size_t encodedSize(PiggybackView const& updates) noexcept {
+	return encodedSize(updates.count) + updates.data.size();
+}
+
+inline std::size_t encodedSize(MembershipUpdate const& update) noexcept {
+	return sizeof(update.kind) + encodedSize(update.node) + encodedSize(update.address) +
+			((update.kind == MembershipUpdate::Kind::Suspect) ? encodedSize(update.suspecter) : 0);
+}
+
+/// Size in bytes of an integer encoded as LEB128 varint
+constexpr Gossip::size_type varintSize(Solace::uint64 value) noexcept {
+	Gossip::size_type size = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		size += 1;
+	}
+
+	return size;
+}
+
+/**
+ * Size in bytes of a compactly encoded address, that does not refer to any other address.
+ * Addresses sharing a prefix with addresses of preceding updates are encoded in fewer bytes.
+ */
+Gossip::size_type compactEncodedSize(Address const& address) noexcept;
+
+/**
+ * Upper bound of the size in bytes of a compactly encoded update.
+ * Node ID is encoded as a difference from the ID of the previous update, modulo 2^32.
+ * Thus when updates are ordered by node ID, the size with `previous` of 0 is an upper bound too.
+ */
+inline std::size_t encodedSize(MembershipUpdate const& update, NodeID previous) noexcept {
+	return sizeof(update.kind) +
+			varintSize(static_cast<Solace::uint32>(update.node.id.value - previous.value)) +
+			varintSize(update.node.gen) +
+			compactEncodedSize(update.address) +
+			((update.kind == MembershipUpdate::Kind::Suspect) ? varintSize(update.suspecter.value) : 0);
+}
+
+
+/// Trait of message fields that are always encoded into the same number of bytes
+template<typename T>
+struct IsFixedSizeField : std::is_integral<T> {};
+
+template<> struct IsFixedSizeField<NodeID> : std::true_type {};
+template<> struct IsFixedSizeField<NodeInfo> : std::true_type {};
+template<> struct IsFixedSizeField<SnapshotChunk> : std::true_type {};
+
+
+/// Get type code of a message
+template<typename MessageType>
+constexpr Gossip::MessageType messageTypeOf(MessageType const&) noexcept {
+	return MessageSchema<MessageType>::type;
+}
+
+/// Pings and pongs with compactly encoded updates are of different message types
+constexpr Gossip::MessageType messageTypeOf(PingMessage const& msg) noexcept {
+	return (msg.updates.encoding == UpdateEncoding::Compact)
+			? Gossip::MessageType::PingCompact
+			: Gossip::MessageType::PingDirect;
+}
+
+constexpr Gossip::MessageType messageTypeOf(PongMessage const& msg) noexcept {
+	return (msg.updates.encoding == UpdateEncoding::Compact)
+			? Gossip::MessageType::PongCompact
+			: Gossip::MessageType::PongDirect;
+}
+
+/// Sync pushes and replies only differ in message type
+constexpr Gossip::MessageType messageTypeOf(SyncMessage const& msg) noexcept {
+	return msg.isReply
+			? Gossip::MessageType::SyncReply
+			: Gossip::MessageType::SyncPush;
+}
+
+
+/// Check if all encoded messages of the given type have the same size
+template<typename MessageType>
+constexpr bool hasFixedEncodedSize() noexcept {
+	return std::apply([](auto... fields) {
+		return (IsFixedSizeField<std::decay_t<decltype(std::declval<MessageType const&>().*fields)>>::value && ...);
+	}, MessageSchema<MessageType>::fields);
+}
+
+
+/// Size in bytes of the encoded message, including message header
+template<typename MessageType>
+constexpr std::size_t encodedSize(MessageType const& msg) noexcept {
+	return std::apply([&msg](auto... fields) {
+		return (std::size_t{Gossip::headerSize()} + ... + encodedSize(msg.*fields));
+	}, MessageSchema<MessageType>::fields);
+}
+
+
+/// Size in bytes of any encoded message of a type with fixed layout, such as BroadcastMessage
+template<typename MessageType>
+constexpr std::size_t encodedSize() noexcept {
+	static_assert(hasFixedEncodedSize<MessageType>(), "Message has fields of variable size");
+	return encodedSize(MessageType{});
+}
+
+}  // namespace tribe
+#endif  // TRIBE_PROTOCOL_MESSAGESCHEMA_HPP
@@ -18,6 +18,9 @@
 #define TRIBE_PROTOCOL_MESSAGEBUILDER_HPP
 
 #include "gossip.hpp"
+#include "messageSchema.hpp"
+
+#include <solace/arrayView.hpp>
 
 
 namespace tribe {
@@ -41,15 +44,95 @@ struct MessageWriter {
 	MessageWriter& join(NodeInfo const& self, Solace::MemoryView token, Solace::MemoryView auth);
 
 	MessageWriter& joinAck(NodeInfo const& self);
+
+	/**
+	 * Write a join acknowledgement carrying the first chunk of a snapshot of the group.
+	 * As many of the leading members as fit into the remaining space of the output buffer are written.
+	 * @see MembershipSnapshot to split a snapshot into chunks.
+	 */
+	MessageWriter& joinAck(NodeInfo const& self, Solace::ArrayView<MembershipUpdate const> members);
 	MessageWriter& joinNack(Solace::Error reason);
 	MessageWriter& joinRedirect(Solace::Error reason, Address const& redirectAddress);
 
 	MessageWriter& advertise(NodeInfo const& state);
 	MessageWriter& ping(NodeID requestorId, NodeID targetId);
+
+	/// Write a ping to be relayed to the target by the recipient, if the recipient is not the target
+	MessageWriter& ping(NodeID requestorId, NodeID targetId, Solace::uint8 ttl);
 	MessageWriter& pong(NodeID requestorId, NodeInfo const& selfInfo);
 
+	/// Write a pong to be relayed to the requestor by the recipient, if the recipient is not the requestor
+	MessageWriter& pong(NodeID requestorId, NodeInfo const& selfInfo, Solace::uint8 ttl);
+
+	/**
+	 * Write a ping with membership updates piggybacked.
+	 * As many of the leading updates as fit into the remaining space of the output buffer are written.
+	 * @see piggybackCapacity to find out how many updates that is.
+	 * Compactly encoded updates take the least space when ordered by node ID.
+	 */
+	MessageWriter& ping(NodeID requestorId, NodeID targetId,
+						Solace::ArrayView<MembershipUpdate const> updates,
+						UpdateEncoding encoding = UpdateEncoding::Fixed);
+
+	/// Write a ping with membership updates piggybacked, to be relayed to the target. @see ping
+	MessageWriter& ping(NodeID requestorId, NodeID targetId, Solace::uint8 ttl,
+						Solace::ArrayView<MembershipUpdate const> updates,
+						UpdateEncoding encoding = UpdateEncoding::Fixed);
+
+	/// Write a pong with membership updates piggybacked. @see ping
+	MessageWriter& pong(NodeID requestorId, NodeInfo const& selfInfo,
+						Solace::ArrayView<MembershipUpdate const> updates,
+						UpdateEncoding encoding = UpdateEncoding::Fixed);
+
+	/// Write a pong with membership updates piggybacked, to be relayed to the requestor. @see ping
+	MessageWriter& pong(NodeID requestorId, NodeInfo const& selfInfo, Solace::uint8 ttl,
+						Solace::ArrayView<MembershipUpdate const> updates,
+						UpdateEncoding encoding = UpdateEncoding::Fixed);
+
+	/**
+	 * Write a chunk of a snapshot of the group membership to push to a peer for anti-entropy sync.
+	 * As many of the leading members as fit into the remaining space of the output buffer are written.
+	 */
+	MessageWriter& syncPush(NodeInfo const& self, SnapshotChunk chunk,
+							Solace::ArrayView<MembershipUpdate const> members);
+
+	/// Write a chunk of a snapshot of the group membership in reply to a sync push. @see syncPush
+	MessageWriter& syncReply(NodeInfo const& self, SnapshotChunk chunk,
+							 Solace::ArrayView<MembershipUpdate const> members);
+
+	/// Get the number of the leading updates that can be encoded into a given number of bytes
+	static Solace::uint32 piggybackCapacity(Solace::ArrayView<MembershipUpdate const> updates,
+											std::size_t budget,
+											UpdateEncoding encoding = UpdateEncoding::Fixed) noexcept;
+
+	/**
+	 * Get the size of a buffer in bytes required to store the encoded message.
+	 * Note: the size is not bounded by the max size of a message, so that an oversized message can be detected.
+	 */
+	template<typename MessageType>
+	static constexpr std::size_t sizeOf(MessageType const& msg) noexcept {
+		return encodedSize(msg);
+	}
+
+	static std::size_t sizeOf(ConnectResponseRedirect const& msg) noexcept;
+	static std::size_t sizeOf(ConnectResponseRejected const& msg) noexcept;
+
 private:
 
+	/**
+	 * Write a message into the output buffer.
+	 * Once the buffer is known to have enough room for the message, the message is written without
+	 * further bounds checks. Messages larger than the max size of a field are always written with bounds checks.
+	 */
+	template<typename MessageType>
+	MessageWriter& write(MessageType const& msg);
+
+	/// Write a message followed by updates to piggyback, which count is the last field of the message
+	template<typename MessageType>
+	MessageWriter& writeWithUpdates(MessageType&& msg, PiggybackView MessageType::* field,
+									Solace::ArrayView<MembershipUpdate const> updates,
+									UpdateEncoding encoding);
+
 	Solace::ByteWriter&     _writer;
 };
 
@@ -0,0 +1,130 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#pragma once
+#ifndef TRIBE_TIMERWHEEL_HPP
+#define TRIBE_TIMERWHEEL_HPP
+
+#include <solace/types.hpp>
+
+#include <array>
+#include <utility>
+#include <vector>
+
+
+namespace tribe {
+
+/**
+ * Hierarchical timing wheel.
+ * Schedules values to expire at a given tick. Scheduling is O(1) and advancing the wheel by one tick costs
+ * O(number of expiring timers), plus amortised cascading of long timers from coarse levels to finer ones.
+ *
+ * Each level has 64 slots, a slot of level N spans 64^N ticks. Timers further than 64^4 ticks in the future
+ * are parked in the last slot of the top level and re-scheduled when it cascades.
+ * Note: there is no cancellation. Users are expected to discard stale timers when they expire.
+ */
+template<typename T>
+struct TimerWheel {
+	using Tick = Solace::uint64;
+
+	struct Timer {
+		T		value;
+		Tick	deadline;
+	};
+
+	static constexpr Solace::uint32 kSlotBits = 6;
+	static constexpr Solace::uint32 kSlots = 1 << kSlotBits;
+	static constexpr Solace::uint32 kLevels = 4;
+	static constexpr Tick kHorizon = Tick{1} << (kSlotBits * kLevels);
+
+	constexpr explicit TimerWheel(Tick now = 0) noexcept
+		: _now{now}
+	{}
+
+	/// Current tick of the wheel
+	Tick now() const noexcept { return _now; }
+
+	/// Number of timers pending, including stale ones
+	Solace::uint64 size() const noexcept { return _size; }
+	bool empty() const noexcept { return (_size == 0); }
+
+	/**
+	 * Schedule a value to expire at the given tick.
+	 * Deadlines in the past expire on the next call to advance.
+	 */
+	void schedule(T value, Tick deadline) {
+		if (deadline <= _now) {
+			deadline = _now + 1;
+		}
+
+		place(Timer{std::move(value), deadline});
+		_size += 1;
+	}
+
+	/**
+	 * Move the wheel one tick forward and expire all the timers due.
+	 * @param onExpired Callable invoked with each expired Timer. It is allowed to schedule new timers.
+	 */
+	template<typename F>
+	void advance(F&& onExpired) {
+		_now += 1;
+
+		// Cascade coarse levels down, top level first as its timers may land in the slots being cascaded next.
+		for (auto level = kLevels - 1; level > 0; --level) {
+			if ((_now & ((Tick{1} << (kSlotBits * level)) - 1)) == 0) {
+				auto timers = std::move(_wheel[level][slotIndex(_now, level)]);
+				_wheel[level][slotIndex(_now, level)].clear();
+				for (auto& timer : timers) {
+					place(std::move(timer));
+				}
+			}
+		}
+
+		auto expired = std::move(_wheel[0][slotIndex(_now, 0)]);
+		_wheel[0][slotIndex(_now, 0)].clear();
+		_size -= expired.size();
+
+		for (auto& timer : expired) {
+			onExpired(std::move(timer));
+		}
+	}
+
+private:
+
+	static Solace::uint32 slotIndex(Tick tick, Solace::uint32 level) noexcept {
+		return static_cast<Solace::uint32>(tick >> (kSlotBits * level)) & (kSlots - 1);
+	}
+
+	void place(Timer&& timer) {
+		auto const delta = timer.deadline - _now;
+		for (Solace::uint32 level = 0; level < kLevels; ++level) {
+			if (delta < (Tick{1} << (kSlotBits * (level + 1)))) {
+				_wheel[level][slotIndex(timer.deadline, level)].emplace_back(std::move(timer));
+				return;
+			}
+		}
+
+		// Beyond the horizon: park in the furthest slot of the top level
+		_wheel[kLevels - 1][slotIndex(_now + kHorizon - 1, kLevels - 1)].emplace_back(std::move(timer));
+	}
+
+private:
+	std::array<std::array<std::vector<Timer>, kSlots>, kLevels>		_wheel;
+	Tick															_now;
+	Solace::uint64													_size{0};
+};
+
+}  // namespace tribe
+#endif  // TRIBE_TIMERWHEEL_HPP
@@ -0,0 +1,204 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/decayScheduler.hpp"
+#include "tribe/livenessStore.hpp"
+
+#include <algorithm>  // std::min, std::max
+#include <cmath>
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+namespace /* anonymous */ {
+
+/**
+ * Number of ticks before the first observable change of a peer: its state, health or expiry.
+ * Liveness of the peer after a number of ticks is given in closed form by catchUpLiveness,
+ * so the tick is estimated from the decay factor and the thresholds, then corrected for rounding errors.
+ */
+DecayScheduler::Tick
+ticksToChange(Peer::Liveness const& value, float32 decayFactor) noexcept {
+	using Tick = DecayScheduler::Tick;
+
+	// Suspected peers are dead and dead peers expire once their TTL runs out
+	if (value.state != Peer::State::Alive) {
+		return std::max<Tick>(value.ttl, 1);
+	}
+
+	// Alive peers are no longer healthy once TTL runs out
+	auto const deadline = (value.ttl > 0)
+			? std::min<Tick>(value.ttl, DecayScheduler::kMaxLookahead)
+			: DecayScheduler::kMaxLookahead;
+
+	auto const probabilityAt = [&value, decayFactor](Tick ticks) {
+		return catchUpLiveness(value, static_cast<uint16>(ticks), decayFactor).probabitily;
+	};
+
+	// Peers are no longer healthy once probability drops to the threshold, and are suspected once it drops below
+	if (probabilityAt(1) <= Peer::kMaybeNotAlive) {
+		return 1;
+	}
+
+	if (decayFactor >= 1) {
+		return deadline;
+	}
+
+	// p*f^n <= threshold <=> n >= log(threshold/p) / log(f)
+	auto const estimate = std::ceil(std::log(Peer::kMaybeNotAlive / value.probabitily) / std::log(decayFactor));
+	auto ticks = static_cast<Tick>(std::min(std::max(estimate, 1.0f), static_cast<float32>(deadline)));
+	while (ticks > 1 && probabilityAt(ticks - 1) <= Peer::kMaybeNotAlive) {
+		ticks -= 1;
+	}
+
+	while (ticks < deadline && probabilityAt(ticks) > Peer::kMaybeNotAlive) {
+		ticks += 1;
+	}
+
+	return ticks;
+}
+
+}  // anonymous namespace
+
+
+DecayScheduler::DecayScheduler(MembershipSettings const& settings) noexcept
+	: DecayScheduler{settings.peerInfoDecayTimeMs, settings.peerInfoDecayRate, settings.peerInfoDecayMode}
+{}
+
+
+DecayScheduler::DecayScheduler(uint32 decayTimeMs, float32 decayRate, DecayMode mode) noexcept
+	: _decayFactor{decayFactor(decayRate, 1, decayTimeMs, mode)}
+{}
+
+
+Peer::Liveness
+DecayScheduler::replay(Peer::Liveness value, Tick ticks) const noexcept {
+	// Note: peers are rescheduled at least every kMaxLookahead ticks, so the number of ticks fits
+	return catchUpLiveness(value, static_cast<uint16>(ticks), _decayFactor);
+}
+
+
+void
+DecayScheduler::schedule(NodeID id, Peer::Liveness const& liveness) {
+	auto const ticks = ticksToChange(liveness, _decayFactor);
+	auto const deadline = now() + ticks;
+	_entries.insert_or_assign(id, Entry{now(), deadline, replay(liveness, ticks)});
+	_wheel.schedule(id, deadline);
+}
+
+
+void
+DecayScheduler::track(NodeID id, Peer::Liveness const& liveness) {
+	schedule(id, liveness);
+}
+
+
+void
+DecayScheduler::track(PeersModel const& model) {
+	_entries.reserve(_entries.size() + model.members.size());
+	for (auto const& entry : model.members) {
+		schedule(entry.first, model.liveness(entry.second));
+	}
+}
+
+
+void
+DecayScheduler::forget(NodeID id) {
+	_entries.erase(id);
+}
+
+
+PeersModel
+DecayScheduler::tick(PeersModel&& model) {
+	model.now += 1;
+	_wheel.advance([this, &model](TimerWheel<NodeID>::Timer&& timer) {
+		auto entryIt = _entries.find(timer.value);
+		if (entryIt == _entries.end() || entryIt->second.deadline != timer.deadline) {
+			return;  // Stale timer: the peer was re-tracked or forgotten since.
+		}
+
+		auto peerIt = model.members.find(timer.value);
+		if (peerIt == model.members.end()) {
+			_entries.erase(entryIt);
+			return;
+		}
+
+		if (PeersModel::isExpired(entryIt->second.next)) {
+			model.erasePeer(timer.value);
+			_entries.erase(entryIt);
+			return;
+		}
+
+		auto next = entryIt->second.next;
+		if (PeersModel::isAlive(model.liveness(peerIt->second)) && PeersModel::isSuspected(next)) {
+			model.startSuspicion(timer.value, next, model.node.id, model.now);
+		}
+
+		model.reindex(timer.value, next);
+		model.setLiveness(peerIt->second, next);
+		schedule(timer.value, next);
+	});
+
+	// Seeds are few: sweep them as DecayPeerInfo does
+	for (auto it = model.seeds.begin(); it != model.seeds.end(); ) {
+		it->second.ttl = (it->second.ttl > 1)
+				? it->second.ttl - 1
+				: 0;
+
+		if (it->second.ttl == 0) {
+			it = model.seeds.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	return std::move(model);
+}
+
+
+PeersModel
+DecayScheduler::advance(PeersModel&& model, LocalHealth& health, LocalHealth::Tick elapsed) {
+	for (auto ticks = health.advance(elapsed); ticks > 0; --ticks) {
+		model = tick(std::move(model));
+	}
+
+	return std::move(model);
+}
+
+
+PeersModel
+DecayScheduler::sync(PeersModel&& model) {
+	for (auto& entry : _entries) {
+		auto const ticks = now() - entry.second.synced;
+		if (ticks == 0) {
+			continue;
+		}
+
+		auto it = model.members.find(entry.first);
+		if (it == model.members.end()) {
+			continue;
+		}
+
+		// Liveness in the model is accurate as of now, and the change due at the deadline is decayed from it
+		auto const liveness = replay(model.liveness(it->second), ticks);
+		model.setLiveness(it->second, liveness);
+		entry.second.synced = now();
+		entry.second.next = replay(liveness, entry.second.deadline - now());
+	}
+
+	return std::move(model);
+}
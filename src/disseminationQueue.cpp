@@ -0,0 +1,250 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/disseminationQueue.hpp"
+#include "tribe/protocol/messageSchema.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+namespace /* anonymous */ {
+
+/// Max number of updates piggybacked on a single message
+constexpr std::size_t kMaxPicks = std::numeric_limits<decltype(PiggybackView::count)>::max();
+
+
+/// Precedence of updates about the same generation of a node
+int precedence(MembershipUpdate::Kind kind) noexcept {
+	switch (kind) {
+	case MembershipUpdate::Kind::Dead:		return 2;
+	case MembershipUpdate::Kind::Suspect:	return 1;
+	case MembershipUpdate::Kind::Alive:
+	case MembershipUpdate::Kind::Joined:
+	default:
+		return 0;
+	}
+}
+
+
+/**
+ * Check if an update carries news over the one pending for the same node.
+ * Re-gossiped copies of the pending update are not news, or its transmit count would keep restarting.
+ */
+bool isNewer(MembershipUpdate const& update, MembershipUpdate const& pending) noexcept {
+	if (update.node.gen != pending.node.gen) {
+		return (update.node.gen > pending.node.gen);
+	}
+
+	auto const updatePrecedence = precedence(update.kind);
+	auto const pendingPrecedence = precedence(pending.kind);
+	if (updatePrecedence != pendingPrecedence) {
+		return (updatePrecedence > pendingPrecedence);
+	}
+
+	// Suspicion by another member is news: it counts towards confirmations
+	return (update.kind == MembershipUpdate::Kind::Suspect && update.suspecter != pending.suspecter);
+}
+
+}  // anonymous namespace
+
+
+DisseminationQueue::size_type
+DisseminationQueue::retransmitLimit(size_type clusterSize) const noexcept {
+	auto const limit = std::ceil(_retransmitMultiplier * std::log10(static_cast<float32>(clusterSize) + 1));
+
+	return (limit < 1) ? 1 : static_cast<size_type>(limit);
+}
+
+
+void
+DisseminationQueue::place(size_type position, HeapEntry const& entry) {
+	_heap[position] = entry;
+	_pending.find(entry.id)->second.position = position;
+}
+
+
+void
+DisseminationQueue::siftUp(size_type position) {
+	auto const entry = _heap[position];
+	while (position > 0) {
+		auto const parent = (position - 1) / 2;
+		if (!isBefore(entry, _heap[parent])) {
+			break;
+		}
+
+		place(position, _heap[parent]);
+		position = parent;
+	}
+
+	place(position, entry);
+}
+
+
+void
+DisseminationQueue::siftDown(size_type position) {
+	auto const entry = _heap[position];
+	auto const count = size();
+	while (true) {
+		auto child = 2 * position + 1;
+		if (child >= count) {
+			break;
+		}
+
+		if (child + 1 < count && isBefore(_heap[child + 1], _heap[child])) {
+			child += 1;
+		}
+
+		if (!isBefore(_heap[child], entry)) {
+			break;
+		}
+
+		place(position, _heap[child]);
+		position = child;
+	}
+
+	place(position, entry);
+}
+
+
+void
+DisseminationQueue::removeAt(size_type position) {
+	_pending.erase(_heap[position].id);
+	detach(position);
+}
+
+
+void
+DisseminationQueue::detach(size_type position) {
+	auto const last = _heap.back();
+	_heap.pop_back();
+	if (position == size()) {
+		return;
+	}
+
+	// Fill the hole with the last entry and restore the heap order around it
+	_heap[position] = last;
+	_pending.find(last.id)->second.position = position;
+	siftDown(position);
+	siftUp(_pending.find(last.id)->second.position);
+}
+
+
+bool
+DisseminationQueue::enqueue(MembershipUpdate const& update) {
+	auto const id = update.node.id;
+	auto it = _pending.find(id);
+	if (it == _pending.end()) {
+		auto const position = size();
+		_pending.try_emplace(id, Pending{update, position});
+		_heap.push_back(HeapEntry{0, _sequence++, id});
+		siftUp(position);
+
+		return true;
+	}
+
+	auto& pending = it->second;
+	if (!isNewer(update, pending.update)) {
+		return false;
+	}
+
+	// Newer update invalidates the pending one: it is to be transmitted afresh
+	pending.update = update;
+	auto const position = pending.position;
+	_heap[position].transmits = 0;
+	_heap[position].sequence = _sequence++;
+	siftUp(position);
+
+	return true;
+}
+
+
+bool
+DisseminationQueue::erase(NodeID id) {
+	auto it = _pending.find(id);
+	if (it == _pending.end()) {
+		return false;
+	}
+
+	removeAt(it->second.position);
+	return true;
+}
+
+
+DisseminationQueue::size_type
+DisseminationQueue::fill(std::size_t budget, size_type clusterSize, ArrayView<MembershipUpdate> dest,
+						 UpdateEncoding encoding) {
+	auto const limit = retransmitLimit(clusterSize);
+	auto const maxPicks = std::min<std::size_t>(dest.size(), kMaxPicks);
+
+	// Picked and skipped updates are taken out of the heap so that none is looked at twice
+	_picked.clear();
+	_skipped.clear();
+	while (_picked.size() < maxPicks && !_heap.empty()) {
+		auto const& pending = _pending.find(_heap[0].id)->second;
+		// Delta-encoded node ID of updates ordered by ID is no larger than the ID itself
+		auto const updateSize = (encoding == UpdateEncoding::Compact)
+				? encodedSize(pending.update, NodeID{0})
+				: encodedSize(pending.update);
+		if (updateSize > budget) {
+			if (_skipped.size() == kMaxSkips) {
+				break;
+			}
+
+			_skipped.push_back(_heap[0]);
+			detach(0);
+			continue;
+		}
+
+		budget -= updateSize;
+		dest[static_cast<size_type>(_picked.size())] = pending.update;
+		_picked.push_back(_heap[0]);
+		detach(0);
+	}
+
+	// Picked updates go back behind others sent fewer times, or are dropped once they have been sent enough
+	for (auto entry : _picked) {
+		entry.transmits += 1;
+		if (entry.transmits >= limit) {
+			_pending.erase(entry.id);
+			continue;
+		}
+
+		auto const position = size();
+		_heap.push_back(entry);
+		siftUp(position);
+	}
+
+	// Skipped updates have not been transmitted: they go back as they were
+	for (auto const& entry : _skipped) {
+		auto const position = size();
+		_heap.push_back(entry);
+		siftUp(position);
+	}
+
+	auto const count = static_cast<size_type>(_picked.size());
+	if (encoding == UpdateEncoding::Compact) {
+		std::sort(dest.begin(), dest.begin() + count, [](MembershipUpdate const& lhs, MembershipUpdate const& rhs) {
+			return lhs.node.id.value < rhs.node.id.value;
+		});
+	}
+
+	return count;
+}
@@ -0,0 +1,373 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/livenessStore.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>  // std::max
+#include <cmath>      // std::exp, std::pow, std::log
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+static_assert(static_cast<uint8>(Peer::State::Alive) + 1 == static_cast<uint8>(Peer::State::Suspected),
+			  "Decay kernel relies on state transitions being increments");
+static_assert(static_cast<uint8>(Peer::State::Suspected) + 1 == static_cast<uint8>(Peer::State::Dead),
+			  "Decay kernel relies on state transitions being increments");
+
+
+namespace /* anonymous */ {
+
+/**
+ * Single step decay of a liveness estimate.
+ * @param deadThreshold Alive peers with probability below it and expired TTL are dead after this step.
+ * It accounts for peers that become suspected before the last of a number of ticks processed at once.
+ */
+Peer::Liveness
+decayStep(Peer::Liveness value, uint16 dt, float32 decayFactor, float32 deadThreshold) noexcept {
+	// Exponential decay of aliveness certainty: dP / dt = -kP
+	value.probabitily *= decayFactor;
+
+	// Decrement TTL of the nodes
+	value.ttl = (value.ttl > dt)
+			? (value.ttl - dt)
+			: 0;
+
+
+	// Update state
+	switch (value.state) {
+	case Peer::State::Alive: {
+		if (value.probabitily < deadThreshold && value.ttl == 0) {
+			value.state = Peer::State::Dead;
+		} else if (value.probabitily < Peer::kMaybeNotAlive) {
+			value.state = Peer::State::Suspected;
+		}
+	} break;
+	case Peer::State::Suspected: {
+		if (value.ttl == 0) {  // Expired suspected state transition to be considered 'dead'
+			value.state = Peer::State::Dead;
+		}
+	} break;
+	case Peer::State::Dead: break;  // Nothing to go from here
+	}
+
+	return value;
+}
+
+
+/// Probability below which a peer alive `ticks` ago has been suspected before the last tick.
+float32
+catchUpThreshold(uint16 ticks, float32 tickFactor) noexcept {
+	// p[n-1] < threshold <=> p[n] < threshold*f
+	return (ticks > 1)
+			? Peer::kMaybeNotAlive * tickFactor
+			: 0;
+}
+
+
+/// Check if a decay step changes anything observable about the peer: its state, health or expiry
+bool
+isChange(Peer::Liveness const& before, Peer::Liveness const& after) noexcept {
+	auto const isHealthy = [](Peer::Liveness const& value) {
+		return (value.state == Peer::State::Alive && value.ttl > 0 && value.probabitily > Peer::kMaybeNotAlive);
+	};
+
+	return (before.state != after.state) ||
+			(isHealthy(before) != isHealthy(after)) ||
+			(after.state == Peer::State::Dead && after.ttl == 0);
+}
+
+
+/**
+ * Decay a number of estimates stored as a structure of arrays.
+ * @param changes If not null, observable changes of the estimates are appended to it.
+ */
+void
+decayArrays(float32* probabilities, uint16* ttls, uint8* states, NodeID const* ids, LivenessStore::size_type count,
+			uint16 ttlDelta, float32 decayFactor, float32 deadThreshold,
+			std::vector<LivenessStore::Change>* changes) {
+	LivenessStore::size_type i = 0;
+
+#if defined(__SSE2__)
+	// Process 8 peers at a time: two vectors of probabilities, one vector of TTLs and half a vector of states.
+	auto const factor = _mm_set1_ps(decayFactor);
+	auto const threshold = _mm_set1_ps(Peer::kMaybeNotAlive);
+	auto const dyingThreshold = _mm_set1_ps(deadThreshold);
+	auto const delta = _mm_set1_epi16(static_cast<int16>(ttlDelta));
+	auto const zero = _mm_setzero_si128();
+	auto const one = _mm_set1_epi16(1);
+	auto const alive = _mm_set1_epi16(static_cast<int16>(Peer::State::Alive));
+	auto const suspected = _mm_set1_epi16(static_cast<int16>(Peer::State::Suspected));
+	auto const dead = _mm_set1_epi16(static_cast<int16>(Peer::State::Dead));
+
+	for (; i + 8 <= count; i += 8) {
+		auto const before0 = _mm_loadu_ps(probabilities + i);
+		auto const before1 = _mm_loadu_ps(probabilities + i + 4);
+		auto const p0 = _mm_mul_ps(before0, factor);
+		auto const p1 = _mm_mul_ps(before1, factor);
+		_mm_storeu_ps(probabilities + i, p0);
+		_mm_storeu_ps(probabilities + i + 4, p1);
+
+		// Saturating subtraction never lets TTL underflow
+		auto const ttlData = reinterpret_cast<__m128i*>(ttls + i);
+		auto const ttlBefore = _mm_loadu_si128(ttlData);
+		auto const ttl = _mm_subs_epu16(ttlBefore, delta);
+		_mm_storeu_si128(ttlData, ttl);
+
+		auto const stateData = reinterpret_cast<__m128i*>(states + i);
+		auto const state = _mm_unpacklo_epi8(_mm_loadl_epi64(stateData), zero);
+
+		// 16 bit masks of the conditions for each of the 8 peers
+		auto const unlikelyAlive = _mm_packs_epi32(_mm_castps_si128(_mm_cmplt_ps(p0, threshold)),
+												   _mm_castps_si128(_mm_cmplt_ps(p1, threshold)));
+		auto const dying = _mm_packs_epi32(_mm_castps_si128(_mm_cmplt_ps(p0, dyingThreshold)),
+										   _mm_castps_si128(_mm_cmplt_ps(p1, dyingThreshold)));
+		auto const expired = _mm_cmpeq_epi16(ttl, zero);
+
+		auto const wasAlive = _mm_cmpeq_epi16(state, alive);
+		auto const toSuspected = _mm_and_si128(wasAlive, unlikelyAlive);
+		auto const toDead = _mm_and_si128(_mm_cmpeq_epi16(state, suspected), expired);
+		auto const aliveToDead = _mm_and_si128(wasAlive, _mm_and_si128(dying, expired));
+
+		// Each transition moves a peer to the next state, alive peers can skip suspected state when catching up
+		auto const steps = _mm_add_epi16(_mm_and_si128(_mm_or_si128(toSuspected, toDead), one),
+										 _mm_and_si128(aliveToDead, one));
+		auto const newState = _mm_add_epi16(state, steps);
+
+		if (changes) {
+			// Healthy peers are alive, have TTL left and are likely alive
+			auto const likelyAliveBefore = _mm_packs_epi32(_mm_castps_si128(_mm_cmpgt_ps(before0, threshold)),
+														   _mm_castps_si128(_mm_cmpgt_ps(before1, threshold)));
+			auto const likelyAlive = _mm_packs_epi32(_mm_castps_si128(_mm_cmpgt_ps(p0, threshold)),
+													 _mm_castps_si128(_mm_cmpgt_ps(p1, threshold)));
+			auto const healthyBefore = _mm_andnot_si128(_mm_cmpeq_epi16(ttlBefore, zero),
+														_mm_and_si128(wasAlive, likelyAliveBefore));
+			auto const healthy = _mm_andnot_si128(expired,
+												  _mm_and_si128(_mm_cmpeq_epi16(newState, alive), likelyAlive));
+
+			auto const changed = _mm_or_si128(_mm_or_si128(_mm_or_si128(toSuspected, toDead), aliveToDead),
+											  _mm_or_si128(_mm_xor_si128(healthy, healthyBefore),
+														   _mm_and_si128(_mm_cmpeq_epi16(newState, dead), expired)));
+
+			// One bit per peer
+			auto mask = static_cast<uint32>(_mm_movemask_epi8(_mm_packs_epi16(changed, zero)));
+			for (; mask != 0; mask &= mask - 1) {
+				auto const j = i + static_cast<LivenessStore::size_type>(__builtin_ctz(mask));
+				changes->push_back({ids[j], static_cast<Peer::State>(states[j])});
+			}
+		}
+
+		_mm_storel_epi64(stateData, _mm_packus_epi16(newState, newState));
+	}
+#endif
+
+	// Scalar tail or fallback
+	for (; i < count; ++i) {
+		auto const before = Peer::Liveness{ttls[i], probabilities[i], static_cast<Peer::State>(states[i])};
+		auto const after = decayStep(before, ttlDelta, decayFactor, deadThreshold);
+		probabilities[i] = after.probabitily;
+		ttls[i] = after.ttl;
+		states[i] = static_cast<uint8>(after.state);
+
+		if (changes && isChange(before, after)) {
+			changes->push_back({ids[i], before.state});
+		}
+	}
+}
+
+}  // anonymous namespace
+
+
+float32
+tribe::decayFactor(float32 k, uint16 ttlDelta, uint32 decayTimeMs, DecayMode mode) noexcept {
+	// Exponential decay of aliveness certainty: dP / dt = -kP
+	auto const dt = ttlDelta*(decayTimeMs / 1000.f);
+
+	switch (mode) {
+	case DecayMode::Exponential:
+		// p1 = p0*exp(-kdt)
+		return std::exp(-k*dt);
+	case DecayMode::Linear:
+		break;
+	}
+
+	// (p1 - p0) / dt = -kp0
+	// p1 = p0 - kp0*dt = p0*(1 - kdt)
+	return std::max(0.0f, 1.0f - k*dt);
+}
+
+
+uint16
+tribe::suspicionTimeout(uint16 minTimeout, uint16 maxTimeout, uint32 confirmations,
+						uint32 expectedConfirmations) noexcept {
+	if (maxTimeout <= minTimeout || expectedConfirmations == 0) {
+		return maxTimeout;
+	}
+
+	if (confirmations >= expectedConfirmations) {
+		return minTimeout;
+	}
+
+	auto const fraction = std::log(confirmations + 1.0f) / std::log(expectedConfirmations + 1.0f);
+	auto const timeout = maxTimeout - (maxTimeout - minTimeout) * fraction;
+
+	return static_cast<uint16>(std::ceil(timeout - 1e-4f));
+}
+
+
+Peer::Liveness
+tribe::decayLiveness(Peer::Liveness value, uint16 dt, float32 decayFactor) noexcept {
+	return decayStep(value, dt, decayFactor, 0);
+}
+
+
+Peer::Liveness
+tribe::catchUpLiveness(Peer::Liveness value, uint16 ticks, float32 tickFactor) noexcept {
+	if (ticks == 0) {
+		return value;
+	}
+
+	return decayStep(value, ticks, std::pow(tickFactor, ticks), catchUpThreshold(ticks, tickFactor));
+}
+
+
+uint16
+tribe::ticksSuspected(Peer::Liveness const& value, uint16 ticks, float32 tickFactor) noexcept {
+	if (ticks <= 1 || !(value.probabitily < Peer::kMaybeNotAlive) || tickFactor <= 0 || tickFactor >= 1) {
+		return 0;
+	}
+
+	// Suspected for m ticks: p[n - m] < threshold <=> p[n] < threshold*f^m, for m < log(p[n]/threshold) / log(f).
+	auto const maxTicks = static_cast<float32>(ticks - 1);
+	auto const estimate = std::ceil(std::log(value.probabitily / Peer::kMaybeNotAlive) / std::log(tickFactor)) - 1;
+	auto suspectedFor = static_cast<uint16>(std::min(std::max(estimate, 0.0f), maxTicks));
+
+	// Correct for rounding errors, so that the peer is suspected no earlier than the decay kernel suspects it
+	auto const isSuspectedFor = [&value, tickFactor](uint16 m) {
+		return (value.probabitily < Peer::kMaybeNotAlive * std::pow(tickFactor, m));
+	};
+	while (suspectedFor > 0 && !isSuspectedFor(suspectedFor)) {
+		suspectedFor -= 1;
+	}
+	while (suspectedFor + 1 < ticks && isSuspectedFor(suspectedFor + 1)) {
+		suspectedFor += 1;
+	}
+
+	return suspectedFor;
+}
+
+
+void
+LivenessStore::clear() noexcept {
+	_blocks.clear();
+	_size = 0;
+}
+
+
+void
+LivenessStore::push_back(Peer::Liveness const& value, NodeID id) {
+	if (_size % kBlockSize == 0) {
+		_blocks.push_back(Block{});
+	}
+
+	_size += 1;
+	assign(_size - 1, value, id);
+}
+
+
+Optional<NodeID>
+LivenessStore::erase(size_type index) {
+	auto const last = _size - 1;
+	auto const moved = id(last);
+	if (index != last) {
+		assign(index, (*this)[last], moved);
+	}
+
+	_size = last;
+	if (_size % kBlockSize == 0) {
+		_blocks.pop_back();
+	}
+
+	return (index != last)
+			? Optional<NodeID>{moved}
+			: Optional<NodeID>{none};
+}
+
+
+void
+LivenessStore::set(size_type index, Peer::Liveness const& value) {
+	assign(index, value, id(index));
+}
+
+
+void
+LivenessStore::assign(size_type index, Peer::Liveness const& value, NodeID id) {
+	_blocks.update(index / kBlockSize, [index, &value, id](Block& block) {
+		auto const i = index % kBlockSize;
+		block.probabilities[i] = value.probabitily;
+		block.ttls[i] = value.ttl;
+		block.states[i] = static_cast<uint8>(value.state);
+		block.ids[i] = id;
+	});
+}
+
+
+void
+LivenessStore::decay(uint16 ttlDelta, float32 decayFactor) {
+	decay(ttlDelta, decayFactor, 0, nullptr);
+}
+
+
+void
+LivenessStore::decay(uint16 ttlDelta, float32 decayFactor, std::vector<Change>& changes) {
+	decay(ttlDelta, decayFactor, 0, &changes);
+}
+
+
+void
+LivenessStore::catchUp(uint16 ticks, float32 tickFactor) {
+	if (ticks == 0) {
+		return;
+	}
+
+	decay(ticks, std::pow(tickFactor, ticks), catchUpThreshold(ticks, tickFactor), nullptr);
+}
+
+
+void
+LivenessStore::catchUp(uint16 ticks, float32 tickFactor, std::vector<Change>& changes) {
+	if (ticks == 0) {
+		return;
+	}
+
+	decay(ticks, std::pow(tickFactor, ticks), catchUpThreshold(ticks, tickFactor), &changes);
+}
+
+
+void
+LivenessStore::decay(uint16 ttlDelta, float32 decayFactor, float32 deadThreshold, std::vector<Change>* changes) {
+	// Blocks shared with copies of the store are copied once, blocks owned by this store are decayed in-place
+	auto const count = size();
+	_blocks.updateEach([=](std::size_t blockIndex, Block& block) {
+		auto const first = static_cast<size_type>(blockIndex) * kBlockSize;
+		decayArrays(block.probabilities, block.ttls, block.states, block.ids, std::min(kBlockSize, count - first),
+					ttlDelta, decayFactor, deadThreshold, changes);
+	});
+}
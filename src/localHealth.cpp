@@ -0,0 +1,89 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/localHealth.hpp"
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+LocalHealth::LocalHealth(MembershipSettings const& settings) noexcept
+	: LocalHealth{settings.maxLocalHealth}
+{}
+
+
+LocalHealth::LocalHealth(Score maxScore) noexcept
+	: _maxScore{maxScore}
+{}
+
+
+void
+LocalHealth::raise() noexcept {
+	if (_score < _maxScore) {
+		_score += 1;
+	}
+}
+
+
+void
+LocalHealth::onProbeSuccess() noexcept {
+	if (_score > 0) {
+		_score -= 1;
+	}
+}
+
+
+void
+LocalHealth::onProbeFailure() noexcept {
+	raise();
+}
+
+
+void
+LocalHealth::onMissedNack() noexcept {
+	raise();
+}
+
+
+void
+LocalHealth::onRefutedSuspicion() noexcept {
+	raise();
+}
+
+
+LocalHealth::Tick
+LocalHealth::advance(Tick elapsed) noexcept {
+	// Note: multiplier may have changed since the last call, lag is converted at the current rate
+	_lag += elapsed;
+	auto const ticks = _lag / multiplier();
+	_lag -= ticks * multiplier();
+
+	return ticks;
+}
+
+
+Optional<DecayPeerInfo>
+LocalHealth::decay(MembershipSettings const& settings, uint16 elapsed) noexcept {
+	auto const ticks = advance(elapsed);
+	if (ticks == 0) {
+		return none;
+	}
+
+	return DecayPeerInfo{static_cast<uint16>(ticks),
+						 settings.peerInfoDecayTimeMs,
+						 settings.peerInfoDecayRate,
+						 settings.peerInfoDecayMode};
+}
@@ -0,0 +1,180 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/membershipSnapshot.hpp"
+#include "tribe/protocol/messageWriter.hpp"
+
+#include <algorithm>  // std::sort
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+namespace /* anonymous */ {
+
+MembershipUpdate::Kind
+updateKind(Peer::State state) noexcept {
+	switch (state) {
+	case Peer::State::Alive:		return MembershipUpdate::Kind::Alive;
+	case Peer::State::Suspected:	return MembershipUpdate::Kind::Suspect;
+	case Peer::State::Dead:			return MembershipUpdate::Kind::Dead;
+	}
+
+	return MembershipUpdate::Kind::Alive;
+}
+
+
+/// Merge a member of a snapshot or an update of gossip about a node other than this one
+void
+mergeMember(PeersModel const& model, MembershipUpdate const& update, std::vector<Action>& actions) {
+	auto const id = update.node.id;
+	auto const isDead = (update.kind == MembershipUpdate::Kind::Dead);
+	auto it = model.members.find(id);
+	if (it == model.members.end()) {
+		if (!isDead) {
+			actions.emplace_back(AddPeer{update.address, update.node, model.params.ttl});
+		}
+		return;
+	}
+
+	auto const& peer = it->second;
+	if (peer.generation > update.node.gen) {  // Update is out of date
+		return;
+	}
+
+	if (isDead) {
+		if (!model.isDead(peer)) {
+			actions.emplace_back(PronouncePeerDead{update.node});
+		}
+	} else if (peer.generation < update.node.gen) {
+		actions.emplace_back(UpdatePeerGeneration{id, update.node.gen, model.params.ttl});
+		if (peer.address != update.address) {
+			actions.emplace_back(UpdatePeerAddress{update.node, update.address});
+		}
+	}
+}
+
+}  // anonymous namespace
+
+
+MembershipSnapshot::MembershipSnapshot(PeersModel const& model) {
+	_members.reserve(model.members.size());
+	for (auto const& entry : model.members) {
+		auto const& peer = entry.second;
+		auto const suspicion = model.suspicions.find(entry.first);
+		_members.push_back(MembershipUpdate{updateKind(model.liveness(peer).state),
+											NodeInfo{entry.first, peer.generation},
+											peer.address,
+											(suspicion != model.suspicions.end())
+												? suspicion->second.suspecters[0]
+												: model.node.id});
+	}
+
+	std::sort(_members.begin(), _members.end(), [](MembershipUpdate const& lhs, MembershipUpdate const& rhs) {
+		return lhs.node.id.value < rhs.node.id.value;
+	});
+
+	// Whole snapshot is a single chunk until split
+	_chunkEnds.push_back(size());
+}
+
+
+MembershipSnapshot::size_type
+MembershipSnapshot::split(Gossip::size_type datagramSize) {
+	_chunkEnds.clear();
+
+	// Note: an empty snapshot is still sent as a single chunk, so that a peer gets a reply to a push
+	auto const overhead = encodedSize(SyncMessage{});
+	auto const budget = (datagramSize > overhead)
+			? static_cast<Gossip::size_type>(datagramSize - overhead)
+			: Gossip::size_type{0};
+
+	size_type chunkStart = 0;
+	do {
+		auto const rest = ArrayView<MembershipUpdate const>{_members.data() + chunkStart, size() - chunkStart};
+		auto const count = MessageWriter::piggybackCapacity(rest, budget, UpdateEncoding::Compact);
+		if (count == 0 && !rest.empty()) {  // Datagram is too small to carry a single member
+			_chunkEnds.clear();
+			break;
+		}
+
+		chunkStart += count;
+		_chunkEnds.push_back(chunkStart);
+	} while (chunkStart < size());
+
+	return chunkCount();
+}
+
+
+ArrayView<MembershipUpdate const>
+MembershipSnapshot::chunk(size_type index) const noexcept {
+	auto const start = (index == 0) ? 0 : _chunkEnds[index - 1];
+
+	return {_members.data() + start, _chunkEnds[index] - start};
+}
+
+
+uint32
+tribe::mergeSnapshot(PeersModel const& model, ArrayView<MembershipUpdate const> members,
+					 std::vector<Action>& actions) {
+	auto const actionsBefore = actions.size();
+	for (auto const& update : members) {
+		if (update.node.id != model.node.id) {
+			mergeMember(model, update, actions);
+		}
+	}
+
+	return static_cast<uint32>(actions.size() - actionsBefore);
+}
+
+
+uint32
+tribe::mergeGossip(PeersModel const& model, ArrayView<MembershipUpdate const> updates,
+				   std::vector<Action>& actions, LocalHealth& health) {
+	auto const actionsBefore = actions.size();
+	for (auto const& update : updates) {
+		auto const isSuspect = (update.kind == MembershipUpdate::Kind::Suspect);
+		if (update.node.id == model.node.id) {
+			// Note: suspicions of earlier generations have been refuted already
+			if (isSuspect && update.node.gen >= model.node.gen) {
+				health.onRefutedSuspicion();
+				actions.emplace_back(SuspectPeer{update.node, update.suspecter});
+			}
+			continue;
+		}
+
+		mergeMember(model, update, actions);
+		if (isSuspect) {
+			actions.emplace_back(SuspectPeer{update.node, update.suspecter});
+		}
+	}
+
+	return static_cast<uint32>(actions.size() - actionsBefore);
+}
+
+
+Optional<NodeID>
+AntiEntropy::poll(PeersModel const& model, uint64 random) {
+	if (_interval == 0 || model.now < _nextSync || model.healthy.empty()) {
+		return none;
+	}
+
+	_nextSync = model.now + _interval;
+
+	// Map 32 bit random values uniformly onto [0, size) with a multiply and shift
+	auto const pick = (uint64{static_cast<uint32>(random)} * model.healthy.size()) >> 32;
+	return model.healthy[static_cast<PeerIdSet::size_type>(pick)];
+}
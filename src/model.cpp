@@ -14,8 +14,12 @@
 *  limitations under the License.
 */
 #include "tribe/model.hpp"
+#include "tribe/livenessStore.hpp"
 
-#include <functional>  // std::remove_if
+#include <algorithm>  // std::remove_if
+#include <cmath>
+#include <limits>
+#include <vector>
 
 
 using namespace Solace;
@@ -39,42 +43,157 @@ eraseIf(C& container, F&& pre) {
 				container.end());
 }
 
-auto
-expDecay(decltype(Peer::Liveness::probabitily) value, float32 k, float32 dt) noexcept {
-	// Exponential decay of aliveness certainty: dP / dt = -kP
-	// (p1 - p0) / dt = -kp0
-	// p1 = p0 - kp0*dt = p0*(1 - kdt)
-	return value * (1.0f - k*dt);
+
+/// Decay factor of a single tick of a lazily decayed model
+float32
+lazyTickFactor(MembershipSettings const& params) noexcept {
+	return decayFactor(params.peerInfoDecayRate, 1, params.peerInfoDecayTimeMs, DecayMode::Exponential);
+}
+
+
+/**
+ * Lower bound of the number of ticks before a peer changes state or expires.
+ * @return none if the peer stays alive forever at the given decay rate.
+ */
+Optional<PeersModel::Tick>
+ticksToTransition(Peer::Liveness const& value, float32 tickFactor) noexcept {
+	using Tick = PeersModel::Tick;
+
+	// Suspected peers are dead and dead peers expire once their TTL runs out
+	if (value.state != Peer::State::Alive) {
+		return std::max<Tick>(value.ttl, 1);
+	}
+
+	if (value.probabitily * tickFactor < Peer::kMaybeNotAlive) {
+		return Tick{1};
+	}
+
+	// Alive peers are no longer healthy once TTL runs out
+	auto const healthyFor = (value.ttl > 0)
+			? Optional<Tick>{value.ttl}
+			: Optional<Tick>{none};
+
+	if (tickFactor >= 1) {  // Never gets suspected
+		return healthyFor;
+	}
+
+	// p*f^s < threshold => s > log(threshold/p) / log(f). Err on the early side: the deadline is re-evaluated.
+	auto const suspectedAt = std::log(Peer::kMaybeNotAlive / value.probabitily) / std::log(tickFactor);
+	auto const lowerBound = std::min(std::floor(suspectedAt) - 1, static_cast<float32>(1 << 30));
+	auto const suspectedTick = static_cast<Tick>(std::max(lowerBound, 1.0f));
+
+	return healthyFor
+			? std::min(*healthyFor, suspectedTick)
+			: suspectedTick;
 }
 
 
-auto
-decayLiveness(Peer::Liveness value, uint16 dt, float32 decayRate, uint32 decayTimeMs) noexcept {
-	// Exponential decay of aliveness certainty: dP / dt = -kP
-	value.probabitily = expDecay(value.probabitily, decayRate, dt*(decayTimeMs / 1000.f));
+bool
+laterDeadline(PeersModel::LivenessEvent const& lhs, PeersModel::LivenessEvent const& rhs) noexcept {
+	return (lhs.deadline > rhs.deadline);
+}
+
 
-	// Decrement TTL of the nodes
-	value.ttl = (value.ttl > dt)
-			? (value.ttl - dt)
-			: 0;
+/// Add an entry into the transitions queue: sift it up the min-heap
+void
+pushEvent(PeersModel::LivenessEvents& queue, PeersModel::LivenessEvent const& event) {
+	auto i = queue.size();
+	queue.push_back(event);
+	while (i > 0) {
+		auto const parent = (i - 1) / 2;
+		if (!laterDeadline(queue[parent], event)) {
+			break;
+		}
 
+		queue.set(i, queue[parent]);
+		i = parent;
+	}
+
+	queue.set(i, event);
+}
 
-	// Update state
-	switch (value.state) {
-	case Peer::State::Alive: {
-		if (value.probabitily < Peer::kMaybeNotAlive) {
-			value.state = Peer::State::Suspected;
+
+/// Remove the entry with the earliest deadline from the transitions queue: sift the last entry down the min-heap
+PeersModel::LivenessEvent
+popEvent(PeersModel::LivenessEvents& queue) {
+	auto const top = queue[0];
+	auto const last = queue.back();
+	queue.pop_back();
+
+	auto const size = queue.size();
+	if (size == 0) {
+		return top;
+	}
+
+	PeersModel::LivenessEvents::size_type i = 0;
+	for (auto child = 2*i + 1; child < size; child = 2*i + 1) {
+		if (child + 1 < size && laterDeadline(queue[child], queue[child + 1])) {
+			child += 1;
 		}
-	} break;
-	case Peer::State::Suspected: {
-		if (value.ttl == 0) {  // Expired suspected state transition to be considered 'dead'
-			value.state = Peer::State::Dead;
+
+		if (!laterDeadline(last, queue[child])) {
+			break;
 		}
-	} break;
-	case Peer::State::Dead: break;  // Nothing to go from here
+
+		queue.set(i, queue[child]);
+		i = child;
 	}
 
-	return value;
+	queue.set(i, last);
+	return top;
+}
+
+
+/// Add lazily decayed peer into the transitions queue
+void
+scheduleTransition(PeersModel& state, NodeID id, Peer const& peer) {
+	if (!state.params.lazyDecay) {
+		return;
+	}
+
+	auto const ticks = ticksToTransition(state.estimates[peer.slot], lazyTickFactor(state.params));
+	if (!ticks) {
+		return;
+	}
+
+	pushEvent(state.livenessEvents, {peer.heardAt + *ticks, peer.heardAt, id});
+}
+
+
+/// Schedule next transition of a peer after its liveness estimate has been updated
+void
+scheduleTransition(PeersModel& state, NodeID id) {
+	auto it = state.members.find(id);
+	if (it != state.members.end()) {
+		scheduleTransition(state, id, it->second);
+	}
+}
+
+
+/**
+ * Rewind liveness of a peer, alive before a decay by a number of ticks at once and not after it,
+ * to the tick the peer has become suspected at: the state and TTL as of that tick.
+ * Note: TTL that has run out before that tick is taken to have run out at it: the suspicion timeout decides.
+ * @return Number of ticks passed since the peer has become suspected.
+ */
+uint16
+rewindToSuspicion(Peer::Liveness& liveness, uint16 ticks, float32 tickFactor) noexcept {
+	auto const suspectedFor = ticksSuspected(liveness, ticks, tickFactor);
+	liveness.state = Peer::State::Suspected;
+	liveness.ttl = static_cast<uint16>(std::min<uint32>(uint32{liveness.ttl} + suspectedFor,
+														std::numeric_limits<uint16>::max()));
+
+	return suspectedFor;
+}
+
+
+/// Run suspicion of a peer, that has started with the liveness given, for the number of ticks passed since
+void
+elapseSuspicion(Peer::Liveness& liveness, uint16 suspectedFor) noexcept {
+	// Note: a suspected peer is dead no earlier than a tick after it has been suspected
+	if (suspectedFor > 0) {
+		liveness = decayLiveness(liveness, suspectedFor, 1);
+	}
 }
 
 }  // anonymous namespace
@@ -82,98 +201,261 @@ decayLiveness(Peer::Liveness value, uint16 dt, float32 decayRate, uint32 decayTi
 
 namespace /* anonymous */ {
 
-PeersModel
-addSeed(PeersModel state, AddSeed&& seedAction) {
+void
+addSeed(PeersModel& state, AddSeed&& seedAction) {
 	state.seeds.try_emplace(std::move(seedAction.address), SeedPeer{seedAction.ttl});
-
-	return state;
 }
 
-PeersModel
-dropSeed(PeersModel state, Address const& address) {
+void
+dropSeed(PeersModel& state, Address const& address) {
 	state.seeds.erase(address);
-
-	return state;
 }
 
 
-PeersModel
-addPeer(PeersModel state, AddPeer&& peerAction) {
+void
+addPeer(PeersModel& state, AddPeer&& peerAction) {
 	if (state.node.id == peerAction.nodeInfo.id) {  // Don't add `self` into the routing table
-		return state;
+		return;
 	}
 
-	state.members.try_emplace(peerAction.nodeInfo.id,
-							  peerAction.nodeInfo.gen,
-							  std::move(peerAction.address),
-							  peerAction.ttl,
-							  Peer::kCertainlyAlive);
+	auto peer = Peer{peerAction.nodeInfo.gen, std::move(peerAction.address), state.estimates.size()};
+	peer.heardAt = state.now;
 
-	return state;
+	if (state.members.try_emplace(peerAction.nodeInfo.id, peer)) {
+		auto const liveness = Peer::Liveness{peerAction.ttl, Peer::kCertainlyAlive, Peer::State::Alive};
+		state.estimates.push_back(liveness, peerAction.nodeInfo.id);
+		state.reindex(peerAction.nodeInfo.id, liveness);
+		scheduleTransition(state, peerAction.nodeInfo.id, peer);
+	}
 }
 
 
-PeersModel
-dropPeer(PeersModel state, NodeID peerId) {
-	state.members.erase(peerId);
-
-	return state;
+void
+dropPeer(PeersModel& state, NodeID peerId) {
+	state.erasePeer(peerId);
 }
 
 
-PeersModel
-pronouncePeerDead(PeersModel state, PronouncePeerDead const& action) {
+void
+pronouncePeerDead(PeersModel& state, PronouncePeerDead const& action) {
 	auto it = state.members.find(action.nodeInfo.id);
-	if (it != state.members.end()) {
-		auto& peer = it->second;
-		if (peer.generation <= action.nodeInfo.gen) {
-			peer.liveness.state = Peer::State::Dead;
+	if (it != state.members.end() && it->second.generation <= action.nodeInfo.gen) {
+		auto liveness = state.liveness(it->second);
+		liveness.state = Peer::State::Dead;
+		state.setLiveness(it->second, liveness);
+		state.members.update(action.nodeInfo.id, [&state](Peer& peer) {
+			peer.heardAt = state.now;
+		});
+
+		state.reindex(action.nodeInfo.id, liveness);
+
+		scheduleTransition(state, action.nodeInfo.id);
+	}
+}
+
+
+/// Count an independent confirmation of the suspicion of a peer and shrink its suspicion timeout accordingly
+void
+confirmSuspicion(PeersModel& state, NodeID id, Peer::Liveness& liveness, NodeID suspecter) {
+	auto it = state.suspicions.find(id);
+	if (it == state.suspicions.end()) {
+		return;
+	}
+
+	auto suspicion = it->second;
+	for (uint32 i = 0; i < suspicion.count; ++i) {
+		if (suspicion.suspecters[i] == suspecter) {  // Not an independent confirmation
+			return;
 		}
 	}
 
-	return state;
+	if (suspicion.count == PeersModel::Suspicion::kMaxSuspecters) {
+		return;
+	}
+
+	suspicion.suspecters[suspicion.count++] = suspecter;
+	state.suspicions.insert_or_assign(id, suspicion);
+
+	auto const timeout = suspicionTimeout(state.params.suspicionMinTimeout, suspicion.timeout,
+										  suspicion.confirmations(), state.params.suspicionConfirmations);
+	auto const elapsed = state.now - suspicion.since;
+	auto const remaining = (timeout > elapsed)
+			? static_cast<uint16>(timeout - elapsed)
+			: uint16{0};
+
+	// Note: confirmations only ever shrink the timeout
+	liveness.ttl = std::min(liveness.ttl, remaining);
 }
 
 
-PeersModel
-updatePeerInfo(PeersModel state, UpdatePeerGeneration&& action) {
+void
+suspectPeer(PeersModel& state, SuspectPeer const& action) {
+	auto const id = action.nodeInfo.id;
+	if (id == state.node.id) {  // Refute suspicion of this node by moving on to a newer generation
+		if (state.node.gen <= action.nodeInfo.gen) {
+			state.node.gen = action.nodeInfo.gen + 1;
+		}
+		return;
+	}
+
+	auto it = state.members.find(id);
+	if (it == state.members.end() || it->second.generation > action.nodeInfo.gen) {
+		return;  // Unknown peer, or suspicion of an earlier generation of the peer, that the peer has refuted
+	}
+
+	auto liveness = state.liveness(it->second);
+	if (PeersModel::isDead(liveness)) {
+		return;
+	}
+
+	if (PeersModel::isAlive(liveness) || state.suspicions.find(id) == state.suspicions.end()) {
+		liveness.state = Peer::State::Suspected;
+		state.startSuspicion(id, liveness, action.from, state.now);
+	} else {
+		confirmSuspicion(state, id, liveness, action.from);
+	}
+
+	state.setLiveness(it->second, liveness);
+	state.members.update(id, [&state](Peer& peer) {
+		peer.heardAt = state.now;
+	});
+
+	state.reindex(id, liveness);
+	scheduleTransition(state, id);
+}
+
+
+void
+updatePeerInfo(PeersModel& state, UpdatePeerGeneration&& action) {
 	auto it = state.members.find(action.peerId);
-	if (it != state.members.end()) {
-		auto& peer = it->second;
-		if (peer.generation <= action.gen) {  // Update info iff newer generation
+	if (it != state.members.end() && it->second.generation <= action.gen) {  // Update info iff newer generation
+		auto const refutes = (it->second.generation < action.gen);
+		auto liveness = state.liveness(it->second);
+		liveness.ttl = action.ttl;
+		liveness.probabitily = Peer::kCertainlyAlive;
+
+		// Newer generation of a suspected peer refutes the suspicion. Note: reindex drops the suspicion record.
+		if (refutes && PeersModel::isSuspected(liveness)) {
+			liveness.state = Peer::State::Alive;
+		}
+
+		state.setLiveness(it->second, liveness);
+		state.members.update(action.peerId, [&state, &action](Peer& peer) {
 			peer.generation = action.gen;
+			peer.heardAt = state.now;
+		});
 
-			peer.liveness.ttl = action.ttl;
-			peer.liveness.probabitily = Peer::kCertainlyAlive;
-		}
+		state.reindex(action.peerId, liveness);
+		scheduleTransition(state, action.peerId);
 	}
-
-	return state;
 }
 
-PeersModel
-updatePeerAddress(PeersModel state, UpdatePeerAddress&& action) {
+void
+updatePeerAddress(PeersModel& state, UpdatePeerAddress&& action) {
 	auto it = state.members.find(action.nodeInfo.id);
-	if (it != state.members.end()) {
-		auto& peer = it->second;
-		if (peer.generation <= action.nodeInfo.gen) {
+	if (it != state.members.end() && it->second.generation <= action.nodeInfo.gen) {
+		state.members.update(action.nodeInfo.id, [&action](Peer& peer) {
 			peer.generation = action.nodeInfo.gen;
 			peer.address = action.newAddress;
+		});
+	}
+}
+
+
+/// Apply state transitions due by now to lazily decayed peers and remove peers that have expired
+void
+applyTransitions(PeersModel& state) {
+	auto& queue = state.livenessEvents;
+	while (!queue.empty() && queue[0].deadline <= state.now) {
+		auto const entry = popEvent(queue);
+
+		auto it = state.members.find(entry.id);
+		if (it == state.members.end() || it->second.heardAt != entry.heardAt) {
+			continue;  // Stale entry: the peer is gone or has been heard from since
+		}
+
+		// Bring the peer up to date and schedule the next transition.
+		// Note: the deadline is an early estimate, so the state may not have changed yet.
+		auto const before = state.estimates[it->second.slot];
+		auto const ticks = static_cast<uint16>(std::min<PeersModel::Tick>(state.now - it->second.heardAt,
+																		   std::numeric_limits<uint16>::max()));
+		auto liveness = catchUpLiveness(before, ticks, lazyTickFactor(state.params));
+		if (PeersModel::isAlive(before) && !PeersModel::isAlive(liveness)) {
+			// Suspicion starts at the tick the peer has become suspected at, which may be a few ticks back
+			auto const suspectedFor = rewindToSuspicion(liveness, ticks, lazyTickFactor(state.params));
+			state.startSuspicion(entry.id, liveness, state.node.id, state.now - suspectedFor);
+			elapseSuspicion(liveness, suspectedFor);
+		}
+
+		if (PeersModel::isExpired(liveness)) {
+			state.erasePeer(entry.id);
+			continue;
 		}
+
+		state.setLiveness(it->second, liveness);
+		state.members.update(entry.id, [&state](Peer& peer) {
+			peer.heardAt = state.now;
+		});
+
+		state.reindex(entry.id, liveness);
+		scheduleTransition(state, entry.id);
+	}
+}
+
+
+void
+decayPeers(PeersModel& state, DecayPeerInfo decayParams) {
+	// Dacaying info producess side-effects - peers change states.
+	// Decay liveness of all the peers in one go, in-place, noting the peers that change state, health or expire.
+	// Note: linear decay by any ttlDelta is a single step
+	std::vector<LivenessStore::Change> changes;
+	uint16 ticks = 1;
+	float32 tickFactor = 1;
+	switch (decayParams.mode) {
+	case DecayMode::Exponential:
+		ticks = decayParams.ttlDelta;
+		tickFactor = decayFactor(decayParams.decayRate, 1, decayParams.decayTimeMs, DecayMode::Exponential);
+		state.estimates.catchUp(ticks, tickFactor, changes);
+		break;
+	case DecayMode::Linear:
+		state.estimates.decay(decayParams.ttlDelta,
+							  decayFactor(decayParams.decayRate, decayParams.ttlDelta, decayParams.decayTimeMs),
+							  changes);
+		break;
 	}
 
-	return state;
+	// Note: changes are identified by peer ids, as removing expired peers moves estimates of other peers
+	for (auto const& change : changes) {
+		auto const slot = state.members.find(change.id)->second.slot;
+		auto liveness = state.estimates[slot];
+
+		// Catching up can take an alive peer past its suspicion, straight to dead: start the suspicion
+		// at the tick the peer has become suspected at, as decaying tick by tick does
+		if (change.previous == Peer::State::Alive && !PeersModel::isAlive(liveness)) {
+			auto const suspectedFor = rewindToSuspicion(liveness, ticks, tickFactor);
+			state.startSuspicion(change.id, liveness, state.node.id, state.now - suspectedFor);
+			elapseSuspicion(liveness, suspectedFor);
+			state.estimates.set(slot, liveness);
+		}
+
+		// Remove expired peers
+		if (PeersModel::isExpired(liveness)) {
+			state.erasePeer(change.id);
+			continue;
+		}
+
+		state.reindex(change.id, liveness);
+	}
 }
 
 
-PeersModel
-decayPeerInfo(PeersModel state, DecayPeerInfo decayParams) {
-	// Dacaying info producess side-effects - peers change states
-	for (auto& peer : state.members) {
-		peer.second.liveness = decayLiveness(peer.second.liveness,
-											 decayParams.ttlDelta,
-											 decayParams.decayRate,
-											 decayParams.decayTimeMs);
+void
+decayPeerInfo(PeersModel& state, DecayPeerInfo decayParams) {
+	state.now += decayParams.ttlDelta;
+	if (state.params.lazyDecay) {
+		applyTransitions(state);
+	} else {
+		decayPeers(state, decayParams);
 	}
 
 	// Dacaying seeds ttl
@@ -183,15 +465,6 @@ decayPeerInfo(PeersModel state, DecayPeerInfo decayParams) {
 				: 0;
 	}
 
-	// Remove expired peers
-	for (auto it = state.members.begin(); it != state.members.end(); ) {
-		if (PeersModel::isExpired(it->second)) {
-			it = state.members.erase(it);
-		} else {
-			++it;
-		}
-	}
-
 	// Remove expired seeds
 	for (auto it = state.seeds.begin(); it != state.seeds.end(); ) {
 		if (it->second.ttl == 0) {
@@ -200,46 +473,205 @@ decayPeerInfo(PeersModel state, DecayPeerInfo decayParams) {
 			++it;
 		}
 	}
-
-	return state;
 }
 
 }  // anonymous namespace
 
 
 
+Peer::Liveness
+PeersModel::liveness(Peer const& p) const noexcept {
+	auto const value = estimates[p.slot];
+	if (!params.lazyDecay || p.heardAt >= now) {
+		return value;
+	}
+
+	// Note: TTL is 16 bit so it runs out before the number of ticks is clamped
+	auto const ticks = static_cast<uint16>(std::min<Tick>(now - p.heardAt, std::numeric_limits<uint16>::max()));
+	auto result = catchUpLiveness(value, ticks, lazyTickFactor(params));
+	if (isAlive(value) && !isAlive(result)) {  // Suspected on the way: the suspicion timeout applies from then on
+		auto const suspectedFor = rewindToSuspicion(result, ticks, lazyTickFactor(params));
+		result.ttl = std::max(result.ttl, params.suspicionMaxTimeout);
+		elapseSuspicion(result, suspectedFor);
+	}
+
+	return result;
+}
+
+
+Optional<Peer::Liveness>
+PeersModel::liveness(NodeID id) const {
+	auto it = members.find(id);
+	if (it == members.end()) {
+		return none;
+	}
+
+	return liveness(it->second);
+}
+
+
+void
+PeersModel::reindex(NodeID id, Peer::Liveness const& value) {
+	// Note: entries keep the tick a peer entered the state
+	if (isSuspected(value)) {
+		suspected.try_emplace(id, now);
+	} else {
+		suspected.erase(id);
+		suspicions.erase(id);
+	}
+
+	if (isDead(value)) {
+		dead.try_emplace(id, now);
+	} else {
+		dead.erase(id);
+	}
+
+	if (isHealthy(value)) {
+		healthy.insert(id);
+	} else {
+		healthy.erase(id);
+	}
+}
+
+
+void
+PeersModel::startSuspicion(NodeID id, Peer::Liveness& liveness, NodeID suspecter, Tick since) {
+	liveness.ttl = std::max(liveness.ttl, params.suspicionMaxTimeout);
+
+	Suspicion suspicion;
+	suspicion.since = since;
+	suspicion.timeout = liveness.ttl;
+	suspicion.suspecters[0] = suspecter;
+	suspicion.count = 1;
+	suspicions.insert_or_assign(id, suspicion);
+}
+
+
+void
+PeersModel::erasePeer(NodeID id) {
+	auto it = members.find(id);
+	if (it == members.end()) {
+		return;
+	}
+
+	// Keep estimates dense: the last estimate takes the slot of the removed one
+	auto const slot = it->second.slot;
+	members.erase(id);
+	auto const moved = estimates.erase(slot);
+	if (moved) {
+		members.update(*moved, [slot](Peer& peer) {
+			peer.slot = slot;
+		});
+	}
+
+	suspected.erase(id);
+	dead.erase(id);
+	healthy.erase(id);
+	suspicions.erase(id);
+}
+
+
 Optional<Address>
 PeersModel::findRedirectAddress() const {
-	for (auto const& peer : members) {
-		if (isHealthy(peer.second)) {
-			return peer.second.address;
-		}
+	if (healthy.empty()) {
+		return none;
 	}
 
-	return none;
+	return members.find(healthy[0])->second.address;
 }
 
 
-PeersModel
-tribe::update(PeersModel const& state, Action&& action) {
+Optional<Address>
+PeersModel::findRedirectAddress(uint64 random, bool preferSpareCapacity) const {
+	if (healthy.empty()) {
+		return none;
+	}
+
+	// Map 32 bit random values uniformly onto [0, size) with a multiply and shift
+	auto const pick = [this](uint32 value) {
+		return healthy[static_cast<PeerIdSet::size_type>((uint64{value} * healthy.size()) >> 32)];
+	};
+
+	auto const& first = members.find(pick(static_cast<uint32>(random)))->second;
+	if (!preferSpareCapacity) {
+		return first.address;
+	}
+
+	// Power of two choices: prefer the peer with more spare capacity
+	auto const& second = members.find(pick(static_cast<uint32>(random >> 32)))->second;
+	auto const spareCapacity = [](Peer const& peer) {
+		return static_cast<int64>(peer.capacity) - static_cast<int64>(peer.peerCount);
+	};
+
+	return (spareCapacity(second) > spareCapacity(first))
+			? second.address
+			: first.address;
+}
+
+
+namespace /* anonymous */ {
+
+void
+applyAction(PeersModel& state, Action&& action) {
 
 	struct ActionHandler {
-		PeersModel const& state;
+		PeersModel& state;
 
-		PeersModel operator() (AddSeed&& request) const { return addSeed(state, std::move(request)); }
-		PeersModel operator() (ForgetSeed&& action) const { return dropSeed(state, std::move(action.address)); }
+		void operator() (AddSeed&& request) const { addSeed(state, std::move(request)); }
+		void operator() (ForgetSeed&& action) const { dropSeed(state, std::move(action.address)); }
 
-		PeersModel operator() (AddPeer&& request) const { return addPeer(state, std::move(request)); }
-		PeersModel operator() (ForgetPeer&& action) const { return dropPeer(state, action.peerId); }
+		void operator() (AddPeer&& request) const { addPeer(state, std::move(request)); }
+		void operator() (ForgetPeer&& action) const { dropPeer(state, action.peerId); }
 
-		PeersModel operator() (UpdatePeerGeneration&& action) const { return updatePeerInfo(state, std::move(action)); }
-		PeersModel operator() (UpdatePeerAddress&& action) const { return updatePeerAddress(state, std::move(action)); }
+		void operator() (UpdatePeerGeneration&& action) const { updatePeerInfo(state, std::move(action)); }
+		void operator() (UpdatePeerAddress&& action) const { updatePeerAddress(state, std::move(action)); }
 
 
-		PeersModel operator() (DecayPeerInfo&& action) const { return decayPeerInfo(state, action); }
-		PeersModel operator() (PronouncePeerDead&& action) const { return pronouncePeerDead(state, action); }
+		void operator() (DecayPeerInfo&& action) const { decayPeerInfo(state, action); }
+		void operator() (PronouncePeerDead&& action) const { pronouncePeerDead(state, action); }
+		void operator() (SuspectPeer&& action) const { suspectPeer(state, action); }
 	};
 
-	return std::visit(ActionHandler{state}, std::move(action));
+	std::visit(ActionHandler{state}, std::move(action));
+}
+
+}  // anonymous namespace
+
+
+PeersModel
+tribe::update(PeersModel const& state, Action&& action) {
+	auto result = state;
+	applyAction(result, std::move(action));
+
+	return result;
+}
+
+
+PeersModel
+tribe::update(PeersModel const& state, ArrayView<Action> actions) {
+	// Note: one copy of the model for the whole batch
+	auto result = state;
+	for (auto& action : actions) {
+		applyAction(result, std::move(action));
+	}
+
+	return result;
+}
+
+
+PeersModel
+tribe::update(PeersModel&& state, Action&& action) {
+	applyAction(state, std::move(action));
+
+	return std::move(state);
+}
+
+
+PeersModel
+tribe::update(PeersModel&& state, ArrayView<Action> actions) {
+	for (auto& action : actions) {
+		applyAction(state, std::move(action));
+	}
 
+	return std::move(state);
 }
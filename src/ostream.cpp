@@ -72,8 +72,14 @@ std::ostream& operator<< (std::ostream& ostr, NodeInfo const& node) {
 std::ostream& operator<< (std::ostream& ostr, Peer const& peer) {
 	return ostr << "{ generation: " << peer.generation
 				<< ", " << "address: " << peer.address
-				<< ", " << "ttl: " << peer.liveness.ttl
-				<< ", " << "alive: " << std::fixed << std::setprecision(2) << peer.liveness.probabitily
+				<< ", " << "slot: " << peer.slot
+				<< "}";
+}
+
+std::ostream& operator<< (std::ostream& ostr, Peer::Liveness const& liveness) {
+	return ostr << "{ ttl: " << liveness.ttl
+				<< ", " << "alive: " << std::fixed << std::setprecision(2) << liveness.probabitily
+				<< ", " << "state: " << static_cast<int>(liveness.state)
 				<< "}";
 }
 
@@ -0,0 +1,242 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/phiAccrual.hpp"
+
+#include <algorithm>  // std::min, std::max
+#include <cmath>      // std::exp, std::log1p, std::sqrt
+#include <limits>
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+namespace /* anonymous */ {
+
+constexpr float32 kLn10 = 2.302585093f;
+
+/// Lowest suspicion threshold accepted, so that the probability of alive peers is interpolated over a non-empty range
+constexpr float32 kMinSuspectThreshold = 1e-3f;
+
+
+/// Linear interpolation between `from` and `to` by `t` in [0, 1]
+float32
+lerp(float32 from, float32 to, float32 t) noexcept {
+	return from + (to - from) * std::min(std::max(t, 0.0f), 1.0f);
+}
+
+
+/**
+ * Apply the suspicion of a suspected peer to its liveness as estimated by phi:
+ * the suspicion stands until the peer is heard from, and the peer is dead once the suspicion times out,
+ * the timeout being shrunk by confirmations of the suspicion.
+ */
+Peer::Liveness
+applySuspicion(PeersModel const& model, PeersModel::Suspicion const& suspicion, Peer::Liveness value,
+			   PeersModel::Tick lastHeartbeat) noexcept {
+	if (PeersModel::isAlive(value) && lastHeartbeat < suspicion.since) {  // Not heard from since the suspicion
+		value.state = Peer::State::Suspected;
+		value.probabitily = std::min(value.probabitily, Peer::kMaybeNotAlive);
+	}
+
+	if (!PeersModel::isSuspected(value)) {
+		return value;
+	}
+
+	auto const timeout = suspicionTimeout(model.params.suspicionMinTimeout, suspicion.timeout,
+										  suspicion.confirmations(), model.params.suspicionConfirmations);
+	if (model.now - suspicion.since >= timeout) {
+		value.state = Peer::State::Dead;
+		value.probabitily = Peer::kCertainlyNotAlive;
+	}
+
+	return value;
+}
+
+}  // anonymous namespace
+
+
+PhiAccrualEstimator::PhiAccrualEstimator(Tick now, Tick firstInterval) noexcept
+	: _intervals{}
+	, _last{now}
+{
+	push(static_cast<uint16>(std::min<Tick>(firstInterval, std::numeric_limits<uint16>::max())));
+}
+
+
+void
+PhiAccrualEstimator::push(uint16 interval) noexcept {
+	if (_count == kWindowSize) {  // Window is full: the oldest interval is replaced
+		auto const oldest = _intervals[_head];
+		_sum -= oldest;
+		_sumSquares -= uint64{oldest} * oldest;
+	} else {
+		_count += 1;
+	}
+
+	_intervals[_head] = interval;
+	_sum += interval;
+	_sumSquares += uint64{interval} * interval;
+	_head = static_cast<uint8>((_head + 1) % kWindowSize);
+}
+
+
+void
+PhiAccrualEstimator::heartbeat(Tick now) noexcept {
+	if (now < _last) {  // Out of order heartbeat
+		return;
+	}
+
+	auto const interval = std::min<Tick>(now - _last, std::numeric_limits<uint16>::max());
+	_last = now;
+	push(static_cast<uint16>(interval));
+}
+
+
+float32
+PhiAccrualEstimator::mean() const noexcept {
+	return static_cast<float32>(_sum) / _count;
+}
+
+
+float32
+PhiAccrualEstimator::variance() const noexcept {
+	// Note: sums are exact integers, so the only rounding is that of the final result
+	auto const n = static_cast<float64>(_count);
+	auto const mean = _sum / n;
+
+	return static_cast<float32>(std::max(_sumSquares / n - mean * mean, 0.0));
+}
+
+
+float32
+PhiAccrualEstimator::phi(Tick now, float32 minStdDev) const noexcept {
+	auto const elapsed = static_cast<float32>((now > _last) ? now - _last : 0);
+	auto const stdDev = std::max(std::sqrt(variance()), minStdDev);
+	if (stdDev <= 0) {
+		return (elapsed > mean()) ? std::numeric_limits<float32>::infinity() : 0.0f;
+	}
+
+	// Logistic approximation of the normal CDF: P(interval > elapsed) ~ 1 / (1 + exp(a)),
+	// where a = y*(1.5976 + 0.070566*y^2) and y = (elapsed - mean) / stdDev
+	// phi = -log10(1 / (1 + exp(a))) = log10(1 + exp(a)), evaluated so that exp never overflows.
+	auto const y = (elapsed - mean()) / stdDev;
+	auto const a = y * (1.5976f + 0.070566f * y * y);
+
+	return (a > 0)
+			? (a + std::log1p(std::exp(-a))) / kLn10
+			: std::log1p(std::exp(a)) / kLn10;
+}
+
+
+PhiAccrualDetector::PhiAccrualDetector(MembershipSettings const& settings) noexcept
+	: PhiAccrualDetector{settings.phiSuspectThreshold, settings.phiDeadThreshold, settings.ttl, settings.phiMinStdDev}
+{}
+
+
+PhiAccrualDetector::PhiAccrualDetector(float32 suspectThreshold, float32 deadThreshold, Tick firstInterval,
+									   float32 minStdDev) noexcept
+	// Note: the bound goes first so that NaN thresholds are clamped too
+	: _suspectThreshold{std::max(kMinSuspectThreshold, suspectThreshold)}
+	, _deadThreshold{std::max(_suspectThreshold, deadThreshold)}
+	, _firstInterval{firstInterval}
+	, _minStdDev{minStdDev}
+{}
+
+
+void
+PhiAccrualDetector::heartbeat(NodeID id, Tick now) {
+	auto result = _estimators.try_emplace(id, now, _firstInterval);
+	if (!result.second) {
+		result.first->second.heartbeat(now);
+	}
+}
+
+
+void
+PhiAccrualDetector::forget(NodeID id) {
+	_estimators.erase(id);
+}
+
+
+Optional<float32>
+PhiAccrualDetector::phi(NodeID id, Tick now) const {
+	auto it = _estimators.find(id);
+	if (it == _estimators.end()) {
+		return none;
+	}
+
+	return it->second.phi(now, _minStdDev);
+}
+
+
+Peer::Liveness
+PhiAccrualDetector::liveness(Peer::Liveness value, float32 phi) const noexcept {
+	if (value.state == Peer::State::Dead) {  // Nothing to go from here
+		return value;
+	}
+
+	if (phi < _suspectThreshold) {
+		value.state = Peer::State::Alive;
+		value.probabitily = lerp(Peer::kCertainlyAlive, Peer::kMaybeNotAlive, phi / _suspectThreshold);
+	} else if (phi < _deadThreshold) {
+		value.state = Peer::State::Suspected;
+		value.probabitily = lerp(Peer::kMaybeNotAlive, Peer::kCertainlyNotAlive,
+								 (phi - _suspectThreshold) / (_deadThreshold - _suspectThreshold));
+	} else {
+		value.state = Peer::State::Dead;
+		value.probabitily = Peer::kCertainlyNotAlive;
+	}
+
+	return value;
+}
+
+
+PeersModel
+PhiAccrualDetector::tick(PeersModel&& model) {
+	model.now += 1;
+
+	for (auto it = _estimators.begin(); it != _estimators.end(); ) {
+		auto const id = it->first;
+		auto peerIt = model.members.find(id);
+		if (peerIt == model.members.end()) {  // Peer has left
+			it = _estimators.erase(it);
+			continue;
+		}
+
+		auto const current = model.liveness(peerIt->second);
+		auto next = liveness(current, it->second.phi(model.now, _minStdDev));
+		if (PeersModel::isAlive(current) && PeersModel::isSuspected(next)) {
+			model.startSuspicion(id, next, model.node.id, model.now);
+		} else if (PeersModel::isSuspected(current)) {
+			auto suspicion = model.suspicions.find(id);
+			if (suspicion != model.suspicions.end()) {
+				next = applySuspicion(model, suspicion->second, next, it->second.lastHeartbeat());
+			}
+		}
+
+		// Note: reindex drops the suspicion of a peer that is alive again
+		if (next.state != current.state || PeersModel::isHealthy(next) != PeersModel::isHealthy(current)) {
+			model.reindex(id, next);
+		}
+
+		model.setLiveness(peerIt->second, next);
+
+		++it;
+	}
+
+	return std::move(model);
+}
@@ -0,0 +1,126 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/pingRelay.hpp"
+#include "tribe/protocol/messageSchema.hpp"
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+namespace /* anonymous */ {
+
+/// Offsets of ttl in encoded messages: ttl follows the message header and IDs of the nodes
+constexpr Gossip::size_type kPingTtlOffset = Gossip::headerSize() + encodedSize(NodeID{}) + encodedSize(NodeID{});
+constexpr Gossip::size_type kPongTtlOffset = Gossip::headerSize() + encodedSize(NodeID{}) + encodedSize(NodeInfo{});
+
+
+template<typename MessageType>
+Route
+routeTo(PeersModel const& model, MessageType const& msg) {
+	auto const id = addressee(msg);
+	if (id == model.node.id) {
+		return Route{Route::Kind::Deliver, Address{}};
+	}
+
+	if (msg.ttl == 0) {
+		return Route{Route::Kind::Drop, Address{}};
+	}
+
+	auto it = model.members.find(id);
+	if (it == model.members.end() || model.isDead(it->second)) {
+		return Route{Route::Kind::Drop, Address{}};
+	}
+
+	return Route{Route::Kind::Forward, it->second.address};
+}
+
+
+/// Read the fixed size prefix of an encoded ping: IDs of the nodes and ttl
+void
+readPrefix(ByteReader& reader, PingMessage* msg) {
+	reader.readLE(msg->origin.value);
+	reader.readLE(msg->target.value);
+	reader.readLE(msg->ttl);
+}
+
+/// Read the fixed size prefix of an encoded pong: ID of the requestor, the node that has replied and ttl
+void
+readPrefix(ByteReader& reader, PongMessage* msg) {
+	reader.readLE(msg->origin.value);
+	reader.readLE(msg->nodeDetails.id.value);
+	reader.readLE(msg->nodeDetails.gen);
+	reader.readLE(msg->ttl);
+}
+
+
+/**
+ * Route an encoded message by its fixed size prefix and decrement ttl of the message, if it is forwarded.
+ * Piggybacked updates are neither decoded nor validated: it is up to the node the message is addressed to.
+ */
+template<typename MessageType>
+Result<Route, MessageParser::Error>
+relayMessage(PeersModel const& model, ByteReader& reader, MutableMemoryView datagram,
+			 Gossip::size_type ttlOffset) {
+	if (datagram.size() < encodedSize(MessageType{})) {
+		return Err(MessageParser::Error{});
+	}
+
+	MessageType msg{};
+	readPrefix(reader, &msg);
+
+	auto result = routeTo(model, msg);
+	if (result.kind == Route::Kind::Forward) {
+		datagram.dataAs<byte>()[ttlOffset] = static_cast<byte>(msg.ttl - 1);
+	}
+
+	return Ok(result);
+}
+
+}  // anonymous namespace
+
+
+Route
+tribe::route(PeersModel const& model, PingMessage const& msg) {
+	return routeTo(model, msg);
+}
+
+
+Route
+tribe::route(PeersModel const& model, PongMessage const& msg) {
+	return routeTo(model, msg);
+}
+
+
+Result<Route, MessageParser::Error>
+tribe::relay(PeersModel const& model, MutableMemoryView datagram) {
+	ByteReader reader{datagram};
+	auto maybeHeader = MessageParser{}.parseMessageHeader(reader);
+	if (!maybeHeader) {
+		return Err(maybeHeader.moveError());
+	}
+
+	switch (maybeHeader.unwrap().type) {
+	case Gossip::MessageType::PingDirect:
+	case Gossip::MessageType::PingCompact:
+		return relayMessage<PingMessage>(model, reader, datagram, kPingTtlOffset);
+	case Gossip::MessageType::PongDirect:
+	case Gossip::MessageType::PongCompact:
+		return relayMessage<PongMessage>(model, reader, datagram, kPongTtlOffset);
+	default:
+		return Err(MessageParser::Error{});
+	}
+}
@@ -0,0 +1,248 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+#include "tribe/probeScheduler.hpp"
+
+#include <algorithm>  // std::shuffle, std::find, std::swap
+
+
+using namespace Solace;
+using namespace tribe;
+
+
+ProbeScheduler::ProbeScheduler(MembershipSettings const& settings, uint64 seed) noexcept
+	: ProbeScheduler{settings.probePeriod, settings.probeTimeout, settings.indirectProbes, seed,
+					 settings.maxLocalHealth}
+{}
+
+
+ProbeScheduler::ProbeScheduler(Tick period, Tick timeout, size_type indirectProbes, uint64 seed,
+							   LocalHealth::Score maxLocalHealth) noexcept
+	: _period{std::max<Tick>(period, 1)}
+	, _timeout{timeout}
+	, _indirectProbes{indirectProbes}
+	, _random{seed}
+	, _health{maxLocalHealth}
+	, _periodLength{_period}
+	, _periodTimeout{_timeout}
+{
+	_helpers.reserve(_indirectProbes);
+}
+
+
+Optional<NodeID>
+ProbeScheduler::target() const {
+	if (!_probing) {
+		return none;
+	}
+
+	return _target;
+}
+
+
+void
+ProbeScheduler::track(NodeID id) {
+	auto const position = static_cast<size_type>(_order.size());
+	if (!_pending.try_emplace(id, position).second) {
+		return;
+	}
+
+	// Insert at a random position among the peers yet to be probed this round:
+	// append, then swap with a random peer yet to be probed, as in the inside-out Fisher-Yates shuffle
+	_order.push_back(id);
+	auto const remaining = static_cast<uint64>(position - _next);
+	auto const other = _next + static_cast<size_type>(_random() % (remaining + 1));
+	if (other != position) {
+		std::swap(_order[other], _order[position]);
+		_pending[_order[position]] = position;
+		_pending[id] = other;
+	}
+}
+
+
+bool
+ProbeScheduler::onAck(NodeID from) noexcept {
+	if (!_probing || from != _target) {
+		return false;
+	}
+
+	// Note: ack is received after the last tick, so it is in time if that tick is before the timeout
+	if (!_acked && _lastTick < _periodStart + _timeout) {
+		_health.onProbeSuccess();
+	}
+
+	_acked = true;
+	return true;
+}
+
+
+bool
+ProbeScheduler::onAck(NodeID from, NodeID via) noexcept {
+	if (!_probing || from != _target) {
+		return false;
+	}
+
+	auto helper = std::find(_helpers.begin(), _helpers.end(), via);
+	if (helper != _helpers.end()) {
+		*helper = _helpers.back();
+		_helpers.pop_back();
+	}
+
+	return onAck(from);
+}
+
+
+void
+ProbeScheduler::startRound(PeersModel const& model) {
+	_order.clear();
+	_next = 0;
+	for (auto const& entry : model.members) {
+		if (!model.isDead(entry.second)) {
+			_order.push_back(entry.first);
+		}
+	}
+
+	std::shuffle(_order.begin(), _order.end(), _random);
+
+	_pending.clear();
+	_pending.reserve(_order.size());
+	for (size_type i = 0; i < _order.size(); ++i) {
+		_pending.try_emplace(_order[i], i);
+	}
+}
+
+
+Optional<NodeID>
+ProbeScheduler::nextTarget(PeersModel const& model) {
+	bool newRound = false;
+	while (true) {
+		if (_next >= _order.size()) {
+			if (newRound) {  // Nothing to probe
+				return none;
+			}
+
+			startRound(model);
+			newRound = true;
+			continue;
+		}
+
+		auto const id = _order[_next++];
+		_pending.erase(id);
+		auto it = model.members.find(id);
+		if (it != model.members.end() && id != model.node.id && !model.isDead(it->second)) {
+			return id;
+		}
+	}
+}
+
+
+ProbeScheduler::size_type
+ProbeScheduler::pickHelpers(PeersModel const& model, ArrayView<Probe> dest) {
+	auto const& healthy = model.healthy;
+	auto const nCandidates = healthy.size() - (healthy.contains(_target) ? 1 : 0);
+	auto const count = std::min({_indirectProbes, dest.size(), nCandidates});
+
+	auto const isPicked = [&dest](size_type picked, NodeID id) {
+		for (size_type i = 0; i < picked; ++i) {
+			if (dest[i].via == id) {
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	size_type picked = 0;
+	if (count == nCandidates) {  // Every candidate helps
+		for (auto id : healthy) {
+			if (id != _target) {
+				dest[picked++] = Probe{Probe::Kind::Indirect, _target, id};
+			}
+		}
+
+		return picked;
+	}
+
+	// Note: there are more candidates than helpers to pick, so few picks are rejected
+	while (picked < count) {
+		auto const id = healthy[static_cast<PeerIdSet::size_type>(_random() % healthy.size())];
+		if (id != _target && !isPicked(picked, id)) {
+			dest[picked++] = Probe{Probe::Kind::Indirect, _target, id};
+		}
+	}
+
+	return picked;
+}
+
+
+ProbeScheduler::size_type
+ProbeScheduler::tick(PeersModel const& model, Tick now, ArrayView<Probe> dest) {
+	size_type count = 0;
+	_lastTick = now;
+	auto periodEnd = _periodStart + _periodLength;
+
+	// Target has not acked in time: ask helpers to probe it
+	if (awaitingAck() && !_indirect && _periodTimeout < _periodLength && now >= _periodStart + _periodTimeout) {
+		_indirect = true;
+		auto const helpers = pickHelpers(model, dest);
+		for (size_type i = 0; i < helpers; ++i) {
+			_helpers.push_back(dest[i].via);
+		}
+		count += helpers;
+
+		// Ticks have been skipped past the end of the period: give helpers the rest of the period to probe the target
+		if (helpers && now >= periodEnd) {
+			_periodLength = (now - _periodStart) + (_periodLength - _periodTimeout);
+			periodEnd = _periodStart + _periodLength;
+		}
+	}
+
+	if (_probing && now < periodEnd) {
+		return count;
+	}
+
+	// End of the protocol period: target that has not acked, and is still around, has failed
+	if (awaitingAck() && count < dest.size() && model.members.find(_target) != model.members.end()) {
+		dest[count++] = Probe{Probe::Kind::Failed, _target, NodeID{0}};
+		_health.onProbeFailure();
+	}
+
+	// Target has acked, yet some of the helpers have not relayed its ack: likely missed by this node
+	if (_probing && _acked) {
+		for (size_type i = 0; i < _helpers.size(); ++i) {
+			_health.onMissedNack();
+		}
+	}
+	_helpers.clear();
+
+	_probing = false;
+	_periodStart = now;
+	_periodLength = _health.scale(_period);
+	_periodTimeout = _health.scale(_timeout);
+	if (count == dest.size()) {
+		return count;
+	}
+
+	auto const next = nextTarget(model);
+	if (next) {
+		_target = *next;
+		_probing = true;
+		_acked = false;
+		_indirect = false;
+		dest[count++] = Probe{Probe::Kind::Direct, _target, NodeID{0}};
+	}
+
+	return count;
+}
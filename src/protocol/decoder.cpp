@@ -19,6 +19,8 @@
 
 #include <solace/posixErrorDomain.hpp>
 
+#include <limits>
+
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -109,9 +111,372 @@ Decoder::read(Address* addr) {
 		readAddress(_src, *reinterpret_cast<sockaddr_in6*>(&addr->addr));
 	} break;
 	default:
-		return Err(makeError(BasicError::InvalidInput, "address family"));
+		// Address of a family the sender does not support is encoded as a bare family: nothing follows
+		*addr = Address{};
+		break;
+	}
+
+	return Ok();
+}
+
+
+Result<void, Error>
+Decoder::readAddressView(MemoryView* dest) {
+	auto const encoded = _src.viewRemaining();
+
+	decltype(sockaddr_storage::ss_family) family{};
+	auto r = read(&family);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	MemoryView::size_type addressSize = 0;
+	switch (family) {
+	case AF_INET:	addressSize = sizeof(sockaddr_in::sin_port) + sizeof(in_addr::s_addr); break;
+	case AF_INET6:	addressSize = sizeof(sockaddr_in6::sin6_port) + sizeof(sockaddr_in6::sin6_addr); break;
+	default:		addressSize = 0; break;  // Unsupported family: decoded as an empty address
+	}
+
+	return _src.advance(addressSize)
+			.then([&]() {
+				*dest = encoded.slice(0, sizeof(family) + addressSize);
+			});
+}
+
+Result<void, Error>
+Decoder::read(SnapshotChunk* chunk) {
+	auto r = read(&chunk->snapshot)
+			.then([&]() { return read(&chunk->index); })
+			.then([&]() { return read(&chunk->count); });
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (chunk->index >= chunk->count) {
+		return Err(makeError(BasicError::InvalidInput, "snapshot chunk"));
+	}
+
+	return Ok();
+}
+
+
+Result<void, Error>
+Decoder::read(MembershipUpdate::Kind* kind) {
+	uint8 value{};
+	auto r = read(&value);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (value > static_cast<uint8>(MembershipUpdate::Kind::Joined)) {
+		return Err(makeError(BasicError::InvalidInput, "update kind"));
+	}
+
+	*kind = static_cast<MembershipUpdate::Kind>(value);
+	return Ok();
+}
+
+
+Result<void, Error>
+Decoder::readVarint(uint64* dest) {
+	uint64 value = 0;
+	for (uint32 shift = 0; shift < 64; shift += 7) {
+		uint8 octet{};
+		auto r = read(&octet);
+		if (!r) {
+			return Err(r.getError());
+		}
+
+		value |= static_cast<uint64>(octet & 0x7F) << shift;
+		if ((octet & 0x80) == 0) {
+			*dest = value;
+			return Ok();
+		}
+	}
+
+	return Err(makeError(BasicError::Overflow, "varint"));
+}
+
+
+Result<void, Error>
+Decoder::readVarint(uint32* dest) {
+	uint64 value{};
+	auto r = readVarint(&value);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (value > std::numeric_limits<uint32>::max()) {
+		return Err(makeError(BasicError::Overflow, "varint"));
+	}
+
+	*dest = static_cast<uint32>(value);
+	return Ok();
+}
+
+
+template<typename Lookup>
+Result<void, Error>
+Decoder::readCompactAddress(Address* dest, Lookup&& preceding) {
+	uint8 tag{};
+	auto r = read(&tag);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	auto const form = static_cast<uint8>(tag & Gossip::kCompactFormMask);
+	if (form == 0) {
+		*dest = Address{};
+		switch (tag) {
+		case Gossip::kCompactIPv4: {
+			auto& addr = *reinterpret_cast<sockaddr_in*>(&dest->addr);
+			dest->size = sizeof(sockaddr_in);
+			addr.sin_family = AF_INET;
+			return _src.read(wrapMemory(&addr.sin_addr.s_addr, sizeof(addr.sin_addr.s_addr)))
+					.then([&]() { return read(&addr.sin_port); });
+		}
+		case Gossip::kCompactIPv6: {
+			auto& addr = *reinterpret_cast<sockaddr_in6*>(&dest->addr);
+			dest->size = sizeof(sockaddr_in6);
+			addr.sin6_family = AF_INET6;
+			return _src.read(wrapMemory(addr.sin6_addr.__in6_u.__u6_addr8))
+					.then([&]() { return read(&addr.sin6_port); });
+		}
+		case Gossip::kCompactUnknown:  // Peer address is of a family the sender does not support: nothing follows
+			return Ok();
+		default:
+			return Err(makeError(BasicError::InvalidInput, "address family"));
+		}
+	}
+
+	if (form != Gossip::kCompactRef && form != Gossip::kCompactRefSamePort) {
+		return Err(makeError(BasicError::InvalidInput, "address form"));
+	}
+
+	Address const* reference = preceding(static_cast<uint32>(tag & ~Gossip::kCompactFormMask) + 1);
+	if (!reference) {
+		return Err(makeError(BasicError::InvalidInput, "address reference"));
+	}
+
+	// Address shares a prefix of IP address, and maybe port, with the one referred to
+	*dest = *reference;
+	byte* ip = nullptr;
+	uint8 ipSize = 0;
+	uint16* port = nullptr;
+	if (dest->addr.ss_family == AF_INET) {
+		auto& addr = *reinterpret_cast<sockaddr_in*>(&dest->addr);
+		ip = reinterpret_cast<byte*>(&addr.sin_addr.s_addr);
+		ipSize = sizeof(addr.sin_addr.s_addr);
+		port = &addr.sin_port;
+	} else if (dest->addr.ss_family == AF_INET6) {
+		auto& addr = *reinterpret_cast<sockaddr_in6*>(&dest->addr);
+		ip = addr.sin6_addr.__in6_u.__u6_addr8;
+		ipSize = sizeof(addr.sin6_addr);
+		port = &addr.sin6_port;
+	} else {
+		return Err(makeError(BasicError::InvalidInput, "address reference"));
+	}
+
+	uint8 suffixSize{};
+	r = read(&suffixSize);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (suffixSize > ipSize) {
+		return Err(makeError(BasicError::InvalidInput, "address suffix"));
+	}
+
+	r = _src.read(wrapMemory(ip + ipSize - suffixSize, suffixSize));
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (form == Gossip::kCompactRef) {
+		return read(port);
+	}
+
+	return Ok();
+}
+
+
+template<typename Lookup>
+Result<void, Error>
+Decoder::readCompact(MembershipUpdate* update, NodeID previous, Lookup&& preceding) {
+	return read(&update->kind)
+			.then([&]() { return readVarint(&update->node.id.value); })
+			.then([&]() {
+				update->node.id.value += previous.value;
+				return readVarint(&update->node.gen);
+			})
+			.then([&]() { return readCompactAddress(&update->address, preceding); })
+			.then([&]() { return readSuspecter(update, true); });
+}
+
+
+Result<void, Error>
+Decoder::readSuspecter(MembershipUpdate* update, bool compact) {
+	update->suspecter = NodeID{0};
+	if (update->kind != MembershipUpdate::Kind::Suspect) {
+		return Ok();
+	}
+
+	return compact
+			? readVarint(&update->suspecter.value)
+			: read(&update->suspecter);
+}
+
+
+Result<void, Error>
+Decoder::readCompact(ArrayView<MembershipUpdate> updates, uint32 index) {
+	auto const previous = (index == 0) ? NodeID{0} : updates[index - 1].node.id;
+
+	return readCompact(&updates[index], previous, [&](uint32 distance) -> Address const* {
+		return (distance <= index && distance <= Gossip::kAddressWindow)
+				? &updates[index - distance].address
+				: nullptr;
+	});
+}
+
+
+namespace /* anonymous */ {
+
+/// Number of bytes of IP address of a compactly encoded literal address of a given tag, 0 if there is none
+uint8
+compactIPSize(uint8 tag) noexcept {
+	switch (tag) {
+	case Gossip::kCompactIPv4:	return sizeof(in_addr::s_addr);
+	case Gossip::kCompactIPv6:	return sizeof(in6_addr);
+	default:					return 0;
+	}
+}
+
+}  // anonymous namespace
+
+
+Result<void, Error>
+Decoder::skipAddress() {
+	decltype(sockaddr_storage::ss_family) family{};
+	auto r = read(&family);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	switch (family) {
+	case AF_INET:	return _src.advance(sizeof(sockaddr_in::sin_port) + sizeof(in_addr::s_addr));
+	case AF_INET6:	return _src.advance(sizeof(sockaddr_in6::sin6_port) + sizeof(sockaddr_in6::sin6_addr));
+	default:		break;  // Unsupported family: nothing follows
+	}
+
+	return Ok();
+}
+
+
+template<typename Lookup>
+Result<void, Error>
+Decoder::skipCompactAddress(uint8* ipSize, Lookup&& preceding) {
+	uint8 tag{};
+	auto r = read(&tag);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	auto const form = static_cast<uint8>(tag & Gossip::kCompactFormMask);
+	if (form == 0) {
+		*ipSize = compactIPSize(tag);
+		if (*ipSize != 0) {
+			return _src.advance(*ipSize + sizeof(uint16));
+		}
+
+		if (tag != Gossip::kCompactUnknown) {
+			return Err(makeError(BasicError::InvalidInput, "address family"));
+		}
+
+		return Ok();
+	}
+
+	if (form != Gossip::kCompactRef && form != Gossip::kCompactRefSamePort) {
+		return Err(makeError(BasicError::InvalidInput, "address form"));
+	}
+
+	// Only addresses of a known family can be referred to
+	*ipSize = preceding(static_cast<uint32>(tag & ~Gossip::kCompactFormMask) + 1);
+	if (*ipSize == 0) {
+		return Err(makeError(BasicError::InvalidInput, "address reference"));
+	}
+
+	uint8 suffixSize{};
+	r = read(&suffixSize);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	if (suffixSize > *ipSize) {
+		return Err(makeError(BasicError::InvalidInput, "address suffix"));
+	}
+
+	return _src.advance(suffixSize + ((form == Gossip::kCompactRef) ? sizeof(uint16) : 0));
+}
+
+
+Result<void, Error>
+Decoder::skipSuspecter(MembershipUpdate::Kind kind, bool compact) {
+	if (kind != MembershipUpdate::Kind::Suspect) {
+		return Ok();
+	}
+
+	uint32 suspecter{};
+	return compact
+			? readVarint(&suspecter)
+			: _src.advance(sizeof(suspecter));
+}
+
+
+Result<void, Error>
+Decoder::read(PiggybackView* updates) {
+	auto r = read(&updates->count);
+	if (!r) {
+		return Err(r.getError());
+	}
+
+	// Updates are only checked to be well formed, not decoded: it takes no more than finding where each one ends
+	auto const encoded = _src.viewRemaining();
+	auto const start = _src.position();
+	MembershipUpdate::Kind kind{};
+	if (updates->encoding == UpdateEncoding::Compact) {
+		// Addresses can only refer to a limited number of preceding updates, and only the size of their IP address,
+		// that is 0 for addresses of unknown family, matters to tell where an address that refers to them ends.
+		uint8 ipSizes[Gossip::kAddressWindow];
+		for (uint32 i = 0; i < updates->count; ++i) {
+			uint32 value{};
+			auto u = read(&kind)
+					.then([&]() { return readVarint(&value); })		// Delta-encoded node ID
+					.then([&]() { return readVarint(&value); })		// Generation
+					.then([&]() {
+						return skipCompactAddress(&ipSizes[i % Gossip::kAddressWindow], [&](uint32 distance) -> uint8 {
+							return (distance <= i && distance <= Gossip::kAddressWindow)
+									? ipSizes[(i - distance) % Gossip::kAddressWindow]
+									: uint8{0};
+						});
+					})
+					.then([&]() { return skipSuspecter(kind, true); });
+			if (!u) {
+				return Err(u.getError());
+			}
+		}
+	} else {
+		for (uint32 i = 0; i < updates->count; ++i) {
+			auto u = read(&kind)
+					.then([&]() { return _src.advance(sizeof(NodeInfo::id.value) + sizeof(NodeInfo::gen)); })
+					.then([&]() { return skipAddress(); })
+					.then([&]() { return skipSuspecter(kind, false); });
+			if (!u) {
+				return Err(u.getError());
+			}
+		}
 	}
 
+	updates->data = encoded.slice(0, _src.position() - start);
 	return Ok();
 }
 
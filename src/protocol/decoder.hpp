@@ -18,8 +18,11 @@
 #define TRIBE_PROTOCOL_DECODER_HPP
 
 #include "tribe/nodeInfo.hpp"
+#include "tribe/protocol/gossip.hpp"
+#include "tribe/protocol/messageSchema.hpp"
 
 #include <solace/byteReader.hpp>
+#include <solace/arrayView.hpp>
 
 
 namespace tribe {
@@ -45,12 +48,93 @@ struct Decoder {
 
 	Solace::Result<void, Solace::Error> read(Address* addr);
 
+	/// Take a view of an encoded address without decoding it
+	Solace::Result<void, Solace::Error> readAddressView(Solace::MemoryView* dest);
+
+	Solace::Result<void, Solace::Error> read(ErrorView* error) {
+		return read(&error->domain)
+				.then([&]() { return read(&error->code); })
+				.then([&]() { return read(&error->tag); });
+	}
+
 	Solace::Result<void, Solace::Error> read(NodeInfo* node) {
 		return read(&node->id)
 				.then([&]() { return read(&node->gen); });
 	}
 
+	/// Decode position of a snapshot chunk, checking that the chunk is within the snapshot
+	Solace::Result<void, Solace::Error> read(SnapshotChunk* chunk);
+
+	Solace::Result<void, Solace::Error> read(MembershipUpdate::Kind* kind);
+
+	Solace::Result<void, Solace::Error> read(MembershipUpdate* update) {
+		return read(&update->kind)
+				.then([&]() { return read(&update->node); })
+				.then([&]() { return read(&update->address); })
+				.then([&]() { return readSuspecter(update, false); });
+	}
+
+	/// Decode LEB128 varint integer
+	Solace::Result<void, Solace::Error> readVarint(Solace::uint64* dest);
+	Solace::Result<void, Solace::Error> readVarint(Solace::uint32* dest);
+
+	/**
+	 * Decode compactly encoded update of a list, which preceding updates have been decoded already.
+	 * Node ID is delta-encoded against the ID of the previous update, and the address can refer
+	 * to an address of one of the preceding updates.
+	 */
+	Solace::Result<void, Solace::Error> readCompact(Solace::ArrayView<MembershipUpdate> updates,
+													Solace::uint32 index);
+
+	/**
+	 * Take a view of piggybacked updates, checking that all of the updates are well formed.
+	 * Encoding of the updates is expected to be set by the caller.
+	 */
+	Solace::Result<void, Solace::Error> read(PiggybackView* updates);
+
+	/// Decode payload of a message, that follows message header, as described by its schema
+	template<typename MessageType>
+	Solace::Result<void, Solace::Error> readPayload(MessageType* msg) {
+		return readFields<0>(msg);
+	}
+
 private:
+
+	/// Decode the suspecter of a Suspect update, that follows its address. Other updates have none.
+	Solace::Result<void, Solace::Error> readSuspecter(MembershipUpdate* update, bool compact);
+
+	/// Skip an encoded address, checking it is well formed
+	Solace::Result<void, Solace::Error> skipAddress();
+
+	/**
+	 * Skip a compactly encoded address, checking it is well formed.
+	 * @param ipSize Output for the size of the IP address, 0 if the address is of unknown family.
+	 * @param preceding Looks up the size of IP address of a preceding address by the distance back.
+	 */
+	template<typename Lookup>
+	Solace::Result<void, Solace::Error> skipCompactAddress(Solace::uint8* ipSize, Lookup&& preceding);
+
+	/// Skip the suspecter of a Suspect update. Other updates have none.
+	Solace::Result<void, Solace::Error> skipSuspecter(MembershipUpdate::Kind kind, bool compact);
+
+	/// Decode compactly encoded address. Preceding addresses are looked up by the distance back.
+	template<typename Lookup>
+	Solace::Result<void, Solace::Error> readCompactAddress(Address* dest, Lookup&& preceding);
+
+	template<typename Lookup>
+	Solace::Result<void, Solace::Error> readCompact(MembershipUpdate* update, NodeID previous, Lookup&& preceding);
+
+	template<std::size_t FieldIndex, typename MessageType>
+	Solace::Result<void, Solace::Error> readFields(MessageType* msg) {
+		constexpr auto& fields = MessageSchema<MessageType>::fields;
+		if constexpr (FieldIndex == std::tuple_size_v<std::decay_t<decltype(fields)>>) {
+			return Solace::Ok();
+		} else {
+			return read(&(msg->*std::get<FieldIndex>(fields)))
+					.then([&]() { return readFields<FieldIndex + 1>(msg); });
+		}
+	}
+
 	Solace::ByteReader& _src;
 };
 
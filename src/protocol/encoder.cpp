@@ -43,14 +43,15 @@ Encoder& operator<< (Encoder& encoder, Solace::uint64 value)  {
 }
 
 Encoder& operator<< (Encoder& encoder, Solace::StringView data) {
-	encoder << data.size();
+	// Note: protocol uses fixed width size fields
+	encoder << static_cast<Gossip::size_type>(data.size());
 	encoder.writer().write(data.view());
 
 	return encoder;
 }
 
 Encoder& operator<< (Encoder& encoder, Solace::MemoryView data) {
-	encoder << data.size();
+	encoder << static_cast<Gossip::size_type>(data.size());
 	encoder.writer().write(data);
 
 	return encoder;
@@ -75,6 +76,21 @@ void writeAddress(ByteWriter& writer, sockaddr_in6 const& addr) {
 }
 
 
+std::size_t
+encodedSize(Address const& address) noexcept {
+	auto const familySize = sizeof(address.addr.ss_family);
+
+	switch (address.addr.ss_family) {
+	case AF_INET:
+		return familySize + sizeof(sockaddr_in::sin_port) + sizeof(sockaddr_in::sin_addr.s_addr);
+	case AF_INET6:
+		return familySize + sizeof(sockaddr_in6::sin6_port) + sizeof(sockaddr_in6::sin6_addr);
+	default:
+		return familySize;
+	}
+}
+
+
 Encoder&
 operator<< (Encoder& out, Address const& address) {
 	auto& writer = out.writer();
@@ -88,7 +104,7 @@ operator<< (Encoder& out, Address const& address) {
 		writeAddress(writer, *reinterpret_cast<sockaddr_in6 const*>(&address.addr));
 	} break;
 	default:
-		// TODO(abbyssoul): Error handling required
+		// Address of unsupported family is encoded as a bare family, and is decoded as an empty address
 		break;
 	}
 
@@ -103,4 +119,256 @@ operator<< (Encoder& out, NodeInfo const& node) {
 }
 
 
+Encoder&
+operator<< (Encoder& out, SnapshotChunk const& chunk) {
+	return out << chunk.snapshot
+			   << chunk.index
+			   << chunk.count;
+}
+
+
+Encoder&
+operator<< (Encoder& out, PiggybackView const& updates) {
+	out << updates.count;
+	out.writer().write(updates.data);
+
+	return out;
+}
+
+
+Encoder&
+operator<< (Encoder& out, MembershipUpdate const& update) {
+	out << static_cast<uint8>(update.kind)
+		<< update.node
+		<< update.address;
+
+	if (update.kind == MembershipUpdate::Kind::Suspect) {
+		out << update.suspecter;
+	}
+
+	return out;
+}
+
+
+Encoder&
+writeVarint(Encoder& out, uint64 value) {
+	while (value >= 0x80) {
+		out << static_cast<uint8>((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+
+	return out << static_cast<uint8>(value);
+}
+
+
+namespace /* anonymous */ {
+
+/// IP address bytes and port of a network address
+struct AddressParts {
+	byte const*		ip;
+	uint8			ipSize;
+	uint16			port;
+};
+
+AddressParts
+addressParts(Address const& address) noexcept {
+	switch (address.addr.ss_family) {
+	case AF_INET: {
+		auto const& addr = *reinterpret_cast<sockaddr_in const*>(&address.addr);
+		return {reinterpret_cast<byte const*>(&addr.sin_addr.s_addr), sizeof(addr.sin_addr.s_addr), addr.sin_port};
+	}
+	case AF_INET6: {
+		auto const& addr = *reinterpret_cast<sockaddr_in6 const*>(&address.addr);
+		return {addr.sin6_addr.__in6_u.__u6_addr8, sizeof(addr.sin6_addr), addr.sin6_port};
+	}
+	default:
+		return {nullptr, 0, 0};
+	}
+}
+
+
+/// Compact encoding chosen for an address
+struct CompactAddress {
+	uint32			distance;	//!< Number of updates back to the address referred to, 0 if none
+	uint8			suffixSize;	//!< Number of trailing bytes of IP address that differ from the one referred to
+	bool			samePort;	//!< If the port is the same as that of the address referred to
+	Gossip::size_type	size;	//!< Size of the encoded address in bytes
+};
+
+
+Gossip::size_type
+literalAddressSize(AddressParts const& parts) noexcept {
+	// Address of unsupported family is encoded as a bare tag
+	return parts.ip
+			? static_cast<Gossip::size_type>(sizeof(byte) + parts.ipSize + sizeof(parts.port))
+			: Gossip::size_type{sizeof(byte)};
+}
+
+
+/// Get the number of leading bytes IP addresses of the same size have in common
+uint8
+commonPrefixSize(byte const* lhs, byte const* rhs, uint8 size) noexcept {
+	// IP addresses are compared 4 bytes at a time: the first byte that differs is the lowest set byte of XOR of
+	// little-endian words
+	auto const loadLE = [](byte const* data) {
+		return uint32{data[0]} | (uint32{data[1]} << 8) | (uint32{data[2]} << 16) | (uint32{data[3]} << 24);
+	};
+
+	uint8 prefixSize = 0;
+	for (; prefixSize + sizeof(uint32) <= size; prefixSize += sizeof(uint32)) {
+		auto const diff = loadLE(lhs + prefixSize) ^ loadLE(rhs + prefixSize);
+		if (diff) {
+			return static_cast<uint8>(prefixSize + __builtin_ctz(diff) / 8);
+		}
+	}
+
+	return prefixSize;
+}
+
+
+/// Find the shortest encoding of the address of an update: a literal or a reference to an address of preceding update
+CompactAddress
+chooseCompactAddress(ArrayView<MembershipUpdate const> updates, uint32 index) noexcept {
+	// Members can not share both IP address and port, so a reference that differs in one byte is as short as it gets
+	constexpr Gossip::size_type kShortestReference = 2 * sizeof(byte) + 1;
+
+	auto const parts = addressParts(updates[index].address);
+	CompactAddress best{0, parts.ipSize, false, literalAddressSize(parts)};
+	if (!parts.ip) {
+		return best;
+	}
+
+	auto const window = (index < Gossip::kAddressWindow) ? index : Gossip::kAddressWindow;
+	for (uint32 distance = 1; distance <= window && best.size > kShortestReference; ++distance) {
+		auto const other = addressParts(updates[index - distance].address);
+		if (other.ipSize != parts.ipSize) {
+			continue;
+		}
+
+		auto const suffixSize = static_cast<uint8>(parts.ipSize - commonPrefixSize(parts.ip, other.ip, parts.ipSize));
+		auto const samePort = (parts.port == other.port);
+		auto const size = static_cast<Gossip::size_type>(2 * sizeof(byte) + suffixSize + (samePort ? 0 : sizeof(parts.port)));
+		if (size < best.size) {
+			best = CompactAddress{distance, suffixSize, samePort, size};
+		}
+	}
+
+	return best;
+}
+
+}  // anonymous namespace
+
+
+Gossip::size_type
+compactEncodedSize(Address const& address) noexcept {
+	return literalAddressSize(addressParts(address));
+}
+
+
+namespace /* anonymous */ {
+
+/// Get exact size in bytes of a compactly encoded update, once the encoding of its address is chosen
+Gossip::size_type
+compactUpdateSize(MembershipUpdate const& update, NodeID previous, CompactAddress const& address) noexcept {
+	return sizeof(update.kind) +
+			varintSize(static_cast<uint32>(update.node.id.value - previous.value)) +
+			varintSize(update.node.gen) +
+			address.size +
+			((update.kind == MembershipUpdate::Kind::Suspect) ? varintSize(update.suspecter.value) : 0);
+}
+
+/// Encode the suspecter of a Suspect update, that follows the address of the suspected node
+void
+writeCompactSuspecter(Encoder& out, MembershipUpdate const& update) {
+	if (update.kind == MembershipUpdate::Kind::Suspect) {
+		writeVarint(out, update.suspecter.value);
+	}
+}
+
+}  // anonymous namespace
+
+
+Gossip::size_type
+compactEncodedSize(ArrayView<MembershipUpdate const> updates, uint32 index) noexcept {
+	auto const previous = (index == 0) ? NodeID{0} : updates[index - 1].node.id;
+
+	return compactUpdateSize(updates[index], previous, chooseCompactAddress(updates, index));
+}
+
+
+Gossip::size_type
+writeCompact(Encoder& out, ArrayView<MembershipUpdate const> updates, uint32 index, std::size_t budget) {
+	auto const& update = updates[index];
+	auto const previous = (index == 0) ? NodeID{0} : updates[index - 1].node.id;
+	auto const address = chooseCompactAddress(updates, index);
+	auto const size = compactUpdateSize(update, previous, address);
+	if (size > budget) {
+		return 0;
+	}
+
+	out << static_cast<uint8>(update.kind);
+	writeVarint(out, static_cast<uint32>(update.node.id.value - previous.value));
+	writeVarint(out, update.node.gen);
+
+	// Address tag: 2 high bits are the form of the address, 6 low bits are its family or distance to the reference
+	auto const parts = addressParts(update.address);
+	auto& writer = out.writer();
+	if (!parts.ip) {
+		out << Gossip::kCompactUnknown;
+	} else if (address.distance == 0) {
+		out << ((parts.ipSize == sizeof(in6_addr)) ? Gossip::kCompactIPv6 : Gossip::kCompactIPv4);
+		writer.write(wrapMemory(parts.ip, parts.ipSize));
+		out << parts.port;
+	} else {
+		auto const form = address.samePort ? Gossip::kCompactRefSamePort : Gossip::kCompactRef;
+		out << static_cast<uint8>(form | (address.distance - 1))
+			<< address.suffixSize;
+		writer.write(wrapMemory(parts.ip + parts.ipSize - address.suffixSize, address.suffixSize));
+		if (!address.samePort) {
+			out << parts.port;
+		}
+	}
+	writeCompactSuspecter(out, update);
+
+	return size;
+}
+
+
+Encoder&
+operator<< (Encoder& out, ErrorView const& error) {
+	return out << error.domain
+			   << error.code
+			   << error.tag;
+}
+
+
+UncheckedEncoder&
+operator<< (UncheckedEncoder& out, Address const& address) noexcept {
+	out << address.addr.ss_family;
+
+	// Note: port and IP address are stored as they are, in network byte order
+	auto const parts = addressParts(address);
+	if (parts.ip) {
+		out.write(reinterpret_cast<byte const*>(&parts.port), sizeof(parts.port));
+		out.write(parts.ip, parts.ipSize);
+	}
+
+	return out;
+}
+
+
+UncheckedEncoder&
+operator<< (UncheckedEncoder& out, MembershipUpdate const& update) noexcept {
+	out << static_cast<uint8>(update.kind)
+		<< update.node
+		<< update.address;
+
+	if (update.kind == MembershipUpdate::Kind::Suspect) {
+		out << update.suspecter;
+	}
+
+	return out;
+}
+
+
 }  // namespace tribe
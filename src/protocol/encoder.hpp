@@ -18,8 +18,12 @@
 #define TRIBE_PROTOCOL_ENCODER_HPP
 
 #include "tribe/protocol/gossip.hpp"
+#include "tribe/protocol/messageSchema.hpp"
 
 #include <solace/byteWriter.hpp>
+#include <solace/arrayView.hpp>
+
+#include <cstring>
 
 
 namespace tribe {
@@ -52,6 +56,121 @@ Encoder& operator<< (Encoder& encoder, Solace::MemoryView str);
 Encoder& operator<< (Encoder& encoder, NodeID id);
 Encoder& operator<< (Encoder& encoder, Address const& addr);
 Encoder& operator<< (Encoder& encoder, NodeInfo const& node);
+Encoder& operator<< (Encoder& encoder, ErrorView const& error);
+Encoder& operator<< (Encoder& encoder, SnapshotChunk const& chunk);
+Encoder& operator<< (Encoder& encoder, PiggybackView const& updates);
+Encoder& operator<< (Encoder& encoder, MembershipUpdate const& update);
+
+/// Encode an integer as LEB128 varint
+Encoder& writeVarint(Encoder& encoder, Solace::uint64 value);
+
+/**
+ * Encode an update of a list compactly, if it fits into a given number of bytes.
+ * Node ID is delta-encoded against the ID of the previous update and the address is encoded as a reference
+ * to an address of one of the preceding updates, when they share a prefix.
+ * @return Size of the encoded update in bytes, or 0 if it does not fit and nothing has been written.
+ */
+Gossip::size_type writeCompact(Encoder& encoder, Solace::ArrayView<MembershipUpdate const> updates,
+							   Solace::uint32 index, std::size_t budget);
+
+/// Get exact size in bytes of an update of a list once it is compactly encoded. @see writeCompact
+Gossip::size_type compactEncodedSize(Solace::ArrayView<MembershipUpdate const> updates, Solace::uint32 index) noexcept;
+
+
+/**
+ * Encoder that writes into a buffer without checking its bounds.
+ * Only to be used once the buffer has been checked to have room for the whole of encoded message.
+ */
+struct UncheckedEncoder {
+
+	constexpr explicit UncheckedEncoder(Solace::byte* dest) noexcept
+		: _dest{dest}
+	{}
+
+	UncheckedEncoder(UncheckedEncoder const&) = delete;
+	UncheckedEncoder& operator= (UncheckedEncoder const&) = delete;
+
+	/// Store an integer in little-endian byte order
+	template<typename T>
+	UncheckedEncoder& writeLE(T value) noexcept {
+		// Note: bytes are stored via a local pointer, as a store of a byte may alias _dest and force its reload
+		auto dest = _dest;
+		for (std::size_t i = 0; i < sizeof(T); ++i) {
+			dest[i] = static_cast<Solace::byte>(value >> (8 * i));
+		}
+		_dest = dest + sizeof(T);
+
+		return *this;
+	}
+
+	UncheckedEncoder& write(Solace::byte const* data, std::size_t size) noexcept {
+		if (size) {
+			std::memcpy(_dest, data, size);
+			_dest += size;
+		}
+
+		return *this;
+	}
+
+	/// Get the location of the next byte to be written
+	constexpr Solace::byte* dest() const noexcept { return _dest; }
+
+private:
+
+	Solace::byte* _dest;
+};
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::uint8 value) { return encoder.writeLE(value); }
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::uint16 value) { return encoder.writeLE(value); }
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::uint32 value) { return encoder.writeLE(value); }
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::uint64 value) { return encoder.writeLE(value); }
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::StringView data) {
+	encoder << static_cast<Gossip::size_type>(data.size());
+	return encoder.write(reinterpret_cast<Solace::byte const*>(data.data()), data.size());
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Solace::MemoryView data) {
+	encoder << static_cast<Gossip::size_type>(data.size());
+	return encoder.write(data.data(), data.size());
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, NodeID id) {
+	return encoder << id.value;
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, NodeInfo const& node) {
+	return encoder << node.id << node.gen;
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, ErrorView const& error) {
+	return encoder << error.domain << error.code << error.tag;
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, SnapshotChunk const& chunk) {
+	return encoder << chunk.snapshot << chunk.index << chunk.count;
+}
+
+inline UncheckedEncoder& operator<< (UncheckedEncoder& encoder, PiggybackView const& updates) {
+	encoder << updates.count;
+	return encoder.write(updates.data.data(), updates.data.size());
+}
+
+UncheckedEncoder& operator<< (UncheckedEncoder& encoder, Address const& addr) noexcept;
+UncheckedEncoder& operator<< (UncheckedEncoder& encoder, MembershipUpdate const& update) noexcept;
+
+
+/// Encode a message, including message header, as described by its schema
+template<typename Output, typename MessageType>
+Output& writeMessage(Output& encoder, MessageType const& msg) {
+	encoder << static_cast<Solace::byte>(messageTypeOf(msg));
+
+	std::apply([&](auto... fields) {
+		(encoder << ... << (msg.*fields));
+	}, MessageSchema<MessageType>::fields);
+
+	return encoder;
+}
 
 
 }  // namespace tribe
@@ -24,133 +24,183 @@ using namespace Solace;
 
 namespace /* anonymous */ {
 
-
-Result<Message, MessageParser::Error>
-parseJoinRequest(ByteReader& reader) {
-	ConnectRequest msg;
-
+/// Decode message payload as described by the message schema
+template<typename MessageType>
+Result<void, MessageParser::Error>
+readPayload(ByteReader& reader, MessageType* msg) {
 	Decoder decoder{reader};
-	auto result = decoder.read(&msg.nodeInfo)
-			.then([&](){ return decoder.read(&msg.token); })
-			.then([&](){ return decoder.read(&msg.auth);  });
-
-	if (!result) {
+	if (!decoder.readPayload(msg)) {
 		return Err(MessageParser::Error{});
 	}
 
-	return Ok(std::move(msg));
+	return Ok();
+}
+
+}  // anonymous namespace
+
+
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, ConnectRequest* msg) {
+	return readPayload(reader, msg);
 }
 
 
-Result<Message, MessageParser::Error>
-parseJoinAck(ByteReader& reader) {
-	ConnectResponseAck msg;
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, ConnectResponseAck* msg) {
+	return readPayload(reader, msg);
+}
 
+
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, ConnectResponseRedirectView* msg) {
 	Decoder decoder{reader};
-	auto result = decoder.read(&msg.self);
-  // .then([&](){ return decoder.read(&msg.snapshot);  });
+	auto result = decoder.readAddressView(&msg->otherNode)
+			.then([&](){ return decoder.read(&msg->reason);	});
 
 	if (!result) {
 		return Err(MessageParser::Error{});
 	}
 
-	return Ok(std::move(msg));
+	return Ok();
 }
 
-Result<Message, MessageParser::Error>
-parseJoinRedirect(ByteReader& reader) {
 
-	Address otherNode;
-	uint64 reasonDomain{};
-	uint64 reasonCode{};
-	StringView reasonMessage{};
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, ConnectResponseRejectedView* msg) {
+	return readPayload(reader, msg);
+}
 
-	Decoder decoder{reader};
-	auto result = decoder.read(&otherNode)
-			.then([&](){ return decoder.read(&reasonDomain);	})
-			.then([&](){ return decoder.read(&reasonCode);		})
-			.then([&](){ return decoder.read(&reasonMessage);	});
 
-	if (!result) {
-		return Err(MessageParser::Error{});
-	}
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, BroadcastMessage* msg) {
+	return readPayload(reader, msg);
+}
 
-	ConnectResponseRedirect msg {
-				std::move(otherNode),
-				Error(static_cast<AtomValue>(reasonDomain), reasonCode, StringLiteral{})
-	};
 
-	return Ok(std::move(msg));
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, PingMessage* msg) {
+	return readPayload(reader, msg);
 }
 
 
-Result<Message, MessageParser::Error>
-parseConnectRejected(ByteReader& reader) {
-	uint64 reasonDomain{};
-	uint64 reasonCode{};
-	StringView reasonMessage{};
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, PongMessage* msg) {
+	return readPayload(reader, msg);
+}
 
-	Decoder decoder{reader};
-	auto result = decoder.read(&reasonDomain)
-						.then([&](){ return decoder.read(&reasonCode);		})
-						.then([&](){ return decoder.read(&reasonMessage);	});
 
+Result<void, MessageParser::Error>
+MessageParser::parsePayload(ByteReader& reader, SyncMessage* msg) {
+	return readPayload(reader, msg);
+}
+
+
+namespace /* anonymous */ {
+
+/// Parse payload of a message of a given type into a message view
+template<typename MessageType>
+Result<MessageView, MessageParser::Error>
+parseMessage(ByteReader& reader) {
+	MessageType msg{};
+	auto result = MessageParser::parsePayload(reader, &msg);
 	if (!result) {
-		return Err(MessageParser::Error{});
+		return Err(result.moveError());
 	}
 
-	ConnectResponseRejected msg {
-				Error(static_cast<AtomValue>(reasonDomain), reasonCode, StringLiteral{})
-	};
+	return Ok(msg);
+}
+
+
+/// Parse payload of a ping or pong with compactly encoded updates
+template<typename MessageType>
+Result<MessageView, MessageParser::Error>
+parseCompactMessage(ByteReader& reader) {
+	MessageType msg{};
+	msg.updates.encoding = UpdateEncoding::Compact;
+	auto result = MessageParser::parsePayload(reader, &msg);
+	if (!result) {
+		return Err(result.moveError());
+	}
 
-	return Ok(std::move(msg));
+	return Ok(msg);
 }
-Result<Message, MessageParser::Error>
-parseBroadcastMessage(ByteReader& reader) {
-	Decoder decoder{reader};
-	BroadcastMessage msg;
 
-	auto result = decoder.read(&msg.node);
 
-	if (result) {
-		return Ok(std::move(msg));
+/// Parse payload of a sync reply, that has the same layout as sync push
+Result<MessageView, MessageParser::Error>
+parseSyncReply(ByteReader& reader) {
+	SyncMessage msg{};
+	msg.isReply = true;
+	auto result = MessageParser::parsePayload(reader, &msg);
+	if (!result) {
+		return Err(result.moveError());
 	}
 
-	return Err(MessageParser::Error{});
+	return Ok(msg);
 }
 
 
-Result<Message, MessageParser::Error>
-parsePingMessage(ByteReader& reader) {
-	PingMessage msg;
+using ParseFunction = Result<MessageView, MessageParser::Error> (*)(ByteReader& reader);
 
-	Decoder decoder{reader};
-	auto result = decoder.read(&msg.origin)
-						 .then([&](){ return decoder.read(&msg.target); })
-						 .then([&](){ return decoder.read(&msg.ttl); });
+/// Get parser of the payload of a given message type
+ParseFunction
+payloadParser(Gossip::MessageType type) noexcept {
+	switch (type) {
+	case Gossip::MessageType::JoinReq:			return parseMessage<ConnectRequest>;
+	case Gossip::MessageType::JoinAck:			return parseMessage<ConnectResponseAck>;
+	case Gossip::MessageType::JoinRedirect:		return parseMessage<ConnectResponseRedirectView>;
+	case Gossip::MessageType::JoinNak:			return parseMessage<ConnectResponseRejectedView>;
 
-	if (!result) {
-		return Err(MessageParser::Error{});
+	case Gossip::MessageType::PingDirect:		return parseMessage<PingMessage>;
+	case Gossip::MessageType::PongDirect:		return parseMessage<PongMessage>;
+	case Gossip::MessageType::PingCompact:		return parseCompactMessage<PingMessage>;
+	case Gossip::MessageType::PongCompact:		return parseCompactMessage<PongMessage>;
+
+	case Gossip::MessageType::SyncPush:			return parseMessage<SyncMessage>;
+	case Gossip::MessageType::SyncReply:		return parseSyncReply;
+
+	case Gossip::MessageType::Broadcast:		return parseMessage<BroadcastMessage>;
 	}
 
-	return Ok(std::move(msg));
+	return nullptr;
 }
 
-Result<Message, MessageParser::Error>
-parsePongMessage(ByteReader& reader) {
-	PongMessage msg;
 
-	Decoder decoder{reader};
-	auto result = decoder.read(&msg.origin)
-						 .then([&](){ return decoder.read(&msg.nodeDetails); })
-						 .then([&](){ return decoder.read(&msg.ttl); });
-	if (!result) {
-		return Err(MessageParser::Error{});
-	}
+Gossip::MessageType
+datagramType(MemoryView datagram) noexcept {
+	return static_cast<Gossip::MessageType>(datagram[0]);
+}
 
-	return Ok(std::move(msg));
+
+Error
+toError(ErrorView const& reason) {
+	return Error(static_cast<AtomValue>(reason.domain), reason.code, StringLiteral{});
 }
 
+
+/// Turn a message view into a message that owns its data
+struct MessageMaterializer {
+	MessageParser const& parser;
+
+	Result<Message, MessageParser::Error> operator() (ConnectResponseRedirectView const& msg) const {
+		auto maybeAddress = parser.parseAddress(msg.otherNode);
+		if (!maybeAddress) {
+			return Err(maybeAddress.moveError());
+		}
+
+		return Ok(Message{ConnectResponseRedirect{maybeAddress.moveResult(), toError(msg.reason)}});
+	}
+
+	Result<Message, MessageParser::Error> operator() (ConnectResponseRejectedView const& msg) const {
+		return Ok(Message{ConnectResponseRejected{toError(msg.reason)}});
+	}
+
+	template<typename T>
+	Result<Message, MessageParser::Error> operator() (T const& msg) const {
+		return Ok(Message{msg});
+	}
+};
+
 }  // anonymous namespace
 
 
@@ -195,25 +245,104 @@ MessageParser::parseMessageHeader(ByteReader& buffer) const {
 }
 
 
-Result<Message, MessageParser::Error>
-MessageParser::parse(ByteReader& reader) const {
+Result<MessageView, MessageParser::Error>
+MessageParser::parseView(ByteReader& reader) const {
 	auto maybeHeader = parseMessageHeader(reader);
 	if (!maybeHeader) {
 		return Err(maybeHeader.moveError());
 	}
 
-	auto& header = maybeHeader.unwrap();
-	switch (header.type) {
-	case Gossip::MessageType::JoinReq:			return parseJoinRequest(reader);
-	case Gossip::MessageType::JoinAck:			return parseJoinAck(reader);
-	case Gossip::MessageType::JoinRedirect:		return parseJoinRedirect(reader);
-	case Gossip::MessageType::JoinNak:			return parseConnectRejected(reader);
+	auto const parsePayload = payloadParser(maybeHeader.unwrap().type);
+	if (!parsePayload) {
+		return Err(MessageParser::Error{});
+	}
+
+	return parsePayload(reader);
+}
+
+
+Result<MessageParser::BatchResult, MessageParser::Error>
+MessageParser::parseBatch(ArrayView<MemoryView const> datagrams,
+						  ArrayView<Address const> sources,
+						  ArrayView<ParsedDatagram> messages,
+						  ArrayView<uint32> failed) const {
+	if ((!sources.empty() && sources.size() != datagrams.size()) ||
+		messages.size() < datagrams.size() ||
+		failed.size() < datagrams.size()) {
+		return Err(MessageParser::Error{});
+	}
+
+	BatchResult result{0, 0};
+
+	// Datagrams are parsed in the order they have been received, picking the parser of each from the dispatch table
+	for (uint32 i = 0; i < datagrams.size(); ++i) {
+		auto const& datagram = datagrams[i];
+		auto const parsePayload = (datagram.size() < Gossip::headerSize())
+				? nullptr
+				: payloadParser(datagramType(datagram));
+		if (!parsePayload) {  // Too short to carry a header or of unknown type
+			failed[result.failed++] = i;
+			continue;
+		}
+
+		ByteReader reader{datagram};
+		reader.advance(Gossip::headerSize());
+
+		auto maybeMessage = parsePayload(reader);
+		if (maybeMessage) {
+			messages[result.parsed++] = ParsedDatagram{maybeMessage.moveResult(),
+													   i,
+													   sources.empty() ? nullptr : &sources[i]};
+		} else {
+			failed[result.failed++] = i;
+		}
+	}
+
+	return Ok(result);
+}
+
+
+Result<Message, MessageParser::Error>
+MessageParser::parse(ByteReader& reader) const {
+	auto maybeView = parseView(reader);
+	if (!maybeView) {
+		return Err(maybeView.moveError());
+	}
+
+	return std::visit(MessageMaterializer{*this}, maybeView.unwrap());
+}
 
-	case Gossip::MessageType::PingDirect:		return parsePingMessage(reader);
-	case Gossip::MessageType::PongDirect:		return parsePongMessage(reader);
 
-	case Gossip::MessageType::Broadcast:		return parseBroadcastMessage(reader);
+Result<uint32, MessageParser::Error>
+MessageParser::parseUpdates(PiggybackView updates, ArrayView<MembershipUpdate> dest) const {
+	if (dest.size() < updates.count) {
+		return Err(MessageParser::Error{});
+	}
+
+	ByteReader reader{updates.data};
+	Decoder decoder{reader};
+	for (uint32 i = 0; i < updates.count; ++i) {
+		auto result = (updates.encoding == UpdateEncoding::Compact)
+				? decoder.readCompact(dest, i)
+				: decoder.read(&dest[i]);
+		if (!result) {
+			return Err(MessageParser::Error{});
+		}
+	}
+
+	return Ok(static_cast<uint32>(updates.count));
+}
+
+
+Result<Address, MessageParser::Error>
+MessageParser::parseAddress(MemoryView encoded) const {
+	Address address;
+
+	ByteReader reader{encoded};
+	Decoder decoder{reader};
+	if (!decoder.read(&address)) {
+		return Err(MessageParser::Error{});
 	}
 
-	return Err(MessageParser::Error{});
+	return Ok(address);
 }
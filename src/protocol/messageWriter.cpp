@@ -17,6 +17,9 @@
 
 #include "encoder.hpp"
 
+#include <limits>
+#include <utility>
+
 
 using namespace tribe;
 using namespace Solace;
@@ -36,32 +39,139 @@ writeHeader(Encoder& encoder, Gossip::MessageType messageType) {
 	return encoder << static_cast<byte>(messageType);
 }
 
+ErrorView
+errorView(Error const& reason) {
+	return ErrorView{static_cast<uint64>(reason.domain()), static_cast<uint64>(reason.value()), reason.tag()};
+}
+
+
+std::size_t
+MessageWriter::sizeOf(ConnectResponseRedirect const& msg) noexcept {
+	return Gossip::headerSize() + encodedSize(msg.otherNode) + encodedSize(errorView(msg.reason));
+}
+
+
+std::size_t
+MessageWriter::sizeOf(ConnectResponseRejected const& msg) noexcept {
+	return sizeOf(ConnectResponseRejectedView{errorView(msg.reason)});
+}
+
+
+template<typename MessageType>
 MessageWriter&
-MessageWriter::join(NodeInfo const& self) {
-	return join(self, MemoryView{}, MemoryView{});
+MessageWriter::write(MessageType const& msg) {
+	auto const size = sizeOf(msg);
+	if (size > std::numeric_limits<Gossip::size_type>::max() || _writer.remaining() < size) {
+		// Not enough room or a field is too large for its size prefix: let the writer handle overflow
+		Encoder encode{_writer};
+		writeMessage(encode, msg);
+
+		return (*this);
+	}
+
+	UncheckedEncoder encode{_writer.viewRemaining().dataAs<byte>()};
+	writeMessage(encode, msg);
+	_writer.advance(size);
+
+	return (*this);
 }
 
 
+template<typename MessageType>
 MessageWriter&
-MessageWriter::join(NodeInfo const& self, MemoryView token, MemoryView auth) {
-	Encoder encode(_writer);
+MessageWriter::writeWithUpdates(MessageType&& msg, PiggybackView MessageType::* field,
+								ArrayView<MembershipUpdate const> updates,
+								UpdateEncoding encoding) {
+	auto const messageSize = sizeOf(msg);
+	auto const budget = (_writer.remaining() > messageSize)
+			? _writer.remaining() - messageSize
+			: std::size_t{0};
+
+	// Updates are appended right after the message, that ends with the piggybacked updates count
+	if (encoding == UpdateEncoding::Fixed) {
+		auto const count = piggybackCapacity(updates, budget, encoding);
+		msg.*field = PiggybackView{static_cast<uint8>(count), MemoryView{}, encoding};
+		write(msg);
+
+		// The remaining space has been checked to have room for the updates as well
+		auto const dest = _writer.viewRemaining().dataAs<byte>();
+		UncheckedEncoder encode{dest};
+		for (uint32 i = 0; i < count; ++i) {
+			encode << updates[i];
+		}
+		_writer.advance(static_cast<ByteWriter::size_type>(encode.dest() - dest));
+
+		return (*this);
+	}
+
+	// Compact updates are sized as they are written, so that the reference for each address is only looked up once.
+	// The count is filled in once the updates are written.
+	auto const message = _writer.viewRemaining().dataAs<byte>();
+	msg.*field = PiggybackView{0, MemoryView{}, encoding};
+	write(msg);
 
-	writeHeader(encode, Gossip::MessageType::JoinReq)
-			<< self
-			<< token
-			<< auth;
+	Encoder encode{_writer};
+	uint32 count = 0;
+	auto remaining = budget;
+	while (count < updates.size() && count < std::numeric_limits<uint8>::max()) {
+		auto const updateSize = writeCompact(encode, updates, count, remaining);
+		if (updateSize == 0) {
+			break;
+		}
+
+		remaining -= updateSize;
+		count += 1;
+	}
+
+	if (count) {
+		message[messageSize - 1] = static_cast<byte>(count);
+	}
 
 	return (*this);
 }
 
+
+uint32
+MessageWriter::piggybackCapacity(ArrayView<MembershipUpdate const> updates, std::size_t budget,
+								 UpdateEncoding encoding) noexcept {
+	uint32 count = 0;
+	for (auto const& update : updates) {
+		auto const updateSize = (encoding == UpdateEncoding::Compact)
+				? compactEncodedSize(updates, count)
+				: encodedSize(update);
+		if (count == std::numeric_limits<uint8>::max() || updateSize > budget) {
+			break;
+		}
+
+		budget -= updateSize;
+		count += 1;
+	}
+
+	return count;
+}
+
+
+MessageWriter&
+MessageWriter::join(NodeInfo const& self) {
+	return join(self, MemoryView{}, MemoryView{});
+}
+
+
+MessageWriter&
+MessageWriter::join(NodeInfo const& self, MemoryView token, MemoryView auth) {
+	return write(ConnectRequest{self, token, auth});
+}
+
 MessageWriter&
 MessageWriter::joinAck(NodeInfo const& self) {
-	Encoder encode(_writer);
+	return write(ConnectResponseAck{self});
+}
 
-	writeHeader(encode, Gossip::MessageType::JoinAck)
-			<< self;
 
-	return (*this);
+MessageWriter&
+MessageWriter::joinAck(NodeInfo const& self, ArrayView<MembershipUpdate const> members) {
+	return writeWithUpdates(ConnectResponseAck{self}, &ConnectResponseAck::members, members,
+							UpdateEncoding::Compact);
 }
 
 
@@ -71,53 +181,80 @@ MessageWriter::joinRedirect(Error reason, Address const& redirectAddress) {
 
 	writeHeader(encode, Gossip::MessageType::JoinRedirect)
 			<< redirectAddress
-			<< static_cast<uint64>(reason.domain())
-			<< static_cast<uint64>(reason.value())
-			<< reason.tag();
+			<< errorView(reason);
 
 	return (*this);
 }
 
 MessageWriter&
 MessageWriter::joinNack(Error reason) {
-	Encoder encode(_writer);
+	return write(ConnectResponseRejectedView{errorView(reason)});
+}
 
-	writeHeader(encode, Gossip::MessageType::JoinNak)
-			<< static_cast<uint64>(reason.domain())
-			<< static_cast<uint64>(reason.value())
-			<< reason.tag();
 
-	return (*this);
+MessageWriter&
+MessageWriter::advertise(NodeInfo const& node) {
+	return write(BroadcastMessage{node});
 }
 
 
 MessageWriter&
-MessageWriter::advertise(NodeInfo const& node) {
-	Encoder encode(_writer);
+MessageWriter::ping(NodeID requestorId, NodeID targetId) {
+	return ping(requestorId, targetId, 0);
+}
 
-	writeHeader(encode, Gossip::MessageType::Broadcast)
-			<< node;
+MessageWriter&
+MessageWriter::ping(NodeID requestorId, NodeID targetId, uint8 ttl) {
+	return write(PingMessage{requestorId, targetId, ttl, PiggybackView{}});
+}
 
-	return (*this);
+MessageWriter&
+MessageWriter::pong(NodeID requestorId, const NodeInfo& targetInfo) {
+	return pong(requestorId, targetInfo, 0);
+}
+
+MessageWriter&
+MessageWriter::pong(NodeID requestorId, const NodeInfo& targetInfo, uint8 ttl) {
+	return write(PongMessage{requestorId, targetInfo, ttl, PiggybackView{}});
 }
 
 
 MessageWriter&
-MessageWriter::ping(NodeID requestorId, NodeID targetId) {
-	Encoder encode{_writer};
-	writeHeader(encode, Gossip::MessageType::PingDirect)
-			<< requestorId
-			<< targetId;
+MessageWriter::ping(NodeID requestorId, NodeID targetId, ArrayView<MembershipUpdate const> updates,
+					UpdateEncoding encoding) {
+	return ping(requestorId, targetId, 0, updates, encoding);
+}
 
-	return (*this);
+MessageWriter&
+MessageWriter::ping(NodeID requestorId, NodeID targetId, uint8 ttl, ArrayView<MembershipUpdate const> updates,
+					UpdateEncoding encoding) {
+	return writeWithUpdates(PingMessage{requestorId, targetId, ttl, PiggybackView{}}, &PingMessage::updates,
+							updates, encoding);
 }
 
 MessageWriter&
-MessageWriter::pong(NodeID requestorId, const NodeInfo& targetInfo) {
-	Encoder encode{_writer};
-	writeHeader(encode, Gossip::MessageType::PongDirect)
-			<< requestorId
-			<< targetInfo;
+MessageWriter::pong(NodeID requestorId, const NodeInfo& targetInfo, ArrayView<MembershipUpdate const> updates,
+					UpdateEncoding encoding) {
+	return pong(requestorId, targetInfo, 0, updates, encoding);
+}
 
-	return (*this);
+MessageWriter&
+MessageWriter::pong(NodeID requestorId, const NodeInfo& targetInfo, uint8 ttl,
+					ArrayView<MembershipUpdate const> updates, UpdateEncoding encoding) {
+	return writeWithUpdates(PongMessage{requestorId, targetInfo, ttl, PiggybackView{}}, &PongMessage::updates,
+							updates, encoding);
+}
+
+
+MessageWriter&
+MessageWriter::syncPush(NodeInfo const& self, SnapshotChunk chunk, ArrayView<MembershipUpdate const> members) {
+	return writeWithUpdates(SyncMessage{self, chunk}, &SyncMessage::members, members, UpdateEncoding::Compact);
+}
+
+MessageWriter&
+MessageWriter::syncReply(NodeInfo const& self, SnapshotChunk chunk, ArrayView<MembershipUpdate const> members) {
+	auto msg = SyncMessage{self, chunk};
+	msg.isReply = true;
+
+	return writeWithUpdates(std::move(msg), &SyncMessage::members, members, UpdateEncoding::Compact);
 }
@@ -0,0 +1,196 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_decayScheduler.cpp
+ *	@brief		Test suit for tribe::DecayScheduler
+ ******************************************************************************/
+#include "tribe/decayScheduler.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+using namespace tribe;
+
+
+namespace {
+
+constexpr Solace::uint32 kDecayTimeMs = 1000;
+constexpr Solace::float32 kDecayRate = 0.05f;
+
+
+PeersModel makeModel(Solace::uint32 nPeers, Solace::uint32 seed) {
+	std::mt19937 gen{seed};
+	std::uniform_int_distribution<Solace::uint16> ttl{0, 40};
+	std::uniform_int_distribution<int> dead{0, 9};
+
+	auto model = update(PeersModel{}, AddSeed{anyAddress(7), 5});
+	for (Solace::uint32 i = 1; i <= nPeers; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<Solace::uint16>(i)), {{i}, 0}, ttl(gen)});
+		if (dead(gen) == 0) {
+			model = update(std::move(model), PronouncePeerDead{{{i}, 0}});
+		}
+	}
+
+	return model;
+}
+
+}  // namespace
+
+
+TEST(DecayScheduler, tracksPeers) {
+	auto model = makeModel(10, 1);
+
+	DecayScheduler scheduler{kDecayTimeMs, kDecayRate};
+	scheduler.track(model);
+	EXPECT_EQ(model.members.size(), scheduler.size());
+
+	scheduler.forget({1});
+	EXPECT_EQ(model.members.size() - 1, scheduler.size());
+}
+
+
+TEST(DecayScheduler, matchesDecaySweep) {
+	auto sweepModel = makeModel(200, 42);
+	auto wheelModel = sweepModel;
+
+	DecayScheduler scheduler{kDecayTimeMs, kDecayRate};
+	scheduler.track(wheelModel);
+
+	for (int tick = 0; tick < 100; ++tick) {
+		sweepModel = update(std::move(sweepModel), DecayPeerInfo{1, kDecayTimeMs, kDecayRate});
+		wheelModel = scheduler.tick(std::move(wheelModel));
+
+		ASSERT_EQ(sweepModel.members.size(), wheelModel.members.size()) << "tick " << tick;
+		ASSERT_EQ(sweepModel.seeds.size(), wheelModel.seeds.size()) << "tick " << tick;
+		ASSERT_EQ(sweepModel.suspected.size(), wheelModel.suspected.size()) << "tick " << tick;
+		ASSERT_EQ(sweepModel.dead.size(), wheelModel.dead.size()) << "tick " << tick;
+		for (auto const& entry : sweepModel.members) {
+			auto it = wheelModel.members.find(entry.first);
+			ASSERT_NE(wheelModel.members.end(), it);
+			ASSERT_EQ(sweepModel.liveness(entry.second).state, wheelModel.liveness(it->second).state) << "tick " << tick;
+			ASSERT_EQ(sweepModel.isHealthy(entry.second), wheelModel.isHealthy(it->second)) << "tick " << tick;
+		}
+
+		if (tick % 10 == 0) {
+			wheelModel = scheduler.sync(std::move(wheelModel));
+			for (auto const& entry : sweepModel.members) {
+				auto const expected = sweepModel.liveness(entry.second);
+				auto const liveness = wheelModel.liveness(wheelModel.members.find(entry.first)->second);
+				EXPECT_EQ(expected.ttl, liveness.ttl);
+				EXPECT_FLOAT_EQ(expected.probabitily, liveness.probabitily);
+			}
+		}
+	}
+
+	EXPECT_TRUE(wheelModel.members.empty());
+	EXPECT_EQ(0, scheduler.size());
+}
+
+
+TEST(DecayScheduler, retrackRefreshedPeer) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(1), {{1}, 0}, 3});
+
+	DecayScheduler scheduler{kDecayTimeMs, kDecayRate};
+	scheduler.track(model);
+
+	model = scheduler.tick(std::move(model));
+	model = scheduler.tick(std::move(model));
+
+	// Refresh the peer: its previous timer must be ignored
+	model = update(std::move(model), UpdatePeerGeneration{{1}, 1, 5});
+	scheduler.track({1}, model.liveness(model.members.find({1})->second));
+
+	for (int i = 0; i < 4; ++i) {
+		model = scheduler.tick(std::move(model));
+		EXPECT_TRUE(model.isHealthy(model.members.find({1})->second));
+	}
+
+	model = scheduler.tick(std::move(model));
+	EXPECT_FALSE(model.isHealthy(model.members.find({1})->second));
+}
+
+
+TEST(DecayScheduler, consecutiveSyncsDecayOnce) {
+	auto sweepModel = makeModel(64, 7);
+	auto wheelModel = sweepModel;
+
+	DecayScheduler scheduler{kDecayTimeMs, kDecayRate};
+	scheduler.track(wheelModel);
+
+	for (int tick = 0; tick < 40; ++tick) {
+		sweepModel = update(std::move(sweepModel), DecayPeerInfo{1, kDecayTimeMs, kDecayRate});
+		wheelModel = scheduler.tick(std::move(wheelModel));
+		if (tick % 3 != 0) {
+			continue;
+		}
+
+		// Syncing a model already in sync changes nothing
+		wheelModel = scheduler.sync(std::move(wheelModel));
+		wheelModel = scheduler.sync(std::move(wheelModel));
+
+		ASSERT_EQ(sweepModel.members.size(), wheelModel.members.size()) << "tick " << tick;
+		for (auto const& entry : sweepModel.members) {
+			auto const expected = sweepModel.liveness(entry.second);
+			auto const liveness = wheelModel.liveness(wheelModel.members.find(entry.first)->second);
+			ASSERT_EQ(expected.state, liveness.state) << "tick " << tick;
+			ASSERT_EQ(expected.ttl, liveness.ttl) << "tick " << tick;
+			ASSERT_NEAR(expected.probabitily, liveness.probabitily, 1e-5f) << "tick " << tick;
+		}
+	}
+}
+
+
+TEST(DecayScheduler, advanceIsStretchedByLocalHealth) {
+	auto settings = MembershipSettings{};
+	settings.peerInfoDecayTimeMs = kDecayTimeMs;
+	settings.peerInfoDecayRate = kDecayRate;
+
+	auto sweepModel = makeModel(64, 3);
+	auto wheelModel = sweepModel;
+
+	DecayScheduler scheduler{settings};
+	scheduler.track(wheelModel);
+
+	// Both clocks run 3 times slower than the ticks elapsed
+	LocalHealth sweepHealth{8};
+	LocalHealth wheelHealth{8};
+	for (int i = 0; i < 2; ++i) {
+		sweepHealth.onProbeFailure();
+		wheelHealth.onRefutedSuspicion();
+	}
+	ASSERT_EQ(3, wheelHealth.multiplier());
+
+	for (int tick = 0; tick < 90; ++tick) {
+		auto decay = sweepHealth.decay(settings, 1);
+		if (decay) {
+			sweepModel = update(std::move(sweepModel), *decay);
+		}
+		wheelModel = scheduler.advance(std::move(wheelModel), wheelHealth, 1);
+
+		ASSERT_EQ(sweepModel.now, wheelModel.now) << "tick " << tick;
+		ASSERT_EQ(sweepModel.members.size(), wheelModel.members.size()) << "tick " << tick;
+		for (auto const& entry : sweepModel.members) {
+			auto it = wheelModel.members.find(entry.first);
+			ASSERT_NE(wheelModel.members.end(), it);
+			ASSERT_EQ(sweepModel.liveness(entry.second).state, wheelModel.liveness(it->second).state) << "tick " << tick;
+		}
+	}
+
+	EXPECT_EQ(30, wheelModel.now);
+}
@@ -0,0 +1,337 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_disseminationQueue.cpp
+ *	@brief		Test suit for tribe::DisseminationQueue
+ ******************************************************************************/
+#include "tribe/disseminationQueue.hpp"    // Class being tested.
+#include "tribe/protocol/messageSchema.hpp"
+#include "tribe/protocol/messageWriter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+MembershipUpdate makeUpdate(uint32 id, uint32 gen, MembershipUpdate::Kind kind = MembershipUpdate::Kind::Alive) {
+	return {kind, {{id}, gen}, anyAddress(static_cast<uint16>(id))};
+}
+
+/// Budget large enough for any number of updates
+constexpr Gossip::size_type kLargeBudget = 4096;
+
+}  // namespace
+
+
+TEST(TestDisseminationQueue, retransmitLimit) {
+	DisseminationQueue queue{3};
+
+	EXPECT_EQ(1, queue.retransmitLimit(0));
+	EXPECT_EQ(3, queue.retransmitLimit(9));
+	EXPECT_EQ(6, queue.retransmitLimit(99));
+	EXPECT_EQ(9, queue.retransmitLimit(999));
+}
+
+
+TEST(TestDisseminationQueue, updatesAreDroppedOnceSentEnough) {
+	DisseminationQueue queue{3};
+	queue.enqueue(makeUpdate(1, 0));
+
+	MembershipUpdate picked[4];
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(1, queue.fill(kLargeBudget, 9, arrayView(picked)));
+		EXPECT_EQ(1, picked[0].node.id.value);
+	}
+
+	EXPECT_TRUE(queue.empty());
+	EXPECT_EQ(0, queue.fill(kLargeBudget, 9, arrayView(picked)));
+}
+
+
+TEST(TestDisseminationQueue, leastSentFirst) {
+	DisseminationQueue queue;
+	queue.enqueue(makeUpdate(1, 0));
+	queue.enqueue(makeUpdate(2, 0));
+
+	MembershipUpdate picked[1];
+	// Newest first among updates sent equal number of times
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	EXPECT_EQ(2, picked[0].node.id.value);
+
+	queue.enqueue(makeUpdate(3, 0));
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	EXPECT_EQ(3, picked[0].node.id.value);
+
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	EXPECT_EQ(1, picked[0].node.id.value);
+}
+
+
+TEST(TestDisseminationQueue, updateIsPickedOncePerMessage) {
+	DisseminationQueue queue;
+	queue.enqueue(makeUpdate(1, 0));
+	queue.enqueue(makeUpdate(2, 0));
+
+	MembershipUpdate picked[8];
+	ASSERT_EQ(2, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	EXPECT_NE(picked[0].node.id.value, picked[1].node.id.value);
+	EXPECT_EQ(2, queue.size());
+}
+
+
+TEST(TestDisseminationQueue, newerUpdateInvalidatesOlder) {
+	DisseminationQueue queue;
+	queue.enqueue(makeUpdate(1, 3));
+	queue.enqueue(makeUpdate(2, 0));
+
+	MembershipUpdate picked[2];
+	ASSERT_EQ(2, queue.fill(kLargeBudget, 100, arrayView(picked)));
+
+	// Update about an older generation is ignored
+	EXPECT_FALSE(queue.enqueue(makeUpdate(1, 2, MembershipUpdate::Kind::Dead)));
+
+	// Update replaces the pending one and is transmitted afresh
+	EXPECT_TRUE(queue.enqueue(makeUpdate(1, 3, MembershipUpdate::Kind::Suspect)));
+	EXPECT_EQ(2, queue.size());
+
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 100, arrayView(picked, 1)));
+	EXPECT_EQ(1, picked[0].node.id.value);
+	EXPECT_EQ(MembershipUpdate::Kind::Suspect, picked[0].kind);
+}
+
+
+TEST(TestDisseminationQueue, sameGenerationUpdatesTakePrecedence) {
+	DisseminationQueue queue;
+	queue.enqueue(makeUpdate(1, 3, MembershipUpdate::Kind::Suspect));
+	queue.enqueue(makeUpdate(2, 3, MembershipUpdate::Kind::Dead));
+
+	// Alive does not override Suspect, nor does anything override Dead, of the same generation
+	EXPECT_FALSE(queue.enqueue(makeUpdate(1, 3, MembershipUpdate::Kind::Alive)));
+	EXPECT_FALSE(queue.enqueue(makeUpdate(2, 3, MembershipUpdate::Kind::Alive)));
+	EXPECT_FALSE(queue.enqueue(makeUpdate(2, 3, MembershipUpdate::Kind::Suspect)));
+
+	// Suspect is overridden by Dead of the same generation, and both by any update of a later one
+	EXPECT_TRUE(queue.enqueue(makeUpdate(1, 3, MembershipUpdate::Kind::Dead)));
+	EXPECT_TRUE(queue.enqueue(makeUpdate(2, 4, MembershipUpdate::Kind::Alive)));
+
+	MembershipUpdate picked[2];
+	ASSERT_EQ(2, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	for (auto const& update : picked) {
+		EXPECT_EQ((update.node.id.value == 1) ? MembershipUpdate::Kind::Dead : MembershipUpdate::Kind::Alive,
+				  update.kind);
+	}
+}
+
+
+TEST(TestDisseminationQueue, regossipedUpdateKeepsItsCount) {
+	DisseminationQueue queue{3};
+	queue.enqueue(makeUpdate(1, 3));
+
+	MembershipUpdate picked[1];
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(1, queue.fill(kLargeBudget, 9, arrayView(picked)));
+		// The same update heard back from a peer is no news
+		EXPECT_FALSE(queue.enqueue(makeUpdate(1, 3)));
+	}
+
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 9, arrayView(picked)));
+	EXPECT_TRUE(queue.empty());
+}
+
+
+TEST(TestDisseminationQueue, suspicionByAnotherMemberIsNews) {
+	DisseminationQueue queue{3};
+	auto suspect = makeUpdate(1, 3, MembershipUpdate::Kind::Suspect);
+	suspect.suspecter = NodeID{7};
+	queue.enqueue(suspect);
+
+	MembershipUpdate picked[1];
+	ASSERT_EQ(1, queue.fill(kLargeBudget, 9, arrayView(picked)));
+	EXPECT_FALSE(queue.enqueue(suspect));
+
+	suspect.suspecter = NodeID{8};
+	EXPECT_TRUE(queue.enqueue(suspect));
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(1, queue.fill(kLargeBudget, 9, arrayView(picked)));
+		EXPECT_EQ(8, picked[0].suspecter.value);
+	}
+	EXPECT_TRUE(queue.empty());
+}
+
+
+TEST(TestDisseminationQueue, fillPicksNoMoreThanMessageCanCarry) {
+	DisseminationQueue queue;
+	for (uint32 i = 0; i < 300; ++i) {
+		queue.enqueue(makeUpdate(i, 0));
+	}
+
+	std::vector<MembershipUpdate> picked(300);
+	ASSERT_EQ(255, queue.fill(1 << 20, 100, arrayView(picked.data(), 300)));
+	std::set<uint32> ids;
+	for (uint32 i = 0; i < 255; ++i) {
+		ids.insert(picked[i].node.id.value);
+	}
+
+	// Updates left out have not been transmitted, so they go first next time
+	ASSERT_EQ(45, queue.fill(1 << 20, 100, arrayView(picked.data(), 45)));
+	for (uint32 i = 0; i < 45; ++i) {
+		EXPECT_EQ(0, ids.count(picked[i].node.id.value));
+		ids.insert(picked[i].node.id.value);
+	}
+	EXPECT_EQ(300, ids.size());
+}
+
+
+TEST(TestDisseminationQueue, fillRespectsBudget) {
+	DisseminationQueue queue;
+	for (uint32 i = 0; i < 10; ++i) {
+		queue.enqueue(makeUpdate(i, 0));
+	}
+
+	auto const updateSize = encodedSize(makeUpdate(0, 0));
+	MembershipUpdate picked[10];
+	EXPECT_EQ(3, queue.fill(static_cast<Gossip::size_type>(3 * updateSize + updateSize - 1), 100, arrayView(picked)));
+	EXPECT_EQ(0, queue.fill(static_cast<Gossip::size_type>(updateSize - 1), 100, arrayView(picked)));
+}
+
+
+TEST(TestDisseminationQueue, fillSkipsUpdatesThatDoNotFit) {
+	auto maybeAddress6 = tryParseAddress("[fe80::1]:7000");
+	ASSERT_TRUE(maybeAddress6.isOk());
+
+	// IPv6 updates, queued last, are at the head of the queue
+	DisseminationQueue queue;
+	for (uint32 i = 1; i <= 4; ++i) {
+		queue.enqueue(makeUpdate(i, 0));
+	}
+	MembershipUpdate const alive6{MembershipUpdate::Kind::Alive, {{5}, 0}, *maybeAddress6};
+	MembershipUpdate const suspect6{MembershipUpdate::Kind::Suspect, {{6}, 0}, *maybeAddress6, {1}};
+	queue.enqueue(alive6);
+	queue.enqueue(suspect6);
+
+	// Budget only fits an IPv4 update: IPv6 ones are skipped rather than holding it back
+	auto const updateSize = encodedSize(makeUpdate(1, 0));
+	auto const budget = static_cast<Gossip::size_type>(updateSize + 4);
+	ASSERT_GT(encodedSize(alive6), budget);
+
+	MembershipUpdate picked[6];
+	ASSERT_EQ(1, queue.fill(budget, 100, arrayView(picked)));
+	EXPECT_EQ(4, picked[0].node.id.value);
+
+	// Skipped updates have not been transmitted, so they still go first
+	ASSERT_EQ(6, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	uint32 const expected[] = {6, 5, 3, 2, 1, 4};
+	for (uint32 i = 0; i < 6; ++i) {
+		EXPECT_EQ(expected[i], picked[i].node.id.value) << "update " << i;
+	}
+}
+
+
+TEST(TestDisseminationQueue, fillLooksAheadBoundedNumberOfUpdates) {
+	auto maybeAddress6 = tryParseAddress("[fe80::1]:7000");
+	ASSERT_TRUE(maybeAddress6.isOk());
+
+	DisseminationQueue queue;
+	queue.enqueue(makeUpdate(1, 0));
+	for (uint32 i = 0; i <= DisseminationQueue::kMaxSkips; ++i) {
+		queue.enqueue(MembershipUpdate{MembershipUpdate::Kind::Alive, {{100 + i}, 0}, *maybeAddress6});
+	}
+
+	// The IPv4 update would fit, but is further back than a fill looks
+	auto const budget = static_cast<Gossip::size_type>(encodedSize(makeUpdate(1, 0)));
+	MembershipUpdate picked[4];
+	EXPECT_EQ(0, queue.fill(budget, 100, arrayView(picked)));
+	EXPECT_EQ(DisseminationQueue::kMaxSkips + 2, queue.size());
+}
+
+
+TEST(TestDisseminationQueue, erase) {
+	DisseminationQueue queue;
+	for (uint32 i = 0; i < 5; ++i) {
+		queue.enqueue(makeUpdate(i, 0));
+	}
+
+	EXPECT_TRUE(queue.erase({2}));
+	EXPECT_FALSE(queue.erase({2}));
+	EXPECT_FALSE(queue.contains({2}));
+	EXPECT_EQ(4, queue.size());
+
+	MembershipUpdate picked[5];
+	ASSERT_EQ(4, queue.fill(kLargeBudget, 100, arrayView(picked)));
+	for (uint32 i = 0; i < 4; ++i) {
+		EXPECT_NE(2, picked[i].node.id.value);
+	}
+}
+
+
+TEST(TestDisseminationQueue, everyUpdateIsSentLimitTimes) {
+	DisseminationQueue queue{2};
+	std::mt19937 gen{17};
+	std::uniform_int_distribution<uint32> ids{0, 63};
+
+	uint32 sent[64] = {0};
+	uint32 enqueued[64] = {0};
+	MembershipUpdate picked[5];
+	for (int round = 0; round < 400; ++round) {
+		if (round < 200) {
+			// Peers re-gossip updates still pending, which must not restart their count
+			auto const id = ids(gen);
+			if (queue.enqueue(makeUpdate(id, 0))) {
+				enqueued[id] += 1;
+			}
+		}
+
+		auto const count = queue.fill(kLargeBudget, 99, arrayView(picked));
+		for (uint32 i = 0; i < count; ++i) {
+			sent[picked[i].node.id.value] += 1;
+		}
+	}
+
+	ASSERT_TRUE(queue.empty());
+	auto const limit = queue.retransmitLimit(99);
+	for (uint32 id = 0; id < 64; ++id) {
+		EXPECT_EQ(enqueued[id] * limit, sent[id]) << "node " << id;
+	}
+}
+
+
+TEST(TestDisseminationQueue, compactFillIsOrderedById) {
+	DisseminationQueue queue;
+	for (uint32 i = 0; i < 100; ++i) {
+		queue.enqueue(makeUpdate((i * 37) % 101 + 1, 0));
+	}
+
+	constexpr Gossip::size_type budget = 1000;
+	MembershipUpdate picked[100];
+	auto const count = queue.fill(budget, 100, arrayView(picked), UpdateEncoding::Compact);
+	ASSERT_LT(0, count);
+	for (uint32 i = 1; i < count; ++i) {
+		EXPECT_LT(picked[i - 1].node.id.value, picked[i].node.id.value);
+	}
+
+	// All of the picked updates fit into the budget once written
+	auto const view = ArrayView<MembershipUpdate const>{picked, count};
+	EXPECT_EQ(count, MessageWriter::piggybackCapacity(view, budget, UpdateEncoding::Compact));
+}
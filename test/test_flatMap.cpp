@@ -0,0 +1,206 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_flatMap.cpp
+ *	@brief		Test suit for tribe::FlatMap
+ ******************************************************************************/
+#include "tribe/flatMap.hpp"    // Class being tested.
+#include "tribe/nodeInfo.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+
+using namespace tribe;
+
+
+namespace {
+
+/// Degenerate hash to force all keys into the same probe sequence
+struct ConstantHash {
+	size_t operator()(int) const noexcept { return 42; }
+};
+
+/// Key comparison that counts how many times it is called
+struct CountingEqual {
+	static Solace::uint64 calls;
+
+	bool operator()(Solace::uint64 lhs, Solace::uint64 rhs) const noexcept {
+		calls += 1;
+		return lhs == rhs;
+	}
+};
+
+Solace::uint64 CountingEqual::calls = 0;
+
+}  // namespace
+
+
+TEST(FlatMap, emptyMap) {
+	FlatMap<NodeID, int> map;
+
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(0, map.size());
+	ASSERT_EQ(map.begin(), map.end());
+	ASSERT_EQ(map.find({3}), map.end());
+	ASSERT_EQ(0, map.erase({3}));
+}
+
+
+TEST(FlatMap, insertAndFind) {
+	FlatMap<NodeID, int> map;
+
+	ASSERT_TRUE(map.try_emplace({1}, 10).second);
+	ASSERT_TRUE(map.try_emplace({2}, 20).second);
+	ASSERT_FALSE(map.try_emplace({1}, 30).second);
+	ASSERT_EQ(2, map.size());
+
+	auto it = map.find({1});
+	ASSERT_NE(it, map.end());
+	ASSERT_EQ(10, it->second);
+
+	ASSERT_FALSE(map.insert_or_assign({1}, 30).second);
+	ASSERT_EQ(30, map.find({1})->second);
+
+	map[NodeID{2}] += 1;
+	ASSERT_EQ(21, map.find({2})->second);
+	ASSERT_EQ(2, map.size());
+}
+
+
+TEST(FlatMap, eraseWhileIterating) {
+	FlatMap<NodeID, int> map;
+	for (Solace::uint32 i = 0; i < 100; ++i) {
+		map.try_emplace({i}, static_cast<int>(i));
+	}
+
+	for (auto it = map.begin(); it != map.end(); ) {
+		if (it->second % 2) {
+			it = map.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	ASSERT_EQ(50, map.size());
+	for (Solace::uint32 i = 0; i < 100; ++i) {
+		ASSERT_EQ((i % 2) ? 0 : 1, map.count({i}));
+	}
+}
+
+
+TEST(FlatMap, copyAndMove) {
+	FlatMap<int, std::shared_ptr<int>> map;
+	auto value = std::make_shared<int>(7);
+	for (int i = 0; i < 40; ++i) {
+		map.try_emplace(i, value);
+	}
+	ASSERT_EQ(41, value.use_count());
+
+	{
+		auto copy = map;
+		ASSERT_EQ(81, value.use_count());
+		copy.erase(3);
+		ASSERT_EQ(39, copy.size());
+		ASSERT_EQ(40, map.size());
+
+		auto moved = std::move(copy);
+		ASSERT_EQ(39, moved.size());
+		ASSERT_EQ(80, value.use_count());
+	}
+
+	ASSERT_EQ(41, value.use_count());
+	map.clear();
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(1, value.use_count());
+}
+
+
+TEST(FlatMap, hashCollisions) {
+	FlatMap<int, int, ConstantHash> map;
+	for (int i = 0; i < 100; ++i) {
+		ASSERT_TRUE(map.try_emplace(i, i * 2).second);
+	}
+
+	for (int i = 0; i < 100; ++i) {
+		auto it = map.find(i);
+		ASSERT_NE(it, map.end());
+		ASSERT_EQ(i * 2, it->second);
+	}
+
+	for (int i = 0; i < 100; i += 2) {
+		ASSERT_EQ(1, map.erase(i));
+	}
+	ASSERT_EQ(50, map.size());
+	ASSERT_EQ(map.find(2), map.end());
+	ASSERT_NE(map.find(3), map.end());
+}
+
+
+TEST(FlatMap, matchesUnorderedMap) {
+	std::mt19937 rng{11};
+	std::uniform_int_distribution<Solace::uint32> keys{0, 65536};
+
+	std::unordered_map<NodeID, Solace::uint32> expected;
+	FlatMap<NodeID, Solace::uint32> map;
+
+	for (Solace::uint32 i = 0; i < 200000; ++i) {
+		auto const key = NodeID{keys(rng)};
+		if (i % 3 == 0) {
+			ASSERT_EQ(expected.erase(key), map.erase(key));
+		} else {
+			expected[key] = i;
+			map.insert_or_assign(key, i);
+		}
+	}
+
+	ASSERT_EQ(expected.size(), map.size());
+	size_t count = 0;
+	for (auto const& entry : map) {
+		auto it = expected.find(entry.first);
+		ASSERT_NE(it, expected.end());
+		ASSERT_EQ(it->second, entry.second);
+		++count;
+	}
+	ASSERT_EQ(expected.size(), count);
+}
+
+
+TEST(FlatMap, keysDifferingInHighBitsDoNotCluster) {
+	// E.g. IPv4 addresses within a subnet in network byte order, or ids shifted into high bits
+	constexpr Solace::uint64 kCount = 20000;
+
+	for (auto shift : {16, 32, 48}) {
+		FlatMap<Solace::uint64, Solace::uint64, std::hash<Solace::uint64>, CountingEqual> map;
+		for (Solace::uint64 i = 0; i < kCount; ++i) {
+			ASSERT_TRUE(map.try_emplace(i << shift, i).second);
+		}
+
+		CountingEqual::calls = 0;
+		for (Solace::uint64 i = 0; i < kCount; ++i) {
+			auto it = map.find(i << shift);
+			ASSERT_NE(map.end(), it);
+			ASSERT_EQ(i, it->second);
+		}
+
+		// Each lookup compares its own key and, rarely, a key with the same 7 bits of hash
+		EXPECT_LT(CountingEqual::calls, kCount + kCount / 8) << "shift " << shift;
+	}
+}
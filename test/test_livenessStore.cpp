@@ -0,0 +1,242 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_livenessStore.cpp
+ *	@brief		Test suit for tribe::LivenessStore
+ ******************************************************************************/
+#include "tribe/livenessStore.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+using namespace tribe;
+
+
+TEST(LivenessStore, decaySinglePeer) {
+	auto value = Peer::Liveness{3, Peer::kCertainlyAlive, Peer::State::Alive};
+
+	value = decayLiveness(value, 1, 0.9f);
+	EXPECT_EQ(2, value.ttl);
+	EXPECT_EQ(Peer::State::Alive, value.state);
+
+	value = decayLiveness(value, 1, 0.5f);
+	EXPECT_EQ(1, value.ttl);
+	EXPECT_EQ(Peer::State::Suspected, value.state);
+
+	value = decayLiveness(value, 5, 1.0f);
+	EXPECT_EQ(0, value.ttl);
+	EXPECT_EQ(Peer::State::Dead, value.state);
+}
+
+
+TEST(LivenessStore, pushAndRead) {
+	LivenessStore store;
+	ASSERT_TRUE(store.empty());
+
+	store.push_back({7, 0.5f, Peer::State::Suspected});
+	store.push_back({1, 0.9f, Peer::State::Alive});
+	ASSERT_EQ(2, store.size());
+
+	EXPECT_EQ(7, store[0].ttl);
+	EXPECT_EQ(Peer::State::Suspected, store[0].state);
+	EXPECT_EQ(Peer::State::Alive, store[1].state);
+
+	store.set(1, {2, 0.1f, Peer::State::Dead});
+	EXPECT_EQ(2, store[1].ttl);
+	EXPECT_EQ(Peer::State::Dead, store[1].state);
+}
+
+
+TEST(LivenessStore, decayMatchesScalar) {
+	std::mt19937 rng{3};
+	std::uniform_int_distribution<Solace::uint16> ttls{0, 6};
+	std::uniform_real_distribution<Solace::float32> probabilities{0.0f, 1.0f};
+	std::uniform_int_distribution<int> states{0, 2};
+
+	// Odd size to exercise both vectorized and scalar paths
+	std::vector<Peer::Liveness> expected;
+	LivenessStore store;
+	for (int i = 0; i < 1027; ++i) {
+		auto const value = Peer::Liveness{ttls(rng), probabilities(rng), static_cast<Peer::State>(states(rng))};
+		expected.push_back(value);
+		store.push_back(value);
+	}
+
+	for (Solace::uint16 tick = 0; tick < 5; ++tick) {
+		auto const dt = static_cast<Solace::uint16>(tick % 3);
+		store.decay(dt, 0.83f);
+		for (auto& value : expected) {
+			value = decayLiveness(value, dt, 0.83f);
+		}
+
+		for (LivenessStore::size_type i = 0; i < store.size(); ++i) {
+			ASSERT_EQ(expected[i].ttl, store[i].ttl);
+			ASSERT_EQ(expected[i].state, store[i].state);
+			ASSERT_FLOAT_EQ(expected[i].probabitily, store[i].probabitily);
+		}
+	}
+}
+
+
+TEST(LivenessStore, decayFactorModes) {
+	// Linear approximation breaks down for large time deltas
+	EXPECT_EQ(0.0f, decayFactor(0.3f, 100, 1000));
+	EXPECT_NEAR(0.7f, decayFactor(0.3f, 1, 1000), 1e-6f);
+
+	// Exponential decay stays exact
+	EXPECT_NEAR(std::exp(-0.3f), decayFactor(0.3f, 1, 1000, DecayMode::Exponential), 1e-6f);
+	EXPECT_LT(0.0f, decayFactor(0.3f, 100, 1000, DecayMode::Exponential));
+	EXPECT_NEAR(std::pow(decayFactor(0.3f, 1, 1300, DecayMode::Exponential), 7.0f),
+				decayFactor(0.3f, 7, 1300, DecayMode::Exponential), 1e-6f);
+}
+
+
+TEST(LivenessStore, catchUpMatchesSteps) {
+	std::mt19937 rng{11};
+	std::uniform_int_distribution<Solace::uint16> ttls{0, 20};
+	std::uniform_int_distribution<Solace::uint16> ticks{0, 30};
+	std::uniform_real_distribution<Solace::float32> probabilities{0.0f, 1.0f};
+	std::uniform_int_distribution<int> states{0, 2};
+
+	auto const tickFactor = decayFactor(0.05f, 1, 1000, DecayMode::Exponential);
+	for (int i = 0; i < 1000; ++i) {
+		auto const value = Peer::Liveness{ttls(rng), probabilities(rng), static_cast<Peer::State>(states(rng))};
+		auto const n = ticks(rng);
+
+		auto expected = value;
+		for (Solace::uint16 t = 0; t < n; ++t) {
+			expected = decayLiveness(expected, 1, tickFactor);
+		}
+
+		auto const result = catchUpLiveness(value, n, tickFactor);
+		ASSERT_EQ(expected.ttl, result.ttl);
+		ASSERT_EQ(expected.state, result.state);
+		ASSERT_NEAR(expected.probabitily, result.probabitily, 1e-5f);
+	}
+}
+
+
+TEST(LivenessStore, catchUpAliveToDead) {
+	// Alive peer becomes suspected and then dead within the ticks passed
+	auto const value = catchUpLiveness({2, 0.66f, Peer::State::Alive}, 3, 0.9f);
+	EXPECT_EQ(0, value.ttl);
+	EXPECT_EQ(Peer::State::Dead, value.state);
+
+	// But not if it only became suspected on the last tick
+	auto const late = catchUpLiveness({2, 0.75f, Peer::State::Alive}, 2, 0.9f);
+	EXPECT_EQ(Peer::State::Suspected, late.state);
+}
+
+
+TEST(LivenessStore, catchUpMatchesScalar) {
+	std::mt19937 rng{5};
+	std::uniform_int_distribution<Solace::uint16> ttls{0, 12};
+	std::uniform_real_distribution<Solace::float32> probabilities{0.0f, 1.0f};
+	std::uniform_int_distribution<int> states{0, 2};
+
+	std::vector<Peer::Liveness> expected;
+	LivenessStore store;
+	for (int i = 0; i < 1029; ++i) {
+		auto const value = Peer::Liveness{ttls(rng), probabilities(rng), static_cast<Peer::State>(states(rng))};
+		expected.push_back(value);
+		store.push_back(value);
+	}
+
+	for (Solace::uint16 ticks = 0; ticks < 6; ++ticks) {
+		store.catchUp(ticks, 0.93f);
+		for (auto& value : expected) {
+			value = catchUpLiveness(value, ticks, 0.93f);
+		}
+
+		for (LivenessStore::size_type i = 0; i < store.size(); ++i) {
+			ASSERT_EQ(expected[i].ttl, store[i].ttl);
+			ASSERT_EQ(expected[i].state, store[i].state);
+			ASSERT_FLOAT_EQ(expected[i].probabitily, store[i].probabitily);
+		}
+	}
+}
+
+
+TEST(LivenessStore, eraseMovesLastEstimate) {
+	LivenessStore store;
+	for (Solace::uint32 i = 0; i < 130; ++i) {
+		store.push_back({static_cast<Solace::uint16>(i), 0.9f, Peer::State::Alive}, NodeID{i});
+	}
+
+	auto const snapshot = store;
+
+	// Removing the last estimate moves nothing
+	EXPECT_FALSE(store.erase(129));
+	ASSERT_EQ(129, store.size());
+
+	auto const moved = store.erase(3);
+	ASSERT_TRUE(moved);
+	EXPECT_EQ(128, (*moved).value);
+	EXPECT_EQ(128, store[3].ttl);
+	EXPECT_EQ(128, store.id(3).value);
+	ASSERT_EQ(128, store.size());
+
+	// Copies of the store are not affected
+	ASSERT_EQ(130, snapshot.size());
+	EXPECT_EQ(3, snapshot[3].ttl);
+	EXPECT_EQ(129, snapshot.id(129).value);
+}
+
+
+TEST(LivenessStore, decayReportsChanges) {
+	std::mt19937 rng{7};
+	std::uniform_int_distribution<Solace::uint16> ttls{0, 3};
+	std::uniform_real_distribution<Solace::float32> probabilities{0.5f, 1.0f};
+	std::uniform_int_distribution<int> states{0, 2};
+
+	std::vector<Peer::Liveness> expected;
+	LivenessStore store;
+	for (Solace::uint32 i = 0; i < 515; ++i) {
+		auto const value = Peer::Liveness{ttls(rng), probabilities(rng), static_cast<Peer::State>(states(rng))};
+		expected.push_back(value);
+		store.push_back(value, NodeID{i});
+	}
+
+	auto const isHealthy = [](Peer::Liveness const& value) {
+		return (value.state == Peer::State::Alive && value.ttl > 0 && value.probabitily > Peer::kMaybeNotAlive);
+	};
+
+	for (Solace::uint16 ticks = 1; ticks < 4; ++ticks) {
+		std::vector<LivenessStore::Change> changes;
+		store.catchUp(ticks, 0.9f, changes);
+
+		std::vector<LivenessStore::Change> expectedChanges;
+		for (Solace::uint32 i = 0; i < expected.size(); ++i) {
+			auto const before = expected[i];
+			expected[i] = catchUpLiveness(before, ticks, 0.9f);
+			if (before.state != expected[i].state || isHealthy(before) != isHealthy(expected[i]) ||
+				(expected[i].state == Peer::State::Dead && expected[i].ttl == 0)) {
+				expectedChanges.push_back({NodeID{i}, before.state});
+			}
+		}
+
+		ASSERT_EQ(expectedChanges.size(), changes.size()) << "ticks " << ticks;
+		for (size_t i = 0; i < changes.size(); ++i) {
+			EXPECT_EQ(expectedChanges[i].id, changes[i].id);
+			EXPECT_EQ(expectedChanges[i].previous, changes[i].previous);
+		}
+	}
+}
@@ -0,0 +1,393 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_localHealth.cpp
+ *	@brief		Test suit for tribe::LocalHealth
+ ******************************************************************************/
+#include "tribe/localHealth.hpp"    // Class being tested.
+#include "tribe/probeScheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+constexpr PeersModel::Tick kPeriod = 5;
+constexpr PeersModel::Tick kTimeout = 2;
+constexpr uint32 kIndirectProbes = 3;
+
+
+PeersModel makeModel(uint32 nPeers, MembershipSettings const& settings) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{0}, 1};
+	model.params = settings;
+	for (uint32 i = 1; i <= nPeers; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(i)), {{i}, 1}, settings.ttl});
+	}
+
+	return model;
+}
+
+
+/// Ack of a probe on its way to the node
+struct Ack {
+	NodeID		from;
+	NodeID		via;	//!< Helper that has relayed the ack, 0 if the ack is direct
+};
+
+
+/// Outcome of a simulated run
+struct SimulationResult {
+	uint32		falseFailures{0};		//!< Probes of live peers reported as failed
+	uint32		falseSuspicions{0};		//!< Live peers the model has suspected
+	uint32		falseDeaths{0};			//!< Live peers the model has considered dead or has expired
+	LocalHealth::Score	peakScore{0};	//!< Highest local health score
+	Optional<PeersModel::Tick>	crashDetectedAt;	//!< Tick the crashed peer has been reported as failed
+};
+
+
+/**
+ * Simulation of a node probing a group of live peers, while the node itself is degraded for a while:
+ * starved of CPU it is slow to process acks, taking several protocol periods at worst.
+ * Acks processed after the period of the probe has ended are dropped, as they would be by sequence number.
+ * Peers are only refreshed by acks, and decay of their liveness is driven by local health.
+ */
+struct Simulation {
+	static constexpr uint32 kPeers = 16;
+	static constexpr PeersModel::Tick kDuration = 6000;
+	static constexpr PeersModel::Tick kDegradedFrom = 1500;
+	static constexpr PeersModel::Tick kDegradedTo = 3500;
+	static constexpr PeersModel::Tick kCrashAt = 4500;
+	static constexpr uint32 kCrashedPeer = 7;
+
+	static MembershipSettings settings(LocalHealth::Score maxLocalHealth) {
+		MembershipSettings result{};
+		result.peerInfoDecayTimeMs = 100;
+		result.peerInfoDecayRate = 0.02f;
+		result.peerInfoDecayMode = DecayMode::Exponential;
+		result.ttl = 300;
+		result.maxLocalHealth = maxLocalHealth;
+		result.probePeriod = kPeriod;
+		result.probeTimeout = kTimeout;
+		result.indirectProbes = kIndirectProbes;
+
+		return result;
+	}
+
+	/// Ticks it takes the node to process an ack
+	PeersModel::Tick ackDelay(PeersModel::Tick now) {
+		if (now < kDegradedFrom || now >= kDegradedTo) {
+			return 1;
+		}
+
+		return std::uniform_int_distribution<PeersModel::Tick>{3, 12}(_random);
+	}
+
+	SimulationResult run(LocalHealth::Score maxLocalHealth) {
+		auto const params = settings(maxLocalHealth);
+		auto model = makeModel(kPeers, params);
+		ProbeScheduler scheduler{params, 31};
+
+		SimulationResult result;
+		std::set<uint32> suspected;
+		std::set<uint32> dead;
+		std::multimap<PeersModel::Tick, Ack> acks;
+		ProbeScheduler::Probe probes[kIndirectProbes + 2];
+
+		for (PeersModel::Tick now = 0; now < kDuration; ++now) {
+			// Process acks due
+			for (auto it = acks.begin(); it != acks.end() && it->first <= now; it = acks.erase(it)) {
+				auto const& ack = it->second;
+				auto const ofTarget = (ack.via == NodeID{0})
+						? scheduler.onAck(ack.from)
+						: scheduler.onAck(ack.from, ack.via);
+				if (ofTarget) {
+					model = update(std::move(model), UpdatePeerGeneration{ack.from, 1, params.ttl});
+				}
+			}
+
+			auto const count = scheduler.tick(model, now, arrayView(probes));
+			for (uint32 i = 0; i < count; ++i) {
+				auto const target = probes[i].target;
+				auto const isUp = (target.value != kCrashedPeer || now < kCrashAt);
+				switch (probes[i].kind) {
+				case ProbeScheduler::Probe::Kind::Direct:
+				case ProbeScheduler::Probe::Kind::Indirect:
+					if (isUp) {
+						acks.emplace(now + ackDelay(now), Ack{target, probes[i].via});
+					}
+					break;
+				case ProbeScheduler::Probe::Kind::Failed:
+					if (isUp) {
+						result.falseFailures += 1;
+					} else if (!result.crashDetectedAt) {
+						result.crashDetectedAt = now;
+					}
+					break;
+				}
+			}
+
+			result.peakScore = std::max(result.peakScore, scheduler.health().score());
+			if (auto decay = scheduler.health().decay(params, 1)) {
+				model = update(std::move(model), std::move(*decay));
+			}
+
+			for (auto const& entry : model.suspectedPeers()) {
+				suspected.insert(entry.first.value);
+			}
+			for (uint32 i = 1; i <= kPeers; ++i) {
+				auto it = model.members.find(NodeID{i});
+				if (it == model.members.end() || model.isDead(it->second)) {
+					dead.insert(i);
+				}
+			}
+		}
+
+		suspected.erase(kCrashedPeer);
+		dead.erase(kCrashedPeer);
+		result.falseSuspicions = static_cast<uint32>(suspected.size());
+		result.falseDeaths = static_cast<uint32>(dead.size());
+
+		return result;
+	}
+
+private:
+	std::mt19937	_random{7};
+};
+
+}  // namespace
+
+
+TEST(TestLocalHealth, healthyByDefault) {
+	LocalHealth health{MembershipSettings{}};
+
+	EXPECT_EQ(0, health.score());
+	EXPECT_EQ(1, health.multiplier());
+	EXPECT_EQ(MembershipSettings{}.maxLocalHealth, health.maxScore());
+	EXPECT_EQ(5, health.scale(5));
+}
+
+
+TEST(TestLocalHealth, scoreIsBounded) {
+	LocalHealth health{3};
+
+	health.onProbeFailure();
+	health.onMissedNack();
+	health.onRefutedSuspicion();
+	EXPECT_EQ(3, health.score());
+	EXPECT_EQ(20, health.scale(5));
+
+	health.onProbeFailure();
+	EXPECT_EQ(3, health.score());
+
+	for (int i = 0; i < 5; ++i) {
+		health.onProbeSuccess();
+	}
+	EXPECT_EQ(0, health.score());
+}
+
+
+TEST(TestLocalHealth, disabled) {
+	LocalHealth health{0};
+	health.onProbeFailure();
+	health.onRefutedSuspicion();
+
+	EXPECT_EQ(0, health.score());
+	EXPECT_EQ(7, health.advance(7));
+}
+
+
+TEST(TestLocalHealth, decayClockSlowsDown) {
+	LocalHealth health{8};
+	EXPECT_EQ(3, health.advance(3));
+
+	health.onProbeFailure();
+	health.onProbeFailure();
+
+	// 3 times slower: ticks left over carry on
+	EXPECT_EQ(0, health.advance(2));
+	EXPECT_EQ(1, health.advance(2));
+	EXPECT_EQ(1, health.advance(3));
+	EXPECT_EQ(3, health.advance(10));
+
+	auto const settings = MembershipSettings{};
+	EXPECT_EQ(1, health.advance(1));
+	EXPECT_TRUE(health.decay(settings, 1).isNone());
+	EXPECT_TRUE(health.decay(settings, 1).isNone());
+
+	auto const decay = health.decay(settings, 1);
+	ASSERT_TRUE(decay.isSome());
+	EXPECT_EQ(1, (*decay).ttlDelta);
+	EXPECT_EQ(settings.peerInfoDecayTimeMs, (*decay).decayTimeMs);
+	EXPECT_EQ(settings.peerInfoDecayRate, (*decay).decayRate);
+}
+
+
+TEST(TestLocalHealth, suspicionTimeoutIsStretched) {
+	auto settings = Simulation::settings(8);
+	settings.ttl = 250;
+
+	// Ticks for a peer, not heard from, to become Suspected and then Dead, which it is expired at once
+	auto const timeouts = [&settings](LocalHealth& health) {
+		auto model = makeModel(1, settings);
+		Optional<PeersModel::Tick> suspectedAt;
+		PeersModel::Tick now = 0;
+		while (model.members.find(NodeID{1}) != model.members.end()) {
+			now += 1;
+			if (auto decay = health.decay(settings, 1)) {
+				model = update(std::move(model), std::move(*decay));
+			}
+
+			if (!suspectedAt && model.suspected.find(NodeID{1}) != model.suspected.end()) {
+				suspectedAt = now;
+			}
+		}
+
+		return std::make_pair(*suspectedAt, now);
+	};
+
+	LocalHealth healthy{8};
+	auto const base = timeouts(healthy);
+	EXPECT_LT(base.first, base.second);
+
+	LocalHealth degraded{8};
+	for (int i = 0; i < 3; ++i) {
+		degraded.onRefutedSuspicion();
+	}
+	auto const stretched = timeouts(degraded);
+	EXPECT_EQ(4 * base.first, stretched.first);
+	EXPECT_EQ(4 * base.second, stretched.second);
+}
+
+
+TEST(TestLocalHealth, probePeriodIsStretched) {
+	auto model = makeModel(4, Simulation::settings(8));
+	ProbeScheduler scheduler{kPeriod, kTimeout, kIndirectProbes, 3, 8};
+	ProbeScheduler::Probe probes[kIndirectProbes + 2];
+
+	PeersModel::Tick now = 0;
+	ASSERT_EQ(1, scheduler.tick(model, now, arrayView(probes)));
+	EXPECT_EQ(kPeriod, scheduler.period());
+
+	// Nobody acks: period ends with a failure and the next period is twice as long
+	for (now = 1; now < kPeriod; ++now) {
+		scheduler.tick(model, now, arrayView(probes));
+	}
+	ASSERT_EQ(2, scheduler.tick(model, now, arrayView(probes)));
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Failed, probes[0].kind);
+	EXPECT_EQ(1, scheduler.health().score());
+	EXPECT_EQ(2 * kPeriod, scheduler.period());
+
+	// Indirect probes are only sent after twice the timeout
+	for (PeersModel::Tick i = 1; i < 2 * kTimeout; ++i) {
+		EXPECT_EQ(0, scheduler.tick(model, now + i, arrayView(probes)));
+	}
+	EXPECT_EQ(kIndirectProbes, scheduler.tick(model, now + 2 * kTimeout, arrayView(probes)));
+
+	// Ack that has only made it thanks to the stretched timeout, relayed by every helper, does not improve health
+	for (uint32 i = 0; i < kIndirectProbes; ++i) {
+		EXPECT_TRUE(scheduler.onAck(probes[i].target, probes[i].via));
+	}
+	EXPECT_EQ(1, scheduler.health().score());
+
+	EXPECT_EQ(0, scheduler.tick(model, now + 2 * kPeriod - 1, arrayView(probes)));
+	now += 2 * kPeriod;
+	ASSERT_EQ(1, scheduler.tick(model, now, arrayView(probes)));
+	EXPECT_EQ(2 * kPeriod, scheduler.period());
+
+	// Ack within the probe timeout as configured does, which is reflected in the duration of the next period
+	EXPECT_EQ(0, scheduler.tick(model, now + 1, arrayView(probes)));
+	EXPECT_TRUE(scheduler.onAck(*scheduler.target()));
+	EXPECT_TRUE(scheduler.onAck(*scheduler.target()));
+	EXPECT_EQ(0, scheduler.health().score());
+	EXPECT_EQ(2 * kPeriod, scheduler.period());
+
+	ASSERT_EQ(1, scheduler.tick(model, now + 2 * kPeriod, arrayView(probes)));
+	EXPECT_EQ(kPeriod, scheduler.period());
+}
+
+
+TEST(TestLocalHealth, missedNacksRaiseScore) {
+	auto model = makeModel(10, Simulation::settings(8));
+	ProbeScheduler scheduler{kPeriod, kTimeout, kIndirectProbes, 3, 8};
+	ProbeScheduler::Probe probes[kIndirectProbes + 2];
+
+	PeersModel::Tick now = 0;
+	ASSERT_EQ(1, scheduler.tick(model, now, arrayView(probes)));
+	EXPECT_EQ(0, scheduler.tick(model, 1, arrayView(probes)));
+	ASSERT_EQ(kIndirectProbes, scheduler.tick(model, kTimeout, arrayView(probes)));
+
+	// Target is alive, yet only one of the helpers relays its ack: the others are missed nacks
+	EXPECT_TRUE(scheduler.onAck(probes[0].target, probes[0].via));
+	EXPECT_FALSE(scheduler.onAck(probes[1].via, probes[1].via));
+	EXPECT_EQ(0, scheduler.health().score());
+
+	for (now = kTimeout + 1; now < kPeriod; ++now) {
+		EXPECT_EQ(0, scheduler.tick(model, now, arrayView(probes)));
+	}
+	ASSERT_EQ(1, scheduler.tick(model, now, arrayView(probes)));
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Direct, probes[0].kind);
+	EXPECT_EQ(kIndirectProbes - 1, scheduler.health().score());
+
+	// Nobody acks: the target may well be down, so only the failure counts and helpers are not held to account
+	auto const score = scheduler.health().score();
+	auto const period = scheduler.period();
+	ASSERT_EQ(kIndirectProbes, scheduler.tick(model, now + kTimeout * (score + 1), arrayView(probes)));
+	ASSERT_EQ(2, scheduler.tick(model, now + period, arrayView(probes)));
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Failed, probes[0].kind);
+	EXPECT_EQ(score + 1, scheduler.health().score());
+}
+
+
+TEST(TestLocalHealth, fewerFalsePositivesWhenDegraded) {
+	auto const plain = Simulation{}.run(0);
+	auto const aware = Simulation{}.run(8);
+
+	::testing::Test::RecordProperty("falseFailures", std::to_string(plain.falseFailures) + " -> " +
+									std::to_string(aware.falseFailures));
+	::testing::Test::RecordProperty("falseSuspicions", std::to_string(plain.falseSuspicions) + " -> " +
+									std::to_string(aware.falseSuspicions));
+	::testing::Test::RecordProperty("falseDeaths", std::to_string(plain.falseDeaths) + " -> " +
+									std::to_string(aware.falseDeaths));
+	::testing::Test::RecordProperty("peakScore", std::to_string(aware.peakScore));
+
+	// Without local health awareness most probes fail while the node is degraded,
+	// and peers not acked for long enough are suspected and then pronounced dead
+	EXPECT_GT(plain.falseFailures, 200);
+	EXPECT_GT(plain.falseSuspicions, Simulation::kPeers / 2);
+	EXPECT_GT(plain.falseDeaths, 0);
+
+	// With it, timeouts stretch to fit the delay of the node, as failed probes and helpers missed add up
+	EXPECT_GT(aware.peakScore, 0);
+	EXPECT_LT(aware.falseFailures * 10, plain.falseFailures);
+	EXPECT_EQ(0, aware.falseSuspicions);
+	EXPECT_EQ(0, aware.falseDeaths);
+
+	// Health recovers once the node is no longer degraded: a crash is detected within 2N - 1 periods
+	ASSERT_TRUE(aware.crashDetectedAt.isSome());
+	EXPECT_LE(*aware.crashDetectedAt, Simulation::kCrashAt + (2 * Simulation::kPeers - 1) * kPeriod);
+}
@@ -0,0 +1,337 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_membershipSnapshot.cpp
+ *	@brief		Test suit for tribe::MembershipSnapshot and anti-entropy sync
+ ******************************************************************************/
+#include "tribe/membershipSnapshot.hpp"    // Class being tested.
+#include "tribe/protocol/messageParser.hpp"
+#include "tribe/protocol/messageWriter.hpp"
+
+#include <gtest/gtest.h>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+constexpr uint16 kTtl = 100;
+
+/// Typical MTU sized datagram
+constexpr Gossip::size_type kDatagramSize = 1400;
+
+
+PeersModel makeModel(uint32 nPeers) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{100000}, 1};
+	for (uint32 i = 1; i <= nPeers; ++i) {
+		// Add peers out of order of their IDs
+		auto const id = (i * 7919) % 100003;
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(id)), {{id}, i % 3}, kTtl});
+	}
+
+	return model;
+}
+
+
+/// Decode members of a snapshot chunk carried by a message
+std::vector<MembershipUpdate> decodeMembers(PiggybackView const& members) {
+	std::vector<MembershipUpdate> result(members.count);
+	auto decoded = MessageParser{}.parseUpdates(members, arrayView(result.data(), members.count));
+	EXPECT_TRUE(decoded.isOk());
+
+	return result;
+}
+
+
+/// Merge members of a received snapshot chunk into a model
+PeersModel merge(PeersModel&& model, std::vector<MembershipUpdate> const& members) {
+	std::vector<Action> actions;
+	mergeSnapshot(model, ArrayView<MembershipUpdate const>{members.data(), static_cast<uint32>(members.size())},
+				  actions);
+
+	return update(std::move(model), arrayView(actions.data(), static_cast<uint32>(actions.size())));
+}
+
+}  // namespace
+
+
+TEST(TestMembershipSnapshot, membersAreOrderedById) {
+	auto model = makeModel(3);
+	model = update(std::move(model), PronouncePeerDead{{{15838}, 2}});
+
+	auto const snapshot = MembershipSnapshot{model};
+	ASSERT_EQ(3, snapshot.size());
+
+	auto const members = snapshot.members();
+	EXPECT_EQ(7919, members[0].node.id.value);
+	EXPECT_EQ(15838, members[1].node.id.value);
+	EXPECT_EQ(23757, members[2].node.id.value);
+
+	EXPECT_EQ(MembershipUpdate::Kind::Alive, members[0].kind);
+	EXPECT_EQ(MembershipUpdate::Kind::Dead, members[1].kind);
+	EXPECT_EQ(2, members[1].node.gen);
+	EXPECT_EQ(anyAddress(7919), members[0].address);
+}
+
+
+TEST(TestMembershipSnapshot, chunksFitIntoDatagram) {
+	auto snapshot = MembershipSnapshot{makeModel(1000)};
+	ASSERT_EQ(1, snapshot.chunkCount());
+
+	auto const chunkCount = snapshot.split(kDatagramSize);
+	ASSERT_LT(1, chunkCount);
+
+	uint32 nMembers = 0;
+	for (uint32 i = 0; i < chunkCount; ++i) {
+		auto const chunk = snapshot.chunk(i);
+		EXPECT_FALSE(chunk.empty());
+
+		byte datagram[kDatagramSize];
+		ByteWriter datagramWriter{wrapMemory(datagram)};
+		MessageWriter{datagramWriter}.syncPush(NodeInfo{{1}, 0},
+											   SnapshotChunk{7, static_cast<uint16>(i), static_cast<uint16>(chunkCount)},
+											   chunk);
+
+		auto reader = ByteReader{datagramWriter.viewWritten()};
+		auto maybeMessage = MessageParser{}.parseView(reader);
+		ASSERT_TRUE(maybeMessage.isOk());
+
+		auto const& msg = std::get<SyncMessage>(*maybeMessage);
+		EXPECT_FALSE(msg.isReply);
+		EXPECT_EQ(7, msg.chunk.snapshot);
+		EXPECT_EQ(i, msg.chunk.index);
+		EXPECT_EQ(chunkCount, msg.chunk.count);
+		EXPECT_EQ(chunk.size(), msg.members.count) << "chunk " << i;
+
+		nMembers += chunk.size();
+	}
+
+	EXPECT_EQ(snapshot.size(), nMembers);
+}
+
+
+TEST(TestMembershipSnapshot, emptySnapshotIsSingleChunk) {
+	auto snapshot = MembershipSnapshot{PeersModel{}};
+	EXPECT_TRUE(snapshot.empty());
+
+	ASSERT_EQ(1, snapshot.split(kDatagramSize));
+	EXPECT_TRUE(snapshot.chunk(0).empty());
+}
+
+
+TEST(TestMembershipSnapshot, datagramTooSmall) {
+	auto snapshot = MembershipSnapshot{makeModel(2)};
+
+	EXPECT_EQ(0, snapshot.split(encodedSize(SyncMessage{}) + 2));
+}
+
+
+TEST(TestMembershipSnapshot, mergeSnapshot) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(1), {{1}, 1}, kTtl});
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 1}, kTtl});
+	model = update(std::move(model), AddPeer{anyAddress(3), {{3}, 2}, kTtl});
+	model.node = NodeInfo{{10}, 1};
+
+	MembershipUpdate const members[] = {
+		{MembershipUpdate::Kind::Alive, {{1}, 2}, anyAddress(11)},	// Restarted at a new address
+		{MembershipUpdate::Kind::Dead, {{2}, 1}, anyAddress(2)},		// Dead
+		{MembershipUpdate::Kind::Dead, {{3}, 1}, anyAddress(3)},		// Out of date
+		{MembershipUpdate::Kind::Suspect, {{4}, 1}, anyAddress(4)},	// Unknown
+		{MembershipUpdate::Kind::Dead, {{5}, 1}, anyAddress(5)},		// Unknown and dead
+		{MembershipUpdate::Kind::Dead, {{10}, 1}, anyAddress(10)},	// Self
+	};
+
+	std::vector<Action> actions;
+	EXPECT_EQ(4, mergeSnapshot(model, ArrayView<MembershipUpdate const>{members}, actions));
+	model = update(std::move(model), arrayView(actions.data(), static_cast<uint32>(actions.size())));
+
+	ASSERT_EQ(4, model.members.size());
+	EXPECT_EQ(2, model.members.find(NodeID{1})->second.generation);
+	EXPECT_EQ(anyAddress(11), model.members.find(NodeID{1})->second.address);
+	EXPECT_TRUE(model.isDead(model.members.find(NodeID{2})->second));
+	EXPECT_TRUE(model.isAlive(model.members.find(NodeID{3})->second));
+	EXPECT_TRUE(model.isAlive(model.members.find(NodeID{4})->second));
+	EXPECT_EQ(model.members.end(), model.members.find(NodeID{5}));
+
+	// Merging the same snapshot again changes nothing
+	actions.clear();
+	EXPECT_EQ(0, mergeSnapshot(model, ArrayView<MembershipUpdate const>{members}, actions));
+}
+
+
+TEST(TestMembershipSnapshot, mergeGossip) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(1), {{1}, 1}, kTtl});
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 1}, kTtl});
+	model.node = NodeInfo{{10}, 3};
+	model.params.suspicionConfirmations = 3;
+	LocalHealth health{8};
+
+	// Suspicion raised by node 7 is relayed by a number of nodes: only node 8 confirms it
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Suspect, {{1}, 1}, anyAddress(1), {7}},
+		{MembershipUpdate::Kind::Suspect, {{1}, 1}, anyAddress(1), {7}},
+		{MembershipUpdate::Kind::Suspect, {{1}, 1}, anyAddress(1), {8}},
+		{MembershipUpdate::Kind::Suspect, {{10}, 2}, anyAddress(10), {7}},	// Self, already refuted
+		{MembershipUpdate::Kind::Joined, {{4}, 1}, anyAddress(4)},
+	};
+
+	std::vector<Action> actions;
+	mergeGossip(model, ArrayView<MembershipUpdate const>{updates}, actions, health);
+	model = update(std::move(model), arrayView(actions.data(), static_cast<uint32>(actions.size())));
+
+	ASSERT_EQ(3, model.members.size());
+	EXPECT_TRUE(model.isSuspected(model.members.find(NodeID{1})->second));
+	EXPECT_TRUE(model.isAlive(model.members.find(NodeID{2})->second));
+	EXPECT_TRUE(model.isAlive(model.members.find(NodeID{4})->second));
+
+	auto suspicion = model.suspicions.find(NodeID{1});
+	ASSERT_NE(model.suspicions.end(), suspicion);
+	EXPECT_EQ(2, suspicion->second.count);
+	EXPECT_EQ(NodeID{7}, suspicion->second.suspecters[0]);
+	EXPECT_EQ(NodeID{8}, suspicion->second.suspecters[1]);
+
+	EXPECT_EQ(3, model.node.gen);
+	EXPECT_EQ(0, health.score());
+
+	// Suspicion of the current generation of this node is refuted
+	MembershipUpdate const selfSuspected[] = {
+		{MembershipUpdate::Kind::Suspect, {{10}, 3}, anyAddress(10), {7}},
+	};
+
+	actions.clear();
+	mergeGossip(model, ArrayView<MembershipUpdate const>{selfSuspected}, actions, health);
+	model = update(std::move(model), arrayView(actions.data(), static_cast<uint32>(actions.size())));
+
+	EXPECT_EQ(4, model.node.gen);
+	EXPECT_EQ(1, health.score());
+	EXPECT_EQ(3, model.members.size());
+}
+
+
+TEST(TestMembershipSnapshot, snapshotCarriesSuspecter) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(1), {{1}, 1}, kTtl});
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 1}, kTtl});
+	model = update(std::move(model), SuspectPeer{{{1}, 1}, {7}});
+
+	MembershipSnapshot snapshot{model};
+	ASSERT_EQ(2, snapshot.size());
+	EXPECT_EQ(MembershipUpdate::Kind::Suspect, snapshot.members()[0].kind);
+	EXPECT_EQ(NodeID{7}, snapshot.members()[0].suspecter);
+	EXPECT_EQ(MembershipUpdate::Kind::Alive, snapshot.members()[1].kind);
+}
+
+
+TEST(TestMembershipSnapshot, joiningNodeConvergesInOneRoundTrip) {
+	auto const model = makeModel(500);
+	auto snapshot = MembershipSnapshot{model};
+	auto const chunkCount = snapshot.split(kDatagramSize);
+	ASSERT_LT(1, chunkCount);
+
+	auto joiner = PeersModel{};
+	joiner.node = NodeInfo{{200000}, 1};
+
+	// Reply to a join request: acknowledgement with the first chunk, followed by the rest of the snapshot
+	for (uint32 i = 0; i < chunkCount; ++i) {
+		byte datagram[kDatagramSize];
+		ByteWriter datagramWriter{wrapMemory(datagram)};
+		MessageWriter datagramBuilder{datagramWriter};
+		if (i == 0) {
+			datagramBuilder.joinAck(model.node, snapshot.chunk(i));
+		} else {
+			datagramBuilder.syncReply(model.node,
+									  SnapshotChunk{1, static_cast<uint16>(i), static_cast<uint16>(chunkCount)},
+									  snapshot.chunk(i));
+		}
+
+		auto reader = ByteReader{datagramWriter.viewWritten()};
+		auto maybeMessage = MessageParser{}.parseView(reader);
+		ASSERT_TRUE(maybeMessage.isOk());
+
+		if (i == 0) {
+			auto const& ack = std::get<ConnectResponseAck>(*maybeMessage);
+			EXPECT_EQ(model.node.id, ack.self.id);
+			joiner = merge(std::move(joiner), decodeMembers(ack.members));
+		} else {
+			auto const& reply = std::get<SyncMessage>(*maybeMessage);
+			EXPECT_TRUE(reply.isReply);
+			joiner = merge(std::move(joiner), decodeMembers(reply.members));
+		}
+	}
+
+	ASSERT_EQ(model.members.size(), joiner.members.size());
+	for (auto const& entry : model.members) {
+		auto it = joiner.members.find(entry.first);
+		ASSERT_NE(joiner.members.end(), it);
+		EXPECT_EQ(entry.second.generation, it->second.generation);
+		EXPECT_EQ(entry.second.address, it->second.address);
+	}
+}
+
+
+TEST(TestMembershipSnapshot, truncatedSyncIsRejected) {
+	auto snapshot = MembershipSnapshot{makeModel(3)};
+
+	byte datagram[kDatagramSize];
+	ByteWriter datagramWriter{wrapMemory(datagram)};
+	MessageWriter{datagramWriter}.syncPush(NodeInfo{{1}, 0}, SnapshotChunk{1, 0, 1}, snapshot.members());
+
+	auto const written = datagramWriter.viewWritten();
+	for (MemoryView::size_type size = 1; size < written.size(); ++size) {
+		auto reader = ByteReader{written.slice(0, size)};
+		EXPECT_TRUE(MessageParser{}.parseView(reader).isError()) << "size " << size;
+	}
+
+	// Chunk index past the number of chunks
+	MessageWriter{datagramWriter}.syncPush(NodeInfo{{1}, 0}, SnapshotChunk{1, 1, 1}, snapshot.members());
+	auto reader = ByteReader{datagramWriter.viewWritten().slice(written.size(), datagramWriter.position())};
+	EXPECT_TRUE(MessageParser{}.parseView(reader).isError());
+}
+
+
+TEST(TestAntiEntropy, syncWithRandomPeerEveryInterval) {
+	auto model = makeModel(10);
+	AntiEntropy antiEntropy{4};
+
+	auto peer = antiEntropy.poll(model, 0);
+	ASSERT_TRUE(peer.isSome());
+	EXPECT_TRUE(model.healthy.contains(*peer));
+	EXPECT_TRUE(antiEntropy.poll(model, 0).isNone());
+
+	model = update(std::move(model), DecayPeerInfo{3, 1300, 0.0f});
+	EXPECT_TRUE(antiEntropy.poll(model, 0).isNone());
+
+	model = update(std::move(model), DecayPeerInfo{1, 1300, 0.0f});
+	peer = antiEntropy.poll(model, ~uint64{0});
+	ASSERT_TRUE(peer.isSome());
+	EXPECT_TRUE(model.healthy.contains(*peer));
+
+	EXPECT_NE(antiEntropy.nextSnapshot(), antiEntropy.nextSnapshot());
+}
+
+
+TEST(TestAntiEntropy, nothingToSyncWith) {
+	AntiEntropy antiEntropy{4};
+	EXPECT_TRUE(antiEntropy.poll(PeersModel{}, 0).isNone());
+
+	MembershipSettings settings{};
+	settings.syncInterval = 0;
+	AntiEntropy disabled{settings};
+	EXPECT_TRUE(disabled.poll(makeModel(3), 0).isNone());
+}
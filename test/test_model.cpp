@@ -23,10 +23,50 @@
 #include "tribe/ostream.hpp"  // ostream << Address
 #include <gtest/gtest.h>
 
+#include <random>
+#include <vector>
+
 
 using namespace tribe;
 
 
+namespace {
+
+/// Check that state indexes match the states of all the members
+void expectIndexesConsistent(PeersModel const& model) {
+	PeersModel::StateIndex::size_type nSuspected = 0;
+	PeersModel::StateIndex::size_type nDead = 0;
+	for (auto const& entry : model.members) {
+		auto const state = model.liveness(entry.second).state;
+		EXPECT_EQ(state == Peer::State::Suspected, model.suspected.find(entry.first) != model.suspected.end());
+		EXPECT_EQ(state == Peer::State::Dead, model.dead.find(entry.first) != model.dead.end());
+		EXPECT_EQ(model.isHealthy(entry.second), model.healthy.contains(entry.first));
+
+		nSuspected += (state == Peer::State::Suspected) ? 1 : 0;
+		nDead += (state == Peer::State::Dead) ? 1 : 0;
+	}
+
+	// Liveness estimates are dense and tagged with ids of their peers
+	EXPECT_EQ(model.members.size(), model.estimates.size());
+	for (auto const& entry : model.members) {
+		EXPECT_EQ(entry.first, model.estimates.id(entry.second.slot));
+	}
+
+	EXPECT_EQ(nSuspected, model.suspected.size());
+	EXPECT_EQ(nDead, model.dead.size());
+	for (auto id : model.healthy) {
+		EXPECT_NE(model.members.end(), model.members.find(id));
+	}
+
+	// Only suspected members have suspicions
+	for (auto const& entry : model.suspicions) {
+		EXPECT_NE(model.suspected.end(), model.suspected.find(entry.first));
+	}
+}
+
+}  // namespace
+
+
 TEST(Model, initialModel) {
 	auto model = PeersModel{};
 
@@ -218,7 +258,7 @@ TEST(Model, PronouncePeerDead) {
 	{  // Check initial state of the peer
 		auto it = initialModel.members.find({1});
 		ASSERT_NE(it, initialModel.members.end());
-		ASSERT_EQ(it->second.liveness.state, Peer::State::Alive);
+		ASSERT_EQ(initialModel.liveness(it->second).state, Peer::State::Alive);
 	}
 
 
@@ -228,8 +268,13 @@ TEST(Model, PronouncePeerDead) {
 	{
 		auto it = model.members.find({1});
 		ASSERT_NE(it, model.members.end());
-		ASSERT_EQ(it->second.liveness.state, Peer::State::Dead);
+		ASSERT_EQ(model.liveness(it->second).state, Peer::State::Dead);
 	}
+
+	// Liveness of a member can be looked up by its id
+	auto const liveness = model.liveness(NodeID{1});
+	ASSERT_TRUE(liveness.isSome());
+	EXPECT_EQ(Peer::State::Dead, (*liveness).state);
 }
 
 TEST(Model, PronouncePeerDead_nonExistent) {
@@ -237,11 +282,12 @@ TEST(Model, PronouncePeerDead_nonExistent) {
 	auto model = update(initialModel, PronouncePeerDead{{{32}, 1}});
 	ASSERT_EQ(1, model.members.size());
 	ASSERT_EQ(model.members.find({32}), model.members.end());
+	EXPECT_TRUE(model.liveness(NodeID{32}).isNone());
 
 	{
 		auto it = model.members.find({1});
 		ASSERT_NE(it, model.members.end());
-		ASSERT_EQ(it->second.liveness.state, Peer::State::Alive);
+		ASSERT_EQ(model.liveness(it->second).state, Peer::State::Alive);
 	}
 }
 
@@ -263,8 +309,8 @@ TEST(Model, DecayPeerInfo) {
 	{
 		auto it = model.members.find({1});
 		ASSERT_NE(it, model.members.end());
-		ASSERT_EQ(it->second.liveness.ttl, 1);
-		ASSERT_EQ(it->second.liveness.state, Peer::State::Suspected);
+		ASSERT_EQ(model.liveness(it->second).ttl, 1);
+		ASSERT_EQ(model.liveness(it->second).state, Peer::State::Suspected);
 	}
 }
 
@@ -280,11 +326,161 @@ TEST(Model, DecayPeerInfo_dontUndeflow) {
 	{
 		auto it = model.members.find({1});
 		ASSERT_NE(it, model.members.end());
-		ASSERT_EQ(it->second.liveness.ttl, 0);
-		ASSERT_EQ(it->second.liveness.state, Peer::State::Suspected);
+		ASSERT_EQ(model.liveness(it->second).ttl, 0);
+		ASSERT_EQ(model.liveness(it->second).state, Peer::State::Suspected);
+	}
+}
+
+
+TEST(Model, DecayPeerInfo_exponentialCatchUp) {
+	auto initialModel = update(PeersModel{}, AddSeed{anyAddress(888), 4});
+	initialModel = update(initialModel, AddPeer{anyAddress(321), {{1}, 0}, 3});
+	initialModel = update(initialModel, AddPeer{anyAddress(12), {{2}, 0}, 20});
+
+	// Decaying by a number of ticks at once is the same as decaying by one tick at a time
+	auto const decayRate = 0.3f;
+	auto stepped = initialModel;
+	for (int i = 0; i < 4; ++i) {
+		stepped = update(std::move(stepped), DecayPeerInfo{1, 1000, decayRate, DecayMode::Exponential});
+	}
+
+	auto const model = update(initialModel, DecayPeerInfo{4, 1000, decayRate, DecayMode::Exponential});
+	ASSERT_EQ(stepped.members.size(), model.members.size());
+	ASSERT_EQ(0, model.seeds.size());
+
+	for (auto const& entry : stepped.members) {
+		auto it = model.members.find(entry.first);
+		ASSERT_NE(it, model.members.end());
+		EXPECT_EQ(stepped.liveness(entry.second).ttl, model.liveness(it->second).ttl);
+		EXPECT_EQ(stepped.liveness(entry.second).state, model.liveness(it->second).state);
+		EXPECT_NEAR(stepped.liveness(entry.second).probabitily, model.liveness(it->second).probabitily, 1e-5f);
 	}
+
+	// Peer {1} has been suspected since the second tick, then dead and expired once its ttl has run out
+	ASSERT_EQ(1, model.members.size());
+	ASSERT_EQ(model.members.end(), model.members.find({1}));
+}
+
+TEST(Model, LazyDecay_matchesEager) {
+	auto eager = PeersModel{};
+	eager.params.peerInfoDecayRate = 0.05f;
+	eager.params.peerInfoDecayTimeMs = 1000;
+
+	auto lazy = eager;
+	lazy.params.lazyDecay = true;
+
+	std::mt19937 rng{17};
+	std::uniform_int_distribution<Solace::uint16> ttls{0, 30};
+	for (Solace::uint32 i = 1; i <= 64; ++i) {
+		auto const ttl = ttls(rng);
+		eager = update(std::move(eager), AddPeer{anyAddress(static_cast<Solace::uint16>(i)), {{i}, 0}, ttl});
+		lazy = update(std::move(lazy), AddPeer{anyAddress(static_cast<Solace::uint16>(i)), {{i}, 0}, ttl});
+	}
+
+	auto const decay = DecayPeerInfo{1, eager.params.peerInfoDecayTimeMs, eager.params.peerInfoDecayRate,
+			DecayMode::Exponential};
+	for (Solace::uint32 tick = 0; tick < 60; ++tick) {
+		if (tick == 5) {
+			eager = update(std::move(eager), PronouncePeerDead{{{3}, 0}});
+			lazy = update(std::move(lazy), PronouncePeerDead{{{3}, 0}});
+		}
+		if (tick == 7) {
+			eager = update(std::move(eager), UpdatePeerGeneration{{4}, 1, 20});
+			lazy = update(std::move(lazy), UpdatePeerGeneration{{4}, 1, 20});
+		}
+
+		eager = update(std::move(eager), Action{decay});
+		lazy = update(std::move(lazy), Action{decay});
+
+		ASSERT_EQ(eager.members.size(), lazy.members.size()) << "tick " << tick;
+		for (auto const& entry : eager.members) {
+			auto it = lazy.members.find(entry.first);
+			ASSERT_NE(lazy.members.end(), it);
+
+			auto const liveness = lazy.liveness(it->second);
+			ASSERT_EQ(eager.liveness(entry.second).state, liveness.state) << "tick " << tick;
+			ASSERT_EQ(eager.liveness(entry.second).ttl, liveness.ttl) << "tick " << tick;
+			ASSERT_NEAR(eager.liveness(entry.second).probabitily, liveness.probabitily, 1e-5f);
+			ASSERT_EQ(eager.isHealthy(entry.second), lazy.isHealthy(it->second));
+		}
+
+		expectIndexesConsistent(eager);
+		expectIndexesConsistent(lazy);
+	}
+
+	EXPECT_TRUE(lazy.members.empty());
+}
+
+
+TEST(Model, LazyDecay_advanceByManyTicks) {
+	auto model = PeersModel{};
+	model.params.lazyDecay = true;
+	model = update(std::move(model), AddPeer{anyAddress(1), {{1}, 0}, 3});
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 0}, 300});
+
+	// Decay advances the clock, peers are only updated on state transitions
+	model = update(std::move(model), DecayPeerInfo{2, 0, 0});
+	ASSERT_EQ(2, model.now);
+	ASSERT_EQ(2, model.members.size());
+	EXPECT_EQ(1, model.liveness(model.members.find({1})->second).ttl);
+	EXPECT_TRUE(model.isSuspected(model.members.find({1})->second));
+	EXPECT_EQ(2, model.suspected.size());
+
+	model = update(std::move(model), DecayPeerInfo{200, 0, 0});
+	ASSERT_EQ(1, model.members.size());
+
+	auto const& peer = model.members.find({2})->second;
+	EXPECT_TRUE(model.isSuspected(peer));
+	EXPECT_FALSE(model.isHealthy(peer));
+	EXPECT_EQ(98, model.liveness(peer).ttl);
 }
 
+TEST(Model, StateViews) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(1), {{1}, 0}, 2});
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 0}, 4});
+	model = update(std::move(model), AddPeer{anyAddress(3), {{3}, 0}, 0});
+	model = update(std::move(model), AddPeer{anyAddress(4), {{4}, 0}, 9});
+	EXPECT_TRUE(model.suspectedPeers().empty());
+	EXPECT_TRUE(model.deadPeers().empty());
+
+	model = update(std::move(model), PronouncePeerDead{{{3}, 0}});
+	model = update(std::move(model), PronouncePeerDead{{{4}, 0}});
+	ASSERT_EQ(2, model.deadPeers().size());
+	ASSERT_EQ(model.dead.find({3})->second, model.now);
+
+	// Only the peer with no ttl left is expired
+	{
+		int count = 0;
+		for (auto const& entry : model.expiredPeers()) {
+			EXPECT_EQ(3, entry.first.value);
+			EXPECT_TRUE(model.isExpired(entry.second));
+			count += 1;
+		}
+		EXPECT_EQ(1, count);
+	}
+
+	// Decay such that all alive nodes transition to suspected in one go
+	model = update(std::move(model), DecayPeerInfo{1, 1000, (1 - Peer::kMaybeNotAlive*0.9f/Peer::kCertainlyAlive)});
+	ASSERT_EQ(3, model.members.size());
+	expectIndexesConsistent(model);
+	{
+		int count = 0;
+		for (auto const& entry : model.suspectedPeers()) {
+			EXPECT_TRUE(model.isSuspected(entry.second));
+			count += 1;
+		}
+		EXPECT_EQ(2, count);
+		EXPECT_EQ(1, model.suspected.find({1})->second);
+	}
+
+	// Suspected peer {1} runs out of ttl, is pronounced dead and removed as expired
+	model = update(std::move(model), ForgetPeer{{2}});
+	model = update(std::move(model), DecayPeerInfo{1, 1000, 0});
+	expectIndexesConsistent(model);
+	ASSERT_EQ(1, model.members.size());
+	EXPECT_TRUE(model.suspectedPeers().empty());
+	ASSERT_EQ(1, model.deadPeers().size());
+}
 
 TEST(Model, noPeerNoRedirect) {
 	ASSERT_TRUE(PeersModel{}.findRedirectAddress().isNone());
@@ -307,3 +503,159 @@ TEST(Model, findRedirectAddress) {
 	ASSERT_TRUE(update(PeersModel{}, AddPeer{address, {{1}, 0}, 0}).findRedirectAddress().isNone());
 	ASSERT_EQ(update(PeersModel{}, AddPeer{address, {{1}, 0}, 2}).findRedirectAddress(), address);
 }
+
+
+TEST(Model, PeerIdSet) {
+	PeerIdSet set;
+	ASSERT_TRUE(set.empty());
+
+	for (Solace::uint32 i = 0; i < 10; ++i) {
+		ASSERT_TRUE(set.insert({i}));
+	}
+	ASSERT_FALSE(set.insert({3}));
+	ASSERT_EQ(10, set.size());
+
+	ASSERT_TRUE(set.erase({0}));
+	ASSERT_TRUE(set.erase({9}));
+	ASSERT_TRUE(set.erase({4}));
+	ASSERT_FALSE(set.erase({4}));
+	ASSERT_EQ(7, set.size());
+
+	for (Solace::uint32 i = 0; i < 10; ++i) {
+		EXPECT_EQ(i != 0 && i != 4 && i != 9, set.contains({i}));
+	}
+
+	for (PeerIdSet::size_type i = 0; i < set.size(); ++i) {
+		EXPECT_TRUE(set.contains(set[i]));
+	}
+}
+
+
+TEST(Model, findRedirectAddress_spreadsLoad) {
+	auto model = PeersModel{};
+	for (Solace::uint32 i = 1; i <= 8; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<Solace::uint16>(i)), {{i}, 0}, 3});
+	}
+	model = update(std::move(model), PronouncePeerDead{{{8}, 0}});
+	ASSERT_EQ(7, model.healthy.size());
+
+	// Uniformly distributed random values pick every healthy peer equally
+	std::vector<int> picks(9, 0);
+	Solace::uint64 const nSamples = 7 * 64;
+	for (Solace::uint64 i = 0; i < nSamples; ++i) {
+		auto const random = ((2*i + 1) << 31) / nSamples;
+		auto address = model.findRedirectAddress(random);
+		ASSERT_TRUE(address.isSome());
+		for (Solace::uint16 port = 1; port <= 8; ++port) {
+			picks[port] += (*address == anyAddress(port)) ? 1 : 0;
+		}
+	}
+
+	EXPECT_EQ(0, picks[8]);
+	for (int i = 1; i < 8; ++i) {
+		EXPECT_EQ(64, picks[i]);
+	}
+
+	// Prefer peers with spare capacity
+	auto const random = (Solace::uint64{0xFFFFFFFF} << 32);  // Picks the first and then the last healthy peer
+	auto const firstId = model.healthy[0];
+	auto const lastId = model.healthy[model.healthy.size() - 1];
+	model.members.update(lastId, [](Peer& peer) { peer.capacity = 10; });
+
+	auto const firstAddress = model.members.find(firstId)->second.address;
+	auto const lastAddress = model.members.find(lastId)->second.address;
+	EXPECT_EQ(firstAddress, *model.findRedirectAddress(random));
+	EXPECT_EQ(lastAddress, *model.findRedirectAddress(random, true));
+
+	model.members.update(firstId, [](Peer& peer) { peer.capacity = 12; });
+	EXPECT_EQ(firstAddress, *model.findRedirectAddress(random, true));
+}
+
+
+TEST(Model, updateBatch) {
+	auto maybeTestAddress = tryParseAddress("10.1.2.3:7654");
+	ASSERT_TRUE(maybeTestAddress.isOk());
+	auto const address = *maybeTestAddress;
+
+	auto makeActions = [&address]() {
+		return std::vector<Action>{
+			AddSeed{anyAddress(888), 2},
+			AddPeer{anyAddress(321), {{1}, 0}, 2},
+			AddPeer{address, {{2}, 0}, 3},
+			AddPeer{anyAddress(13), {{3}, 0}, 1},
+			UpdatePeerGeneration{{1}, 4, 5},
+			PronouncePeerDead{{{3}, 3}},
+			UpdatePeerAddress{{{2}, 1}, anyAddress(17)},
+			ForgetPeer{{72}},
+			DecayPeerInfo{1, 1000, 0.1f}
+		};
+	};
+
+	auto const initialModel = update(PeersModel{}, AddPeer{anyAddress(7), {{7}, 0}, 4});
+
+	auto expected = initialModel;
+	for (auto& action : makeActions()) {
+		expected = update(expected, std::move(action));
+	}
+
+	auto actions = makeActions();
+	auto const model = update(initialModel, Solace::arrayView(actions.data(), actions.size()));
+
+	// Batch update does not change the original model
+	ASSERT_EQ(1, initialModel.members.size());
+	ASSERT_TRUE(initialModel.seeds.empty());
+
+	ASSERT_EQ(expected.seeds.size(), model.seeds.size());
+	ASSERT_EQ(expected.members.size(), model.members.size());
+	for (auto const& entry : expected.members) {
+		auto it = model.members.find(entry.first);
+		ASSERT_NE(it, model.members.end());
+		EXPECT_EQ(entry.second.generation, it->second.generation);
+		EXPECT_EQ(entry.second.address, it->second.address);
+		EXPECT_EQ(expected.liveness(entry.second).ttl, model.liveness(it->second).ttl);
+		EXPECT_EQ(expected.liveness(entry.second).state, model.liveness(it->second).state);
+	}
+}
+
+
+TEST(Model, updateOwnedModel) {
+	auto model = update(PeersModel{}, AddPeer{anyAddress(321), {{1}, 0}, 1});
+	model = update(std::move(model), AddPeer{anyAddress(322), {{2}, 0}, 1});
+
+	auto const snapshot = model;
+	model = update(std::move(model), UpdatePeerGeneration{{1}, 8, 1});
+	model = update(std::move(model), PronouncePeerDead{{{2}, 1}});
+
+	ASSERT_EQ(2, model.members.size());
+	ASSERT_EQ(8, model.members.find({1})->second.generation);
+	ASSERT_EQ(Peer::State::Dead, model.liveness(model.members.find({2})->second).state);
+
+	// Copies of the model are not affected by in-place updates
+	ASSERT_EQ(0, snapshot.members.find({1})->second.generation);
+	ASSERT_EQ(Peer::State::Alive, snapshot.liveness(snapshot.members.find({2})->second).state);
+}
+
+
+TEST(Model, indexesOfCopiesAreIndependent) {
+	auto model = PeersModel{};
+	model.params.lazyDecay = true;
+	for (Solace::uint32 i = 1; i <= 100; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<Solace::uint16>(i)), {{i}, 0}, 8});
+	}
+
+	auto const snapshot = model;
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, {2}});
+	model = update(std::move(model), PronouncePeerDead{{{3}, 0}});
+	model = update(std::move(model), ForgetPeer{{4}});
+	model = update(std::move(model), DecayPeerInfo{64, 1300, 0.3f});
+
+	expectIndexesConsistent(model);
+	EXPECT_TRUE(model.healthy.empty());
+
+	// Updates of the copy do not leak into the snapshot
+	expectIndexesConsistent(snapshot);
+	EXPECT_EQ(100u, snapshot.healthy.size());
+	EXPECT_TRUE(snapshot.suspected.empty());
+	EXPECT_TRUE(snapshot.dead.empty());
+	EXPECT_EQ(100u, snapshot.livenessEvents.size());
+}
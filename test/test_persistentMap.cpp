@@ -0,0 +1,257 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_persistentMap.cpp
+ *	@brief		Test suit for tribe::PersistentMap
+ ******************************************************************************/
+#include "tribe/persistentMap.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <unordered_map>
+
+
+using namespace tribe;
+
+
+namespace {
+
+/// Degenerate hash to force all keys into collision nodes
+struct ConstantHash {
+	size_t operator()(int) const noexcept { return 42; }
+};
+
+/// Hash that only differs in the highest bits to force deep tries
+struct HighBitsHash {
+	size_t operator()(int value) const noexcept { return static_cast<size_t>(value) << (sizeof(size_t)*8 - 8); }
+};
+
+template<typename Map>
+size_t countByIteration(Map const& map) {
+	size_t count = 0;
+	for (auto it = map.begin(); it != map.end(); ++it) {
+		++count;
+	}
+
+	return count;
+}
+
+}  // namespace
+
+
+TEST(PersistentMap, emptyMap) {
+	PersistentMap<int, int> map;
+
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(0, map.size());
+	ASSERT_EQ(map.begin(), map.end());
+	ASSERT_EQ(map.find(3), map.end());
+}
+
+
+TEST(PersistentMap, insertAndFind) {
+	PersistentMap<int, int> map;
+
+	ASSERT_TRUE(map.try_emplace(1, 10));
+	ASSERT_TRUE(map.try_emplace(2, 20));
+	ASSERT_FALSE(map.try_emplace(1, 30));
+	ASSERT_EQ(2, map.size());
+
+	auto it = map.find(1);
+	ASSERT_NE(it, map.end());
+	ASSERT_EQ(10, it->second);
+
+	ASSERT_FALSE(map.insert_or_assign(1, 30));
+	ASSERT_EQ(30, map.find(1)->second);
+	ASSERT_EQ(2, map.size());
+}
+
+
+TEST(PersistentMap, copiesAreIndependent) {
+	PersistentMap<int, int> map;
+	for (int i = 0; i < 100; ++i) {
+		map.insert_or_assign(i, i);
+	}
+
+	auto copy = map;
+	copy.insert_or_assign(7, -7);
+	copy.erase(8);
+	copy.insert_or_assign(100, 100);
+
+	ASSERT_EQ(100, map.size());
+	ASSERT_EQ(7, map.find(7)->second);
+	ASSERT_NE(map.find(8), map.end());
+	ASSERT_EQ(map.find(100), map.end());
+
+	ASSERT_EQ(100, copy.size());
+	ASSERT_EQ(-7, copy.find(7)->second);
+	ASSERT_EQ(copy.find(8), copy.end());
+	ASSERT_NE(copy.find(100), copy.end());
+}
+
+
+TEST(PersistentMap, update) {
+	PersistentMap<int, int> map;
+	map.insert_or_assign(3, 1);
+
+	auto copy = map;
+	ASSERT_TRUE(copy.update(3, [](int& value) { value += 2; }));
+	ASSERT_FALSE(copy.update(4, [](int& value) { value += 2; }));
+
+	ASSERT_EQ(1, map.find(3)->second);
+	ASSERT_EQ(3, copy.find(3)->second);
+	ASSERT_EQ(1, copy.size());
+}
+
+
+TEST(PersistentMap, erase) {
+	PersistentMap<int, int> map;
+	map.insert_or_assign(1, 1);
+	map.insert_or_assign(2, 2);
+
+	ASSERT_EQ(0, map.erase(3));
+	ASSERT_EQ(1, map.erase(1));
+	ASSERT_EQ(0, map.erase(1));
+	ASSERT_EQ(1, map.size());
+	ASSERT_EQ(map.find(1), map.end());
+
+	ASSERT_EQ(1, map.erase(2));
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(map.begin(), map.end());
+}
+
+
+TEST(PersistentMap, hashCollisions) {
+	PersistentMap<int, int, ConstantHash> map;
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_TRUE(map.insert_or_assign(i, i * 2));
+	}
+
+	ASSERT_EQ(10, map.size());
+	ASSERT_EQ(10, countByIteration(map));
+	for (int i = 0; i < 10; ++i) {
+		auto it = map.find(i);
+		ASSERT_NE(it, map.end());
+		ASSERT_EQ(i * 2, it->second);
+	}
+
+	for (int i = 0; i < 10; i += 2) {
+		ASSERT_EQ(1, map.erase(i));
+	}
+	ASSERT_EQ(5, map.size());
+	ASSERT_EQ(5, countByIteration(map));
+	ASSERT_EQ(map.find(2), map.end());
+	ASSERT_NE(map.find(3), map.end());
+}
+
+
+TEST(PersistentMap, deepTrie) {
+	PersistentMap<int, int, HighBitsHash> map;
+	for (int i = 0; i < 256; ++i) {
+		map.insert_or_assign(i, i);
+	}
+
+	ASSERT_EQ(256, countByIteration(map));
+	for (int i = 0; i < 256; ++i) {
+		ASSERT_EQ(1, map.erase(i));
+		ASSERT_EQ(map.find(i), map.end());
+	}
+
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(map.begin(), map.end());
+}
+
+
+TEST(PersistentMap, iterateFromFind) {
+	PersistentMap<int, int> map;
+	for (int i = 0; i < 2000; ++i) {
+		map.insert_or_assign(i, i);
+	}
+
+	// Iteration resumed from any position must visit the rest of the entries
+	size_t visited = 0;
+	for (auto it = map.begin(); it != map.end(); ++it, ++visited) {
+		auto fromFind = map.find(it->first);
+		ASSERT_EQ(fromFind, it);
+
+		size_t remaining = 0;
+		for (; fromFind != map.end(); ++fromFind) {
+			++remaining;
+		}
+		ASSERT_EQ(map.size() - visited, remaining);
+
+		if (visited > 100) break;
+	}
+}
+
+
+TEST(PersistentMap, matchesUnorderedMap) {
+	std::mt19937 rng{7};
+	std::uniform_int_distribution<int> keys{0, 4096};
+
+	std::unordered_map<int, int> expected;
+	PersistentMap<int, int> map;
+
+	for (int i = 0; i < 20000; ++i) {
+		auto const key = keys(rng);
+		if (i % 3 == 0) {
+			ASSERT_EQ(expected.erase(key), map.erase(key));
+		} else {
+			expected[key] = i;
+			map.insert_or_assign(key, i);
+		}
+	}
+
+	ASSERT_EQ(expected.size(), map.size());
+	ASSERT_EQ(expected.size(), countByIteration(map));
+	for (auto const& entry : map) {
+		auto it = expected.find(entry.first);
+		ASSERT_NE(it, expected.end());
+		ASSERT_EQ(it->second, entry.second);
+	}
+}
+
+
+TEST(PersistentMap, inPlaceEditsDontLeakIntoCopies) {
+	PersistentMap<int, int> map;
+	for (int i = 0; i < 1000; ++i) {
+		map.insert_or_assign(i, i);
+	}
+
+	auto const snapshot = map;
+
+	// First edit copies the path shared with the snapshot, the following edits modify owned nodes in-place.
+	for (int i = 0; i < 1000; ++i) {
+		map.insert_or_assign(i, -i);
+		if (i % 2) {
+			map.erase(i);
+		}
+	}
+
+	ASSERT_EQ(500, map.size());
+	ASSERT_EQ(1000, snapshot.size());
+	for (int i = 0; i < 1000; ++i) {
+		auto it = snapshot.find(i);
+		ASSERT_NE(it, snapshot.end());
+		ASSERT_EQ(i, it->second);
+	}
+
+	for (int i = 0; i < 1000; i += 2) {
+		ASSERT_EQ(-i, map.find(i)->second);
+	}
+}
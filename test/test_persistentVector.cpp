@@ -0,0 +1,157 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_persistentVector.cpp
+ *	@brief		Test suit for tribe::PersistentVector
+ ******************************************************************************/
+#include "tribe/persistentVector.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+
+using namespace tribe;
+
+
+TEST(PersistentVector, emptyVector) {
+	PersistentVector<int> vector;
+
+	ASSERT_TRUE(vector.empty());
+	ASSERT_EQ(0u, vector.size());
+	ASSERT_TRUE(vector.begin() == vector.end());
+}
+
+
+TEST(PersistentVector, pushBackAndIndex) {
+	PersistentVector<int> vector;
+	// Enough values to grow the trie by a few levels
+	for (int i = 0; i < 40000; ++i) {
+		vector.push_back(i);
+	}
+
+	ASSERT_EQ(40000u, vector.size());
+	ASSERT_EQ(39999, vector.back());
+	for (int i = 0; i < 40000; ++i) {
+		ASSERT_EQ(i, vector[static_cast<size_t>(i)]);
+	}
+
+	int expected = 0;
+	for (auto value : vector) {
+		ASSERT_EQ(expected++, value);
+	}
+	ASSERT_EQ(40000, expected);
+}
+
+
+TEST(PersistentVector, popBackShrinks) {
+	PersistentVector<int, 0> vector;
+	for (int i = 0; i < 2000; ++i) {
+		vector.push_back(i);
+	}
+
+	for (int i = 1999; i >= 0; --i) {
+		ASSERT_EQ(i, vector.back());
+		vector.pop_back();
+		ASSERT_EQ(static_cast<size_t>(i), vector.size());
+	}
+
+	ASSERT_TRUE(vector.empty());
+
+	// Vector is usable after being emptied
+	vector.push_back(7);
+	ASSERT_EQ(7, vector[0]);
+}
+
+
+TEST(PersistentVector, copiesAreIndependent) {
+	PersistentVector<int> original;
+	for (int i = 0; i < 1000; ++i) {
+		original.push_back(i);
+	}
+
+	auto copy = original;
+	copy.set(500, -1);
+	copy.update(10, [](int& value) { value *= 100; });
+	copy.push_back(1000);
+	copy.pop_back();
+	copy.pop_back();
+
+	ASSERT_EQ(1000u, original.size());
+	ASSERT_EQ(500, original[500]);
+	ASSERT_EQ(10, original[10]);
+	ASSERT_EQ(999, original.back());
+
+	ASSERT_EQ(999u, copy.size());
+	ASSERT_EQ(-1, copy[500]);
+	ASSERT_EQ(1000, copy[10]);
+	ASSERT_EQ(998, copy.back());
+}
+
+
+TEST(PersistentVector, updateEachVisitsValuesInOrder) {
+	PersistentVector<int> original;
+	for (int i = 0; i < 5000; ++i) {
+		original.push_back(i);
+	}
+
+	auto copy = original;
+	size_t expectedIndex = 0;
+	copy.updateEach([&expectedIndex](size_t index, int& value) {
+		ASSERT_EQ(expectedIndex++, index);
+		value += 1;
+	});
+
+	ASSERT_EQ(5000u, expectedIndex);
+	for (size_t i = 0; i < 5000; ++i) {
+		ASSERT_EQ(static_cast<int>(i), original[i]);
+		ASSERT_EQ(static_cast<int>(i) + 1, copy[i]);
+	}
+}
+
+
+TEST(PersistentVector, matchesStdVector) {
+	std::mt19937 rng{42};
+	std::vector<int> reference;
+	PersistentVector<int, 2> vector;
+	std::vector<PersistentVector<int, 2>> versions;
+
+	for (int i = 0; i < 20000; ++i) {
+		auto const op = rng() % 4;
+		if (op == 0 && !reference.empty()) {
+			reference.pop_back();
+			vector.pop_back();
+		} else if (op == 1 && !reference.empty()) {
+			auto const index = rng() % reference.size();
+			reference[index] = i;
+			vector.set(index, i);
+		} else {
+			reference.push_back(i);
+			vector.push_back(i);
+		}
+
+		if (i % 1000 == 0) {
+			versions.push_back(vector);  // Keep old versions around to force copying of shared nodes
+		}
+	}
+
+	ASSERT_EQ(reference.size(), vector.size());
+	for (size_t i = 0; i < reference.size(); ++i) {
+		ASSERT_EQ(reference[i], vector[i]);
+	}
+}
@@ -0,0 +1,385 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_phiAccrual.cpp
+ *	@brief		Test suit for tribe::PhiAccrualDetector
+ ******************************************************************************/
+#include "tribe/phiAccrual.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <deque>
+#include <random>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+constexpr float32 kSuspect = 8.0f;
+constexpr float32 kDead = 16.0f;
+constexpr float32 kMinStdDev = 1.0f;
+
+
+PeersModel makeModel(uint32 nPeers) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{0}, 1};
+	for (uint32 i = 1; i <= nPeers; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(i)), {{i}, 1}, 8});
+	}
+
+	return model;
+}
+
+
+/// Ticks since the last heartbeat it takes phi to reach a threshold
+PeersModel::Tick ticksToReach(PhiAccrualEstimator const& estimator, float32 threshold) {
+	auto now = estimator.lastHeartbeat();
+	while (estimator.phi(now, kMinStdDev) < threshold) {
+		now += 1;
+	}
+
+	return now - estimator.lastHeartbeat();
+}
+
+}  // namespace
+
+
+TEST(TestPhiAccrual, windowKeepsRunningStats) {
+	std::mt19937 gen{11};
+	std::uniform_int_distribution<uint32> interval{1, 300};
+
+	PhiAccrualEstimator estimator{0, 20};
+	std::deque<uint32> window{20};
+
+	PeersModel::Tick now = 0;
+	for (int i = 0; i < 100; ++i) {
+		auto const dt = interval(gen);
+		now += dt;
+		estimator.heartbeat(now);
+
+		window.push_back(dt);
+		if (window.size() > PhiAccrualEstimator::kWindowSize) {
+			window.pop_front();
+		}
+
+		double sum = 0;
+		for (auto value : window) {
+			sum += value;
+		}
+		auto const mean = sum / window.size();
+
+		double squares = 0;
+		for (auto value : window) {
+			squares += (value - mean) * (value - mean);
+		}
+
+		ASSERT_EQ(window.size(), estimator.size());
+		EXPECT_NEAR(mean, estimator.mean(), 1e-3);
+		EXPECT_NEAR(squares / window.size(), estimator.variance(), 1e-2 * (1 + squares / window.size()));
+	}
+
+	EXPECT_EQ(now, estimator.lastHeartbeat());
+
+	// Out of order heartbeat is ignored
+	estimator.heartbeat(now - 1);
+	EXPECT_EQ(now, estimator.lastHeartbeat());
+	EXPECT_EQ(PhiAccrualEstimator::kWindowSize, estimator.size());
+}
+
+
+TEST(TestPhiAccrual, phiGrowsWithTimeSinceHeartbeat) {
+	PhiAccrualEstimator estimator{0, 10};
+	for (PeersModel::Tick now = 10; now <= 200; now += 10) {
+		estimator.heartbeat(now);
+	}
+
+	// Heartbeat just heard
+	EXPECT_LT(estimator.phi(200, kMinStdDev), 0.01f);
+
+	// Heartbeat is as late as usual: as likely to come as not
+	EXPECT_NEAR(std::log10(2.0f), estimator.phi(210, kMinStdDev), 1e-3f);
+
+	auto previous = estimator.phi(200, kMinStdDev);
+	for (PeersModel::Tick now = 201; now < 300; ++now) {
+		auto const phi = estimator.phi(now, kMinStdDev);
+		EXPECT_GE(phi, previous);
+		EXPECT_TRUE(std::isfinite(phi));
+		previous = phi;
+	}
+	EXPECT_GT(previous, kDead);
+}
+
+
+TEST(TestPhiAccrual, adaptsToLatencyProfile) {
+	std::mt19937 gen{3};
+	std::uniform_int_distribution<PeersModel::Tick> jitter{5, 15};
+
+	// Links with the same mean interval between heartbeats
+	PhiAccrualEstimator steady{0, 10};
+	PhiAccrualEstimator jittery{0, 10};
+	PeersModel::Tick steadyNow = 0;
+	PeersModel::Tick jitteryNow = 0;
+	for (int i = 0; i < 64; ++i) {
+		steady.heartbeat(steadyNow += 10);
+		jittery.heartbeat(jitteryNow += jitter(gen));
+	}
+
+	// Steady link is suspected soon after a heartbeat is missed, jittery link is given more time
+	auto const steadySuspectedIn = ticksToReach(steady, kSuspect);
+	auto const jitterySuspectedIn = ticksToReach(jittery, kSuspect);
+	EXPECT_GT(steadySuspectedIn, 10);
+	EXPECT_LE(steadySuspectedIn, 20);
+	EXPECT_GT(jitterySuspectedIn, steadySuspectedIn + 5);
+
+	// Yet neither is suspected while heartbeats are on time
+	EXPECT_LT(steady.phi(steady.lastHeartbeat() + 10, kMinStdDev), 1);
+	EXPECT_LT(jittery.phi(jittery.lastHeartbeat() + 15, kMinStdDev), kSuspect);
+}
+
+
+TEST(TestPhiAccrual, livenessFollowsPhiThresholds) {
+	PhiAccrualDetector detector{kSuspect, kDead, 10, kMinStdDev};
+	auto const alive = Peer::Liveness{8, Peer::kCertainlyAlive, Peer::State::Alive};
+
+	auto value = detector.liveness(alive, 0);
+	EXPECT_EQ(Peer::State::Alive, value.state);
+	EXPECT_NEAR(Peer::kCertainlyAlive, value.probabitily, 1e-6f);
+	EXPECT_TRUE(PeersModel::isHealthy(value));
+
+	value = detector.liveness(alive, kSuspect - 0.01f);
+	EXPECT_EQ(Peer::State::Alive, value.state);
+	EXPECT_TRUE(PeersModel::isHealthy(value));
+
+	value = detector.liveness(alive, kSuspect);
+	EXPECT_EQ(Peer::State::Suspected, value.state);
+	EXPECT_FALSE(PeersModel::isHealthy(value));
+
+	value = detector.liveness(value, 1);
+	EXPECT_EQ(Peer::State::Alive, value.state);
+
+	value = detector.liveness(alive, kDead);
+	EXPECT_EQ(Peer::State::Dead, value.state);
+	EXPECT_NEAR(Peer::kCertainlyNotAlive, value.probabitily, 1e-6f);
+
+	// Dead peers stay dead
+	EXPECT_EQ(Peer::State::Dead, detector.liveness(value, 0).state);
+
+	// TTL is not affected
+	EXPECT_EQ(alive.ttl, value.ttl);
+}
+
+
+TEST(TestPhiAccrual, thresholdsAreClamped) {
+	auto const alive = Peer::Liveness{8, Peer::kCertainlyAlive, Peer::State::Alive};
+
+	// Zero suspicion threshold must not turn probabilities into NaN
+	PhiAccrualDetector zero{0, 0, 10, kMinStdDev};
+	auto value = zero.liveness(alive, 0);
+	EXPECT_EQ(Peer::State::Alive, value.state);
+	EXPECT_FALSE(std::isnan(value.probabitily));
+
+	value = zero.liveness(alive, 1);
+	EXPECT_EQ(Peer::State::Dead, value.state);
+	EXPECT_FALSE(std::isnan(value.probabitily));
+
+	// Dead threshold below the suspicion threshold: peers go from alive to dead
+	PhiAccrualDetector inverted{kSuspect, 1, 10, kMinStdDev};
+	EXPECT_EQ(Peer::State::Alive, inverted.liveness(alive, kSuspect - 1).state);
+	EXPECT_EQ(Peer::State::Dead, inverted.liveness(alive, kSuspect).state);
+
+	PhiAccrualDetector nan{std::nanf(""), std::nanf(""), 10, kMinStdDev};
+	EXPECT_FALSE(std::isnan(nan.liveness(alive, 0).probabitily));
+}
+
+
+TEST(TestPhiAccrual, detectorDrivesPeerStates) {
+	auto model = makeModel(3);
+	PhiAccrualDetector detector{kSuspect, kDead, 5, kMinStdDev};
+
+	// Every peer heartbeats every 5 ticks for a while, then peer 2 goes silent and peer 3 pauses briefly
+	for (uint32 i = 1; i <= 3; ++i) {
+		detector.heartbeat(NodeID{i}, model.now);
+	}
+	EXPECT_EQ(3, detector.size());
+
+	while (model.now < 100) {
+		model = detector.tick(std::move(model));
+		if (model.now % 5 == 0) {
+			detector.heartbeat(NodeID{1}, model.now);
+			detector.heartbeat(NodeID{2}, model.now);
+			detector.heartbeat(NodeID{3}, model.now);
+		}
+	}
+	EXPECT_EQ(3, model.healthy.size());
+
+	Optional<PeersModel::Tick> suspectedAt;
+	Optional<PeersModel::Tick> deadAt;
+	while (model.now < 200) {
+		model = detector.tick(std::move(model));
+		if (model.now % 5 == 0) {
+			detector.heartbeat(NodeID{1}, model.now);
+		}
+
+		if (model.now == 111) {  // Pause of peer 3 has been long enough to suspect it, but not to deem it dead
+			EXPECT_TRUE(model.isSuspected(model.members.find(NodeID{3})->second));
+			EXPECT_NE(model.suspicions.end(), model.suspicions.find(NodeID{3}));
+		}
+		if (model.now >= 111 && model.now % 5 == 1) {
+			detector.heartbeat(NodeID{3}, model.now);
+		}
+
+		auto const& peer = model.members.find(NodeID{2})->second;
+		if (!suspectedAt && model.isSuspected(peer)) {
+			suspectedAt = model.now;
+			EXPECT_FALSE(model.healthy.contains(NodeID{2}));
+			EXPECT_NE(model.suspected.end(), model.suspected.find(NodeID{2}));
+
+			// Suspicion is started by this node
+			auto suspicion = model.suspicions.find(NodeID{2});
+			ASSERT_NE(model.suspicions.end(), suspicion);
+			EXPECT_EQ(model.node.id, suspicion->second.suspecters[0]);
+			EXPECT_EQ(1u, suspicion->second.count);
+		}
+		if (!deadAt && model.isDead(peer)) {
+			deadAt = model.now;
+			EXPECT_NE(model.dead.end(), model.dead.find(NodeID{2}));
+		}
+	}
+
+	ASSERT_TRUE(suspectedAt.isSome());
+	ASSERT_TRUE(deadAt.isSome());
+	EXPECT_LT(*suspectedAt, *deadAt);
+	EXPECT_LE(*suspectedAt, 100 + 15);
+
+	// Peer that kept heartbeating is healthy, peer that has resumed is alive again
+	EXPECT_TRUE(model.healthy.contains(NodeID{1}));
+	EXPECT_TRUE(model.isAlive(model.members.find(NodeID{3})->second));
+	EXPECT_TRUE(model.healthy.contains(NodeID{3}));
+	EXPECT_TRUE(model.isDead(model.members.find(NodeID{2})->second));
+
+	// Suspicion of the peer that has resumed is dropped, as is that of the dead peer
+	EXPECT_EQ(model.suspicions.end(), model.suspicions.find(NodeID{3}));
+	EXPECT_EQ(model.suspicions.end(), model.suspicions.find(NodeID{2}));
+}
+
+
+TEST(TestPhiAccrual, confirmedSuspicionTimesOut) {
+	auto model = makeModel(1);
+	// Dead threshold is out of reach: only the suspicion timeout makes the peer dead
+	PhiAccrualDetector detector{kSuspect, 1e6f, 5, kMinStdDev};
+
+	detector.heartbeat(NodeID{1}, model.now);
+	while (model.now < 50) {
+		model = detector.tick(std::move(model));
+		if (model.now % 5 == 0) {
+			detector.heartbeat(NodeID{1}, model.now);
+		}
+	}
+
+	while (!model.isSuspected(model.members.find(NodeID{1})->second)) {
+		model = detector.tick(std::move(model));
+		ASSERT_LT(model.now, 100);
+	}
+	auto const suspectedAt = model.now;
+
+	// Other members confirm the suspicion: the timeout shrinks from TTL of the peer down to the min timeout
+	for (uint32 from = 7; from < 7 + model.params.suspicionConfirmations; ++from) {
+		model = update(std::move(model), SuspectPeer{{{1}, 1}, {from}});
+	}
+	auto const suspicion = model.suspicions.find(NodeID{1});
+	ASSERT_NE(model.suspicions.end(), suspicion);
+	EXPECT_EQ(model.params.suspicionConfirmations, suspicion->second.confirmations());
+
+	while (model.now + 1 < suspectedAt + model.params.suspicionMinTimeout) {
+		model = detector.tick(std::move(model));
+		EXPECT_TRUE(model.isSuspected(model.members.find(NodeID{1})->second));
+	}
+
+	model = detector.tick(std::move(model));
+	EXPECT_TRUE(model.isDead(model.members.find(NodeID{1})->second));
+	EXPECT_NE(model.dead.end(), model.dead.find(NodeID{1}));
+}
+
+
+TEST(TestPhiAccrual, gossipedSuspicionStandsUntilPeerIsHeardFrom) {
+	auto model = makeModel(2);
+	PhiAccrualDetector detector{kSuspect, kDead, 5, kMinStdDev};
+
+	detector.heartbeat(NodeID{1}, model.now);
+	detector.heartbeat(NodeID{2}, model.now);
+	while (model.now < 52) {
+		model = detector.tick(std::move(model));
+		if (model.now % 5 == 0) {
+			detector.heartbeat(NodeID{1}, model.now);
+			detector.heartbeat(NodeID{2}, model.now);
+		}
+	}
+
+	// Another member suspects both peers, while their phi is still low: TTL of 8 is the suspicion timeout
+	model = update(std::move(model), SuspectPeer{{{1}, 1}, {7}});
+	model = update(std::move(model), SuspectPeer{{{2}, 1}, {7}});
+
+	while (model.now < 52 + 8) {
+		model = detector.tick(std::move(model));
+		if (model.now <= 55) {
+			EXPECT_TRUE(model.isSuspected(model.members.find(NodeID{1})->second)) << "tick " << model.now;
+		} else {
+			EXPECT_TRUE(model.isAlive(model.members.find(NodeID{1})->second)) << "tick " << model.now;
+		}
+
+		if (model.now < 52 + 8) {
+			EXPECT_TRUE(model.isSuspected(model.members.find(NodeID{2})->second)) << "tick " << model.now;
+		}
+
+		// Only peer 1 is heard from
+		if (model.now == 55) {
+			detector.heartbeat(NodeID{1}, model.now);
+		}
+	}
+
+	// Suspicion of the peer heard from is dropped, the other one has timed out before its phi got to the threshold
+	EXPECT_EQ(model.suspicions.end(), model.suspicions.find(NodeID{1}));
+	EXPECT_TRUE(model.isDead(model.members.find(NodeID{2})->second));
+	EXPECT_LT(*detector.phi(NodeID{2}, model.now), kSuspect);
+}
+
+
+TEST(TestPhiAccrual, onlyTrackedPeersAreEstimated) {
+	auto model = makeModel(3);
+	PhiAccrualDetector detector{kSuspect, kDead, 5, kMinStdDev};
+	detector.heartbeat(NodeID{1}, 0);
+	detector.heartbeat(NodeID{2}, 0);
+	EXPECT_TRUE(detector.phi(NodeID{3}, 0).isNone());
+
+	model = update(std::move(model), ForgetPeer{NodeID{2}});
+	for (int i = 0; i < 50; ++i) {
+		model = detector.tick(std::move(model));
+	}
+
+	// Peer that has left is forgotten, peer that is not tracked is left as is
+	EXPECT_EQ(1, detector.size());
+	EXPECT_TRUE(detector.phi(NodeID{2}, model.now).isNone());
+	EXPECT_TRUE(model.isDead(model.members.find(NodeID{1})->second));
+	EXPECT_TRUE(model.healthy.contains(NodeID{3}));
+
+	detector.forget(NodeID{1});
+	EXPECT_EQ(0, detector.size());
+}
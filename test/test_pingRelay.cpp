@@ -0,0 +1,227 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_pingRelay.cpp
+ *	@brief		Test suit for relaying of indirect pings
+ ******************************************************************************/
+#include "tribe/pingRelay.hpp"    // Class being tested.
+#include "tribe/probeScheduler.hpp"
+#include "tribe/protocol/messageWriter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+/// Model of a node that knows of the given peers
+PeersModel makeModel(uint32 self, std::initializer_list<uint32> peers) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{self}, 1};
+	for (auto id : peers) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(id)), {{id}, 1}, 100});
+	}
+
+	return model;
+}
+
+
+struct TestPingRelay : public ::testing::Test {
+
+	MutableMemoryView written() {
+		return wrapMemory(buffer, writer.position());
+	}
+
+	template<typename MessageType>
+	MessageType parse(MemoryView datagram) {
+		ByteReader reader{datagram};
+		auto maybeMessage = MessageParser{}.parseView(reader);
+		EXPECT_TRUE(maybeMessage.isOk());
+
+		return std::get<MessageType>(*maybeMessage);
+	}
+
+protected:
+	byte buffer[256] = {0};
+	ByteWriter writer{wrapMemory(buffer)};
+	MessageWriter messageWriter{writer};
+};
+
+}  // namespace
+
+
+TEST_F(TestPingRelay, pingIsForwardedToTarget) {
+	auto const relayModel = makeModel(2, {1, 3});
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Suspect, {{9}, 4}, anyAddress(9)},
+	};
+	messageWriter.ping(NodeID{1}, NodeID{3}, 1, ArrayView<MembershipUpdate const>{updates});
+
+	byte original[sizeof(buffer)];
+	std::memcpy(original, buffer, sizeof(buffer));
+
+	auto maybeRoute = relay(relayModel, written());
+	ASSERT_TRUE(maybeRoute.isOk());
+	EXPECT_EQ(Route::Kind::Forward, maybeRoute.unwrap().kind);
+	EXPECT_EQ(anyAddress(3), maybeRoute.unwrap().nextHop);
+
+	// Only ttl has changed
+	auto const ping = parse<PingMessage>(written());
+	EXPECT_EQ(0, ping.ttl);
+	EXPECT_EQ(NodeID{1}, ping.origin);
+	EXPECT_EQ(NodeID{3}, ping.target);
+	EXPECT_EQ(1, ping.updates.count);
+
+	for (uint32 i = 0; i < writer.position(); ++i) {
+		if (i != 9) {
+			EXPECT_EQ(original[i], buffer[i]) << "byte " << i;
+		}
+	}
+}
+
+
+TEST_F(TestPingRelay, updatesAreNotDecodedWhenForwarding) {
+	auto const relayModel = makeModel(2, {1, 3});
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Alive, {{9}, 4}, anyAddress(9)},
+	};
+	messageWriter.ping(NodeID{1}, NodeID{3}, 1, ArrayView<MembershipUpdate const>{updates});
+	buffer[10] = 200;  // Count of updates the ping has not got
+
+	auto maybeRoute = relay(relayModel, written());
+	ASSERT_TRUE(maybeRoute.isOk());
+	EXPECT_EQ(Route::Kind::Forward, maybeRoute.unwrap().kind);
+	EXPECT_EQ(0, buffer[9]);
+}
+
+
+TEST_F(TestPingRelay, pingIsDeliveredToTarget) {
+	auto const targetModel = makeModel(3, {2});
+
+	messageWriter.ping(NodeID{1}, NodeID{3});
+	auto maybeRoute = relay(targetModel, written());
+	ASSERT_TRUE(maybeRoute.isOk());
+	EXPECT_EQ(Route::Kind::Deliver, maybeRoute.unwrap().kind);
+	EXPECT_EQ(0, parse<PingMessage>(written()).ttl);
+}
+
+
+TEST_F(TestPingRelay, pingIsDroppedWhenTargetIsUnreachable) {
+	auto relayModel = makeModel(2, {1, 3, 4});
+	relayModel = update(std::move(relayModel), PronouncePeerDead{{{4}, 1}});
+
+	// TTL has run out
+	EXPECT_EQ(Route::Kind::Drop, route(relayModel, PingMessage{{1}, {3}, 0, PiggybackView{}}).kind);
+	// Unknown target
+	EXPECT_EQ(Route::Kind::Drop, route(relayModel, PingMessage{{1}, {5}, 1, PiggybackView{}}).kind);
+	// Dead target
+	EXPECT_EQ(Route::Kind::Drop, route(relayModel, PingMessage{{1}, {4}, 1, PiggybackView{}}).kind);
+
+	// Dropped datagram is left intact
+	messageWriter.ping(NodeID{1}, NodeID{5}, 1);
+	auto maybeRoute = relay(relayModel, written());
+	ASSERT_TRUE(maybeRoute.isOk());
+	EXPECT_EQ(Route::Kind::Drop, maybeRoute.unwrap().kind);
+	EXPECT_EQ(1, parse<PingMessage>(written()).ttl);
+}
+
+
+TEST_F(TestPingRelay, pongIsForwardedToRequester) {
+	auto const relayModel = makeModel(2, {1, 3});
+
+	messageWriter.pong(NodeID{1}, NodeInfo{{3}, 1}, 1);
+	auto maybeRoute = relay(relayModel, written());
+	ASSERT_TRUE(maybeRoute.isOk());
+	EXPECT_EQ(Route::Kind::Forward, maybeRoute.unwrap().kind);
+	EXPECT_EQ(anyAddress(1), maybeRoute.unwrap().nextHop);
+
+	auto const pong = parse<PongMessage>(written());
+	EXPECT_EQ(0, pong.ttl);
+	EXPECT_EQ(NodeID{1}, pong.origin);
+	EXPECT_EQ(NodeID{3}, pong.nodeDetails.id);
+}
+
+
+TEST_F(TestPingRelay, onlyPingsAndPongsAreRelayed) {
+	messageWriter.advertise(NodeInfo{{3}, 1});
+	EXPECT_TRUE(relay(makeModel(2, {3}), written()).isError());
+
+	byte truncated[] = {static_cast<byte>(Gossip::MessageType::PingDirect), 1, 0, 0, 0, 3};
+	EXPECT_TRUE(relay(makeModel(2, {3}), wrapMemory(truncated)).isError());
+}
+
+
+TEST_F(TestPingRelay, indirectProbe) {
+	// Node 1 probes node 3 through node 2, as it can not reach node 3 directly
+	auto const requesterModel = makeModel(1, {2, 3});
+	auto const helperModel = makeModel(2, {1, 3});
+	auto const targetModel = makeModel(3, {2});
+
+	ProbeScheduler scheduler{4, 1, 1, 5};
+	ProbeScheduler::Probe probes[3];
+	PeersModel::Tick now = 0;
+	while (true) {  // Wait for the turn of node 3
+		ASSERT_EQ(1, scheduler.tick(requesterModel, now, arrayView(probes)));
+		ASSERT_EQ(ProbeScheduler::Probe::Kind::Direct, probes[0].kind);
+		if (probes[0].target == NodeID{3}) {
+			break;
+		}
+
+		scheduler.onAck(probes[0].target);
+		now += 4;
+	}
+
+	// Direct ping is lost, helper is asked to ping the target
+	ASSERT_EQ(1, scheduler.tick(requesterModel, now + 1, arrayView(probes)));
+	ASSERT_EQ(ProbeScheduler::Probe::Kind::Indirect, probes[0].kind);
+	ASSERT_EQ(NodeID{2}, probes[0].via);
+
+	messageWriter.ping(requesterModel.node.id, probes[0].target, ProbeScheduler::kIndirectProbeTtl);
+	auto atHelper = relay(helperModel, written());
+	ASSERT_TRUE(atHelper.isOk());
+	ASSERT_EQ(Route::Kind::Forward, atHelper.unwrap().kind);
+
+	auto atTarget = relay(targetModel, written());
+	ASSERT_TRUE(atTarget.isOk());
+	ASSERT_EQ(Route::Kind::Deliver, atTarget.unwrap().kind);
+
+	// Target does not know the requester: it replies to the helper, that forwards the pong back
+	auto const ping = parse<PingMessage>(written());
+	byte reply[64];
+	ByteWriter replyWriter{wrapMemory(reply)};
+	MessageWriter{replyWriter}.pong(ping.origin, targetModel.node, ProbeScheduler::kIndirectProbeTtl);
+	auto const replyDatagram = wrapMemory(reply, replyWriter.position());
+
+	atHelper = relay(helperModel, replyDatagram);
+	ASSERT_TRUE(atHelper.isOk());
+	ASSERT_EQ(Route::Kind::Forward, atHelper.unwrap().kind);
+	EXPECT_EQ(anyAddress(1), atHelper.unwrap().nextHop);
+
+	auto atRequester = relay(requesterModel, replyDatagram);
+	ASSERT_TRUE(atRequester.isOk());
+	ASSERT_EQ(Route::Kind::Deliver, atRequester.unwrap().kind);
+
+	EXPECT_TRUE(scheduler.onAck(parse<PongMessage>(replyDatagram).nodeDetails.id));
+	EXPECT_FALSE(scheduler.awaitingAck());
+}
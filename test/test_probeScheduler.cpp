@@ -0,0 +1,335 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_probeScheduler.cpp
+ *	@brief		Test suit for tribe::ProbeScheduler
+ ******************************************************************************/
+#include "tribe/probeScheduler.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+constexpr PeersModel::Tick kPeriod = 5;
+constexpr PeersModel::Tick kTimeout = 2;
+constexpr uint32 kIndirectProbes = 3;
+
+
+PeersModel makeModel(uint32 nPeers) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{0}, 1};
+	for (uint32 i = 1; i <= nPeers; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(i)), {{i}, 0}, 1000});
+	}
+
+	return model;
+}
+
+
+/// Deterministic clock driving a scheduler one tick at a time
+struct ProbeDriver {
+	ProbeScheduler						scheduler{kPeriod, kTimeout, kIndirectProbes, 17};
+	PeersModel::Tick					now{0};
+	std::vector<ProbeScheduler::Probe>	probes;
+
+	/// Advance the clock by one tick and collect probes due
+	uint32 tick(PeersModel const& model) {
+		ProbeScheduler::Probe due[kIndirectProbes + 2];
+		auto const count = scheduler.tick(model, now++, arrayView(due));
+		probes.insert(probes.end(), due, due + count);
+
+		return count;
+	}
+
+	/// Run a number of protocol periods, acking direct probes of the peers that are up
+	void run(PeersModel const& model, uint32 nPeriods, std::set<uint32> const& down = {}) {
+		for (uint32 i = 0; i < nPeriods * kPeriod; ++i) {
+			tick(model);
+			auto const target = scheduler.target();
+			if (target && scheduler.awaitingAck() && !down.count((*target).value)) {
+				scheduler.onAck(*target);
+			}
+		}
+	}
+
+	std::vector<uint32> directTargets() const {
+		std::vector<uint32> result;
+		for (auto const& probe : probes) {
+			if (probe.kind == ProbeScheduler::Probe::Kind::Direct) {
+				result.push_back(probe.target.value);
+			}
+		}
+
+		return result;
+	}
+};
+
+}  // namespace
+
+
+TEST(TestProbeScheduler, nothingToProbe) {
+	ProbeDriver driver;
+	driver.run(PeersModel{}, 3);
+
+	EXPECT_TRUE(driver.probes.empty());
+	EXPECT_TRUE(driver.scheduler.target().isNone());
+}
+
+
+TEST(TestProbeScheduler, everyPeerIsProbedOncePerRound) {
+	auto const model = makeModel(10);
+
+	ProbeDriver driver;
+	driver.run(model, 20);
+
+	auto const targets = driver.directTargets();
+	ASSERT_EQ(20, targets.size());
+
+	auto const firstRound = std::set<uint32>(targets.begin(), targets.begin() + 10);
+	auto const secondRound = std::set<uint32>(targets.begin() + 10, targets.end());
+	EXPECT_EQ(10, firstRound.size());
+	EXPECT_EQ(10, secondRound.size());
+
+	// Rounds are shuffled
+	EXPECT_FALSE(std::equal(targets.begin(), targets.begin() + 10, targets.begin() + 10));
+
+	// Acked probes do not escalate
+	for (auto const& probe : driver.probes) {
+		EXPECT_EQ(ProbeScheduler::Probe::Kind::Direct, probe.kind);
+	}
+}
+
+
+TEST(TestProbeScheduler, indirectProbesOnTimeout) {
+	auto const model = makeModel(10);
+
+	ProbeDriver driver;
+	ASSERT_EQ(1, driver.tick(model));
+	auto const target = driver.probes[0].target;
+	EXPECT_EQ(target, *driver.scheduler.target());
+
+	// Waiting for an ack
+	for (PeersModel::Tick i = 1; i < kTimeout; ++i) {
+		EXPECT_EQ(0, driver.tick(model));
+	}
+
+	// Timeout: helpers are asked to probe the target
+	ASSERT_EQ(kIndirectProbes, driver.tick(model));
+	std::set<uint32> helpers;
+	for (uint32 i = 1; i <= kIndirectProbes; ++i) {
+		auto const& probe = driver.probes[i];
+		EXPECT_EQ(ProbeScheduler::Probe::Kind::Indirect, probe.kind);
+		EXPECT_EQ(target, probe.target);
+		EXPECT_NE(target, probe.via);
+		EXPECT_TRUE(model.healthy.contains(probe.via));
+		helpers.insert(probe.via.value);
+	}
+	EXPECT_EQ(kIndirectProbes, helpers.size());
+
+	// No ack by the end of the period: the target has failed and the next one is probed
+	for (PeersModel::Tick i = kTimeout + 1; i < kPeriod; ++i) {
+		EXPECT_EQ(0, driver.tick(model));
+	}
+
+	ASSERT_EQ(2, driver.tick(model));
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Failed, driver.probes[kIndirectProbes + 1].kind);
+	EXPECT_EQ(target, driver.probes[kIndirectProbes + 1].target);
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Direct, driver.probes[kIndirectProbes + 2].kind);
+	EXPECT_NE(target, driver.probes[kIndirectProbes + 2].target);
+}
+
+
+TEST(TestProbeScheduler, indirectProbesAfterSkippedTicks) {
+	auto const model = makeModel(10);
+
+	ProbeDriver driver;
+	ASSERT_EQ(1, driver.tick(model));
+	auto const target = driver.probes[0].target;
+
+	// No tick until past the end of the period: helpers are asked rather than the target failed outright
+	driver.now = kPeriod + 1;
+	ASSERT_EQ(kIndirectProbes, driver.tick(model));
+	for (uint32 i = 1; i <= kIndirectProbes; ++i) {
+		EXPECT_EQ(ProbeScheduler::Probe::Kind::Indirect, driver.probes[i].kind);
+		EXPECT_EQ(target, driver.probes[i].target);
+	}
+	EXPECT_TRUE(driver.scheduler.awaitingAck());
+
+	// Helpers have as long as they would have had, had they been asked at the probe timeout
+	for (PeersModel::Tick i = kTimeout + 1; i < kPeriod; ++i) {
+		EXPECT_EQ(0, driver.tick(model));
+	}
+
+	ASSERT_EQ(2, driver.tick(model));
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Failed, driver.probes[kIndirectProbes + 1].kind);
+	EXPECT_EQ(target, driver.probes[kIndirectProbes + 1].target);
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Direct, driver.probes[kIndirectProbes + 2].kind);
+}
+
+
+TEST(TestProbeScheduler, indirectAckPreventsFailure) {
+	auto const model = makeModel(10);
+
+	ProbeDriver driver;
+	for (PeersModel::Tick i = 0; i <= kTimeout; ++i) {
+		driver.tick(model);
+	}
+	ASSERT_EQ(1 + kIndirectProbes, driver.probes.size());
+
+	// Ack relayed by a helper
+	EXPECT_FALSE(driver.scheduler.onAck(driver.probes[1].via));
+	EXPECT_TRUE(driver.scheduler.onAck(driver.probes[0].target));
+	EXPECT_FALSE(driver.scheduler.awaitingAck());
+
+	for (PeersModel::Tick i = kTimeout + 1; i <= kPeriod; ++i) {
+		driver.tick(model);
+	}
+
+	ASSERT_EQ(2 + kIndirectProbes, driver.probes.size());
+	EXPECT_EQ(ProbeScheduler::Probe::Kind::Direct, driver.probes.back().kind);
+}
+
+
+TEST(TestProbeScheduler, fewHelpersAvailable) {
+	auto const model = makeModel(3);
+
+	ProbeDriver driver;
+	for (PeersModel::Tick i = 0; i <= kTimeout; ++i) {
+		driver.tick(model);
+	}
+
+	// All of the other peers help
+	ASSERT_EQ(3, driver.probes.size());
+	EXPECT_NE(driver.probes[1].via, driver.probes[2].via);
+}
+
+
+TEST(TestProbeScheduler, deadAndRemovedPeersAreNotProbed) {
+	auto model = makeModel(10);
+	model = update(std::move(model), PronouncePeerDead{{{3}, 0}});
+	model = update(std::move(model), ForgetPeer{NodeID{4}});
+
+	ProbeDriver driver;
+	driver.run(model, 16);
+
+	auto const targets = driver.directTargets();
+	ASSERT_EQ(16, targets.size());
+	for (auto target : targets) {
+		EXPECT_NE(3, target);
+		EXPECT_NE(4, target);
+	}
+}
+
+
+TEST(TestProbeScheduler, trackedPeerIsProbedWithinRound) {
+	auto model = makeModel(10);
+
+	ProbeDriver driver;
+	driver.run(model, 3);
+
+	// Peer joins mid-round
+	model = update(std::move(model), AddPeer{anyAddress(11), {{11}, 0}, 1000});
+	driver.scheduler.track(NodeID{11});
+	driver.scheduler.track(NodeID{11});
+
+	driver.run(model, 8);
+	auto const targets = driver.directTargets();
+	EXPECT_EQ(1, std::count(targets.begin(), targets.end(), 11));
+	EXPECT_EQ(11, std::set<uint32>(targets.begin(), targets.end()).size());
+}
+
+
+TEST(TestProbeScheduler, joinBurstIsProbedWithinRound) {
+	constexpr uint32 kJoined = 100;
+	auto model = makeModel(10);
+
+	ProbeDriver driver;
+	driver.run(model, 3);
+
+	// Many peers join mid-round, each tracked more than once
+	for (uint32 i = 11; i <= 10 + kJoined; ++i) {
+		model = update(std::move(model), AddPeer{anyAddress(static_cast<uint16>(i)), {{i}, 0}, 1000});
+		driver.scheduler.track(NodeID{i});
+		driver.scheduler.track(NodeID{i});
+	}
+
+	// The rest of the round: every peer yet to be probed, joined ones included, is probed exactly once
+	driver.run(model, 7 + kJoined);
+	auto const targets = driver.directTargets();
+	auto const round = std::set<uint32>(targets.begin() + 3, targets.end());
+	EXPECT_EQ(7 + kJoined, round.size());
+	for (uint32 i = 11; i <= 10 + kJoined; ++i) {
+		EXPECT_EQ(1, round.count(i)) << "peer " << i;
+	}
+}
+
+
+TEST(TestProbeScheduler, boundedDetectionTime) {
+	auto model = makeModel(20);
+
+	// Every peer is probed within 2N - 1 periods of any point in time
+	ProbeDriver driver;
+	driver.run(model, 200);
+
+	auto const targets = driver.directTargets();
+	std::map<uint32, size_t> lastProbed;
+	for (size_t i = 0; i < targets.size(); ++i) {
+		auto it = lastProbed.find(targets[i]);
+		if (it != lastProbed.end()) {
+			EXPECT_LE(i - it->second, 2 * 20 - 1);
+		}
+		lastProbed[targets[i]] = i;
+	}
+	EXPECT_EQ(20, lastProbed.size());
+}
+
+
+TEST(TestProbeScheduler, constantLoadRegardlessOfClusterSize) {
+	constexpr uint32 kPeriods = 50;
+
+	for (uint32 clusterSize : {10, 100, 1000}) {
+		auto const model = makeModel(clusterSize);
+
+		// Healthy cluster: one probe per period
+		ProbeDriver healthy;
+		healthy.run(model, kPeriods);
+		EXPECT_EQ(kPeriods, healthy.probes.size()) << "cluster of " << clusterSize;
+
+		// No acks at all: 1 direct and k indirect probes per period
+		std::set<uint32> everyone;
+		for (uint32 i = 1; i <= clusterSize; ++i) {
+			everyone.insert(i);
+		}
+
+		ProbeDriver failing;
+		failing.run(model, kPeriods, everyone);
+		size_t messages = 0;
+		for (auto const& probe : failing.probes) {
+			messages += (probe.kind != ProbeScheduler::Probe::Kind::Failed);
+		}
+		EXPECT_EQ(kPeriods * (1 + kIndirectProbes), messages) << "cluster of " << clusterSize;
+	}
+}
@@ -20,17 +20,55 @@
  ******************************************************************************/
 #include "tribe/protocol/messageParser.hpp"    // Class being tested.
 #include "tribe/protocol/messageWriter.hpp"
+#include "tribe/protocol/messageSchema.hpp"
 
 #include <gtest/gtest.h>
 
 #include <solace/result.hpp>
 #include <solace/posixErrorDomain.hpp>  // test makeError for redirect reason
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <vector>
+
 
 using namespace tribe;
 using namespace Solace;
 
 
+namespace {
+std::atomic<std::size_t> allocationsCount{0};
+
+template<typename T, std::size_t N>
+ArrayView<T const> constView(T (&array)[N]) noexcept {
+	return arrayView(static_cast<T const*>(array), N);
+}
+
+}  // namespace
+
+// Count heap allocations made by the test binary
+void* operator new(std::size_t size) {
+	allocationsCount += 1;
+	if (auto memory = std::malloc(size ? size : 1)) {
+		return memory;
+	}
+
+	throw std::bad_alloc{};
+}
+
+// Note: GCC can not tell that the replacement operator new above allocates with malloc
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#pragma GCC diagnostic pop
+
+
 TEST(TestProtocol, test_parser) {
 	auto parser = MessageParser{};
 
@@ -116,3 +154,715 @@ TEST_F(TestGossipMessage, ConnectResponseRedirect) {
 				EXPECT_EQ(request.reason, reason);
 			}).isOk());
 }
+
+
+TEST_F(TestGossipMessage, ConnectResponseRedirectView) {
+	auto maybeAltAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAltAddress.isOk());
+	auto altAddress = *maybeAltAddress;
+
+	auto reason = makeError(BasicError::Overflow, "server full");
+	messageWriter.joinRedirect(reason, altAddress);
+
+	auto parser = MessageParser{};
+	auto reader = ByteReader{messageWriter.writer().viewWritten()};
+	auto message = parser.parseView(reader);
+	ASSERT_TRUE(message.isOk());
+	ASSERT_TRUE(std::holds_alternative<ConnectResponseRedirectView>(*message));
+	EXPECT_EQ(0, reader.remaining());
+
+	auto const& view = std::get<ConnectResponseRedirectView>(*message);
+	EXPECT_EQ(static_cast<uint64>(reason.domain()), view.reason.domain);
+	EXPECT_EQ(static_cast<uint64>(reason.value()), view.reason.code);
+
+	// Address bytes are not copied out of the buffer
+	EXPECT_LE(messageWriter.writer().viewWritten().begin(), view.otherNode.begin());
+	EXPECT_GE(messageWriter.writer().viewWritten().end(), view.otherNode.end());
+
+	auto address = parser.parseAddress(view.otherNode);
+	ASSERT_TRUE(address.isOk());
+	EXPECT_EQ(altAddress, *address);
+}
+
+
+TEST_F(TestGossipMessage, parseViewDoesNotAllocate) {
+	byte messages[512] = {0};
+	ByteWriter messagesWriter{wrapMemory(messages)};
+	MessageWriter builder{messagesWriter};
+
+	byte token[] = {1, 2, 3};
+	auto const reason = makeError(BasicError::Overflow, "full");
+	auto maybeAltAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAltAddress.isOk());
+
+	builder.join(otherNodeInfo, wrapMemory(token), MemoryView{});
+	builder.joinAck(selfNodeInfo);
+	builder.joinRedirect(reason, *maybeAltAddress);
+	builder.joinNack(reason);
+	builder.advertise(selfNodeInfo);
+	builder.ping(selfNodeInfo.id, otherNodeInfo.id);
+	builder.pong(selfNodeInfo.id, otherNodeInfo);
+	builder.syncReply(selfNodeInfo, SnapshotChunk{1, 0, 1}, ArrayView<MembershipUpdate const>{});
+
+	auto parser = MessageParser{};
+	auto reader = ByteReader{messagesWriter.viewWritten()};
+
+	std::size_t nParsed = 0;
+	std::size_t typesParsed[std::variant_size_v<MessageView>] = {0};
+	auto const allocationsBefore = allocationsCount.load();
+	while (reader.remaining() > 0) {
+		auto message = parser.parseView(reader);
+		if (!message) {
+			break;
+		}
+
+		typesParsed[(*message).index()] += 1;
+		nParsed += 1;
+	}
+	auto const allocationsAfter = allocationsCount.load();
+
+	EXPECT_EQ(0, allocationsAfter - allocationsBefore);
+	ASSERT_EQ(8, nParsed);
+	for (auto count : typesParsed) {
+		EXPECT_EQ(1, count);
+	}
+}
+
+
+TEST_F(TestGossipMessage, parseBatch) {
+	byte datagramsBuffer[512] = {0};
+	ByteWriter bufferWriter{wrapMemory(datagramsBuffer)};
+	MessageWriter builder{bufferWriter};
+
+	auto const reason = makeError(BasicError::Overflow, "full");
+	MemoryView datagrams[8];
+	uint32 nDatagrams = 0;
+	auto const endDatagram = [&](ByteWriter::size_type from) {
+		datagrams[nDatagrams++] = bufferWriter.viewWritten().slice(from, bufferWriter.position());
+		return bufferWriter.position();
+	};
+
+	ByteWriter::size_type start = 0;
+	builder.ping(selfNodeInfo.id, otherNodeInfo.id);
+	start = endDatagram(start);
+	builder.joinNack(reason);
+	start = endDatagram(start);
+	bufferWriter.writeLE(uint8{0xFF});  // Unknown message type
+	start = endDatagram(start);
+	builder.ping(otherNodeInfo.id, selfNodeInfo.id);
+	start = endDatagram(start);
+	start = endDatagram(start);  // Empty datagram
+	builder.joinAck(selfNodeInfo);
+	start = endDatagram(start);
+	datagrams[nDatagrams - 1] = datagrams[nDatagrams - 1].slice(0, 3);  // Truncated ack
+	builder.joinAck(otherNodeInfo);
+	start = endDatagram(start);
+
+	Address sources[7];
+	MessageParser::ParsedDatagram messages[7];
+	uint32 failed[7];
+
+	auto const allocationsBefore = allocationsCount.load();
+	auto maybeResult = MessageParser{}.parseBatch(arrayView(static_cast<MemoryView const*>(datagrams), nDatagrams),
+												  constView(sources),
+												  arrayView(messages),
+												  arrayView(failed));
+	auto const allocationsAfter = allocationsCount.load();
+
+	ASSERT_TRUE(maybeResult.isOk());
+	EXPECT_EQ(0, allocationsAfter - allocationsBefore);
+	EXPECT_EQ(4, (*maybeResult).parsed);
+	ASSERT_EQ(3, (*maybeResult).failed);
+
+	// Messages are in the order the datagrams have been received
+	EXPECT_EQ(0, messages[0].index);
+	EXPECT_EQ(1, messages[1].index);
+	EXPECT_EQ(3, messages[2].index);
+	EXPECT_EQ(6, messages[3].index);
+	for (uint32 i = 0; i < (*maybeResult).parsed; ++i) {
+		EXPECT_EQ(&sources[messages[i].index], messages[i].source);
+	}
+
+	ASSERT_TRUE(std::holds_alternative<PingMessage>(messages[0].message));
+	EXPECT_EQ(selfNodeInfo.id, std::get<PingMessage>(messages[0].message).origin);
+	EXPECT_TRUE(std::holds_alternative<ConnectResponseRejectedView>(messages[1].message));
+	ASSERT_TRUE(std::holds_alternative<PingMessage>(messages[2].message));
+	EXPECT_EQ(otherNodeInfo.id, std::get<PingMessage>(messages[2].message).origin);
+	EXPECT_TRUE(std::holds_alternative<ConnectResponseAck>(messages[3].message));
+	EXPECT_EQ(otherNodeInfo.id, std::get<ConnectResponseAck>(messages[3].message).self.id);
+
+	EXPECT_EQ(2, failed[0]);
+	EXPECT_EQ(4, failed[1]);
+	EXPECT_EQ(5, failed[2]);
+}
+
+
+TEST_F(TestGossipMessage, parseBatchRejectsSmallOutput) {
+	MemoryView datagrams[2];
+	Address sources[1];
+	MessageParser::ParsedDatagram messages[2];
+	uint32 failed[1];
+
+	auto const parser = MessageParser{};
+	EXPECT_TRUE(parser.parseBatch(constView(datagrams), constView(sources), arrayView(messages),
+								  arrayView(failed)).isError());
+	EXPECT_TRUE(parser.parseBatch(constView(datagrams), ArrayView<Address const>{}, arrayView(messages),
+								  arrayView(failed)).isError());
+}
+
+
+TEST_F(TestGossipMessage, dispatch) {
+	struct Handler {
+		std::size_t calls[std::variant_size_v<MessageView>] = {0};
+		NodeID pingOrigin{};
+		NodeInfo ackPeer{};
+
+		void onJoinRequest(ConnectRequest const&) { calls[0] += 1; }
+		void onJoinAck(ConnectResponseAck const& msg) { calls[1] += 1; ackPeer = msg.self; }
+		void onJoinRedirect(ConnectResponseRedirectView const&) { calls[2] += 1; }
+		void onJoinRejected(ConnectResponseRejectedView const&) { calls[3] += 1; }
+		void onPing(PingMessage const& msg) { calls[4] += 1; pingOrigin = msg.origin; }
+		void onPong(PongMessage const&) { calls[5] += 1; }
+		void onSync(SyncMessage const&) { calls[6] += 1; }
+		void onBroadcast(BroadcastMessage const&) { calls[7] += 1; }
+	};
+
+	byte messages[512] = {0};
+	ByteWriter messagesWriter{wrapMemory(messages)};
+	MessageWriter builder{messagesWriter};
+
+	byte token[] = {1, 2, 3};
+	auto const reason = makeError(BasicError::Overflow, "full");
+	auto maybeAltAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAltAddress.isOk());
+
+	builder.join(otherNodeInfo, wrapMemory(token), MemoryView{});
+	builder.joinAck(selfNodeInfo);
+	builder.joinRedirect(reason, *maybeAltAddress);
+	builder.joinNack(reason);
+	builder.ping(otherNodeInfo.id, selfNodeInfo.id);
+	builder.pong(selfNodeInfo.id, otherNodeInfo);
+	builder.syncPush(selfNodeInfo, SnapshotChunk{1, 0, 1}, ArrayView<MembershipUpdate const>{});
+	builder.advertise(selfNodeInfo);
+
+	Handler handler;
+	auto const parser = MessageParser{};
+	auto reader = ByteReader{messagesWriter.viewWritten()};
+	auto const allocationsBefore = allocationsCount.load();
+	while (reader.remaining() > 0) {
+		ASSERT_TRUE(parser.dispatch(reader, handler).isOk());
+	}
+	EXPECT_EQ(0, allocationsCount.load() - allocationsBefore);
+
+	for (auto count : handler.calls) {
+		EXPECT_EQ(1, count);
+	}
+	EXPECT_EQ(otherNodeInfo.id, handler.pingOrigin);
+	EXPECT_EQ(selfNodeInfo.id, handler.ackPeer.id);
+
+	// Malformed message is not passed to the handler
+	byte truncated[] = {static_cast<byte>(Gossip::MessageType::PingDirect), 1, 2};
+	auto truncatedReader = ByteReader{wrapMemory(truncated)};
+	EXPECT_TRUE(parser.dispatch(truncatedReader, handler).isError());
+	EXPECT_EQ(1, handler.calls[4]);
+}
+
+
+TEST_F(TestGossipMessage, encodedSizeOfFixedLayoutMessages) {
+	static_assert(hasFixedEncodedSize<BroadcastMessage>());
+	static_assert(!hasFixedEncodedSize<ConnectResponseAck>());
+	static_assert(!hasFixedEncodedSize<SyncMessage>());
+	static_assert(!hasFixedEncodedSize<PingMessage>());
+	static_assert(!hasFixedEncodedSize<ConnectRequest>());
+	static_assert(!hasFixedEncodedSize<ConnectResponseRejectedView>());
+
+	static_assert(encodedSize<BroadcastMessage>() == 9);
+	static_assert(encodedSize(PingMessage{}) == 11);
+	static_assert(encodedSize(PongMessage{}) == 15);
+	static_assert(encodedSize(ConnectResponseAck{}) == 10);
+	static_assert(encodedSize(SyncMessage{}) == 18);
+
+	messageWriter.advertise(selfNodeInfo);
+	EXPECT_EQ(encodedSize<BroadcastMessage>(), writer.position());
+}
+
+
+TEST_F(TestGossipMessage, encodedSizeMatchesWrittenSize) {
+	byte token[] = {1, 2, 3};
+	byte auth[] = {7};
+	auto const reason = makeError(BasicError::Overflow, "full");
+	auto const reasonView = ErrorView{static_cast<uint64>(reason.domain()),
+									  static_cast<uint64>(reason.value()),
+									  reason.tag()};
+
+	auto& output = messageWriter.writer();
+	auto written = output.position();
+	auto const expectSize = [&](Gossip::size_type expected) {
+		EXPECT_EQ(expected, output.position() - written);
+		written = output.position();
+	};
+
+	messageWriter.join(otherNodeInfo, wrapMemory(token), wrapMemory(auth));
+	expectSize(encodedSize(ConnectRequest{otherNodeInfo, wrapMemory(token), wrapMemory(auth)}));
+
+	messageWriter.joinAck(selfNodeInfo);
+	expectSize(encodedSize(ConnectResponseAck{selfNodeInfo}));
+
+	messageWriter.joinNack(reason);
+	expectSize(encodedSize(ConnectResponseRejectedView{reasonView}));
+
+	messageWriter.advertise(selfNodeInfo);
+	expectSize(encodedSize(BroadcastMessage{selfNodeInfo}));
+
+	messageWriter.pong(otherNodeInfo.id, selfNodeInfo);
+	expectSize(encodedSize(PongMessage{}));
+}
+
+
+TEST_F(TestGossipMessage, oversizedMessageIsNotWrittenPastBuffer) {
+	// Size of the message is greater than the max value of the message size type
+	std::vector<byte> token(std::numeric_limits<Gossip::size_type>::max(), 0x5A);
+	auto const msg = ConnectRequest{otherNodeInfo, wrapMemory(token.data(), token.size()), MemoryView{}};
+	auto const expectedSize = Gossip::headerSize() + encodedSize(otherNodeInfo) + 2 * sizeof(Gossip::size_type) +
+			token.size();
+	EXPECT_EQ(expectedSize, MessageWriter::sizeOf(msg));
+	EXPECT_GT(MessageWriter::sizeOf(msg), std::numeric_limits<Gossip::size_type>::max());
+
+	// Message does not fit: the writer stops at the end of the buffer
+	messageWriter.join(otherNodeInfo, wrapMemory(token.data(), token.size()), MemoryView{});
+	EXPECT_LE(writer.position(), sizeof(buffer));
+
+	// Message fits: the whole of it is written
+	std::vector<byte> largeBuffer(expectedSize + 16);
+	ByteWriter largeWriter{wrapMemory(largeBuffer.data(), largeBuffer.size())};
+	MessageWriter{largeWriter}.join(otherNodeInfo, wrapMemory(token.data(), token.size()), MemoryView{});
+	EXPECT_EQ(expectedSize, largeWriter.position());
+}
+
+
+TEST_F(TestGossipMessage, sizeOf) {
+	auto const reason = makeError(BasicError::Overflow, "full");
+	auto maybeAltAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAltAddress.isOk());
+
+	messageWriter.joinRedirect(reason, *maybeAltAddress);
+	EXPECT_EQ(MessageWriter::sizeOf(ConnectResponseRedirect{*maybeAltAddress, reason}), writer.position());
+
+	auto const redirectSize = writer.position();
+	messageWriter.joinNack(reason);
+	EXPECT_EQ(MessageWriter::sizeOf(ConnectResponseRejected{reason}), writer.position() - redirectSize);
+
+	auto const nackSize = writer.position();
+	messageWriter.pong(otherNodeInfo.id, selfNodeInfo);
+	EXPECT_EQ(MessageWriter::sizeOf(PongMessage{otherNodeInfo.id, selfNodeInfo, 0, PiggybackView{}}), writer.position() - nackSize);
+}
+
+
+TEST_F(TestGossipMessage, PongMessage) {
+	messageWriter.pong(otherNodeInfo.id, selfNodeInfo);
+
+	auto maybeMessage = expectMessage<PongMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+
+	auto& message = *maybeMessage;
+	EXPECT_EQ(otherNodeInfo.id, message.origin);
+	EXPECT_EQ(selfNodeInfo.id, message.nodeDetails.id);
+	EXPECT_EQ(selfNodeInfo.gen, message.nodeDetails.gen);
+	EXPECT_EQ(0, message.ttl);
+}
+
+
+TEST_F(TestGossipMessage, PingToRelay) {
+	messageWriter.ping(selfNodeInfo.id, otherNodeInfo.id, 3);
+
+	EXPECT_TRUE(expectMessage<PingMessage>()
+			.then([this](PingMessage const& msg) {
+				EXPECT_EQ(selfNodeInfo.id, msg.origin);
+				EXPECT_EQ(otherNodeInfo.id, msg.target);
+				EXPECT_EQ(3, msg.ttl);
+			}).isOk());
+}
+
+
+TEST_F(TestGossipMessage, PingWithPiggybackedUpdates) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	auto maybeAddress6 = tryParseAddress("[fe80::1]:7000");
+	ASSERT_TRUE(maybeAddress.isOk());
+	ASSERT_TRUE(maybeAddress6.isOk());
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Joined, {{17}, 1}, *maybeAddress},
+		{MembershipUpdate::Kind::Suspect, {{32}, 4}, *maybeAddress6, {77}},
+		{MembershipUpdate::Kind::Dead, {{9}, 2}, *maybeAddress},
+	};
+
+	messageWriter.ping(selfNodeInfo.id, otherNodeInfo.id, constView(updates));
+	EXPECT_EQ(encodedSize(PingMessage{}) + encodedSize(updates[0]) + encodedSize(updates[1]) + encodedSize(updates[2]),
+			  writer.position());
+
+	auto maybeMessage = expectMessage<PingMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	auto& message = *maybeMessage;
+	EXPECT_EQ(selfNodeInfo.id, message.origin);
+	EXPECT_EQ(otherNodeInfo.id, message.target);
+	ASSERT_EQ(3, message.updates.count);
+
+	auto const parser = MessageParser{};
+	MembershipUpdate decoded[3];
+	auto const allocationsBefore = allocationsCount.load();
+	auto maybeCount = parser.parseUpdates(message.updates, arrayView(decoded));
+	EXPECT_EQ(0, allocationsCount.load() - allocationsBefore);
+	ASSERT_TRUE(maybeCount.isOk());
+	ASSERT_EQ(3, *maybeCount);
+
+	for (uint32 i = 0; i < 3; ++i) {
+		EXPECT_EQ(updates[i].kind, decoded[i].kind);
+		EXPECT_EQ(updates[i].node.id, decoded[i].node.id);
+		EXPECT_EQ(updates[i].node.gen, decoded[i].node.gen);
+
+		EXPECT_EQ(updates[i].address, decoded[i].address);
+		EXPECT_EQ(updates[i].suspecter, decoded[i].suspecter);
+	}
+
+	// No room to output all of the updates
+	EXPECT_TRUE(parser.parseUpdates(message.updates, arrayView(decoded, 2)).isError());
+}
+
+
+TEST_F(TestGossipMessage, AddressOfUnknownFamilyRoundTrips) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	Address unknown{};
+	unknown.size = sizeof(sockaddr_storage);
+	unknown.addr.ss_family = AF_UNIX;
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Alive, {{300}, 1}, *maybeAddress},
+		{MembershipUpdate::Kind::Suspect, {{301}, 1}, unknown, {300}},
+		{MembershipUpdate::Kind::Dead, {{302}, 1}, Address{}},
+	};
+
+	// Address of unknown family is encoded as a bare family
+	EXPECT_EQ(sizeof(unknown.addr.ss_family), encodedSize(unknown));
+
+	messageWriter.pong(selfNodeInfo.id, otherNodeInfo, constView(updates));
+	EXPECT_EQ(encodedSize(PongMessage{}) + encodedSize(updates[0]) + encodedSize(updates[1]) + encodedSize(updates[2]),
+			  writer.position());
+
+	auto maybeMessage = expectMessage<PongMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	ASSERT_EQ(3, (*maybeMessage).updates.count);
+
+	MembershipUpdate decoded[3];
+	auto maybeCount = MessageParser{}.parseUpdates((*maybeMessage).updates, arrayView(decoded));
+	ASSERT_TRUE(maybeCount.isOk());
+	ASSERT_EQ(3, *maybeCount);
+	EXPECT_EQ(*maybeAddress, decoded[0].address);
+	EXPECT_EQ(Address{}, decoded[1].address);
+	EXPECT_EQ(NodeID{300}, decoded[1].suspecter);
+	EXPECT_EQ(Address{}, decoded[2].address);
+	EXPECT_EQ(NodeID{302}, decoded[2].node.id);
+}
+
+
+TEST_F(TestGossipMessage, PongPiggybacksUpdatesThatFit) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	MembershipUpdate updates[16];
+	for (uint32 i = 0; i < 16; ++i) {
+		updates[i] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{i}, i}, *maybeAddress};
+	}
+
+	// Each update of IPv4 address takes 17 bytes, pong with no updates - 15
+	auto const updateSize = encodedSize(updates[0]);
+	ASSERT_EQ(17, updateSize);
+	auto const budget = static_cast<Gossip::size_type>(writer.remaining() - encodedSize(PongMessage{}));
+	auto const expectedCount = MessageWriter::piggybackCapacity(constView(updates), budget);
+	EXPECT_EQ(budget / updateSize, expectedCount);
+
+	messageWriter.pong(selfNodeInfo.id, otherNodeInfo, constView(updates));
+
+	auto maybeMessage = expectMessage<PongMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	EXPECT_EQ(expectedCount, (*maybeMessage).updates.count);
+	EXPECT_EQ(encodedSize(PongMessage{}) + expectedCount * updateSize, writer.position());
+}
+
+
+TEST_F(TestGossipMessage, PingWithCompactUpdates) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Joined, {{17}, 1}, *maybeAddress},
+		{MembershipUpdate::Kind::Alive, {{300}, 70000}, *maybeAddress},
+		{MembershipUpdate::Kind::Dead, {{0xFFFFFFF0}, 0xFFFFFFFF}, *maybeAddress},
+		{MembershipUpdate::Kind::Suspect, {{5}, 2}, *maybeAddress, {300}},  // Out of order still decodes
+	};
+
+	messageWriter.ping(selfNodeInfo.id, otherNodeInfo.id, constView(updates), UpdateEncoding::Compact);
+	EXPECT_EQ(static_cast<byte>(Gossip::MessageType::PingCompact), buffer[0]);
+
+	// Size of updates written agrees with the size the writer has planned for, suspecter included
+	auto const updatesSize = static_cast<Gossip::size_type>(writer.position() - encodedSize(PingMessage{}));
+	EXPECT_EQ(4, MessageWriter::piggybackCapacity(constView(updates), updatesSize, UpdateEncoding::Compact));
+	EXPECT_EQ(3, MessageWriter::piggybackCapacity(constView(updates), updatesSize - 1, UpdateEncoding::Compact));
+
+	auto maybeMessage = expectMessage<PingMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	auto& message = *maybeMessage;
+	EXPECT_EQ(UpdateEncoding::Compact, message.updates.encoding);
+	ASSERT_EQ(4, message.updates.count);
+
+	MembershipUpdate decoded[4];
+	auto maybeCount = MessageParser{}.parseUpdates(message.updates, arrayView(decoded));
+	ASSERT_TRUE(maybeCount.isOk());
+	ASSERT_EQ(4, *maybeCount);
+	for (uint32 i = 0; i < 4; ++i) {
+		EXPECT_EQ(updates[i].kind, decoded[i].kind);
+		EXPECT_EQ(updates[i].node.id, decoded[i].node.id);
+		EXPECT_EQ(updates[i].node.gen, decoded[i].node.gen);
+		EXPECT_EQ(updates[i].suspecter, decoded[i].suspecter);
+	}
+}
+
+
+TEST_F(TestGossipMessage, PongPiggybacksCompactUpdatesThatFit) {
+	MembershipUpdate updates[32];
+	for (uint32 i = 0; i < 32; ++i) {
+		updates[i] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{1000 + i}, 2},
+									  anyAddress(static_cast<uint16>(7000 + i))};
+	}
+
+	// Compact updates are sized as they are written: count written agrees with the capacity of the buffer
+	auto const budget = writer.remaining() - encodedSize(PongMessage{});
+	auto const expectedCount = MessageWriter::piggybackCapacity(constView(updates), budget, UpdateEncoding::Compact);
+	ASSERT_LT(expectedCount, 32);
+
+	messageWriter.pong(selfNodeInfo.id, otherNodeInfo, 2, constView(updates), UpdateEncoding::Compact);
+
+	// First update: 1 + 2 + 1 + 7 bytes of address, then 1 + 1 + 1 + 4 bytes of address reference
+	EXPECT_EQ(encodedSize(PongMessage{}) + 11 + (expectedCount - 1) * 7, writer.position());
+
+	auto maybeMessage = expectMessage<PongMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	EXPECT_EQ(2, (*maybeMessage).ttl);
+	ASSERT_EQ(expectedCount, (*maybeMessage).updates.count);
+
+	MembershipUpdate decoded[32];
+	auto maybeCount = MessageParser{}.parseUpdates((*maybeMessage).updates, arrayView(decoded));
+	ASSERT_TRUE(maybeCount.isOk());
+	ASSERT_EQ(expectedCount, *maybeCount);
+	for (uint32 i = 0; i < expectedCount; ++i) {
+		EXPECT_EQ(updates[i].node.id, decoded[i].node.id);
+		EXPECT_EQ(updates[i].address, decoded[i].address);
+	}
+}
+
+
+TEST_F(TestGossipMessage, CompactUpdatesTakeLessSpace) {
+	MembershipUpdate updates[255];
+	for (uint32 i = 0; i < 255; ++i) {
+		updates[i] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{1000 + 3 * i}, 2},
+									  anyAddress(static_cast<uint16>(7000 + i))};
+	}
+
+	// Typical MTU sized datagram
+	constexpr Gossip::size_type budget = 1400;
+	auto const fixedCount = MessageWriter::piggybackCapacity(constView(updates), budget);
+	auto const compactCount = MessageWriter::piggybackCapacity(constView(updates), budget, UpdateEncoding::Compact);
+
+	// Fixed: 1 + 8 + 8 bytes of address.
+	// Compact: 1 + 2 + 1 + 7 bytes of address for the first update, then 1 + 1 + 1 + 4 bytes of address reference
+	EXPECT_EQ(budget / 17, fixedCount);
+	EXPECT_EQ(1 + (budget - 11) / 7, compactCount);
+}
+
+
+TEST_F(TestGossipMessage, CompactAddressesOfRealisticClusters) {
+	struct Cluster {
+		char const*		description;
+		char const*		addressFormat;
+		Gossip::size_type	expectedSize;	//!< Encoded size of 64 updates
+	};
+
+	// Node IDs are sequential and generations small: 1 + 1 + 1 bytes, except for the first ID
+	Cluster const clusters[] = {
+		// First address 1 + 4 + 2 bytes, then 1 + 1 + 1 byte of suffix
+		{"IPv4 subnet, same port", "10.1.0.%u:7000", 4 + 7 + 63 * (3 + 3)},
+		// Racks of 8 nodes in a /16: address of the first node of a rack differs from others in the last 2 bytes
+		{"IPv4 /16, same port", "10.1.%u.%u:7000", 4 + 7 + 56 * (3 + 3) + 7 * (3 + 4)},
+		// First address 1 + 16 + 2 bytes, then 1 + 1 + 1 byte of suffix
+		{"IPv6 /64, same port", "[2001:db8::%x]:7000", 4 + 19 + 63 * (3 + 3)},
+	};
+
+	for (auto const& cluster : clusters) {
+		MembershipUpdate updates[64];
+		for (uint32 i = 0; i < 64; ++i) {
+			char addressString[64];
+			if (std::strstr(cluster.addressFormat, "%u.%u")) {
+				std::snprintf(addressString, sizeof(addressString), cluster.addressFormat, i / 8 + 1, i % 8 + 1);
+			} else {
+				std::snprintf(addressString, sizeof(addressString), cluster.addressFormat, i + 1);
+			}
+
+			auto maybeAddress = tryParseAddress(StringView{addressString});
+			ASSERT_TRUE(maybeAddress.isOk()) << addressString;
+			updates[i] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{1000 + i}, 1}, *maybeAddress};
+		}
+
+		byte datagram[1500];
+		ByteWriter datagramWriter{wrapMemory(datagram)};
+		MessageWriter{datagramWriter}.ping(selfNodeInfo.id, otherNodeInfo.id, constView(updates),
+										   UpdateEncoding::Compact);
+		auto const payloadSize = datagramWriter.position() - encodedSize(PingMessage{});
+		EXPECT_EQ(cluster.expectedSize, payloadSize) << cluster.description;
+
+		// Updates decode back to the original addresses
+		auto reader = ByteReader{datagramWriter.viewWritten()};
+		auto maybeMessage = MessageParser{}.parseView(reader);
+		ASSERT_TRUE(maybeMessage.isOk()) << cluster.description;
+		auto const& ping = std::get<PingMessage>(*maybeMessage);
+		ASSERT_EQ(64, ping.updates.count) << cluster.description;
+
+		MembershipUpdate decoded[64];
+		ASSERT_TRUE(MessageParser{}.parseUpdates(ping.updates, arrayView(decoded)).isOk());
+		for (uint32 i = 0; i < 64; ++i) {
+			EXPECT_EQ(updates[i].node.id, decoded[i].node.id);
+			EXPECT_EQ(updates[i].address, decoded[i].address) << cluster.description << " update " << i;
+		}
+	}
+}
+
+
+TEST_F(TestGossipMessage, CompactAddressReferencesAreBounded) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	auto maybeAddress6 = tryParseAddress("[fe80::1]:7000");
+	ASSERT_TRUE(maybeAddress.isOk());
+	ASSERT_TRUE(maybeAddress6.isOk());
+
+	// Only the first update has the IPv4 address, which is out of reach of the last one
+	MembershipUpdate updates[Gossip::kAddressWindow + 2];
+	updates[0] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{1}, 1}, *maybeAddress};
+	for (uint32 i = 1; i < Gossip::kAddressWindow + 1; ++i) {
+		updates[i] = MembershipUpdate{MembershipUpdate::Kind::Alive, {{i + 1}, 1}, *maybeAddress6};
+	}
+	updates[Gossip::kAddressWindow + 1] = updates[0];
+	updates[Gossip::kAddressWindow + 1].node.id = NodeID{Gossip::kAddressWindow + 2};
+
+	byte datagram[1500];
+	ByteWriter datagramWriter{wrapMemory(datagram)};
+	MessageWriter{datagramWriter}.pong(selfNodeInfo.id, otherNodeInfo, constView(updates), UpdateEncoding::Compact);
+
+	auto reader = ByteReader{datagramWriter.viewWritten()};
+	auto maybeMessage = MessageParser{}.parseView(reader);
+	ASSERT_TRUE(maybeMessage.isOk());
+	auto const& pong = std::get<PongMessage>(*maybeMessage);
+	ASSERT_EQ(Gossip::kAddressWindow + 2, pong.updates.count);
+
+	MembershipUpdate decoded[Gossip::kAddressWindow + 2];
+	ASSERT_TRUE(MessageParser{}.parseUpdates(pong.updates, arrayView(decoded)).isOk());
+	for (uint32 i = 0; i < Gossip::kAddressWindow + 2; ++i) {
+		EXPECT_EQ(updates[i].node.id, decoded[i].node.id);
+		EXPECT_EQ(updates[i].address, decoded[i].address) << "update " << i;
+	}
+}
+
+
+TEST_F(TestGossipMessage, CompactAddressOfUnknownFamilyRoundTrips) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	Address unknown{};
+	unknown.size = sizeof(sockaddr_storage);
+	unknown.addr.ss_family = AF_UNIX;
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Alive, {{300}, 1}, *maybeAddress},
+		{MembershipUpdate::Kind::Suspect, {{301}, 1}, unknown},
+		{MembershipUpdate::Kind::Dead, {{302}, 1}, *maybeAddress},
+	};
+
+	// Address of unknown family is just a tag, and is not referred to by the addresses that follow
+	EXPECT_EQ(1, compactEncodedSize(unknown));
+	EXPECT_EQ(1 + 1 + 1 + 1 + 1, encodedSize(updates[1], NodeID{300}));
+
+	messageWriter.ping(selfNodeInfo.id, otherNodeInfo.id, constView(updates), UpdateEncoding::Compact);
+	// Literal IPv4 address: 1 + 2 + 1 + 7 bytes, unknown and suspecter: 1 + 1 + 1 + 1 + 1, ref 2 back: 1 + 1 + 1 + 2
+	EXPECT_EQ(encodedSize(PingMessage{}) + 11 + 5 + 5, writer.position());
+
+	auto maybeMessage = expectMessage<PingMessage>();
+	ASSERT_TRUE(maybeMessage.isOk());
+	ASSERT_EQ(3, (*maybeMessage).updates.count);
+
+	MembershipUpdate decoded[3];
+	auto maybeCount = MessageParser{}.parseUpdates((*maybeMessage).updates, arrayView(decoded));
+	ASSERT_TRUE(maybeCount.isOk());
+	ASSERT_EQ(3, *maybeCount);
+	EXPECT_EQ(*maybeAddress, decoded[0].address);
+	EXPECT_EQ(Address{}, decoded[1].address);
+	EXPECT_EQ(MembershipUpdate::Kind::Suspect, decoded[1].kind);
+	EXPECT_EQ(NodeID{301}, decoded[1].node.id);
+	EXPECT_EQ(*maybeAddress, decoded[2].address);
+}
+
+
+TEST_F(TestGossipMessage, InvalidCompactAddressReferencesAreRejected) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Alive, {{300}, 1}, *maybeAddress},
+		{MembershipUpdate::Kind::Dead, {{301}, 1}, *maybeAddress},
+	};
+	messageWriter.ping(selfNodeInfo.id, otherNodeInfo.id, constView(updates), UpdateEncoding::Compact);
+
+	// Address of the last update refers to the one before it, with empty suffix and the same port
+	auto const written = writer.viewWritten();
+	ASSERT_EQ(Gossip::kCompactRefSamePort, written[written.size() - 2]);
+	ASSERT_EQ(0, written[written.size() - 1]);
+
+	auto const parser = MessageParser{};
+	{
+		auto reader = ByteReader{written};
+		EXPECT_TRUE(parser.parseView(reader).isOk());
+	}
+
+	std::pair<MemoryView::size_type, int> const patches[] = {
+		{2, Gossip::kCompactRefSamePort | 1},	// Refers before the first update
+		{2, Gossip::kCompactFormMask},			// Unknown address form
+		{1, 5},									// IPv4 address has no 5 bytes suffix
+	};
+
+	byte corrupted[sizeof(buffer)];
+	for (auto const& patch : patches) {
+		std::memcpy(corrupted, buffer, sizeof(buffer));
+		corrupted[written.size() - patch.first] = static_cast<byte>(patch.second);
+
+		auto reader = ByteReader{wrapMemory(corrupted, written.size())};
+		EXPECT_TRUE(parser.parseView(reader).isError()) << "patch " << patch.second;
+	}
+}
+
+
+TEST_F(TestGossipMessage, TruncatedCompactUpdatesAreRejected) {
+	auto maybeAddress = tryParseAddress("10.1.1.3:12483");
+	ASSERT_TRUE(maybeAddress.isOk());
+
+	MembershipUpdate const updates[] = {
+		{MembershipUpdate::Kind::Alive, {{300}, 70000}, *maybeAddress},
+	};
+	messageWriter.pong(selfNodeInfo.id, otherNodeInfo, constView(updates), UpdateEncoding::Compact);
+
+	auto const parser = MessageParser{};
+	auto const written = writer.viewWritten();
+	for (MemoryView::size_type size = 1; size < written.size(); ++size) {
+		auto reader = ByteReader{written.slice(0, size)};
+		EXPECT_TRUE(parser.parseView(reader).isError()) << "size " << size;
+	}
+
+	auto reader = ByteReader{written};
+	EXPECT_TRUE(parser.parseView(reader).isOk());
+}
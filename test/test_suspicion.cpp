@@ -0,0 +1,403 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_suspicion.cpp
+ *	@brief		Test suit for suspicion confirmations of tribe::PeersModel
+ ******************************************************************************/
+#include "tribe/model.hpp"    // Class being tested.
+#include "tribe/decayScheduler.hpp"
+#include "tribe/livenessStore.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace tribe;
+using namespace Solace;
+
+
+namespace {
+
+constexpr uint16 kMinTimeout = 3;
+constexpr uint16 kMaxTimeout = 12;
+constexpr uint32 kExpectedConfirmations = 3;
+
+/// Decay that keeps probability of peers intact, so that only TTL runs out
+constexpr DecayPeerInfo kTick{1, 1000, 0};
+
+/// Decay such that a peer certainly alive is suspected in one go
+constexpr DecayPeerInfo kSuspectingTick{1, 1000, 0.5f};
+
+
+MembershipSettings makeSettings(uint16 minTimeout, uint16 maxTimeout, uint32 expectedConfirmations) {
+	MembershipSettings settings{};
+	settings.suspicionMinTimeout = minTimeout;
+	settings.suspicionMaxTimeout = maxTimeout;
+	settings.suspicionConfirmations = expectedConfirmations;
+
+	return settings;
+}
+
+
+PeersModel makeModel(MembershipSettings const& settings, uint16 ttl = 8) {
+	auto model = PeersModel{};
+	model.node = NodeInfo{{100}, 1};
+	model.params = settings;
+	model = update(std::move(model), AddPeer{anyAddress(1), {{1}, 0}, ttl});
+
+	return model;
+}
+
+
+Peer const* findPeer(PeersModel const& model, uint32 id) {
+	auto it = model.members.find(NodeID{id});
+	return (it != model.members.end())
+			? &(it->second)
+			: nullptr;
+}
+
+
+PeersModel::Suspicion const* findSuspicion(PeersModel const& model, uint32 id) {
+	auto it = model.suspicions.find(NodeID{id});
+	return (it != model.suspicions.end())
+			? &(it->second)
+			: nullptr;
+}
+
+
+/// Check if the peer has been declared dead: dead peers with no TTL left are removed at once
+bool isDeclaredDead(PeersModel const& model, uint32 id) {
+	auto const peer = findPeer(model, id);
+	return (peer == nullptr) || model.isDead(*peer);
+}
+
+
+/// Ticks a peer, that has become suspected by the observer at tick 1, has taken to be declared dead
+struct SuspicionRun {
+	struct Event {
+		PeersModel::Tick	at;
+		NodeID				from;		//!< Member confirming the suspicion
+	};
+
+	std::vector<Event>			confirmations;
+	Optional<PeersModel::Tick>	refutedAt;		//!< Tick the peer refutes the suspicion, if it is alive
+
+	/// @return Ticks from suspicion to death of the peer, or none if the peer has refuted the suspicion in time
+	Optional<PeersModel::Tick> run(MembershipSettings const& settings) {
+		auto model = makeModel(settings, 0);
+		model = update(std::move(model), DecayPeerInfo{kSuspectingTick});
+		EXPECT_TRUE(model.isSuspected(*findPeer(model, 1)));
+
+		std::sort(confirmations.begin(), confirmations.end(), [](Event const& lhs, Event const& rhs) {
+			return lhs.at < rhs.at;
+		});
+
+		auto next = confirmations.begin();
+		while (!isDeclaredDead(model, 1)) {
+			if (refutedAt && *refutedAt <= model.now) {
+				return none;
+			}
+
+			for (; next != confirmations.end() && next->at <= model.now; ++next) {
+				model = update(std::move(model), SuspectPeer{{{1}, 0}, next->from});
+			}
+
+			model = update(std::move(model), DecayPeerInfo{kTick});
+		}
+
+		return model.now - 1;
+	}
+};
+
+
+/// Mean detection latency and rate of false positives of a suspicion configuration
+struct Tradeoff {
+	float64		detectionLatency{0};
+	float64		falsePositiveRate{0};
+};
+
+
+/**
+ * Simulation of suspicions of a peer by an observer.
+ * True failure: the rest of the group suspect the crashed peer at about the same time as the observer does,
+ * and their suspicions reach the observer as gossip a few ticks later.
+ * False positive: the observer alone is slow, and is late to hear from the peer, that is alive.
+ */
+Tradeoff simulate(MembershipSettings const& settings, uint32 runs) {
+	constexpr uint32 kGroupSize = 16;
+
+	std::mt19937 gen{5};
+	std::uniform_int_distribution<int> suspectedAfter{-2, 6};
+	std::uniform_int_distribution<PeersModel::Tick> gossipDelay{1, 3};
+	std::uniform_int_distribution<PeersModel::Tick> lateBy{1, 16};
+
+	Tradeoff result;
+	for (uint32 i = 0; i < runs; ++i) {
+		SuspicionRun crash;
+		for (uint32 member = 2; member <= kGroupSize; ++member) {
+			auto const suspectedAt = 1 + std::max(0, suspectedAfter(gen));
+			crash.confirmations.push_back({suspectedAt + gossipDelay(gen), NodeID{member}});
+		}
+
+		auto const latency = crash.run(settings);
+		EXPECT_TRUE(latency.isSome());
+		result.detectionLatency += *latency;
+
+		SuspicionRun slowObserver;
+		slowObserver.refutedAt = 1 + lateBy(gen);
+		result.falsePositiveRate += slowObserver.run(settings).isSome() ? 1 : 0;
+	}
+
+	result.detectionLatency /= runs;
+	result.falsePositiveRate /= runs;
+
+	return result;
+}
+
+}  // namespace
+
+
+TEST(TestSuspicion, timeoutShrinksLogarithmically) {
+	EXPECT_EQ(12, suspicionTimeout(2, 12, 0, 3));
+	EXPECT_EQ(7, suspicionTimeout(2, 12, 1, 3));
+	EXPECT_EQ(5, suspicionTimeout(2, 12, 2, 3));
+	EXPECT_EQ(2, suspicionTimeout(2, 12, 3, 3));
+	EXPECT_EQ(2, suspicionTimeout(2, 12, 10, 3));
+
+	// No confirmations expected or nothing to shrink
+	EXPECT_EQ(12, suspicionTimeout(2, 12, 5, 0));
+	EXPECT_EQ(2, suspicionTimeout(12, 2, 5, 3));
+}
+
+
+TEST(TestSuspicion, gossipStartsSuspicion) {
+	auto model = makeModel(makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations));
+	model = update(std::move(model), AddPeer{anyAddress(2), {{2}, 3}, 8});
+	model = update(std::move(model), AddPeer{anyAddress(3), {{3}, 0}, 8});
+	model = update(std::move(model), PronouncePeerDead{{{3}, 0}});
+	model = update(std::move(model), kTick);
+
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{5}});
+	auto const& peer = *findPeer(model, 1);
+	EXPECT_TRUE(model.isSuspected(peer));
+	EXPECT_FALSE(model.healthy.contains(NodeID{1}));
+	EXPECT_NE(model.suspected.end(), model.suspected.find(NodeID{1}));
+	EXPECT_EQ(kMaxTimeout, model.liveness(peer).ttl);
+	auto const suspicion = findSuspicion(model, 1);
+	ASSERT_NE(nullptr, suspicion);
+	EXPECT_EQ(1, suspicion->since);
+	EXPECT_EQ(kMaxTimeout, suspicion->timeout);
+	EXPECT_EQ(0, suspicion->confirmations());
+
+	// Suspicions of an earlier generation, of dead and unknown peers are ignored
+	model = update(std::move(model), SuspectPeer{{{2}, 2}, NodeID{5}});
+	EXPECT_TRUE(model.isAlive(*findPeer(model, 2)));
+	model = update(std::move(model), SuspectPeer{{{3}, 0}, NodeID{5}});
+	EXPECT_TRUE(model.isDead(*findPeer(model, 3)));
+	model = update(std::move(model), SuspectPeer{{{4}, 0}, NodeID{5}});
+	EXPECT_EQ(nullptr, findPeer(model, 4));
+
+	// Suspicion is dropped along with the peer
+	model = update(std::move(model), ForgetPeer{{1}});
+	EXPECT_EQ(nullptr, findSuspicion(model, 1));
+}
+
+
+TEST(TestSuspicion, confirmationsShrinkTimeout) {
+	auto model = makeModel(makeSettings(2, kMaxTimeout, kExpectedConfirmations));
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{5}});
+	model = update(std::move(model), kTick);
+	model = update(std::move(model), kTick);
+	ASSERT_EQ(kMaxTimeout - 2, model.liveness(*findPeer(model, 1)).ttl);
+
+	// First confirmation: timeout of 7 ticks, 2 of which have passed
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{6}});
+	EXPECT_EQ(1, findSuspicion(model, 1)->confirmations());
+	EXPECT_EQ(5, model.liveness(*findPeer(model, 1)).ttl);
+
+	// Repeated suspicions are not independent confirmations
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{6}});
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{5}});
+	EXPECT_EQ(1, findSuspicion(model, 1)->confirmations());
+	EXPECT_EQ(5, model.liveness(*findPeer(model, 1)).ttl);
+
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{7}});
+	EXPECT_EQ(3, model.liveness(*findPeer(model, 1)).ttl);
+
+	// All confirmations expected are in: min timeout has passed already
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{8}});
+	EXPECT_EQ(0, model.liveness(*findPeer(model, 1)).ttl);
+	EXPECT_TRUE(model.isSuspected(*findPeer(model, 1)));
+
+	model = update(std::move(model), kTick);
+	EXPECT_TRUE(isDeclaredDead(model, 1));
+}
+
+
+TEST(TestSuspicion, loneObserverGetsFullTimeout) {
+	auto const settings = makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations);
+	auto lazySettings = settings;
+	lazySettings.lazyDecay = true;
+	lazySettings.peerInfoDecayTimeMs = kSuspectingTick.decayTimeMs;
+	lazySettings.peerInfoDecayRate = kSuspectingTick.decayRate;
+
+	// Peer with no TTL left is suspected by the decay, whichever way it is decayed
+	auto eager = makeModel(settings, 0);
+	auto lazy = makeModel(lazySettings, 0);
+	auto timed = makeModel(settings, 0);
+
+	DecayScheduler scheduler{kSuspectingTick.decayTimeMs, kSuspectingTick.decayRate, kSuspectingTick.mode};
+	scheduler.track(timed);
+
+	for (PeersModel::Tick tick = 1; tick <= kMaxTimeout; ++tick) {
+		eager = update(std::move(eager), DecayPeerInfo{kSuspectingTick});
+		lazy = update(std::move(lazy), DecayPeerInfo{kSuspectingTick});
+		timed = scheduler.tick(std::move(timed));
+
+		EXPECT_TRUE(eager.isSuspected(*findPeer(eager, 1))) << "tick " << tick;
+		EXPECT_TRUE(lazy.isSuspected(*findPeer(lazy, 1))) << "tick " << tick;
+		EXPECT_TRUE(timed.isSuspected(*findPeer(timed, 1))) << "tick " << tick;
+	}
+
+	auto const suspicion = findSuspicion(eager, 1);
+	ASSERT_NE(nullptr, suspicion);
+	EXPECT_EQ(1, suspicion->since);
+	EXPECT_EQ(kMaxTimeout, suspicion->timeout);
+	EXPECT_EQ(eager.node.id, suspicion->suspecters[0]);
+	EXPECT_NE(nullptr, findSuspicion(lazy, 1));
+	EXPECT_NE(nullptr, findSuspicion(timed, 1));
+
+	eager = update(std::move(eager), DecayPeerInfo{kSuspectingTick});
+	lazy = update(std::move(lazy), DecayPeerInfo{kSuspectingTick});
+	timed = scheduler.tick(std::move(timed));
+	EXPECT_TRUE(isDeclaredDead(eager, 1));
+	EXPECT_TRUE(isDeclaredDead(lazy, 1));
+	EXPECT_TRUE(isDeclaredDead(timed, 1));
+
+	// Suspicions of peers declared dead are dropped
+	EXPECT_TRUE(eager.suspicions.empty());
+	EXPECT_TRUE(lazy.suspicions.empty());
+	EXPECT_TRUE(timed.suspicions.empty());
+}
+
+
+TEST(TestSuspicion, catchUpStartsSuspicionAtTheTickOfIt) {
+	// Exponential decay that has a peer certainly alive suspected at the 3rd tick
+	constexpr DecayPeerInfo kExpTick{1, 1000, 0.15f, DecayMode::Exponential};
+
+	auto lazySettings = makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations);
+	lazySettings.lazyDecay = true;
+	lazySettings.peerInfoDecayTimeMs = kExpTick.decayTimeMs;
+	lazySettings.peerInfoDecayRate = kExpTick.decayRate;
+
+	// TTL runs out before the suspicion, during it, or after the suspicion timeout
+	for (uint16 ttl : {0, 2, 8, 20}) {
+		for (uint16 ticks = 1; ticks <= 24; ++ticks) {
+			auto stepped = makeModel(makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations), ttl);
+			for (uint16 i = 0; i < ticks; ++i) {
+				stepped = update(std::move(stepped), DecayPeerInfo{kExpTick});
+			}
+
+			auto caughtUp = makeModel(makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations), ttl);
+			caughtUp = update(std::move(caughtUp), DecayPeerInfo{ticks, kExpTick.decayTimeMs, kExpTick.decayRate,
+																  kExpTick.mode});
+
+			auto lazy = makeModel(lazySettings, ttl);
+			lazy = update(std::move(lazy), DecayPeerInfo{ticks, kExpTick.decayTimeMs, kExpTick.decayRate,
+														  kExpTick.mode});
+
+			auto const expected = findPeer(stepped, 1);
+			auto const message = "ttl " + std::to_string(ttl) + ", ticks " + std::to_string(ticks);
+			for (auto const* model : {&caughtUp, &lazy}) {
+				auto const peer = findPeer(*model, 1);
+				ASSERT_EQ(expected == nullptr, peer == nullptr) << message;
+				if (!expected) {
+					continue;
+				}
+
+				auto const expectedLiveness = stepped.liveness(*expected);
+				auto const liveness = model->liveness(*peer);
+				EXPECT_EQ(expectedLiveness.state, liveness.state) << message;
+				EXPECT_EQ(expectedLiveness.ttl, liveness.ttl) << message;
+				EXPECT_NEAR(expectedLiveness.probabitily, liveness.probabitily, 1e-5) << message;
+			}
+
+			// Suspicion is recorded as of the tick the peer has become suspected at
+			auto const expectedSuspicion = findSuspicion(stepped, 1);
+			auto const suspicion = findSuspicion(caughtUp, 1);
+			ASSERT_EQ(expectedSuspicion == nullptr, suspicion == nullptr) << message;
+			if (expectedSuspicion) {
+				EXPECT_EQ(3, expectedSuspicion->since) << message;
+				EXPECT_EQ(expectedSuspicion->since, suspicion->since) << message;
+				EXPECT_EQ(expectedSuspicion->timeout, suspicion->timeout) << message;
+			}
+		}
+	}
+}
+
+
+TEST(TestSuspicion, newerGenerationRefutesSuspicion) {
+	auto model = makeModel(makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations));
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{5}});
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{6}});
+
+	// Same generation does not refute the suspicion
+	model = update(std::move(model), UpdatePeerGeneration{{1}, 0, 8});
+	EXPECT_TRUE(model.isSuspected(*findPeer(model, 1)));
+
+	model = update(std::move(model), UpdatePeerGeneration{{1}, 1, 8});
+	auto const& peer = *findPeer(model, 1);
+	EXPECT_TRUE(model.isAlive(peer));
+	EXPECT_TRUE(model.healthy.contains(NodeID{1}));
+	EXPECT_TRUE(model.suspected.empty());
+	EXPECT_EQ(nullptr, findSuspicion(model, 1));
+
+	// Suspicion of the refuted generation is stale
+	model = update(std::move(model), SuspectPeer{{{1}, 0}, NodeID{7}});
+	EXPECT_TRUE(model.isAlive(*findPeer(model, 1)));
+}
+
+
+TEST(TestSuspicion, detectionLatencyAgainstFalsePositives) {
+	constexpr uint32 kRuns = 500;
+
+	auto const fixedShort = simulate(makeSettings(kMinTimeout, kMinTimeout, 0), kRuns);
+	auto const fixedLong = simulate(makeSettings(kMaxTimeout, kMaxTimeout, 0), kRuns);
+	auto const confirmed = simulate(makeSettings(kMinTimeout, kMaxTimeout, kExpectedConfirmations), kRuns);
+
+	auto const describe = [](Tradeoff const& value) {
+		return "latency " + std::to_string(value.detectionLatency) +
+				", false positives " + std::to_string(value.falsePositiveRate);
+	};
+	::testing::Test::RecordProperty("fixedShort", describe(fixedShort));
+	::testing::Test::RecordProperty("fixedLong", describe(fixedLong));
+	::testing::Test::RecordProperty("confirmed", describe(confirmed));
+
+	// Fixed timeouts trade detection latency for false positives
+	EXPECT_NEAR(kMinTimeout, fixedShort.detectionLatency, 1e-9);
+	EXPECT_NEAR(kMaxTimeout, fixedLong.detectionLatency, 1e-9);
+	EXPECT_GT(fixedShort.falsePositiveRate, 2 * fixedLong.falsePositiveRate);
+
+	// Lone slow observer gets no confirmations: false positives are as rare as with the long timeout,
+	// while true failures, confirmed by the rest of the group, are declared much faster.
+	EXPECT_NEAR(fixedLong.falsePositiveRate, confirmed.falsePositiveRate, 1e-9);
+	EXPECT_LT(confirmed.detectionLatency, fixedLong.detectionLatency / 2);
+}
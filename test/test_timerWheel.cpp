@@ -0,0 +1,150 @@
+/*
+*  Copyright 2019 Ivan Ryabov
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*/
+/*******************************************************************************
+ * libTribe Unit Test Suit
+ *	@file test/test_timerWheel.cpp
+ *	@brief		Test suit for tribe::TimerWheel
+ ******************************************************************************/
+#include "tribe/timerWheel.hpp"    // Class being tested.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+
+using namespace tribe;
+
+
+namespace {
+
+/// Advance the wheel up to the given tick and collect (tick, value) of expired timers
+std::vector<std::pair<TimerWheel<int>::Tick, int>>
+runUntil(TimerWheel<int>& wheel, TimerWheel<int>::Tick until) {
+	std::vector<std::pair<TimerWheel<int>::Tick, int>> fired;
+	while (wheel.now() < until) {
+		wheel.advance([&](TimerWheel<int>::Timer&& timer) {
+			EXPECT_EQ(timer.deadline, wheel.now());
+			fired.emplace_back(wheel.now(), timer.value);
+		});
+	}
+
+	return fired;
+}
+
+}  // namespace
+
+
+TEST(TimerWheel, empty) {
+	TimerWheel<int> wheel;
+	EXPECT_TRUE(wheel.empty());
+	EXPECT_EQ(0, wheel.now());
+
+	EXPECT_TRUE(runUntil(wheel, 100).empty());
+	EXPECT_EQ(100, wheel.now());
+}
+
+
+TEST(TimerWheel, expiresOnDeadline) {
+	TimerWheel<int> wheel;
+	wheel.schedule(1, 3);
+	wheel.schedule(2, 1);
+	wheel.schedule(3, 3);
+	EXPECT_EQ(3, wheel.size());
+
+	auto const fired = runUntil(wheel, 10);
+	ASSERT_EQ(3, fired.size());
+	EXPECT_EQ(std::make_pair(TimerWheel<int>::Tick{1}, 2), fired[0]);
+	EXPECT_EQ(3, fired[1].first);
+	EXPECT_EQ(3, fired[2].first);
+	EXPECT_TRUE(wheel.empty());
+}
+
+
+TEST(TimerWheel, pastDeadlineExpiresNextTick) {
+	TimerWheel<int> wheel{10};
+	wheel.schedule(1, 3);
+	wheel.schedule(2, 10);
+
+	auto const fired = runUntil(wheel, 11);
+	ASSERT_EQ(2, fired.size());
+	EXPECT_EQ(11, fired[0].first);
+	EXPECT_EQ(11, fired[1].first);
+}
+
+
+TEST(TimerWheel, cascadesLongTimers) {
+	TimerWheel<int> wheel{5};
+	wheel.schedule(1, 64);
+	wheel.schedule(2, 64 * 64 + 7);
+	wheel.schedule(3, 64 * 64 * 64 * 3 + 1);
+
+	auto const fired = runUntil(wheel, 64 * 64 * 64 * 4);
+	ASSERT_EQ(3, fired.size());
+	EXPECT_EQ(std::make_pair(TimerWheel<int>::Tick{64}, 1), fired[0]);
+	EXPECT_EQ(std::make_pair(TimerWheel<int>::Tick{64 * 64 + 7}, 2), fired[1]);
+	EXPECT_EQ(std::make_pair(TimerWheel<int>::Tick{64 * 64 * 64 * 3 + 1}, 3), fired[2]);
+}
+
+
+TEST(TimerWheel, beyondHorizon) {
+	auto const deadline = TimerWheel<int>::kHorizon + 100;
+
+	TimerWheel<int> wheel{3};
+	wheel.schedule(42, deadline);
+
+	auto const fired = runUntil(wheel, deadline + 1);
+	ASSERT_EQ(1, fired.size());
+	EXPECT_EQ(deadline, fired[0].first);
+}
+
+
+TEST(TimerWheel, scheduleFromCallback) {
+	TimerWheel<int> wheel;
+	wheel.schedule(0, 1);
+
+	std::vector<TimerWheel<int>::Tick> fired;
+	while (wheel.now() < 1000) {
+		wheel.advance([&](TimerWheel<int>::Timer&& timer) {
+			fired.push_back(wheel.now());
+			wheel.schedule(timer.value + 1, wheel.now() + 100);
+		});
+	}
+
+	ASSERT_EQ(10, fired.size());
+	for (std::size_t i = 0; i < fired.size(); ++i) {
+		EXPECT_EQ(1 + 100*i, fired[i]);
+	}
+}
+
+
+TEST(TimerWheel, randomDeadlines) {
+	std::mt19937 gen{7};
+	std::uniform_int_distribution<TimerWheel<int>::Tick> dist{1, 300000};
+
+	TimerWheel<int> wheel;
+	std::vector<TimerWheel<int>::Tick> deadlines;
+	for (int i = 0; i < 500; ++i) {
+		deadlines.push_back(dist(gen));
+		wheel.schedule(i, deadlines.back());
+	}
+
+	auto const fired = runUntil(wheel, 300000);
+	ASSERT_EQ(deadlines.size(), fired.size());
+	for (auto const& f : fired) {
+		EXPECT_EQ(deadlines[f.second], f.first);
+	}
+}